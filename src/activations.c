@@ -1,37 +1,80 @@
 #include "activations.h"
+#include "simd.h"
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 Activation* activation_relu(void) {
     Activation* act = malloc(sizeof(Activation));
     act->type = ACTIVATION_RELU;
-    act->input_cache = NULL;  // Will be filled during forward pass
-    act->output_cache = NULL;
+    act->output_cache = NULL;  // Will be filled during forward pass
+    act->mask = NULL;
+    act->mask_size = 0;
+    act->mask_words = 0;
     return act;
 }
 
 Activation* activation_softmax(void) {
     Activation* act = malloc(sizeof(Activation));
     act->type = ACTIVATION_SOFTMAX;
-    act->input_cache = NULL;  // Will be filled during forward pass
-    act->output_cache = NULL;
+    act->output_cache = NULL;  // Will be filled during forward pass
+    act->mask = NULL;
+    act->mask_size = 0;
+    act->mask_words = 0;
     return act;
 }
 
 void activation_free(Activation* act) {
     if (act == NULL) return;
 
-    if (act->input_cache != NULL) {
-        tensor_free(act->input_cache);
-    }
-
     if (act->output_cache != NULL) {
         tensor_free(act->output_cache);
     }
 
+    free(act->mask);
+    if (act->mask_words > 0) mem_track_free(MEM_ACTIVATIONS, act->mask_words * sizeof(uint64_t));
+
     free(act);
 }
 
+// gi = g where the bit is set, else 0, for the n <= 64 elements of one mask word
+static void relu_mask_backward(const float* g, float* gi, uint64_t word, size_t n) {
+    const i32x4 lane_bits = {1, 2, 4, 8};
+    const i32x4 none = {0, 0, 0, 0};
+    size_t b = 0;
+    for (; b + SIMD_WIDTH <= n; b += SIMD_WIDTH) {
+        int32_t nibble = (int32_t)(word >> b & 15);
+        i32x4 keep = ((i32x4){nibble, nibble, nibble, nibble} & lane_bits) != none;
+        f32x4_store(gi + b, (f32x4)(keep & (i32x4)f32x4_load(g + b)));
+    }
+    for (; b < n; b++) gi[b] = (word >> b & 1) ? g[b] : 0.0f;
+}
+
+// out = max(x, 0) for n floats, setting mask bit i where x[i] > 0; 64 elements per mask word
+static void relu_mask_forward(const float* x, float* out, uint64_t* mask, size_t n) {
+    const f32x4 zero = f32x4_set1(0.0f);
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        uint64_t word = 0;
+        for (size_t v = 0; v < 64; v += SIMD_WIDTH) {
+            f32x4 x4 = f32x4_load(x + i + v);
+            i32x4 keep = x4 > zero;
+            f32x4_store(out + i + v, (f32x4)(keep & (i32x4)x4));
+            word |= (uint64_t)f32x4_positive_mask(x4) << v;
+        }
+        mask[i / 64] = word;
+    }
+    if (i < n) {
+        uint64_t word = 0;
+        for (size_t b = 0; i + b < n; b++) {
+            int keep = x[i + b] > 0.0f;
+            out[i + b] = keep ? x[i + b] : 0.0f;
+            word |= (uint64_t)keep << b;
+        }
+        mask[i / 64] = word;
+    }
+}
+
 Tensor* activation_forward(Activation* act, const Tensor* input) {
     if (act == NULL || input == NULL) return NULL;
 
@@ -39,21 +82,24 @@ Tensor* activation_forward(Activation* act, const Tensor* input) {
 
         //output tensor
         Tensor* output = tensor_create(input->shape, input->ndim);
-
-        for (size_t i = 0; i < input->size; i++) {
-            output->data[i] = (input->data[i] > 0) ? input->data[i] : 0.0f;
-        }
-
-        if (act->input_cache != NULL) {
-            tensor_free(act->input_cache);
-        }
-
-        if (act->output_cache != NULL) {
-            tensor_free(act->output_cache);
+        if (output == NULL) return NULL;
+
+        // backward only asks whether each input was positive, so that's all that's kept: a bit each
+        size_t words = (input->size + 63) / 64;
+        if (words > act->mask_words) {
+            uint64_t* mask = malloc(words * sizeof(uint64_t));
+            if (mask == NULL) {
+                tensor_free(output);
+                return NULL;
+            }
+            free(act->mask);
+            if (act->mask_words > 0) mem_track_free(MEM_ACTIVATIONS, act->mask_words * sizeof(uint64_t));
+            mem_track_alloc(MEM_ACTIVATIONS, words * sizeof(uint64_t));
+            act->mask = mask;
+            act->mask_words = words;
         }
-
-        act->input_cache = tensor_copy(input);
-        act->output_cache = tensor_copy(output);
+        relu_mask_forward(input->data, output->data, act->mask, input->size);
+        act->mask_size = input->size;
 
         return output;
     }
@@ -92,8 +138,13 @@ Tensor* activation_forward(Activation* act, const Tensor* input) {
             }
         }
 
-        act->input_cache = tensor_copy(input);
+        // backward is written in terms of the output alone
+        if (act->output_cache != NULL) {
+            tensor_free(act->output_cache);
+        }
+        MemCategory prev = mem_set_category(MEM_ACTIVATIONS);
         act->output_cache = tensor_copy(output);
+        mem_set_category(prev);
 
         return output;
     }
@@ -107,26 +158,37 @@ Tensor* activation_backward(Activation* act, const Tensor* grad_output) {
     // validate
     if (act == NULL || grad_output == NULL) return NULL;
 
-    if (act->input_cache == NULL || act->output_cache == NULL) return NULL;
-
-    if (grad_output->ndim != act->output_cache->ndim) return NULL;
-    for (size_t i = 0; i < grad_output->ndim; i++) {
-        if (grad_output->shape[i] != act->output_cache->shape[i]) return NULL;
-    }
-
     // switch
     if (act->type == ACTIVATION_RELU) {
+        if (act->mask == NULL || grad_output->size != act->mask_size) return NULL;
+
         Tensor* grad_input = tensor_create(grad_output->shape, grad_output->ndim);
         if (grad_input == NULL) return NULL;
 
-        // gradient passes through where input > 0, everything else 0
-        for (size_t i = 0; i < grad_output->size; i++) {
-            grad_input->data[i] = (act->input_cache->data[i] > 0.0f) ? grad_output->data[i] : 0.0f;
+        // gradient passes through where input > 0, everything else 0; whole words of one kind skip the bit tests
+        const float* g = grad_output->data;
+        float* gi = grad_input->data;
+        for (size_t i = 0; i < grad_output->size; i += 64) {
+            uint64_t word = act->mask[i / 64];
+            size_t n = grad_output->size - i < 64 ? grad_output->size - i : 64;
+            if (word == 0) {
+                memset(gi + i, 0, n * sizeof(float));
+            } else if (word == UINT64_MAX) {
+                memcpy(gi + i, g + i, n * sizeof(float));
+            } else {
+                relu_mask_backward(g + i, gi + i, word, n);
+            }
         }
 
         return grad_input;
     }
 
+    if (act->output_cache == NULL) return NULL;
+    if (grad_output->ndim != act->output_cache->ndim) return NULL;
+    for (size_t i = 0; i < grad_output->ndim; i++) {
+        if (grad_output->shape[i] != act->output_cache->shape[i]) return NULL;
+    }
+
     if (act->type == ACTIVATION_SOFTMAX) {
         Tensor* grad_input = tensor_create(grad_output->shape, grad_output->ndim);
         if (grad_input == NULL) return NULL;
@@ -1,6 +1,7 @@
 #ifndef ACTIVATIONS_H
 #define ACTIVATIONS_H
 
+#include <stdint.h>
 #include "tensor.h"
 
 typedef struct {
@@ -9,8 +10,12 @@ typedef struct {
         ACTIVATION_SOFTMAX,
         ACTIVATION_NONE
     } type;
-    Tensor* input_cache;
-    Tensor* output_cache;
+    // what backward needs and no more: relu keeps one bit per element (input > 0),
+    // softmax its output. both are accounted as MEM_ACTIVATIONS
+    Tensor* output_cache;   // softmax
+    uint64_t* mask;         // relu: bit i % 64 of word i / 64 is set where input i was > 0
+    size_t mask_size;       // relu: elements the mask covers
+    size_t mask_words;      // allocated, reused while the batch fits
 } Activation;
 
 Activation* activation_relu(void);
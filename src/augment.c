@@ -0,0 +1,135 @@
+#include "augment.h"
+#include "parallel.h"
+#include "rng.h"
+#include "simd.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define AUGMENT_GRAIN 8   // samples per parallel chunk
+#define ELASTIC_GRID 4    // the elastic field is bilinear over a (GRID+1)^2 lattice of random offsets
+#define AUGMENT_PI 3.14159265358979f
+
+typedef struct {
+    const AugmentConfig* cfg;
+    Tensor* x;
+    uint64_t stream;
+} AugmentJob;
+
+int augment_enabled(const AugmentConfig* cfg) {
+    if (cfg == NULL || cfg->width == 0 || cfg->height == 0) return 0;
+    return cfg->max_shift > 0.0f || cfg->max_rotate_deg > 0.0f ||
+           cfg->max_scale > 0.0f || cfg->elastic > 0.0f;
+}
+
+static float uniform_pm(Rng* rng, float range) {
+    return (2.0f * rng_uniform(rng) - 1.0f) * range;
+}
+
+static float sample_bilinear(const float* src, size_t w, size_t h, float sx, float sy) {
+    float fx = floorf(sx), fy = floorf(sy);
+    long x0 = (long)fx, y0 = (long)fy;
+    float ax = sx - fx, ay = sy - fy;
+
+    float v = 0.0f;
+    for (int dy = 0; dy <= 1; dy++) {
+        long yy = y0 + dy;
+        if (yy < 0 || yy >= (long)h) continue;
+        float wy = dy ? ay : 1.0f - ay;
+        for (int dx = 0; dx <= 1; dx++) {
+            long xx = x0 + dx;
+            if (xx < 0 || xx >= (long)w) continue;
+            float wx = dx ? ax : 1.0f - ax;
+            v += wx * wy * src[yy * (long)w + xx];
+        }
+    }
+    return v;
+}
+
+// warp one image in place; src is scratch of w * h floats
+static void augment_one(const AugmentConfig* cfg, float* img, float* src, Rng* rng) {
+    size_t w = cfg->width, h = cfg->height;
+    memcpy(src, img, w * h * sizeof(float));
+
+    float angle = uniform_pm(rng, cfg->max_rotate_deg) * AUGMENT_PI / 180.0f;
+    float scale = 1.0f + uniform_pm(rng, cfg->max_scale);
+    float tx = uniform_pm(rng, cfg->max_shift);
+    float ty = uniform_pm(rng, cfg->max_shift);
+
+    float grid_x[ELASTIC_GRID + 1][ELASTIC_GRID + 1];
+    float grid_y[ELASTIC_GRID + 1][ELASTIC_GRID + 1];
+    for (int i = 0; i <= ELASTIC_GRID; i++) {
+        for (int j = 0; j <= ELASTIC_GRID; j++) {
+            grid_x[i][j] = uniform_pm(rng, cfg->elastic);
+            grid_y[i][j] = uniform_pm(rng, cfg->elastic);
+        }
+    }
+
+    // output pixel -> source pixel is the inverse warp: undo shift, then rotation and scale about the centre
+    float a = cosf(angle) / scale;
+    float b = sinf(angle) / scale;
+    float cx = 0.5f * (float)(w - 1), cy = 0.5f * (float)(h - 1);
+    float gx_step = (float)ELASTIC_GRID / (float)(w > 1 ? w - 1 : 1);
+    float gy_step = (float)ELASTIC_GRID / (float)(h > 1 ? h - 1 : 1);
+
+    f32x4 va = f32x4_set1(a), vb = f32x4_set1(b);
+    f32x4 vcx = f32x4_set1(cx), vcy = f32x4_set1(cy);
+    f32x4 lane = {0.0f, 1.0f, 2.0f, 3.0f};
+
+    float sx[SIMD_WIDTH], sy[SIMD_WIDTH];
+    for (size_t y = 0; y < h; y++) {
+        // elastic offsets: interpolate the lattice rows bracketing this image row once
+        float gy = (float)y * gy_step;
+        int gi = (int)gy;
+        if (gi >= ELASTIC_GRID) gi = ELASTIC_GRID - 1;
+        float fy = gy - (float)gi;
+        float row_x[ELASTIC_GRID + 1], row_y[ELASTIC_GRID + 1];
+        for (int j = 0; j <= ELASTIC_GRID; j++) {
+            row_x[j] = (1.0f - fy) * grid_x[gi][j] + fy * grid_x[gi + 1][j];
+            row_y[j] = (1.0f - fy) * grid_y[gi][j] + fy * grid_y[gi + 1][j];
+        }
+
+        f32x4 dy = f32x4_set1((float)y - cy - ty);
+        for (size_t x = 0; x < w; x += SIMD_WIDTH) {
+            // affine part four pixels at a time
+            f32x4 dx = (lane + (float)x) - vcx - tx;
+            f32x4_store(sx, va * dx + vb * dy + vcx);
+            f32x4_store(sy, va * dy - vb * dx + vcy);
+
+            size_t n = (x + SIMD_WIDTH <= w) ? SIMD_WIDTH : w - x;
+            for (size_t l = 0; l < n; l++) {
+                float gx = (float)(x + l) * gx_step;
+                int gj = (int)gx;
+                if (gj >= ELASTIC_GRID) gj = ELASTIC_GRID - 1;
+                float fx = gx - (float)gj;
+                float ex = (1.0f - fx) * row_x[gj] + fx * row_x[gj + 1];
+                float ey = (1.0f - fx) * row_y[gj] + fx * row_y[gj + 1];
+                img[y * w + x + l] = sample_bilinear(src, w, h, sx[l] + ex, sy[l] + ey);
+            }
+        }
+    }
+}
+
+static void augment_range(void* ctx, size_t begin, size_t end) {
+    const AugmentJob* job = ctx;
+    const AugmentConfig* cfg = job->cfg;
+    size_t len = cfg->width * cfg->height;
+
+    float* scratch = malloc(len * sizeof(float));
+    if (scratch == NULL) return;  // leave these samples unaugmented rather than fail the batch
+
+    for (size_t i = begin; i < end; i++) {
+        Rng rng;
+        rng_seed(&rng, cfg->seed ^ (job->stream * 0x9e3779b97f4a7c15ull) ^ ((uint64_t)(i + 1) * 0xd1b54a32d192ed03ull));
+        augment_one(cfg, job->x->data + i * job->x->strides[0], scratch, &rng);
+    }
+    free(scratch);
+}
+
+void augment_batch(const AugmentConfig* cfg, Tensor* x, uint64_t stream) {
+    if (!augment_enabled(cfg) || x == NULL || x->ndim != 2) return;
+    if (x->shape[1] != cfg->width * cfg->height) return;
+
+    AugmentJob job = { cfg, x, stream };
+    parallel_for(x->shape[0], AUGMENT_GRAIN, augment_range, &job);
+}
@@ -0,0 +1,35 @@
+#ifndef AUGMENT_H
+#define AUGMENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tensor.h"
+
+/**
+ * Randomized per-sample image augmentation, applied in place to a batch of
+ * flattened single-channel images while it's being assembled.
+ *
+ * Each sample gets a random affine warp (rotation, scale, shift around the
+ * image centre) plus a smooth "elastic" displacement field, resampled with
+ * bilinear interpolation; pixels mapped from outside the image read as 0.
+ * Transforms are drawn from (seed, epoch, sample position), so a run is
+ * reproducible no matter how the work is split across threads.
+ */
+typedef struct {
+    size_t width;           // image geometry of each row; 0 disables augmentation
+    size_t height;
+    float max_shift;        // pixels, uniform in [-max_shift, max_shift] per axis
+    float max_rotate_deg;   // uniform in [-max_rotate_deg, max_rotate_deg]
+    float max_scale;        // zoom factor uniform in [1 - max_scale, 1 + max_scale]
+    float elastic;          // peak displacement of the elastic field, in pixels
+    uint64_t seed;
+} AugmentConfig;
+
+// Nonzero when cfg describes at least one transform for a known image size
+int augment_enabled(const AugmentConfig* cfg);
+
+// Augment every row of x ([rows, width * height]). `stream` identifies the batch
+// (e.g. epoch * batches_per_epoch + index) so each one draws different transforms.
+void augment_batch(const AugmentConfig* cfg, Tensor* x, uint64_t stream);
+
+#endif // AUGMENT_H
@@ -0,0 +1,390 @@
+#include "autotune.h"
+#include "parallel.h"
+#include "timer.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define AUTOTUNE_MAX_ROWS 256   // rows of a a class is timed on; bigger batches only repeat row blocks
+#define AUTOTUNE_REPS 3         // timed calls per candidate after one warm-up; the fastest counts
+#define AUTOTUNE_MAX_PENDING 16
+
+typedef enum { ENTRY_PENDING, ENTRY_TUNING, ENTRY_READY } EntryState;
+
+typedef struct {
+    size_t m, n, k;         // the class: each rounded up to a power of two
+    int transposed;
+    EntryState state;
+    GemmTiling tiling;      // once ready
+    size_t shape[3];        // first m, n, k seen in the class, which it's tuned on
+} Entry;
+
+static struct {
+    pthread_mutex_t lock;
+    int loaded;
+    int enabled;
+    Entry* entries;
+    size_t num_entries;
+    size_t capacity;
+    char* foreign;          // cache lines measured on other CPUs, written back as they were
+    char path[1024];
+    int path_set;           // autotune_set_cache_path chose the path, whatever the environment says
+    int default_path;       // path is the ~/.cache default
+    char cpu[256];
+} tune = { .lock = PTHREAD_MUTEX_INITIALIZER, .enabled = 1 };
+
+static size_t round_pow2(size_t x) {
+    size_t p = 1;
+    while (p < x) p <<= 1;
+    return p;
+}
+
+static void read_cpu_model(char* out, size_t size) {
+    snprintf(out, size, "unknown");
+    FILE* f = fopen("/proc/cpuinfo", "r");
+    if (f == NULL) return;
+    char line[512];
+    char part[128] = "";
+    while (fgets(line, sizeof line, f) != NULL) {
+        char* colon = strchr(line, ':');
+        if (colon == NULL) continue;
+        char* value = colon + 1;
+        while (*value == ' ' || *value == '\t') value++;
+        value[strcspn(value, "\n")] = '\0';
+        // x86 names the model; arm only gives implementer and part numbers
+        if (strncmp(line, "model name", 10) == 0) {
+            snprintf(out, size, "%s", value);
+            break;
+        }
+        if (strncmp(line, "CPU part", 8) == 0 && part[0] == '\0') snprintf(part, sizeof part, "arm part %s", value);
+    }
+    fclose(f);
+    if (strcmp(out, "unknown") == 0 && part[0] != '\0') snprintf(out, size, "%s", part);
+}
+
+static Entry* find(size_t m, size_t n, size_t k, int transposed) {
+    for (size_t i = 0; i < tune.num_entries; i++) {
+        Entry* e = &tune.entries[i];
+        if (e->m == m && e->n == n && e->k == k && e->transposed == transposed) return e;
+    }
+    return NULL;
+}
+
+static Entry* add(size_t m, size_t n, size_t k, int transposed) {
+    if (tune.num_entries == tune.capacity) {
+        size_t cap = tune.capacity > 0 ? 2 * tune.capacity : 16;
+        Entry* grown = realloc(tune.entries, cap * sizeof(Entry));
+        if (grown == NULL) return NULL;
+        tune.entries = grown;
+        tune.capacity = cap;
+    }
+    Entry* e = &tune.entries[tune.num_entries++];
+    memset(e, 0, sizeof *e);
+    e->m = round_pow2(m);
+    e->n = round_pow2(n);
+    e->k = round_pow2(k);
+    e->transposed = transposed;
+    e->state = ENTRY_PENDING;
+    e->shape[0] = m;
+    e->shape[1] = n;
+    e->shape[2] = k;
+    return e;
+}
+
+// line has no newline; one is added
+static void append_foreign(const char* line) {
+    size_t old = tune.foreign != NULL ? strlen(tune.foreign) : 0;
+    size_t len = strlen(line);
+    char* grown = realloc(tune.foreign, old + len + 2);
+    if (grown == NULL) return;
+    memcpy(grown + old, line, len);
+    strcpy(grown + old + len, "\n");
+    tune.foreign = grown;
+}
+
+// first use: settings from the environment, then whatever the cache holds for this CPU
+static void load_locked(void) {
+    if (tune.loaded) return;
+    tune.loaded = 1;
+
+    const char* env = getenv("AXIOM_TUNE");
+    if (env != NULL && atoi(env) == 0) tune.enabled = 0;
+    read_cpu_model(tune.cpu, sizeof tune.cpu);
+
+    const char* path = getenv("AXIOM_TUNE_CACHE");
+    const char* home = getenv("HOME");
+    if (tune.path_set) {
+        // already chosen
+    } else if (path != NULL) {
+        snprintf(tune.path, sizeof tune.path, "%s", path);
+    } else if (home != NULL && home[0] != '\0') {
+        snprintf(tune.path, sizeof tune.path, "%s/.cache/axiom_gemm.tune", home);
+        tune.default_path = 1;
+    }
+    if (tune.path[0] == '\0') return;
+
+    FILE* f = fopen(tune.path, "r");
+    if (f == NULL) return;
+    char line[512];
+    while (fgets(line, sizeof line, f) != NULL) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        size_t m, n, k, kc, mc, threads;
+        int transposed, pos = 0;
+        if (sscanf(line, "%zu %zu %zu %d %zu %zu %zu %n", &m, &n, &k, &transposed, &kc, &mc, &threads, &pos) != 7 ||
+            pos == 0) {
+            continue;
+        }
+        char* cpu = line + pos;
+        cpu[strcspn(cpu, "\n")] = '\0';
+        if (strcmp(cpu, tune.cpu) != 0) {
+            append_foreign(line);
+            continue;
+        }
+        Entry* e = find(m, n, k, transposed != 0);
+        if (e == NULL) e = add(m, n, k, transposed != 0);
+        if (e == NULL) break;
+        e->state = ENTRY_READY;
+        e->tiling = (GemmTiling){ .kc = kc, .mc = mc, .threads = threads };
+    }
+    fclose(f);
+}
+
+// written beside the cache and renamed over it, so readers never see half a file
+static void save_locked(void) {
+    if (tune.path[0] == '\0') return;
+    if (tune.default_path) {
+        // the default lives in ~/.cache, which may not exist yet
+        char dir[1024];
+        snprintf(dir, sizeof dir, "%s", tune.path);
+        char* slash = strrchr(dir, '/');
+        if (slash != NULL) {
+            *slash = '\0';
+            mkdir(dir, 0755);
+        }
+    }
+
+    char tmp[1100];
+    snprintf(tmp, sizeof tmp, "%s.tmp", tune.path);
+    FILE* f = fopen(tmp, "w");
+    if (f == NULL) return;
+    fprintf(f, "# axiom gemm tuning cache: m n k transposed kc mc threads cpu\n");
+    if (tune.foreign != NULL) fputs(tune.foreign, f);
+    for (size_t i = 0; i < tune.num_entries; i++) {
+        const Entry* e = &tune.entries[i];
+        if (e->state != ENTRY_READY) continue;
+        fprintf(f, "%zu %zu %zu %d %zu %zu %zu %s\n", e->m, e->n, e->k, e->transposed,
+                e->tiling.kc, e->tiling.mc, e->tiling.threads, tune.cpu);
+    }
+    int failed = ferror(f);
+    if (fclose(f) != 0 || failed || rename(tmp, tune.path) != 0) remove(tmp);
+}
+
+static size_t candidates(size_t m, size_t k, GemmTiling* out) {
+    static const size_t depths[] = { 0, 256, 128, 64 };
+    static const size_t rows[] = { 4, 16, 64, 256 };
+    size_t threads[] = { 1, parallel_num_threads() };
+    size_t num_threads = threads[1] > 1 && m > 4 ? 2 : 1;
+
+    size_t count = 0;
+    for (size_t t = 0; t < num_threads; t++) {
+        for (size_t d = 0; d < sizeof depths / sizeof depths[0]; d++) {
+            if (depths[d] != 0 && depths[d] >= k) continue;
+            for (size_t r = 0; r < sizeof rows / sizeof rows[0]; r++) {
+                if (rows[r] > 4 && rows[r] / 2 >= m) continue;  // one block either way
+                out[count++] = (GemmTiling){ .kc = depths[d], .mc = rows[r], .threads = threads[t] };
+            }
+        }
+    }
+    return count;
+}
+
+// fastest of AUTOTUNE_REPS calls after a warm-up, in microseconds
+static double time_tiling(const Tensor* a, const float* packed, size_t n, const GemmTiling* tiling) {
+    double best = -1.0;
+    for (int rep = 0; rep <= AUTOTUNE_REPS; rep++) {
+        uint64_t start = timer_now_ns();
+        Tensor* c = tensor_matmul_packed(a, packed, n, tiling);
+        double us = (double)(timer_now_ns() - start) / 1e3;
+        if (c == NULL) return -1.0;
+        tensor_free(c);
+        if (rep > 0 && (best < 0.0 || us < best)) best = us;
+    }
+    return best;
+}
+
+// operands for timing an m x n x k product (rows capped at AUTOTUNE_MAX_ROWS), made-up values
+typedef struct {
+    Tensor* a;
+    float* packed;
+    size_t packed_bytes;
+    size_t n;
+} Operands;
+
+static void operands_free(Operands* op) {
+    tensor_free(op->a);
+    free(op->packed);
+    if (op->packed != NULL) mem_track_free(MEM_TEMPORARY, op->packed_bytes);
+}
+
+static int operands_create(Operands* op, size_t m, size_t n, size_t k) {
+    size_t shape[] = { m < AUTOTUNE_MAX_ROWS ? m : AUTOTUNE_MAX_ROWS, k };
+    op->n = n;
+    op->packed_bytes = tensor_packed_size(k, n) * sizeof(float);
+    op->a = tensor_create(shape, 2);
+    op->packed = malloc(op->packed_bytes);
+    if (op->packed != NULL) mem_track_alloc(MEM_TEMPORARY, op->packed_bytes);
+    if (op->a == NULL || op->packed == NULL) {
+        operands_free(op);
+        return -1;
+    }
+    // not tensor_rand: that reseeds the global rand() stream layer init draws from
+    for (size_t i = 0; i < op->a->size; i++) op->a->data[i] = (float)(i % 13) * 0.1f - 0.6f;
+    for (size_t i = 0; i < op->packed_bytes / sizeof(float); i++) op->packed[i] = (float)(i % 7) * 0.1f - 0.3f;
+    return 0;
+}
+
+// times the default and every candidate; the fastest wins, the default on a tie or failure
+static GemmTiling tune_shape(size_t m, size_t n, size_t k, AutotuneResult* result) {
+    GemmTiling best = GEMM_TILING_DEFAULT;
+    memset(result, 0, sizeof *result);
+    result->tiling = best;
+    Operands op;
+    if (operands_create(&op, m, n, k) != 0) return best;
+
+    GemmTiling list[64];
+    size_t count = candidates(op.a->shape[0], k, list);
+    double best_us = time_tiling(op.a, op.packed, n, &best);
+    result->default_us = best_us;
+    for (size_t i = 0; i < count && best_us >= 0.0; i++) {
+        double us = time_tiling(op.a, op.packed, n, &list[i]);
+        if (us >= 0.0 && us < best_us) {
+            best_us = us;
+            best = list[i];
+        }
+    }
+    result->tiling = best;
+    result->tuned_us = best_us;
+    result->candidates = count;
+    operands_free(&op);
+    return best;
+}
+
+// tune every pending class, the lock released meanwhile so other threads keep multiplying on defaults
+static void tune_pending_locked(void) {
+    size_t todo[AUTOTUNE_MAX_PENDING];
+    size_t num_todo = 0;
+    for (size_t i = 0; i < tune.num_entries && num_todo < AUTOTUNE_MAX_PENDING; i++) {
+        if (tune.entries[i].state != ENTRY_PENDING) continue;
+        tune.entries[i].state = ENTRY_TUNING;
+        todo[num_todo++] = i;
+    }
+    if (num_todo == 0) return;
+
+    GemmTiling tilings[AUTOTUNE_MAX_PENDING];
+    for (size_t t = 0; t < num_todo; t++) {
+        size_t shape[3];
+        memcpy(shape, tune.entries[todo[t]].shape, sizeof shape);  // entries may move once unlocked
+        pthread_mutex_unlock(&tune.lock);
+        AutotuneResult r;
+        tilings[t] = tune_shape(shape[0], shape[1], shape[2], &r);
+        pthread_mutex_lock(&tune.lock);
+    }
+    for (size_t t = 0; t < num_todo; t++) {
+        tune.entries[todo[t]].tiling = tilings[t];
+        tune.entries[todo[t]].state = ENTRY_READY;
+    }
+    save_locked();
+}
+
+GemmTiling autotune_gemm(size_t m, size_t n, size_t k, int transposed) {
+    if ((double)m * (double)n * (double)k < AUTOTUNE_MIN_MACS) return GEMM_TILING_DEFAULT;
+
+    pthread_mutex_lock(&tune.lock);
+    load_locked();
+    Entry* e = find(round_pow2(m), round_pow2(n), round_pow2(k), transposed != 0);
+    if (e == NULL && tune.enabled) e = add(m, n, k, transposed != 0);
+    if (e != NULL && e->state != ENTRY_READY && tune.enabled && !parallel_is_inline()) {
+        size_t index = (size_t)(e - tune.entries);
+        tune_pending_locked();
+        e = &tune.entries[index];
+    }
+    GemmTiling tiling = e != NULL && e->state == ENTRY_READY ? e->tiling : GEMM_TILING_DEFAULT;
+    pthread_mutex_unlock(&tune.lock);
+    return tiling;
+}
+
+int autotune_gemm_now(size_t m, size_t n, size_t k, int transposed, int force, AutotuneResult* result) {
+    AutotuneResult scratch;
+    if (result == NULL) result = &scratch;
+    memset(result, 0, sizeof *result);
+    result->tiling = GEMM_TILING_DEFAULT;
+    if ((double)m * (double)n * (double)k < AUTOTUNE_MIN_MACS) return -1;
+
+    pthread_mutex_lock(&tune.lock);
+    load_locked();
+    Entry* e = find(round_pow2(m), round_pow2(n), round_pow2(k), transposed != 0);
+    if (e == NULL) e = add(m, n, k, transposed != 0);
+    if (e == NULL) {
+        pthread_mutex_unlock(&tune.lock);
+        return -1;
+    }
+    size_t index = (size_t)(e - tune.entries);
+    int cached = e->state == ENTRY_READY && !force;
+    GemmTiling tiling = e->tiling;
+    if (!cached) e->state = ENTRY_TUNING;
+    pthread_mutex_unlock(&tune.lock);
+
+    if (cached) {
+        // nothing to search, but report what the cached tiling buys on this shape
+        Operands op;
+        if (operands_create(&op, m, n, k) == 0) {
+            GemmTiling base = GEMM_TILING_DEFAULT;
+            result->default_us = time_tiling(op.a, op.packed, n, &base);
+            result->tuned_us = time_tiling(op.a, op.packed, n, &tiling);
+            operands_free(&op);
+        }
+        result->tiling = tiling;
+        return 0;
+    }
+
+    tiling = tune_shape(m, n, k, result);
+    pthread_mutex_lock(&tune.lock);
+    tune.entries[index].tiling = tiling;
+    tune.entries[index].state = ENTRY_READY;
+    save_locked();
+    pthread_mutex_unlock(&tune.lock);
+    return 0;
+}
+
+const char* autotune_cache_path(void) {
+    pthread_mutex_lock(&tune.lock);
+    load_locked();
+    pthread_mutex_unlock(&tune.lock);
+    return tune.path;
+}
+
+const char* autotune_cpu_model(void) {
+    pthread_mutex_lock(&tune.lock);
+    load_locked();
+    pthread_mutex_unlock(&tune.lock);
+    return tune.cpu;
+}
+
+void autotune_set_cache_path(const char* path) {
+    pthread_mutex_lock(&tune.lock);
+    snprintf(tune.path, sizeof tune.path, "%s", path != NULL ? path : "");
+    tune.path_set = 1;
+    tune.default_path = 0;
+    pthread_mutex_unlock(&tune.lock);
+}
+
+int autotune_set_enabled(int enable) {
+    pthread_mutex_lock(&tune.lock);
+    load_locked();
+    int old = tune.enabled;
+    tune.enabled = enable != 0;
+    pthread_mutex_unlock(&tune.lock);
+    return old;
+}
@@ -0,0 +1,58 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <stddef.h>
+#include "tensor.h"
+
+/**
+ * GEMM autotuning for tensor_matmul_packed. The best depth block, row block
+ * and thread split depend on the shape and on the CPU's caches, so each shape
+ * class (m, n and k rounded up to powers of two, plus whether the packed
+ * operand is a layer's W or its transpose) is timed over a small set of
+ * candidate tilings the first time it's multiplied, and the winner is used
+ * from then on. Tiling never changes results, only speed.
+ *
+ * Winners persist in a text cache, one line per class, tagged with the CPU
+ * model so a cache shared between machines only applies where it was
+ * measured. It's read on first use and rewritten (atomically) whenever a
+ * class is tuned. The path is $AXIOM_TUNE_CACHE, else
+ * $HOME/.cache/axiom_gemm.tune; an empty AXIOM_TUNE_CACHE keeps it in memory.
+ * AXIOM_TUNE=0 turns tuning on first use off: cached classes are still used,
+ * the rest run GEMM_TILING_DEFAULT. `axiom tune <model>` fills the cache ahead
+ * of time.
+ *
+ * Products below AUTOTUNE_MIN_MACS multiply-adds aren't worth timing and
+ * always use the default.
+ */
+#define AUTOTUNE_MIN_MACS (1u << 16)
+
+// Tiling for a [m, k] x packed [k, n] product (transposed: the packed operand is W^T, as in a
+// dense layer's backward). On a miss it tunes the class now, unless this thread is inside a
+// parallel region (timings there would be serial and contended); then it returns the default and
+// the class is tuned by the next call from a thread that can. Safe to call from any thread.
+GemmTiling autotune_gemm(size_t m, size_t n, size_t k, int transposed);
+
+typedef struct {
+    GemmTiling tiling;
+    double default_us;      // GEMM_TILING_DEFAULT, per call, on the tuned shape
+    double tuned_us;        // the chosen tiling
+    size_t candidates;      // tilings timed; 0 if it came from the cache
+} AutotuneResult;
+
+// Tune the shape's class now, whatever the calling thread, and save the cache. With force = 0
+// a class already tuned is just looked up. Returns 0, or -1 for a product too small to tune.
+int autotune_gemm_now(size_t m, size_t n, size_t k, int transposed, int force, AutotuneResult* result);
+
+// Where the cache lives ("" when it isn't persisted) and the CPU model its entries are keyed by
+const char* autotune_cache_path(void);
+const char* autotune_cpu_model(void);
+
+// Use path for the cache instead of the environment's choice; "" (or NULL) keeps it in memory.
+// Call it before the first GEMM: entries already loaded from another cache stay, and are saved to
+// the new path when the next class is tuned. Tests and benchmarks use "" so they leave no files.
+void autotune_set_cache_path(const char* path);
+
+// Tuning on first use on (1) or off (0); returns the old setting
+int autotune_set_enabled(int enable);
+
+#endif // AUTOTUNE_H
@@ -1,12 +1,65 @@
+#define _POSIX_C_SOURCE 200809L
 #include "axiom.h"
+#include "checkpoint.h"
+#include "checksum.h"
 #include "loss.h"
 #include "optimizer.h"
+#include "dataloader.h"
+#include "parallel.h"
+#include "timer.h"
+#include "trace.h"
+#include <math.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define AXIOM_MAGIC "AXIO"
+#define AXIOM_PREFETCH_BUFFERS 3  // batches the loader may have ready ahead of the training loop
+#define AXIOM_OPT_MAGIC "OPTM"  // optional trailer after the layers: optimizer hyperparameters + state
+#define AXIOM_V2_MAGIC "AXI2"
+#define AXIOM_V2_VERSION 2
+#define AXIOM_BLOB_ALIGN 64
+
+/*
+ * v2 checkpoint: a fixed header, a table with one entry per layer, then every
+ * weight and bias array as a raw float blob starting on a 64-byte boundary,
+ * then optionally the optimizer trailer. Everything is at a fixed offset, so
+ * the file can be mapped and the blobs used in place as layer weights.
+ * The header, the table, each blob and the trailer carry a CRC-32.
+ * v1 ("AXIO") is a plain stream of the same data and still loads.
+ */
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t num_layers;
+    uint32_t table_crc;
+    uint64_t table_offset;
+    uint64_t opt_offset;    // 0 when there is no optimizer trailer
+    uint64_t opt_size;
+    uint64_t file_size;
+    uint32_t opt_crc;
+    uint32_t reserved[2];
+    uint32_t header_crc;    // over every byte before it
+} AxiomFileHeader;
+
+typedef struct {
+    uint32_t type;          // 0 dense, 1 activation, 2 low-rank dense, 3 embedding
+    uint32_t activation;    // 0 relu, 1 softmax; the rank for low-rank layers, whose weights blob is u then v;
+                            // the vocabulary size for embeddings (input_size fields, the table as the weights blob, no biases)
+    uint32_t input_size;
+    uint32_t output_size;
+    uint64_t weights_offset;
+    uint64_t biases_offset;
+    uint32_t weights_crc;
+    uint32_t biases_crc;
+} AxiomLayerEntry;
 
 AxiomNet* axiom_create(void) {
     AxiomNet* net = malloc(sizeof(AxiomNet));
@@ -14,7 +67,24 @@ AxiomNet* axiom_create(void) {
 
     net->layers = NULL;
     net->optimizer = NULL;
+    net->params = NULL;
+    net->mapping = NULL;
+    net->mapping_size = 0;
     net->num_layers = 0;
+    net->train_opts.shuffle = 1;
+    net->train_opts.seed = 42;
+    net->train_opts.shuffle_window = 0;
+    memset(&net->train_opts.augment, 0, sizeof net->train_opts.augment);
+    net->train_opts.checkpoint_path = NULL;
+    net->train_opts.checkpoint_every_steps = 0;
+    net->train_opts.checkpoint_every_seconds = 0.0;
+    net->train_opts.trace_path = NULL;
+    net->train_opts.memory_report_every = 0;
+    net->train_opts.task_graph = 1;
+    net->train_opts.verbose = 1;
+    net->epochs_trained = 0;
+    net->backward_graph = NULL;
+    memset(&net->backward_stats, 0, sizeof net->backward_stats);
 
     return net;
 }
@@ -30,6 +100,10 @@ void axiom_free(AxiomNet* net) {
             dense_free(current->layer.dense);
         } else if (current->type == LAYER_ACTIVATION) {
             activation_free(current->layer.activation);
+        } else if (current->type == LAYER_DENSE_LOWRANK) {
+            lowrank_free(current->layer.lowrank);
+        } else if (current->type == LAYER_EMBEDDING) {
+            embedding_free(current->layer.embedding);
         }
 
         free(current);
@@ -41,6 +115,10 @@ void axiom_free(AxiomNet* net) {
         optimizer_free(net->optimizer);
     }
 
+    taskgraph_free(net->backward_graph);
+    param_arena_free(net->params); // layer tensors were views into it, so this goes after them
+    if (net->mapping != NULL) munmap(net->mapping, net->mapping_size);
+
     free(net);
 }
 
@@ -59,6 +137,10 @@ void axiom_add(AxiomNet* net, void* layer, int layer_type) {
         new_layer->layer.dense = (DenseLayer*)layer;
     } else if (layer_type == LAYER_ACTIVATION) {
         new_layer->layer.activation = (Activation*)layer;
+    } else if (layer_type == LAYER_DENSE_LOWRANK) {
+        new_layer->layer.lowrank = (LowRankLayer*)layer;
+    } else if (layer_type == LAYER_EMBEDDING) {
+        new_layer->layer.embedding = (EmbeddingLayer*)layer;
     }
 
     // if list empty, add as first layer
@@ -76,6 +158,162 @@ void axiom_add(AxiomNet* net, void* layer, int layer_type) {
     net->num_layers++;
 }
 
+int axiom_set_optimizer(AxiomNet* net, Optimizer* opt) {
+    if (net == NULL) return -1;
+
+    if (net->optimizer != NULL && net->optimizer != opt) {
+        optimizer_free(net->optimizer);
+    }
+    net->optimizer = opt;
+
+    // the arena's state regions are sized per optimizer, so relayout if it already exists
+    if (net->params != NULL) return axiom_params_build(net);
+    return 0;
+}
+
+#define LAYER_MAX_PARAMS 3
+
+// a layer's trainable tensors in arena order, bias (if any) last, with their gradients
+typedef struct {
+    Tensor** values[LAYER_MAX_PARAMS];
+    Tensor** grads[LAYER_MAX_PARAMS];
+    size_t* offset;     // the layer's param_offset and param_count
+    size_t* count;
+    size_t n;
+    int has_bias;
+} LayerParams;
+
+static size_t layer_params(Layer* layer, LayerParams* p) {
+    memset(p, 0, sizeof *p);
+    if (layer->type == LAYER_DENSE) {
+        DenseLayer* d = layer->layer.dense;
+        *p = (LayerParams){ .values = {&d->weights, &d->biases}, .grads = {&d->grad_weights, &d->grad_biases},
+                            .offset = &d->param_offset, .count = &d->param_count, .n = 2, .has_bias = 1 };
+    } else if (layer->type == LAYER_DENSE_LOWRANK) {
+        LowRankLayer* l = layer->layer.lowrank;
+        *p = (LayerParams){ .values = {&l->u, &l->v, &l->biases}, .grads = {&l->grad_u, &l->grad_v, &l->grad_biases},
+                            .offset = &l->param_offset, .count = &l->param_count, .n = 3, .has_bias = 1 };
+    } else if (layer->type == LAYER_EMBEDDING) {
+        EmbeddingLayer* e = layer->layer.embedding;
+        *p = (LayerParams){ .values = {&e->table}, .grads = {&e->grad_table},
+                            .offset = &e->param_offset, .count = &e->param_count, .n = 1, .has_bias = 0 };
+    }
+    return p->n;
+}
+
+// where tensor j starts, relative to the layer's param_offset
+static size_t param_slice(const LayerParams* p, size_t j) {
+    size_t off = 0;
+    for (size_t i = 0; i < j; i++) off += param_arena_pad((*p->values[i])->size);
+    return off;
+}
+
+// force: relayout even if the arena already suits the optimizer, e.g. after layers were replaced
+static int params_build(AxiomNet* net, int force) {
+    size_t num_state = optimizer_num_state(net->optimizer);
+    ParamArena* old = net->params;
+    if (!force && old != NULL && old->num_state == num_state) {
+        if (net->optimizer != NULL) net->optimizer->arena = old;
+        return 0;
+    }
+
+    // each layer gets its tensors back to back ([weights | biases] for dense), all padded so every slice starts on a cache line
+    size_t num_tensors = 0;
+    size_t total = 0;
+    LayerParams lp;
+    for (Layer* cur = net->layers; cur != NULL; cur = cur->next) {
+        layer_params(cur, &lp);
+        for (size_t j = 0; j < lp.n; j++) {
+            total += param_arena_pad((*lp.values[j])->size);
+            num_tensors++;
+        }
+    }
+
+    ParamArena* arena = param_arena_create(total, num_state);
+    if (arena == NULL) return -1;
+
+    // build every view up front so a failed allocation leaves the layers untouched
+    Tensor** views = calloc(2 * num_tensors + 1, sizeof(Tensor*));
+    if (views == NULL) {
+        param_arena_free(arena);
+        return -1;
+    }
+
+    size_t off = 0;
+    size_t k = 0;
+    for (Layer* cur = net->layers; cur != NULL; cur = cur->next) {
+        layer_params(cur, &lp);
+        for (size_t j = 0; j < lp.n; j++) {
+            Tensor* t = *lp.values[j];
+            MemCategory prev = mem_set_category(MEM_PARAMS);
+            views[k++] = tensor_view(arena->params + off, t->shape, t->ndim);
+            mem_set_category(MEM_GRADS);
+            views[k++] = tensor_view(arena->grads + off, t->shape, t->ndim);
+            mem_set_category(prev);
+            off += param_arena_pad(t->size);
+        }
+    }
+    for (size_t i = 0; i < k; i++) {
+        if (views[i] == NULL) {
+            for (size_t j = 0; j < k; j++) tensor_free(views[j]);
+            free(views);
+            param_arena_free(arena);
+            return -1;
+        }
+    }
+
+    // copy current values in and swap the views onto the layers
+    off = 0;
+    k = 0;
+    for (Layer* cur = net->layers; cur != NULL; cur = cur->next) {
+        if (layer_params(cur, &lp) == 0) continue;
+        size_t count = param_slice(&lp, lp.n);
+
+        // keep whatever optimizer state the old layout had in common with the new one
+        if (old != NULL && (*lp.values[0])->data == old->params + *lp.offset) {
+            for (size_t s = 0; s < old->num_state && s < num_state; s++) {
+                memcpy(arena->state[s] + off, old->state[s] + *lp.offset, count * sizeof(float));
+            }
+        }
+
+        for (size_t j = 0; j < lp.n; j++) {
+            Tensor* w = views[k++];
+            Tensor* g = views[k++];
+            memcpy(w->data, (*lp.values[j])->data, w->size * sizeof(float));
+            if (*lp.grads[j] != NULL) memcpy(g->data, (*lp.grads[j])->data, g->size * sizeof(float));
+            tensor_free(*lp.values[j]);
+            tensor_free(*lp.grads[j]);
+            *lp.values[j] = w;
+            *lp.grads[j] = g;
+        }
+        *lp.offset = off;
+        *lp.count = count;
+
+        off += count;
+    }
+    free(views);
+
+    param_arena_free(old);
+    net->params = arena;
+    if (net->optimizer != NULL) net->optimizer->arena = arena;
+
+    return 0;
+}
+
+int axiom_params_build(AxiomNet* net) {
+    if (net == NULL) return -1;
+    return params_build(net, 0);
+}
+
+// trace names for a layer's forward and backward pass
+static const char* layer_op_name(const Layer* layer, int backward) {
+    if (layer->type == LAYER_DENSE) return backward ? "dense_backward" : "dense_forward";
+    if (layer->type == LAYER_DENSE_LOWRANK) return backward ? "lowrank_backward" : "lowrank_forward";
+    if (layer->type == LAYER_EMBEDDING) return backward ? "embedding_backward" : "embedding_forward";
+    if (layer->layer.activation->type == ACTIVATION_SOFTMAX) return backward ? "softmax_backward" : "softmax_forward";
+    return backward ? "relu_backward" : "relu_forward";
+}
+
 Tensor* axiom_forward(AxiomNet* net, const Tensor* input) {
     if (net == NULL || input == NULL) return NULL;
 
@@ -83,14 +321,21 @@ Tensor* axiom_forward(AxiomNet* net, const Tensor* input) {
     if (current_x == NULL) return NULL;
 
     Layer* current_layer = net->layers;
+    int index = 0;
     while (current_layer != NULL) {
         Tensor* next_x = NULL;
 
+        uint64_t t0 = trace_begin();
         if (current_layer->type == LAYER_DENSE) {
             next_x = dense_forward(current_layer->layer.dense, current_x);
         } else if (current_layer->type == LAYER_ACTIVATION) {
             next_x = activation_forward(current_layer->layer.activation, current_x);
+        } else if (current_layer->type == LAYER_DENSE_LOWRANK) {
+            next_x = lowrank_forward(current_layer->layer.lowrank, current_x);
+        } else if (current_layer->type == LAYER_EMBEDDING) {
+            next_x = embedding_forward(current_layer->layer.embedding, current_x);
         }
+        trace_end(t0, layer_op_name(current_layer, 0), index++);
 
         if (next_x == NULL) {
             tensor_free(current_x);
@@ -105,8 +350,138 @@ Tensor* axiom_forward(AxiomNet* net, const Tensor* input) {
     return current_x;
 }
 
+// one op of the task-graph backward pass. layer i of the reversed list reads
+// grads[i] and writes grads[i + 1]
+typedef struct {
+    Layer* layer;
+    Optimizer* opt;
+    Tensor** grads;
+    size_t index;
+    atomic_int* failed;
+} BackwardOp;
+
+static void op_dense_weights(void* ctx) {
+    BackwardOp* op = ctx;
+    if (dense_backward_weights(op->layer->layer.dense, op->grads[op->index]) != 0) atomic_store(op->failed, 1);
+}
+
+static void op_dense_bias(void* ctx) {
+    BackwardOp* op = ctx;
+    if (dense_backward_bias(op->layer->layer.dense, op->grads[op->index]) != 0) atomic_store(op->failed, 1);
+}
+
+static void op_dense_input(void* ctx) {
+    BackwardOp* op = ctx;
+    op->grads[op->index + 1] = dense_backward_input(op->layer->layer.dense, op->grads[op->index]);
+    if (op->grads[op->index + 1] == NULL) atomic_store(op->failed, 1);
+}
+
+static void op_lowrank(void* ctx) {
+    BackwardOp* op = ctx;
+    op->grads[op->index + 1] = lowrank_backward(op->layer->layer.lowrank, op->grads[op->index]);
+    if (op->grads[op->index + 1] == NULL) atomic_store(op->failed, 1);
+}
+
+static void op_embedding(void* ctx) {
+    BackwardOp* op = ctx;
+    op->grads[op->index + 1] = embedding_backward(op->layer->layer.embedding, op->grads[op->index]);
+    if (op->grads[op->index + 1] == NULL) atomic_store(op->failed, 1);
+}
+
+static void op_optimizer(void* ctx) {
+    BackwardOp* op = ctx;
+    if (!atomic_load(op->failed)) optimizer_step(op->opt, op->layer);
+}
+
+static void op_activation(void* ctx) {
+    BackwardOp* op = ctx;
+    op->grads[op->index + 1] = activation_backward(op->layer->layer.activation, op->grads[op->index]);
+    if (op->grads[op->index + 1] == NULL) atomic_store(op->failed, 1);
+}
+
+// Each dense layer is three independent ops (dW, db, dX) plus its optimizer
+// update, which waits for all three since dX reads the weights it changes.
+// Only dX feeds the next layer, so one layer's update runs alongside the
+// backward of the layers below it. A low-rank layer's gradients form a chain
+// (dV, dh, dU and dX each need the one before), so it is one op plus its update.
+static Tensor* backward_graph(AxiomNet* net, Layer** layers, Tensor* grad_output, Optimizer* opt) {
+    size_t n = net->num_layers;
+    if (net->backward_graph == NULL) net->backward_graph = taskgraph_create(4 * n);
+    TaskGraph* g = net->backward_graph;
+    Tensor** grads = calloc(n + 1, sizeof(Tensor*));
+    BackwardOp* ops = malloc(n * sizeof(BackwardOp));
+    if (g == NULL || grads == NULL || ops == NULL) {
+        free(grads);
+        free(ops);
+        tensor_free(grad_output);
+        return NULL;
+    }
+    grads[0] = grad_output;
+
+    atomic_int failed;
+    atomic_init(&failed, 0);
+    taskgraph_clear(g);
+    int producer = -1;  // task that writes grads[i]
+    int ok = 1;
+    for (size_t i = 0; i < n && ok; i++) {
+        int index = (int)(n - 1 - i);
+        ops[i] = (BackwardOp){ .layer = layers[i], .opt = opt, .grads = grads, .index = i, .failed = &failed };
+        if (layers[i]->type == LAYER_DENSE) {
+            int dw = taskgraph_add(g, op_dense_weights, &ops[i], "dense_grad_weights", index);
+            int db = taskgraph_add(g, op_dense_bias, &ops[i], "dense_grad_bias", index);
+            int dx = taskgraph_add(g, op_dense_input, &ops[i], "dense_grad_input", index);
+            int step = taskgraph_add(g, op_optimizer, &ops[i], "optimizer_step", index);
+            ok = dw >= 0 && db >= 0 && dx >= 0 && step >= 0;
+            if (ok && producer >= 0) {
+                ok = taskgraph_depend(g, dw, producer) == 0 && taskgraph_depend(g, db, producer) == 0 &&
+                     taskgraph_depend(g, dx, producer) == 0;
+            }
+            ok = ok && taskgraph_depend(g, step, dw) == 0 && taskgraph_depend(g, step, db) == 0 &&
+                 taskgraph_depend(g, step, dx) == 0;
+            producer = dx;
+        } else if (layers[i]->type == LAYER_DENSE_LOWRANK || layers[i]->type == LAYER_EMBEDDING) {
+            task_fn fn = layers[i]->type == LAYER_EMBEDDING ? op_embedding : op_lowrank;
+            int grad = taskgraph_add(g, fn, &ops[i], layer_op_name(layers[i], 1), index);
+            int step = taskgraph_add(g, op_optimizer, &ops[i], "optimizer_step", index);
+            ok = grad >= 0 && step >= 0 && (producer < 0 || taskgraph_depend(g, grad, producer) == 0) &&
+                 taskgraph_depend(g, step, grad) == 0;
+            producer = grad;
+        } else {
+            int act = taskgraph_add(g, op_activation, &ops[i], layer_op_name(layers[i], 1), index);
+            ok = act >= 0 && (producer < 0 || taskgraph_depend(g, act, producer) == 0);
+            producer = act;
+        }
+    }
+    if (!ok || taskgraph_run(g, &net->backward_stats) != 0) atomic_store(&failed, 1);
+
+    Tensor* result = grads[n];
+    for (size_t i = 0; i < n; i++) tensor_free(grads[i]);
+    if (atomic_load(&failed)) {
+        tensor_free(result);
+        result = NULL;
+    }
+    free(grads);
+    free(ops);
+    return result;
+}
+
+// every layer with parameters in an arena sized for the net's optimizer, so optimizer_step never
+// falls back to plain sgd; cheap when the layout already fits
+static int params_ready(AxiomNet* net) {
+    if (axiom_params_build(net) != 0) return -1;
+    LayerParams lp;
+    for (Layer* cur = net->layers; cur != NULL; cur = cur->next) {
+        if (layer_params(cur, &lp) == 0) continue;
+        if ((*lp.values[0])->data != net->params->params + *lp.offset) return params_build(net, 1);  // added since
+    }
+    return 0;
+}
+
 Tensor* axiom_backward(AxiomNet* net, const Tensor* grad_output, Optimizer* opt) {
     if (net == NULL || grad_output == NULL) return NULL;
+    if (opt != NULL && (optimizer_num_state(opt) > 0 || opt->weight_decay != 0.0f)) {
+        if (opt != net->optimizer || params_ready(net) != 0) return NULL;
+    }
 
     Tensor* current_grad = tensor_copy(grad_output);  // copying to avoid input modification
     if (current_grad == NULL) return NULL;
@@ -122,14 +497,40 @@ Tensor* axiom_backward(AxiomNet* net, const Tensor* grad_output, Optimizer* opt)
         current = current->next;
     }
 
+    if (opt != NULL) opt->t++;  // one optimizer step per backward pass, shared by every layer
+
+    // with one thread there is nothing to overlap
+    if (net->train_opts.task_graph && net->num_layers > 0 && parallel_num_threads() > 1) {
+        Tensor* result = backward_graph(net, layers, current_grad, opt);
+        free(layers);
+        return result;
+    }
 
     for (size_t i = 0; i < net->num_layers; i++) {
         Tensor* next_grad = NULL;
+        int index = (int)(net->num_layers - 1 - i);
+        uint64_t t0 = trace_begin();
         if (layers[i]->type == LAYER_DENSE) {
             next_grad = dense_backward(layers[i]->layer.dense, current_grad);
+            trace_end(t0, "dense_backward", index);
+
+            t0 = trace_begin();
+            optimizer_step(opt, layers[i]);
+            trace_end(t0, "optimizer_step", index);
+        } else if (layers[i]->type == LAYER_DENSE_LOWRANK || layers[i]->type == LAYER_EMBEDDING) {
+            if (layers[i]->type == LAYER_EMBEDDING) {
+                next_grad = embedding_backward(layers[i]->layer.embedding, current_grad);
+            } else {
+                next_grad = lowrank_backward(layers[i]->layer.lowrank, current_grad);
+            }
+            trace_end(t0, layer_op_name(layers[i], 1), index);
+
+            t0 = trace_begin();
             optimizer_step(opt, layers[i]);
+            trace_end(t0, "optimizer_step", index);
         } else if (layers[i]->type == LAYER_ACTIVATION) {
             next_grad = activation_backward(layers[i]->layer.activation, current_grad);
+            trace_end(t0, layer_op_name(layers[i], 1), index);
         }
 
         if (next_grad == NULL) {
@@ -150,138 +551,403 @@ Tensor* axiom_backward(AxiomNet* net, const Tensor* grad_output, Optimizer* opt)
 
 }
 
-void axiom_train(AxiomNet* net, Tensor* x_train, Tensor* y_train,
+int axiom_train_step(AxiomNet* net, const Tensor* x, const Tensor* y, const int32_t* labels, float* loss) {
+    if (net == NULL || net->optimizer == NULL || x == NULL || (y == NULL && labels == NULL)) return -1;
+
+    // run forward pass on batch
+    Tensor* batch_predictions = axiom_forward(net, x);
+    if (batch_predictions == NULL) return -1;
+
+    // calculate cross-entropy loss and gradient on batch; class-id labels skip the one-hot rows
+    uint64_t t0 = trace_begin();
+    float batch_loss = labels != NULL ? loss_cross_entropy_index(batch_predictions, labels)
+                                      : loss_cross_entropy(batch_predictions, y);
+    trace_end(t0, "loss", TRACE_NO_LAYER);
+    if (loss != NULL) *loss = batch_loss;
+
+    t0 = trace_begin();
+    Tensor* grad = labels != NULL ? loss_cross_entropy_index_grad(batch_predictions, labels)
+                                  : loss_cross_entropy_grad(batch_predictions, y);
+    trace_end(t0, "loss_grad", TRACE_NO_LAYER);
+    tensor_free(batch_predictions);
+    if (grad == NULL) return -1;
+
+    // run backwards pass and get output for next layer (previous layer)
+    // NULL means a layer's backward (or the task graph) failed, maybe after later layers were updated
+    Tensor* grad_outputs = axiom_backward(net, grad, net->optimizer);
+    tensor_free(grad);
+    if (grad_outputs == NULL) return -1;
+    tensor_free(grad_outputs);
+    return 0;
+}
+
+int axiom_train(AxiomNet* net, Tensor* x_train, Tensor* y_train,
     size_t epochs, float learning_rate, size_t bsize) {
 
-    if (net == NULL || x_train == NULL || y_train == NULL) return;
-    if (bsize <= 0) return; // batch size
-
-    size_t n_samples = x_train->shape[0];
-    size_t n_features = x_train->shape[1];
-    size_t n_classes = y_train->shape[1];
-
-    Optimizer* opt = optimizer_sgd_create(learning_rate);
-    for (size_t epoch = 0; epoch < epochs; epoch++) {
-        size_t batch_idx = 0; // for print statement after loss
-        for (size_t batch_start = 0; batch_start < n_samples; batch_start += bsize) {
-
-            // in case of batch smaller than batch size when at end of epoch
-            size_t actual = bsize;
-            if (batch_start + actual > n_samples)
-                actual = n_samples - batch_start;
-
-            // create tensors to hold batch x and y
-            size_t shape_x[] = {actual, n_features};
-            size_t shape_y[] = {actual, n_classes};
-            Tensor* x_batch = tensor_create(shape_x, 2);
-            if (x_batch == NULL) continue;
-            Tensor* y_batch = tensor_create(shape_y, 2);
-            if (y_batch == NULL) {
-                tensor_free(x_batch);
-                continue;
-            }
+    if (x_train == NULL || y_train == NULL) return -1;
+    Dataset x = dataset_from_tensor(x_train);
+    Dataset y = dataset_from_tensor(y_train);
+    return axiom_train_dataset(net, &x, &y, epochs, learning_rate, bsize);
+}
 
-            // copy data from full training set to batch tensors
-            for (size_t i = 0; i < actual; i++) {
-                size_t row = batch_start + i;
-                for (size_t f = 0; f < n_features; f++)
-                    x_batch->data[i * n_features + f] = x_train->data[row * x_train->strides[0] + f * x_train->strides[1]];
-                for (size_t c = 0; c < n_classes; c++)
-                    y_batch->data[i * n_classes + c] = y_train->data[row * y_train->strides[0] + c * y_train->strides[1]];
-            }
+int axiom_train_dataset(AxiomNet* net, const Dataset* x_train, const Dataset* y_train,
+    size_t epochs, float learning_rate, size_t bsize) {
 
-            // run forward pass on batch
-            Tensor* batch_predictions = axiom_forward(net, x_batch);
-            if (batch_predictions == NULL) {
-                tensor_free(x_batch);
-                tensor_free(y_batch);
-                return;
-            }
+    if (net == NULL || x_train == NULL || y_train == NULL) return -1;
+    if (bsize <= 0) return -1; // batch size
 
-            // calculate cross-entropy loss and gradient on batch
-            float loss = loss_cross_entropy(batch_predictions, y_batch);
-            if (batch_idx % 50 == 0) printf("Epoch %zu Batch %zu: Loss = %f\n", epoch, batch_idx, loss);
+    // train with the net's optimizer (plain sgd unless one was set), keeping its state across calls
+    if (net->optimizer == NULL) {
+        net->optimizer = optimizer_sgd_create(learning_rate);
+        if (net->optimizer == NULL) return -1;
+    }
+    Optimizer* opt = net->optimizer;
+    opt->learning_rate = learning_rate;
+    if (axiom_params_build(net) != 0) return -1;
+
+    // batches are assembled on a background thread while the previous one trains
+    DataLoaderConfig load_cfg = {
+        .batch_size = bsize,
+        .num_buffers = AXIOM_PREFETCH_BUFFERS,
+        .epochs = epochs,
+        .first_epoch = net->epochs_trained,
+        .shuffle = net->train_opts.shuffle,
+        .seed = net->train_opts.seed,
+        .shuffle_window = net->train_opts.shuffle_window,
+        .augment = net->train_opts.augment,
+    };
+    DataLoader* loader = dataloader_create(x_train, y_train, &load_cfg);
+    if (loader == NULL) return -1;
+
+    // checkpoints are copied out between steps and written on a background thread
+    const AxiomTrainOptions* opts = &net->train_opts;
+    Checkpointer* ckpt = NULL;
+    if (opts->checkpoint_path != NULL && (opts->checkpoint_every_steps > 0 || opts->checkpoint_every_seconds > 0.0)) {
+        ckpt = checkpointer_create(net, opts->checkpoint_path);
+        if (ckpt == NULL) printf("Checkpointing to \"%s\" disabled: could not set up the writer\n", opts->checkpoint_path);
+    }
+    size_t steps = 0;
+    uint64_t last_ckpt = timer_now_ns();
+
+    // tracing covers this run if a trace file was asked for; if the caller turned it on, leave it on
+    int own_trace = opts->trace_path != NULL && !trace_enabled();
+    if (own_trace) {
+        trace_reset();
+        trace_set_enabled(1);
+    }
+    trace_set_thread_name("train");
+
+    uint64_t train_start = timer_now_ns();
+    int rc = 0;
+    Batch* batch;
+    for (;;) {
+        uint64_t step_t0 = trace_begin();
+        batch = dataloader_next(loader);
+        trace_end(step_t0, "batch_wait", TRACE_NO_LAYER);
+        if (batch == NULL) break;
+
+        float loss;
+        if (axiom_train_step(net, batch->x, batch->y, batch->labels, &loss) != 0) {
+            // a failed backward may have updated some layers already, so there's no carrying on
+            printf("Training stopped: epoch %zu batch %zu failed (out of memory, or a layer's forward or backward)\n",
+                   batch->epoch, batch->index);
+            dataloader_release(loader, batch);
+            rc = -1;
+            break;
+        }
+        if (opts->verbose && batch->index % 50 == 0) printf("Epoch %zu Batch %zu: Loss = %f\n", batch->epoch, batch->index, loss);
+        net->epochs_trained = batch->epoch + 1;
+        dataloader_release(loader, batch);
+
+        steps++;
+        if (ckpt != NULL &&
+            ((opts->checkpoint_every_steps > 0 && steps % opts->checkpoint_every_steps == 0) ||
+             (opts->checkpoint_every_seconds > 0.0 && timer_elapsed_ms(last_ckpt) >= 1000.0 * opts->checkpoint_every_seconds))) {
+            uint64_t t0 = trace_begin();
+            checkpointer_snapshot(ckpt, net);
+            trace_end(t0, "checkpoint_snapshot", TRACE_NO_LAYER);
+            last_ckpt = timer_now_ns();
+        }
+        trace_end(step_t0, "step", TRACE_NO_LAYER);
 
-            Tensor* grad = loss_cross_entropy_grad(batch_predictions, y_batch);
-            if (grad == NULL) {
-                tensor_free(x_batch);
-                tensor_free(y_batch);
-                tensor_free(batch_predictions);
-                return;
-            }
+        if (opts->memory_report_every > 0 && steps % opts->memory_report_every == 0) {
+            MemStats ms;
+            mem_stats(&ms);
+            printf("Step %zu memory: ", steps);
+            mem_print_line(stdout, &ms);
+        }
+    }
 
-            // run backwards pass and get output for next layer (previous layer)
-            Tensor* grad_outputs = axiom_backward(net, grad, opt);
+    DataLoaderStats stats;
+    dataloader_stats(loader, &stats);
+    double train_ms = timer_elapsed_ms(train_start);
+    if (opts->verbose) {
+        printf("Data loader: %zu batches, stalled %.1f ms waiting for data (%.1f%% of %.1f ms), %.1f ms assembly in background",
+               stats.batches, stats.wait_ms, train_ms > 0.0 ? 100.0 * stats.wait_ms / train_ms : 0.0,
+               train_ms, stats.assemble_ms);
+        if (stats.augment_ms > 0.0) printf(" (%.1f ms augmenting)", stats.augment_ms);
+        printf("\n");
+    }
+    dataloader_free(loader);
+
+    if (ckpt != NULL) {
+        CheckpointStats cs;
+        checkpointer_wait(ckpt);
+        checkpointer_stats(ckpt, &cs);
+        printf("Checkpoints: %zu written to \"%s\" (%zu skipped while a write was in flight, %zu failed), "
+               "training paused %.1f ms max / %.1f ms avg per snapshot, %.1f ms avg background write\n",
+               cs.written, opts->checkpoint_path, cs.skipped, cs.failed, cs.snapshot_ms_max,
+               cs.taken > 0 ? cs.snapshot_ms_total / cs.taken : 0.0,
+               cs.taken > 0 ? cs.write_ms_total / cs.taken : 0.0);
+        checkpointer_free(ckpt);
+    }
+
+    if (opts->memory_report_every > 0) {
+        MemStats ms;
+        mem_stats(&ms);
+        mem_print_table(stdout, &ms);
+    }
 
-            tensor_free(x_batch);
-            tensor_free(y_batch);
-            tensor_free(batch_predictions);
-            tensor_free(grad);
-            if (grad_outputs != NULL)
-                tensor_free(grad_outputs);
+    if (trace_enabled()) {
+        trace_print_summary(stdout);
+        if (opts->trace_path != NULL) {
+            if (trace_write_chrome(opts->trace_path) == 0) {
+                printf("Trace written to \"%s\" (open in chrome://tracing or ui.perfetto.dev)\n", opts->trace_path);
+            } else {
+                printf("Could not write trace to \"%s\"\n", opts->trace_path);
+            }
+        }
+    }
+    if (own_trace) trace_set_enabled(0);
+    return rc;
+}
 
-            batch_idx++;
+// optimizer trailer: magic, type, hyperparameters, step count, then each state buffer per layer with
+// parameters, in the order of the layer's tensors (weights, biases)
+static void save_optimizer(const AxiomNet* net, const AxiomSnapshot* snap, FILE* f) {
+    const Optimizer* opt = &snap->opt;
+    uint8_t num_state = (uint8_t)snap->num_state;
+
+    uint8_t opt_type = (uint8_t)opt->type;
+    float hyper[6] = {opt->learning_rate, opt->momentum, opt->beta1, opt->beta2, opt->epsilon, opt->weight_decay};
+    uint64_t t = (uint64_t)opt->t;
+
+    fwrite(AXIOM_OPT_MAGIC, 1, 4, f);
+    fwrite(&opt_type, sizeof(uint8_t), 1, f);
+    fwrite(hyper, sizeof(float), 6, f);
+    fwrite(&t, sizeof(uint64_t), 1, f);
+    fwrite(&num_state, sizeof(uint8_t), 1, f);
+
+    LayerParams lp;
+    for (Layer* cur = net->layers; cur != NULL; cur = cur->next) {
+        if (layer_params(cur, &lp) == 0) continue;
+        for (size_t s = 0; s < num_state; s++) {
+            for (size_t j = 0; j < lp.n; j++) {
+                fwrite(snap->state[s] + *lp.offset + param_slice(&lp, j), sizeof(float), (*lp.values[j])->size, f);
+            }
         }
     }
-    optimizer_free(opt);
 }
 
-void axiom_save(AxiomNet* net, const char* filename) {
-    if (net == NULL || filename == NULL) return;
+// describe the net's current values: its arena if it has one, else the layer tensors
+static void live_snapshot(const AxiomNet* net, AxiomSnapshot* snap) {
+    memset(snap, 0, sizeof *snap);
+    ParamArena* arena = net->params;
+    if (arena != NULL) snap->params = arena->params;
+
+    Optimizer* opt = net->optimizer;
+    if (opt == NULL) return;
+    snap->has_opt = 1;
+    snap->opt = *opt;
+
+    // state only exists once the layers live in an arena built for this optimizer
+    size_t num_state = optimizer_num_state(opt);
+    if (arena == NULL || opt->arena != arena || arena->num_state < num_state) num_state = 0;
+    snap->num_state = num_state;
+    for (size_t s = 0; s < num_state; s++) snap->state[s] = arena->state[s];
+}
 
-    FILE* f = fopen(filename, "wb");
-    if (f == NULL) return;
+static size_t blob_align(size_t n) {
+    return (n + AXIOM_BLOB_ALIGN - 1) / AXIOM_BLOB_ALIGN * AXIOM_BLOB_ALIGN;
+}
+
+// zero-fill up to the next blob offset
+static void pad_to(FILE* f, size_t offset) {
+    static const uint8_t zeros[AXIOM_BLOB_ALIGN] = {0};
+    long pos = ftell(f);
+    if (pos >= 0 && (size_t)pos < offset) fwrite(zeros, 1, offset - (size_t)pos, f);
+}
 
-    fwrite(AXIOM_MAGIC, 1, 4, f);
-    uint32_t n = (uint32_t)net->num_layers;
-    fwrite(&n, sizeof(uint32_t), 1, f);
-
-    Layer* cur = net->layers; // loop over each layer in order and define the main attributes in binary to the checkpoint file;
-    while (cur != NULL) {
-        uint8_t layer_type = (cur->type == LAYER_DENSE) ? 0 : 1;
-        fwrite(&layer_type, sizeof(uint8_t), 1, f);
-
-        if (cur->type == LAYER_DENSE) {
-            DenseLayer* d = cur->layer.dense;
-            uint32_t in_sz = (uint32_t)d->input_size;
-            uint32_t out_sz = (uint32_t)d->output_size;
-            fwrite(&in_sz, sizeof(uint32_t), 1, f);
-            fwrite(&out_sz, sizeof(uint32_t), 1, f);
-            fwrite(d->weights->data, sizeof(float), (size_t)(in_sz * out_sz), f);
-            fwrite(d->biases->data, sizeof(float), (size_t)out_sz, f);
+int axiom_write_snapshot(const AxiomNet* net, const AxiomSnapshot* snap, FILE* f) {
+    if (net == NULL || snap == NULL || f == NULL) return -1;
+
+    AxiomLayerEntry* table = calloc(net->num_layers + 1, sizeof(AxiomLayerEntry));
+    const float* (*src)[LAYER_MAX_PARAMS] = calloc(net->num_layers + 1, sizeof *src);
+    if (table == NULL || src == NULL) {
+        free(table);
+        free(src);
+        return -1;
+    }
+
+    // lay out the table and every blob first so the header and table can be written up front.
+    // a layer's bias is its biases blob, its other tensors are concatenated into the weights blob
+    AxiomFileHeader h = {0};
+    memcpy(h.magic, AXIOM_V2_MAGIC, 4);
+    h.version = AXIOM_V2_VERSION;
+    h.num_layers = (uint32_t)net->num_layers;
+    h.table_offset = sizeof(AxiomFileHeader);
+
+    size_t pos = blob_align(h.table_offset + net->num_layers * sizeof(AxiomLayerEntry));
+    size_t i = 0;
+    LayerParams lp;
+    for (Layer* cur = net->layers; cur != NULL; cur = cur->next, i++) {
+        AxiomLayerEntry* e = &table[i];
+        if (layer_params(cur, &lp) > 0) {
+            size_t num_weights = lp.n - (size_t)lp.has_bias;
+            size_t nw = 0;
+            for (size_t j = 0; j < lp.n; j++) {
+                src[i][j] = snap->params ? snap->params + *lp.offset + param_slice(&lp, j) : (*lp.values[j])->data;
+                if (j < num_weights) {
+                    e->weights_crc = checksum_crc32(e->weights_crc, src[i][j], (*lp.values[j])->size * sizeof(float));
+                    nw += (*lp.values[j])->size;
+                }
+            }
+            size_t nb = lp.has_bias ? (*lp.values[lp.n - 1])->size : 0;
+
+            if (cur->type == LAYER_DENSE) {
+                e->type = 0;
+                e->input_size = (uint32_t)cur->layer.dense->input_size;
+                e->output_size = (uint32_t)cur->layer.dense->output_size;
+            } else if (cur->type == LAYER_DENSE_LOWRANK) {
+                e->type = 2;
+                e->activation = (uint32_t)cur->layer.lowrank->rank;
+                e->input_size = (uint32_t)cur->layer.lowrank->input_size;
+                e->output_size = (uint32_t)cur->layer.lowrank->output_size;
+            } else {
+                EmbeddingLayer* emb = cur->layer.embedding;
+                e->type = 3;
+                e->activation = (uint32_t)emb->vocab_size;
+                e->input_size = (uint32_t)emb->num_fields;
+                e->output_size = (uint32_t)(emb->num_fields * emb->dim);
+            }
+            e->weights_offset = pos;
+            pos = blob_align(pos + nw * sizeof(float));
+            e->biases_offset = pos;
+            e->biases_crc = checksum_crc32(0, lp.has_bias ? src[i][lp.n - 1] : NULL, nb * sizeof(float));
+            pos = blob_align(pos + nb * sizeof(float));
         } else {
-            uint8_t act_type = (cur->layer.activation->type == ACTIVATION_RELU) ? 0 : 1;
-            fwrite(&act_type, sizeof(uint8_t), 1, f);
+            e->type = 1;
+            e->activation = (cur->layer.activation->type == ACTIVATION_RELU) ? 0 : 1;
+        }
+    }
+    h.table_crc = checksum_crc32(0, table, net->num_layers * sizeof(AxiomLayerEntry));
+
+    int failed = 0;
+    if (fwrite(&h, sizeof h, 1, f) != 1) failed = 1;  // rewritten below once the trailer is known
+    if (fwrite(table, sizeof(AxiomLayerEntry), net->num_layers, f) != net->num_layers) failed = 1;
+
+    i = 0;
+    for (Layer* cur = net->layers; cur != NULL && !failed; cur = cur->next, i++) {
+        if (layer_params(cur, &lp) == 0) continue;
+        pad_to(f, table[i].weights_offset);
+        for (size_t j = 0; j < lp.n; j++) {
+            if (lp.has_bias && j + 1 == lp.n) pad_to(f, table[i].biases_offset);
+            size_t n = (*lp.values[j])->size;
+            if (fwrite(src[i][j], sizeof(float), n, f) != n) failed = 1;
         }
-
-        cur = cur->next;
+    }
+    pad_to(f, pos);
+    h.file_size = pos;
+
+    if (snap->has_opt && !failed) {
+        save_optimizer(net, snap, f);
+        long end = ftell(f);
+        h.opt_offset = pos;
+        h.opt_size = end > 0 ? (size_t)end - pos : 0;
+        h.file_size = pos + h.opt_size;
+
+        // the trailer is streamed out by save_optimizer; read it back to checksum it
+        uint8_t* buf = malloc(h.opt_size > 0 ? h.opt_size : 1);
+        if (buf != NULL && fflush(f) == 0 && fseek(f, (long)pos, SEEK_SET) == 0 &&
+            fread(buf, 1, h.opt_size, f) == h.opt_size) {
+            h.opt_crc = checksum_crc32(0, buf, h.opt_size);
+        } else {
+            failed = 1;
+        }
+        free(buf);
     }
 
-    fclose(f);
+    h.header_crc = checksum_crc32(0, &h, offsetof(AxiomFileHeader, header_crc));
+    if (fseek(f, 0, SEEK_SET) != 0 || fwrite(&h, sizeof h, 1, f) != 1 || fflush(f) != 0) failed = 1;
+
+    free(table);
+    free(src);
+    return failed ? -1 : 0;
 }
 
-AxiomNet* axiom_load(const char* filename) {
-    if (filename == NULL) return NULL;
+void axiom_save(AxiomNet* net, const char* filename) {
+    if (net == NULL || filename == NULL) return;
 
-    FILE* f = fopen(filename, "rb");
-    if (f == NULL) return NULL;
+    FILE* f = fopen(filename, "w+b");
+    if (f == NULL) return;
 
-    char magic[4];
-    if (fread(magic, 1, 4, f) != 4 || memcmp(magic, AXIOM_MAGIC, 4) != 0) {
-        fclose(f);
-        return NULL;
+    AxiomSnapshot snap;
+    live_snapshot(net, &snap);
+    axiom_write_snapshot(net, &snap, f);
+    fclose(f);
+}
+
+static int load_optimizer(AxiomNet* net, FILE* f) {
+    uint8_t opt_type, num_state;
+    float hyper[6];
+    uint64_t t;
+    if (fread(&opt_type, sizeof(uint8_t), 1, f) != 1 ||
+        fread(hyper, sizeof(float), 6, f) != 6 ||
+        fread(&t, sizeof(uint64_t), 1, f) != 1 ||
+        fread(&num_state, sizeof(uint8_t), 1, f) != 1) {
+        return -1;
+    }
+    if (opt_type > OPTIMIZER_ADAMW) return -1;
+
+    Optimizer* opt = optimizer_sgd_create(hyper[0]);
+    if (opt == NULL) return -1;
+    opt->type = opt_type;
+    opt->momentum = hyper[1];
+    opt->beta1 = hyper[2];
+    opt->beta2 = hyper[3];
+    opt->epsilon = hyper[4];
+    opt->weight_decay = hyper[5];
+    opt->t = (size_t)t;
+    if (axiom_set_optimizer(net, opt) != 0) return -1;
+
+    if (num_state == 0) return 0;
+    if (num_state != optimizer_num_state(opt)) return -1;
+    if (axiom_params_build(net) != 0) return -1;
+
+    ParamArena* arena = net->params;
+    LayerParams lp;
+    for (Layer* cur = net->layers; cur != NULL; cur = cur->next) {
+        if (layer_params(cur, &lp) == 0) continue;
+        for (size_t s = 0; s < num_state; s++) {
+            for (size_t j = 0; j < lp.n; j++) {
+                size_t n = (*lp.values[j])->size;
+                if (fread(arena->state[s] + *lp.offset + param_slice(&lp, j), sizeof(float), n, f) != n) return -1;
+            }
+        }
     }
+    return 0;
+}
 
+// v1: everything streamed in order after the magic
+static AxiomNet* load_v1(FILE* f) {
     uint32_t n32;
     if (fread(&n32, sizeof(uint32_t), 1, f) != 1) {
-        fclose(f);
         return NULL;
     }
     size_t num_layers = (size_t)n32;
 
     AxiomNet* net = axiom_create(); // initialize a net
     if (net == NULL) {
-        fclose(f);
         return NULL;
     }
 
@@ -290,7 +956,6 @@ AxiomNet* axiom_load(const char* filename) {
         uint8_t layer_type;
         if (fread(&layer_type, sizeof(uint8_t), 1, f) != 1) {
             axiom_free(net);
-            fclose(f);
             return NULL;
         }
 
@@ -299,13 +964,11 @@ AxiomNet* axiom_load(const char* filename) {
             if (fread(&in_sz, sizeof(uint32_t), 1, f) != 1 ||
                 fread(&out_sz, sizeof(uint32_t), 1, f) != 1) {
                 axiom_free(net);
-                fclose(f);
                 return NULL;
             }
             DenseLayer* d = dense_create((size_t)in_sz, (size_t)out_sz);
             if (d == NULL) {
                 axiom_free(net);
-                fclose(f);
                 return NULL;
             }
             size_t nw = (size_t)in_sz * (size_t)out_sz;
@@ -314,7 +977,6 @@ AxiomNet* axiom_load(const char* filename) {
                 fread(d->biases->data, sizeof(float), nb, f) != nb) {
                 dense_free(d);
                 axiom_free(net);
-                fclose(f);
                 return NULL;
             }
             axiom_add(net, d, LAYER_DENSE);
@@ -322,27 +984,310 @@ AxiomNet* axiom_load(const char* filename) {
             uint8_t act_type;
             if (fread(&act_type, sizeof(uint8_t), 1, f) != 1) {
                 axiom_free(net);
-                fclose(f);
                 return NULL;
             }
             Activation* act = (act_type == 0) ? activation_relu() : activation_softmax();
             if (act == NULL) {
                 axiom_free(net);
-                fclose(f);
                 return NULL;
             }
             axiom_add(net, act, LAYER_ACTIVATION);
         }
     }
 
+    // older checkpoints end here; newer ones may carry the optimizer trailer
+    char tag[4];
+    if (fread(tag, 1, 4, f) == 4 && memcmp(tag, AXIOM_OPT_MAGIC, 4) == 0) {
+        if (load_optimizer(net, f) != 0) {
+            axiom_free(net);
+            return NULL;
+        }
+    }
+
+    return net;
+}
+
+
+// bounds, alignment and (if verify) checksums of a layer's weights blob (nw floats) and biases blob (nb)
+static int layer_blobs(const uint8_t* base, size_t size, const AxiomLayerEntry* e, uint64_t nw, uint64_t nb,
+                       int verify, float** w, float** b) {
+    if (e->weights_offset % AXIOM_BLOB_ALIGN != 0 || e->biases_offset % AXIOM_BLOB_ALIGN != 0 ||
+        e->weights_offset > size || nw > (size - e->weights_offset) / sizeof(float) ||
+        e->biases_offset > size || nb > (size - e->biases_offset) / sizeof(float)) {
+        return -1;
+    }
+    *w = (float*)(base + e->weights_offset);
+    *b = (float*)(base + e->biases_offset);
+    if (verify && (checksum_crc32(0, *w, nw * sizeof(float)) != e->weights_crc ||
+                   checksum_crc32(0, *b, nb * sizeof(float)) != e->biases_crc)) {
+        return -1;
+    }
+    return 0;
+}
+
+// checks the header, table and (if verify) blob checksums, then builds a net whose dense
+// layers view the blobs in place. base must stay valid for as long as the layers use it.
+static AxiomNet* load_v2(const uint8_t* base, size_t size, int verify, int with_optimizer) {
+    AxiomFileHeader h;
+    if (size < sizeof h) return NULL;
+    memcpy(&h, base, sizeof h);
+    if (memcmp(h.magic, AXIOM_V2_MAGIC, 4) != 0 || h.version != AXIOM_V2_VERSION ||
+        h.header_crc != checksum_crc32(0, &h, offsetof(AxiomFileHeader, header_crc)) ||
+        h.file_size != size || h.table_offset % sizeof(uint64_t) != 0 ||
+        h.table_offset > size || h.num_layers > (size - h.table_offset) / sizeof(AxiomLayerEntry)) {
+        return NULL;
+    }
+    const AxiomLayerEntry* table = (const AxiomLayerEntry*)(base + h.table_offset);
+    if (checksum_crc32(0, table, h.num_layers * sizeof(AxiomLayerEntry)) != h.table_crc) return NULL;
+
+    AxiomNet* net = axiom_create();
+    if (net == NULL) return NULL;
+
+    for (size_t i = 0; i < h.num_layers; i++) {
+        const AxiomLayerEntry* e = &table[i];
+        float* w;
+        float* b;
+        if (e->type == 0) {
+            uint64_t nw = (uint64_t)e->input_size * e->output_size;
+            if (layer_blobs(base, size, e, nw, e->output_size, verify, &w, &b) != 0) {
+                axiom_free(net);
+                return NULL;
+            }
+            DenseLayer* d = dense_create_view(e->input_size, e->output_size, w, b);
+            if (d == NULL) {
+                axiom_free(net);
+                return NULL;
+            }
+            axiom_add(net, d, LAYER_DENSE);
+        } else if (e->type == 2) {
+            uint64_t rank = e->activation;
+            uint64_t nw = rank * ((uint64_t)e->input_size + e->output_size);
+            if (rank == 0 || layer_blobs(base, size, e, nw, e->output_size, verify, &w, &b) != 0) {
+                axiom_free(net);
+                return NULL;
+            }
+            LowRankLayer* l = lowrank_create_view(e->input_size, e->output_size, rank,
+                                                  w, w + (size_t)e->input_size * rank, b);
+            if (l == NULL) {
+                axiom_free(net);
+                return NULL;
+            }
+            axiom_add(net, l, LAYER_DENSE_LOWRANK);
+        } else if (e->type == 3) {
+            uint64_t vocab = e->activation;
+            uint64_t dim = e->input_size > 0 ? e->output_size / e->input_size : 0;
+            if (dim == 0 || dim * e->input_size != e->output_size ||
+                layer_blobs(base, size, e, vocab * dim, 0, verify, &w, &b) != 0) {
+                axiom_free(net);
+                return NULL;
+            }
+            EmbeddingLayer* emb = embedding_create_view(vocab, dim, e->input_size, w);
+            if (emb == NULL) {
+                axiom_free(net);
+                return NULL;
+            }
+            axiom_add(net, emb, LAYER_EMBEDDING);
+        } else if (e->type == 1) {
+            Activation* act = (e->activation == 0) ? activation_relu() : activation_softmax();
+            if (act == NULL) {
+                axiom_free(net);
+                return NULL;
+            }
+            axiom_add(net, act, LAYER_ACTIVATION);
+        } else {
+            axiom_free(net);
+            return NULL;
+        }
+    }
+
+    if (with_optimizer && h.opt_offset != 0) {
+        if (h.opt_offset > size || h.opt_size > size - h.opt_offset ||
+            checksum_crc32(0, base + h.opt_offset, h.opt_size) != h.opt_crc) {
+            axiom_free(net);
+            return NULL;
+        }
+        // the trailer is the same byte stream as in v1, so read it through the same code
+        FILE* f = fmemopen((void*)(base + h.opt_offset), h.opt_size, "rb");
+        char tag[4];
+        int ok = f != NULL && fread(tag, 1, 4, f) == 4 && memcmp(tag, AXIOM_OPT_MAGIC, 4) == 0 &&
+                 load_optimizer(net, f) == 0;
+        if (f != NULL) fclose(f);
+        if (!ok) {
+            axiom_free(net);
+            return NULL;
+        }
+    }
+    return net;
+}
+
+AxiomNet* axiom_load(const char* filename) {
+    if (filename == NULL) return NULL;
+
+    FILE* f = fopen(filename, "rb");
+    if (f == NULL) return NULL;
+
+    char magic[4];
+    if (fread(magic, 1, 4, f) != 4) {
+        fclose(f);
+        return NULL;
+    }
+    if (memcmp(magic, AXIOM_MAGIC, 4) == 0) {
+        AxiomNet* net = load_v1(f);
+        fclose(f);
+        return net;
+    }
+    if (memcmp(magic, AXIOM_V2_MAGIC, 4) != 0 || fseek(f, 0, SEEK_END) != 0) {
+        fclose(f);
+        return NULL;
+    }
+
+    // read the whole file into an aligned buffer, build the net over it, then move
+    // the weights into the net's own parameter arena so the buffer can go
+    long end = ftell(f);
+    size_t size = end > 0 ? (size_t)end : 0;
+    size_t buf_size = blob_align(size > 0 ? size : 1);
+    uint8_t* buf = aligned_alloc(AXIOM_BLOB_ALIGN, buf_size);
+    if (buf == NULL || fseek(f, 0, SEEK_SET) != 0 || fread(buf, 1, size, f) != size) {
+        free(buf);
+        fclose(f);
+        return NULL;
+    }
     fclose(f);
+    mem_track_alloc(MEM_CHECKPOINT, buf_size);
+
+    AxiomNet* net = load_v2(buf, size, 1, 1);
+    if (net != NULL && axiom_params_build(net) != 0) {
+        axiom_free(net);
+        net = NULL;
+    }
+    free(buf);
+    mem_track_free(MEM_CHECKPOINT, buf_size);
+    return net;
+}
+
+AxiomNet* axiom_load_mapped(const char* filename, int verify) {
+    if (filename == NULL) return NULL;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 4) {
+        close(fd);
+        return NULL;
+    }
+    size_t size = (size_t)st.st_size;
+    void* map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    // v1 has no alignment guarantees to map against
+    if (memcmp(map, AXIOM_V2_MAGIC, 4) != 0) {
+        munmap(map, size);
+        return axiom_load(filename);
+    }
+
+    AxiomNet* net = load_v2(map, size, verify, 0);
+    if (net == NULL) {
+        munmap(map, size);
+        return NULL;
+    }
+    net->mapping = map;
+    net->mapping_size = size;
+
+    // mapped weights are read-only, so pack them once here and never again; a layer that
+    // fails to pack just packs on its first forward
+    for (Layer* cur = net->layers; cur != NULL; cur = cur->next) {
+        if (cur->type == LAYER_DENSE) dense_pack(cur->layer.dense);
+    }
     return net;
 }
 
+int axiom_compress_lowrank(AxiomNet* net, size_t rank, float energy, AxiomCompressLayer* report) {
+    if (net == NULL || (rank == 0 && !(energy > 0.0f && energy <= 1.0f))) return -1;
+
+    // factor every layer first so a failure leaves the net as it was
+    LowRankLayer** factored = calloc(net->num_layers + 1, sizeof(LowRankLayer*));
+    if (factored == NULL) return -1;
+
+    int failed = 0;
+    size_t i = 0, n = 0;
+    for (Layer* cur = net->layers; cur != NULL && !failed; cur = cur->next, i++) {
+        if (cur->type != LAYER_DENSE) continue;
+        const DenseLayer* d = cur->layer.dense;
+        size_t in = d->input_size, out = d->output_size;
+        size_t k = in < out ? in : out;
+
+        float* s = malloc(k * sizeof(float));
+        LowRankLayer* l = s != NULL ? lowrank_from_dense(d, rank, energy, s) : NULL;
+        if (l == NULL) {
+            free(s);
+            failed = 1;
+            break;
+        }
+
+        double total = 0.0, kept = 0.0;
+        for (size_t q = 0; q < k; q++) {
+            total += (double)s[q] * s[q];
+            if (q < l->rank) kept += (double)s[q] * s[q];
+        }
+        free(s);
+        double frac = total > 0.0 ? kept / total : 1.0;
+        AxiomCompressLayer entry = {
+            .layer = i, .input_size = in, .output_size = out, .rank = l->rank,
+            .energy = (float)frac, .rel_error = (float)sqrt(frac < 1.0 ? 1.0 - frac : 0.0),
+        };
+
+        // u and v together must be smaller than w, or the factored layer is only slower
+        if (l->rank * (in + out) >= in * out) {
+            lowrank_free(l);
+            l = NULL;
+            entry.rank = 0;
+            entry.energy = 1.0f;
+            entry.rel_error = 0.0f;
+        }
+        if (report != NULL) report[n] = entry;
+        n++;
+        factored[i] = l;
+    }
+    if (failed) {
+        for (size_t j = 0; j < net->num_layers; j++) lowrank_free(factored[j]);
+        free(factored);
+        return -1;
+    }
+
+    int replaced = 0;
+    i = 0;
+    for (Layer* cur = net->layers; cur != NULL; cur = cur->next, i++) {
+        if (factored[i] == NULL) continue;
+        dense_free(cur->layer.dense);
+        cur->type = LAYER_DENSE_LOWRANK;
+        cur->layer.lowrank = factored[i];
+        replaced++;
+    }
+    free(factored);
+
+    // the new layers own their tensors; move them into a fresh arena with the rest
+    if (replaced > 0 && net->params != NULL && params_build(net, 1) != 0) return -1;
+    return replaced;
+}
+
+void axiom_memory_stats(MemStats* stats) {
+    mem_stats(stats);
+}
+
 DenseLayer* axiom_layer_dense(size_t input_size, size_t output_size) {
     return dense_create(input_size, output_size);
 }
 
+LowRankLayer* axiom_layer_dense_lowrank(size_t input_size, size_t output_size, size_t rank) {
+    return lowrank_create(input_size, output_size, rank);
+}
+
+EmbeddingLayer* axiom_layer_embedding(size_t vocab_size, size_t dim, size_t num_fields) {
+    return embedding_create(vocab_size, dim, num_fields);
+}
+
 Activation* axiom_activation_relu(void) {
     return activation_relu();
 }
@@ -1,27 +1,62 @@
 #ifndef AXIOM_H
 #define AXIOM_H
 
+#include <stdint.h>
+#include <stdio.h>
 #include "tensor.h"
 #include "dense.h"
+#include "lowrank.h"
+#include "embedding.h"
 #include "activations.h"
 #include "optimizer.h"
+#include "params.h"
+#include "augment.h"
+#include "dataset.h"
+#include "memstats.h"
+#include "taskgraph.h"
 
 typedef struct Layer {
     enum {
         LAYER_DENSE,
-        LAYER_ACTIVATION
+        LAYER_ACTIVATION,
+        LAYER_DENSE_LOWRANK,
+        LAYER_EMBEDDING
     } type;
     union {
         DenseLayer* dense;
         Activation* activation;
+        LowRankLayer* lowrank;
+        EmbeddingLayer* embedding;
     } layer;
     struct Layer* next;
 } Layer;
 
+// Knobs for axiom_train beyond the ones in its signature; axiom_create sets the defaults
+typedef struct {
+    int shuffle;          // new random row order every epoch (default on)
+    uint64_t seed;        // epoch order is reproducible from this
+    size_t shuffle_window;  // 0: shuffle the whole set; > 0: shuffle within windows of ~this many rows (see dataloader.h)
+    AugmentConfig augment;  // per-sample image augmentation while batches are built (default off)
+    const char* checkpoint_path;      // periodic background checkpoints go here; NULL = none (default)
+    size_t checkpoint_every_steps;    // take one every this many steps (0 = no step trigger)
+    double checkpoint_every_seconds;  // and/or every this many seconds (0 = no time trigger)
+    const char* trace_path;           // trace the run and write Chrome trace JSON here; NULL = off (default)
+    size_t memory_report_every;       // print memory in use every this many steps, and peaks at the end (0 = off)
+    int task_graph;       // run each backward pass as a task graph across the pool, overlapping layers (default on)
+    int verbose;          // print the running loss and the data loader summary (default on)
+} AxiomTrainOptions;
+
 typedef struct {
     Layer* layers;
     Optimizer* optimizer;
+    ParamArena* params;   // flat params/grads/optimizer state; NULL until axiom_params_build
+    void* mapping;        // read-only checkpoint the layers view, from axiom_load_mapped
+    size_t mapping_size;
     size_t num_layers;
+    AxiomTrainOptions train_opts;
+    size_t epochs_trained;  // advanced by axiom_train; picks the next epoch's shuffle order
+    TaskGraph* backward_graph;     // reused by every task-graph backward pass; NULL until the first
+    TaskGraphStats backward_stats; // accumulated over those passes
 } AxiomNet;
 
 // Network creation and management
@@ -31,21 +66,124 @@ void axiom_free(AxiomNet* net);
 // Add layers to network
 void axiom_add(AxiomNet* net, void* layer, int layer_type);
 
-// Training
-void axiom_train(AxiomNet* net, Tensor* x_train, Tensor* y_train,
-                 size_t epochs, float learning_rate, size_t bsize);
+// Optimizer and parameter storage. The net takes ownership of opt. If the arena already exists it
+// is relaid out for opt's state; returns -1 if that fails (opt is still the net's optimizer, and
+// the next backward pass tries the relayout again), else 0.
+int axiom_set_optimizer(AxiomNet* net, Optimizer* opt);
+
+// Move every layer's weights, biases and gradients into one ParamArena
+// sized for the net's optimizer; layer tensors become views into it.
+// Safe to call again, e.g. after switching optimizers. Returns 0 on success.
+int axiom_params_build(AxiomNet* net);
+
+// Training. Returns 0 once every epoch ran, or -1 on bad arguments, out of memory or a failed
+// step. A failed step is reported with its epoch and batch and stops training there; the net
+// keeps the updates made so far, possibly part of the failed step's.
+int axiom_train(AxiomNet* net, Tensor* x_train, Tensor* y_train,
+                size_t epochs, float learning_rate, size_t bsize);
+
+// Same, but rows come from a Dataset, e.g. a memory-mapped byte file that is
+// only converted to floats a batch at a time
+int axiom_train_dataset(AxiomNet* net, const Dataset* x_train, const Dataset* y_train,
+                        size_t epochs, float learning_rate, size_t bsize);
 
+// One optimizer step on one batch: forward, cross-entropy against the target rows y or the class
+// ids in labels (one of them may be NULL), backward and update. The net needs its optimizer and
+// parameter arena in place already (axiom_params_build). Returns 0, with the batch loss in *loss,
+// or -1 if any part failed; a failed backward may leave the update applied to some layers only.
+int axiom_train_step(AxiomNet* net, const Tensor* x, const Tensor* y, const int32_t* labels, float* loss);
+
+// Backward pass, stepping opt on every layer with parameters. An optimizer with state or weight
+// decay needs the layers in the arena: for the net's own optimizer it is built (or rebuilt after
+// layers were added) here; any other such optimizer has nowhere to keep its state, and the call
+// fails. Returns the gradient with respect to the input, or NULL on failure.
 Tensor* axiom_backward(AxiomNet* net, const Tensor* grad_output, Optimizer* opt);
 
 // Inference
 Tensor* axiom_forward(AxiomNet* net, const Tensor* input);
 
-// Model serialization
+#define AXIOM_EVAL_TOP_K 5
+#define AXIOM_EVAL_CONFUSION_MAX 1024  // no confusion matrix above this many classes (it grows as classes^2)
+
+typedef struct {
+    size_t samples;         // rows scored; every figure below is over these
+    size_t skipped;         // rows without a valid label (id out of range, all-zero one-hot), left out
+    size_t num_classes;
+    size_t correct;         // top-1
+    size_t correct_topk;    // true class among the AXIOM_EVAL_TOP_K highest scores
+    float accuracy;
+    float topk_accuracy;
+    float loss;             // mean cross-entropy
+    size_t* confusion;      // counts at [true_class * num_classes + predicted]; NULL past AXIOM_EVAL_CONFUSION_MAX
+} AxiomEvalResult;
+
+// Score net on (x, y) in batches of batch_size, spread over the thread pool.
+// y is one-hot rows or a label dataset of class ids (read as ids, no one-hot).
+// Runs the inference path only (no layer caches are written), so memory stays
+// at a few batches per thread whatever the dataset size. argmax, top-k, loss
+// and the confusion matrix are taken in one pass over the output rows.
+// Returns 0 on success; free the result with axiom_eval_result_free.
+int axiom_evaluate(const AxiomNet* net, const Dataset* x, const Dataset* y, size_t batch_size,
+                   AxiomEvalResult* result);
+void axiom_eval_result_free(AxiomEvalResult* result);
+
+// Model serialization. axiom_save writes the v2 format: 64-byte-aligned weight
+// blobs with CRC-32s. axiom_load reads v1 or v2 into memory the net owns, along
+// with any optimizer state.
 void axiom_save(AxiomNet* net, const char* filename);
 AxiomNet* axiom_load(const char* filename);
 
+// Values to checkpoint, laid out like the net's ParamArena, so they can be a
+// copy taken while training carries on. params NULL means the layer tensors.
+typedef struct {
+    const float* params;
+    const float* state[PARAM_MAX_STATE];  // optimizer state buffers, num_state of them
+    size_t num_state;
+    Optimizer opt;        // hyperparameters and step count, when has_opt
+    int has_opt;
+} AxiomSnapshot;
+
+// Write a v2 checkpoint of net from snap to f (opened "w+b"). Only the net's
+// structure is read from net, so another thread may keep training it.
+// Returns 0 on success.
+int axiom_write_snapshot(const AxiomNet* net, const AxiomSnapshot* snap, FILE* f);
+
+// Map a v2 checkpoint read-only and use its weights in place: nothing is
+// initialized, and processes serving the same file share its pages. The only
+// copy made is each dense layer's GEMM-packed panels, built once here so
+// forward never packs (see dense_pack).
+// verify = 0 skips the blob checksums (header and layer table are always
+// checked). Optimizer state isn't loaded; training such a net first copies the
+// weights into its own arena. v1 files fall back to axiom_load.
+AxiomNet* axiom_load_mapped(const char* filename, int verify);
+
+// One dense layer's outcome in axiom_compress_lowrank
+typedef struct {
+    size_t layer;           // index in the net
+    size_t input_size;
+    size_t output_size;
+    size_t rank;            // 0: left dense, factoring would not save anything
+    float energy;           // fraction of sum(s^2) the kept singular values hold
+    float rel_error;        // ||W - U V||_F / ||W||_F = sqrt(1 - energy)
+} AxiomCompressLayer;
+
+// Replace each dense layer by its truncated SVD (see lowrank_from_dense): `rank`
+// if nonzero, else the smallest rank keeping `energy` of the spectrum. Layers
+// where rank (in + out) >= in out would not get cheaper and stay dense. If
+// report isn't NULL it gets one entry per dense layer of the original net.
+// If the net has a parameter arena it is rebuilt; factored layers start with
+// no optimizer state. Returns the number of layers factored, or -1 on bad
+// arguments or out of memory.
+int axiom_compress_lowrank(AxiomNet* net, size_t rank, float energy, AxiomCompressLayer* report);
+
+// Memory the library has allocated, process-wide, by category (see memstats.h):
+// live and peak bytes plus allocation counts. Reset peaks with mem_reset_peak().
+void axiom_memory_stats(MemStats* stats);
+
 // Convenience functions for creating layers
 DenseLayer* axiom_layer_dense(size_t input_size, size_t output_size);
+LowRankLayer* axiom_layer_dense_lowrank(size_t input_size, size_t output_size, size_t rank);
+EmbeddingLayer* axiom_layer_embedding(size_t vocab_size, size_t dim, size_t num_fields);
 Activation* axiom_activation_relu(void);
 Activation* axiom_activation_softmax(void);
 
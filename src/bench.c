@@ -0,0 +1,1256 @@
+#define _DEFAULT_SOURCE  // getrusage, fdatasync
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "activations.h"
+#include "autotune.h"
+#include "axiom.h"
+#include "checkpoint.h"
+#include "chunked.h"
+#include "dense.h"
+#include "embedding.h"
+#include "loadgen.h"
+#include "loss.h"
+#include "mnist.h"
+#include "optimizer.h"
+#include "parallel.h"
+#include "predict.h"
+#include "reduce.h"
+#include "rng.h"
+#include "serve.h"
+#include "stream.h"
+#include "tensor.h"
+#include "timer.h"
+
+/*
+ * Kernel microbenchmarks: `make bench` or ./build/bench [options].
+ *
+ * Each case is warmed up, then timed `reps` times. Every sample runs the kernel
+ * enough times back to back to last at least --min-sample-us, so fast kernels
+ * aren't dominated by clock overhead. Reported times are per call. `flops` and
+ * `bytes` are what the operation must do at minimum (inputs read once,
+ * outputs written once); gflops/gbps are derived from the median.
+ *
+ * ./build/bench <command> [options] runs one of the whole-system benchmarks
+ * instead (out-of-core training, checkpointing, the task graph, embeddings,
+ * batch-1 latency, the inference server, streaming learning); see usage().
+ */
+
+#define BENCH_MAX_RESULTS 256
+
+typedef struct {
+    size_t warmup;
+    size_t reps;
+    double min_sample_us;
+    const char* filter;   // only kernels whose name contains this
+} BenchConfig;
+
+typedef struct {
+    char kernel[32];
+    char shape[48];
+    size_t reps;
+    size_t inner;         // calls per sample
+    double min_us, p10_us, median_us, p90_us, max_us;
+    double flops;
+    double bytes;
+} BenchResult;
+
+// inputs and state for one case; run functions use what they need
+typedef struct {
+    Tensor* a;
+    Tensor* b;
+    float* packed;      // b packed into panels, for matmul_packed
+    GemmTiling tiling;  // for matmul_tuned
+    int32_t* labels;    // class id per row of a, for the index losses
+    size_t shape[2];
+    Activation* act;
+    DenseLayer* dense;
+    AxiomNet* net;
+} Fixture;
+
+typedef void (*bench_fn)(Fixture* f);
+
+static BenchResult results[BENCH_MAX_RESULTS];
+static size_t num_results = 0;
+static volatile float sink;  // keeps loss calls from being optimised out
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// nearest-rank percentile of sorted v
+static double percentile(const double* v, size_t n, double p) {
+    return v[(size_t)(p * (double)(n - 1) + 0.5)];
+}
+
+static double time_calls(bench_fn run, Fixture* f, size_t inner) {
+    uint64_t start = timer_now_ns();
+    for (size_t i = 0; i < inner; i++) run(f);
+    return (double)(timer_now_ns() - start) / 1e3 / (double)inner;
+}
+
+static void bench_case(const BenchConfig* cfg, const char* kernel, const char* shape,
+                       double flops, double bytes, bench_fn run, Fixture* f) {
+    if (cfg->filter != NULL && strstr(kernel, cfg->filter) == NULL) return;
+    if (num_results == BENCH_MAX_RESULTS) return;
+
+    // calibrate calls per sample off one cold call, then warm up at that size
+    double once = time_calls(run, f, 1);
+    size_t inner = 1;
+    if (once > 0.0 && once < cfg->min_sample_us) inner = (size_t)(cfg->min_sample_us / once) + 1;
+    for (size_t i = 0; i < cfg->warmup; i++) time_calls(run, f, inner);
+
+    double* samples = malloc(cfg->reps * sizeof(double));
+    if (samples == NULL) return;
+    for (size_t i = 0; i < cfg->reps; i++) samples[i] = time_calls(run, f, inner);
+    qsort(samples, cfg->reps, sizeof(double), compare_double);
+
+    BenchResult* r = &results[num_results++];
+    snprintf(r->kernel, sizeof(r->kernel), "%s", kernel);
+    snprintf(r->shape, sizeof(r->shape), "%s", shape);
+    r->reps = cfg->reps;
+    r->inner = inner;
+    r->min_us = samples[0];
+    r->p10_us = percentile(samples, cfg->reps, 0.10);
+    r->median_us = percentile(samples, cfg->reps, 0.50);
+    r->p90_us = percentile(samples, cfg->reps, 0.90);
+    r->max_us = samples[cfg->reps - 1];
+    r->flops = flops;
+    r->bytes = bytes;
+    free(samples);
+
+    printf("%-24s %-16s %12.2f %12.2f %12.2f", r->kernel, r->shape, r->median_us, r->p10_us, r->p90_us);
+    if (flops > 0.0) printf(" %9.2f GFLOP/s", flops / (r->median_us * 1e3));
+    if (bytes > 0.0) printf(" %9.2f GB/s", bytes / (r->median_us * 1e3));
+    printf("\n");
+    fflush(stdout);
+}
+
+static Tensor* random_tensor(size_t rows, size_t cols, unsigned int seed) {
+    size_t shape[] = {rows, cols};
+    Tensor* t = tensor_create(shape, 2);
+    if (t != NULL) tensor_rand(t, -1.0f, 1.0f, seed);
+    return t;
+}
+
+// softmax-like rows: positive and summing to 1, or one-hot targets
+static Tensor* distribution_tensor(size_t rows, size_t cols, int one_hot, unsigned int seed) {
+    Tensor* t = random_tensor(rows, cols, seed);
+    if (t == NULL) return NULL;
+    for (size_t i = 0; i < rows; i++) {
+        float* row = t->data + i * cols;
+        float sum = 0.0f;
+        for (size_t j = 0; j < cols; j++) {
+            row[j] = one_hot ? (j == (i * 7) % cols ? 1.0f : 0.0f) : row[j] + 1.5f;
+            sum += row[j];
+        }
+        for (size_t j = 0; j < cols; j++) row[j] /= sum;
+    }
+    return t;
+}
+
+static void fixture_free(Fixture* f) {
+    tensor_free(f->a);
+    tensor_free(f->b);
+    free(f->packed);
+    free(f->labels);
+    activation_free(f->act);
+    if (f->net != NULL) {
+        axiom_free(f->net);
+    } else {
+        dense_free(f->dense);
+    }
+    memset(f, 0, sizeof(*f));
+}
+
+static void run_matmul(Fixture* f) { tensor_free(tensor_matmul(f->a, f->b)); }
+static void run_matmul_packed(Fixture* f) { tensor_free(tensor_matmul_packed(f->a, f->packed, f->b->shape[1], NULL)); }
+static void run_matmul_tuned(Fixture* f) { tensor_free(tensor_matmul_packed(f->a, f->packed, f->b->shape[1], &f->tiling)); }
+static void run_pack(Fixture* f) { tensor_pack_panels(f->b->data, f->b->shape[0], f->b->shape[1], f->b->shape[1], 1, f->packed); }
+static void run_transpose(Fixture* f) { tensor_free(tensor_transpose(f->a)); }
+static void run_broadcast(Fixture* f) { tensor_free(tensor_broadcast(f->a, f->shape, 2)); }
+static void run_add(Fixture* f) { tensor_free(tensor_add(f->a, f->b)); }
+static void run_act_forward(Fixture* f) { tensor_free(activation_forward(f->act, f->a)); }
+static void run_act_backward(Fixture* f) { tensor_free(activation_backward(f->act, f->b)); }
+static void run_ce(Fixture* f) { sink = loss_cross_entropy(f->a, f->b); }
+static void run_ce_grad(Fixture* f) { tensor_free(loss_cross_entropy_grad(f->a, f->b)); }
+static void run_ce_index(Fixture* f) { sink = loss_cross_entropy_index(f->a, f->labels); }
+static void run_ce_index_grad(Fixture* f) { tensor_free(loss_cross_entropy_index_grad(f->a, f->labels)); }
+static void run_mse(Fixture* f) { sink = loss_mse(f->a, f->b); }
+static void run_mse_grad(Fixture* f) { tensor_free(loss_mse_grad(f->a, f->b)); }
+static void run_dense_forward(Fixture* f) { tensor_free(dense_forward(f->dense, f->a)); }
+static void run_dense_backward(Fixture* f) { tensor_free(dense_backward(f->dense, f->b)); }
+static void run_optimizer(Fixture* f) { optimizer_step(f->net->optimizer, f->net->layers); }
+
+static void bench_tensor_ops(const BenchConfig* cfg, int quick) {
+    static const size_t mm[][3] = {
+        {64, 784, 128}, {64, 128, 10}, {128, 256, 256}, {256, 512, 512}, {512, 512, 512}, {1024, 1024, 1024},
+    };
+    static const size_t ew[][2] = { {64, 784}, {256, 1024}, {1024, 4096} };
+    size_t num_mm = quick ? 3 : sizeof(mm) / sizeof(mm[0]);
+    size_t num_ew = quick ? 2 : sizeof(ew) / sizeof(ew[0]);
+    char shape[48];
+
+    for (size_t i = 0; i < num_mm; i++) {
+        size_t m = mm[i][0], k = mm[i][1], n = mm[i][2];
+        Fixture f = {0};
+        f.a = random_tensor(m, k, 1);
+        f.b = random_tensor(k, n, 2);
+        if (f.a != NULL && f.b != NULL) {
+            snprintf(shape, sizeof(shape), "%zux%zux%zu", m, k, n);
+            bench_case(cfg, "matmul", shape, 2.0 * m * k * n, 4.0 * (m * k + k * n + m * n), run_matmul, &f);
+            // what dense layers run: b packed once per weight update, then multiplied from the panels
+            f.packed = aligned_alloc(64, tensor_packed_size(k, n) * sizeof(float));
+            if (f.packed != NULL) {
+                run_pack(&f);
+                bench_case(cfg, "matmul_packed", shape, 2.0 * m * k * n, 4.0 * (m * k + k * n + m * n),
+                           run_matmul_packed, &f);
+                // the tiling the autotuner picks for this shape (tuned here on first use, then cached)
+                if (cfg->filter == NULL || strstr("matmul_tuned", cfg->filter) != NULL) f.tiling = autotune_gemm(m, n, k, 0);
+                bench_case(cfg, "matmul_tuned", shape, 2.0 * m * k * n, 4.0 * (m * k + k * n + m * n),
+                           run_matmul_tuned, &f);
+                snprintf(shape, sizeof(shape), "%zux%zu", k, n);
+                bench_case(cfg, "pack_panels", shape, 0.0, 8.0 * k * n, run_pack, &f);
+            }
+        }
+        fixture_free(&f);
+    }
+
+    for (size_t i = 0; i < num_ew; i++) {
+        size_t m = ew[i][0], n = ew[i][1];
+        double size = (double)m * n;
+        snprintf(shape, sizeof(shape), "%zux%zu", m, n);
+
+        Fixture f = {0};
+        f.a = random_tensor(m, n, 3);
+        f.b = random_tensor(m, n, 4);
+        if (f.a != NULL && f.b != NULL) {
+            bench_case(cfg, "transpose", shape, 0.0, 8.0 * size, run_transpose, &f);
+            bench_case(cfg, "add", shape, size, 12.0 * size, run_add, &f);
+        }
+        fixture_free(&f);
+
+        // bias row broadcast up to the full batch, as dense_forward does
+        f.a = random_tensor(1, n, 5);
+        f.shape[0] = m;
+        f.shape[1] = n;
+        if (f.a != NULL) bench_case(cfg, "broadcast", shape, 0.0, 4.0 * (n + size), run_broadcast, &f);
+        fixture_free(&f);
+
+        f.act = activation_relu();
+        f.a = random_tensor(m, n, 6);
+        f.b = random_tensor(m, n, 7);
+        if (f.act != NULL && f.a != NULL && f.b != NULL) {
+            run_act_forward(&f);  // backward needs the caches even when forward is filtered out
+            // plus the one-bit mask forward writes and backward reads
+            bench_case(cfg, "relu_forward", shape, size, 8.125 * size, run_act_forward, &f);
+            bench_case(cfg, "relu_backward", shape, size, 8.125 * size, run_act_backward, &f);
+        }
+        fixture_free(&f);
+    }
+}
+
+static void bench_classifier_heads(const BenchConfig* cfg, int quick) {
+    static const size_t heads[][2] = { {64, 10}, {256, 1000}, {1024, 1000}, {256, 10000} };
+    size_t num = quick ? 2 : sizeof(heads) / sizeof(heads[0]);
+    char shape[48];
+
+    for (size_t i = 0; i < num; i++) {
+        size_t m = heads[i][0], n = heads[i][1];
+        double size = (double)m * n;
+        snprintf(shape, sizeof(shape), "%zux%zu", m, n);
+
+        Fixture f = {0};
+        f.act = activation_softmax();
+        f.a = random_tensor(m, n, 8);
+        f.b = random_tensor(m, n, 9);
+        if (f.act != NULL && f.a != NULL && f.b != NULL) {
+            run_act_forward(&f);
+            bench_case(cfg, "softmax_forward", shape, 0.0, 8.0 * size, run_act_forward, &f);
+            bench_case(cfg, "softmax_backward", shape, 0.0, 12.0 * size, run_act_backward, &f);
+        }
+        fixture_free(&f);
+
+        f.a = distribution_tensor(m, n, 0, 10);
+        f.b = distribution_tensor(m, n, 1, 11);
+        if (f.a != NULL && f.b != NULL) {
+            bench_case(cfg, "cross_entropy", shape, 0.0, 8.0 * size, run_ce, &f);
+            bench_case(cfg, "cross_entropy_grad", shape, 0.0, 12.0 * size, run_ce_grad, &f);
+            bench_case(cfg, "mse", shape, 3.0 * size, 8.0 * size, run_mse, &f);
+            bench_case(cfg, "mse_grad", shape, 2.0 * size, 12.0 * size, run_mse_grad, &f);
+        }
+
+        // the same targets as class ids: the loss reads one probability per row
+        f.labels = malloc(m * sizeof(int32_t));
+        if (f.a != NULL && f.labels != NULL) {
+            for (size_t r = 0; r < m; r++) f.labels[r] = (int32_t)((r * 7919) % n);
+            bench_case(cfg, "cross_entropy_index", shape, 0.0, 8.0 * m, run_ce_index, &f);
+            bench_case(cfg, "cross_entropy_index_grad", shape, 0.0, 8.0 * size + 4.0 * m, run_ce_index_grad, &f);
+        }
+        fixture_free(&f);
+    }
+}
+
+static void bench_dense(const BenchConfig* cfg, int quick) {
+    static const size_t layers[][3] = { {64, 784, 128}, {64, 128, 10}, {256, 1024, 1024} };
+    size_t num = quick ? 2 : sizeof(layers) / sizeof(layers[0]);
+    char shape[48];
+
+    for (size_t i = 0; i < num; i++) {
+        size_t batch = layers[i][0], in = layers[i][1], out = layers[i][2];
+        double weights = (double)in * out;
+        snprintf(shape, sizeof(shape), "%zux%zux%zu", batch, in, out);
+
+        Fixture f = {0};
+        f.dense = dense_create(in, out);
+        f.a = random_tensor(batch, in, 12);
+        f.b = random_tensor(batch, out, 13);
+        if (f.dense != NULL && f.a != NULL && f.b != NULL) {
+            run_dense_forward(&f);
+            bench_case(cfg, "dense_forward", shape, 2.0 * batch * weights,
+                       4.0 * (batch * in + weights + out + batch * out), run_dense_forward, &f);
+            // dW = x^T dy and dx = dy W^T
+            bench_case(cfg, "dense_backward", shape, 4.0 * batch * weights,
+                       4.0 * (2.0 * batch * in + 2.0 * weights + batch * out + out), run_dense_backward, &f);
+            // the same, with the batch sums split and combined as in deterministic mode (reduce.h)
+            int prev = reduce_set_deterministic(1);
+            bench_case(cfg, "dense_backward_det", shape, 4.0 * batch * weights,
+                       4.0 * (2.0 * batch * in + 2.0 * weights + batch * out + out), run_dense_backward, &f);
+            reduce_set_deterministic(prev);
+        }
+        fixture_free(&f);
+    }
+}
+
+static Optimizer* bench_optimizer(int type) {
+    switch (type) {
+        case OPTIMIZER_SGD: return optimizer_sgd_create(0.01f);
+        case OPTIMIZER_MOMENTUM: return optimizer_momentum_create(0.01f, 0.9f);
+        case OPTIMIZER_NESTEROV: return optimizer_nesterov_create(0.01f, 0.9f);
+        case OPTIMIZER_ADAM: return optimizer_adam_create(0.001f, 0.9f, 0.999f, 1e-8f);
+        default: return optimizer_adamw_create(0.001f, 0.9f, 0.999f, 1e-8f, 0.01f);
+    }
+}
+
+static void bench_optimizers(const BenchConfig* cfg, int quick) {
+    static const size_t layers[][2] = { {784, 128}, {1024, 1024}, {4096, 1024} };
+    static const struct { int type; const char* name; } opts[] = {
+        {OPTIMIZER_SGD, "optimizer_sgd"},
+        {OPTIMIZER_MOMENTUM, "optimizer_momentum"},
+        {OPTIMIZER_NESTEROV, "optimizer_nesterov"},
+        {OPTIMIZER_ADAM, "optimizer_adam"},
+        {OPTIMIZER_ADAMW, "optimizer_adamw"},
+    };
+    size_t num = quick ? 2 : sizeof(layers) / sizeof(layers[0]);
+    char shape[48];
+
+    for (size_t i = 0; i < num; i++) {
+        size_t in = layers[i][0], out = layers[i][1];
+        double params = (double)in * out + out;
+        snprintf(shape, sizeof(shape), "%zux%zu", in, out);
+
+        for (size_t o = 0; o < sizeof(opts) / sizeof(opts[0]); o++) {
+            Fixture f = {0};
+            f.net = axiom_create();
+            if (f.net == NULL) continue;
+            axiom_add(f.net, dense_create(in, out), LAYER_DENSE);
+            axiom_set_optimizer(f.net, bench_optimizer(opts[o].type));
+            if (axiom_params_build(f.net) == 0) {
+                // params, grads and each state buffer are read and the params and state written back
+                size_t num_state = optimizer_num_state(f.net->optimizer);
+                bench_case(cfg, opts[o].name, shape, 0.0, 4.0 * params * (3 + 2 * num_state), run_optimizer, &f);
+            }
+            fixture_free(&f);
+        }
+    }
+}
+
+static void write_json(FILE* out, const BenchConfig* cfg, int pinned) {
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"format\": 1,\n");
+    fprintf(out, "  \"timestamp\": %lld,\n", (long long)time(NULL));
+    fprintf(out, "  \"host\": \"%s\",\n", host);
+    fprintf(out, "  \"compiler\": \"%s\",\n", __VERSION__);
+    fprintf(out, "  \"threads\": %zu,\n", parallel_num_threads());
+    fprintf(out, "  \"pinned\": %s,\n", pinned ? "true" : "false");
+    fprintf(out, "  \"warmup\": %zu,\n", cfg->warmup);
+    fprintf(out, "  \"min_sample_us\": %.1f,\n", cfg->min_sample_us);
+    fprintf(out, "  \"results\": [\n");
+    for (size_t i = 0; i < num_results; i++) {
+        const BenchResult* r = &results[i];
+        fprintf(out, "    {\"kernel\": \"%s\", \"shape\": \"%s\", \"reps\": %zu, \"inner\": %zu, "
+                     "\"min_us\": %.3f, \"p10_us\": %.3f, \"median_us\": %.3f, \"p90_us\": %.3f, \"max_us\": %.3f, "
+                     "\"flops\": %.0f, \"bytes\": %.0f, \"gflops\": %.3f, \"gbps\": %.3f}%s\n",
+                r->kernel, r->shape, r->reps, r->inner,
+                r->min_us, r->p10_us, r->median_us, r->p90_us, r->max_us,
+                r->flops, r->bytes, r->flops / (r->median_us * 1e3), r->bytes / (r->median_us * 1e3),
+                i + 1 < num_results ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+static long peak_rss_kb(void) {
+    struct rusage ru;
+    return getrusage(RUSAGE_SELF, &ru) == 0 ? ru.ru_maxrss : -1;
+}
+
+// Out-of-core benchmark: generate a synthetic chunked dataset `factor` times the memory budget,
+// drop it from the page cache, then train one epoch streaming it with a shuffle window sized to the budget.
+static int run_stream_bench(int argc, char* argv[]) {
+    size_t budget_mb = 32;
+    size_t factor = 10;
+    size_t bsize = 64;
+    const char* path = "/tmp/axiom_stream.axds";
+    int keep = 0;
+    for (int i = 2; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--budget-mb") == 0) { budget_mb = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--factor") == 0) { factor = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--batch") == 0) { bsize = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--file") == 0) { path = argv[i + 1]; i++; }
+        else if (strcmp(argv[i], "--keep") == 0) { keep = atoi(argv[i + 1]); i++; }
+    }
+
+    // Synthetic 28x28 "images": noise plus a bright band whose position encodes the class
+    const size_t features = 784, classes = 10;
+    size_t budget = budget_mb << 20;
+    size_t rows = budget * factor / (features + 1);
+    printf("Generating %zu rows (%zu MB, %zux a %zu MB budget) in \"%s\" ...\n",
+           rows, rows * (features + 1) >> 20, factor, budget_mb, path);
+
+    uint64_t start = timer_now_ns();
+    ChunkedWriter* w = chunked_writer_create(path, DATASET_U8, features, 1.0f / 255.0f, classes, 0);
+    if (w == NULL) {
+        printf("bench stream: cannot create \"%s\"\n", path);
+        return 1;
+    }
+    Rng rng;
+    rng_seed(&rng, 7);
+    uint8_t row[784];
+    int ok = 1;
+    for (size_t r = 0; r < rows && ok; r++) {
+        uint8_t label = (uint8_t)rng_below(&rng, (uint32_t)classes);
+        for (size_t j = 0; j < features; j++) {
+            size_t band = (j / 28) * classes / 28;
+            row[j] = (uint8_t)(band == label ? 160 + rng_below(&rng, 96) : rng_below(&rng, 96));
+        }
+        ok = chunked_writer_append(w, row, label) == 0;
+    }
+    if (chunked_writer_close(w) != 0 || !ok) {
+        printf("bench stream: writing \"%s\" failed\n", path);
+        return 1;
+    }
+    printf("Generated in %.1f s\n", timer_elapsed_ms(start) / 1000.0);
+
+    ChunkedFile* f = chunked_open(path);
+    if (f == NULL) {
+        printf("bench stream: cannot open \"%s\"\n", path);
+        return 1;
+    }
+    // Start cold: flush what we just wrote and evict it from the page cache
+    fdatasync(f->fd);
+    for (size_t b = 0; b < f->header.num_blocks; b++) chunked_advise(f, b, 0);
+
+    AxiomNet* net = axiom_create();
+    if (!net) {
+        chunked_close(f);
+        return 1;
+    }
+    axiom_add(net, axiom_layer_dense(features, classes), LAYER_DENSE);
+    axiom_add(net, axiom_activation_softmax(), LAYER_ACTIVATION);
+    // Two windows are resident at a time (current + read-ahead); give them half the budget
+    size_t window_rows = budget / 4 / (features + 1);
+    net->train_opts.shuffle_window = window_rows;
+
+    long rss_before = peak_rss_kb();
+    start = timer_now_ns();
+    axiom_train_dataset(net, &f->x, &f->y, 1, 0.05f, bsize);
+    double secs = timer_elapsed_ms(start) / 1000.0;
+    long rss_after = peak_rss_kb();
+
+    double mb = (double)(f->header.num_blocks * f->header.block_bytes) / (1 << 20);
+    printf("Streamed %zu rows (%.0f MB) in %.2f s: %.0f rows/s, %.1f MB/s, shuffle window %zu rows\n",
+           rows, mb, secs, rows / secs, mb / secs, window_rows);
+    printf("Peak RSS %.1f MB (%.1f MB before training), budget %zu MB: %s\n",
+           rss_after / 1024.0, rss_before / 1024.0, budget_mb,
+           (size_t)rss_after <= budget_mb * 1024 ? "within budget" : "OVER budget");
+
+    axiom_free(net);
+    chunked_close(f);
+    if (!keep) remove(path);
+    return 0;
+}
+
+// Times `steps` training steps on batch x/y, snapshotting into ckpt every `every` steps if ckpt is set.
+// Fills step_ms (steps entries). Returns 0 on success.
+static int timed_steps(AxiomNet* net, Checkpointer* ckpt, const Tensor* x, const Tensor* y,
+                       size_t steps, size_t every, double* step_ms) {
+    for (size_t s = 0; s < steps; s++) {
+        uint64_t start = timer_now_ns();
+        Tensor* pred = axiom_forward(net, x);
+        Tensor* grad = pred ? loss_cross_entropy_grad(pred, y) : NULL;
+        Tensor* grad_in = grad ? axiom_backward(net, grad, net->optimizer) : NULL;
+        if (ckpt != NULL && (s + 1) % every == 0) checkpointer_snapshot(ckpt, net);
+        step_ms[s] = timer_elapsed_ms(start);
+        int ok = grad_in != NULL;
+        tensor_free(pred);
+        tensor_free(grad);
+        tensor_free(grad_in);
+        if (!ok) return -1;
+    }
+    return 0;
+}
+
+// Step-time cost of periodic checkpointing on a large model: per-step times with no checkpoints and with
+// background checkpoints every few steps, plus the cost of one blocking axiom_save for comparison.
+static int run_checkpoint_bench(int argc, char* argv[]) {
+    size_t mb = 256;
+    size_t steps = 30;
+    size_t every = 10;
+    size_t bsize = 4;
+    const char* path = "/tmp/axiom_ckpt_bench.bin";
+    for (int i = 2; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--mb") == 0) { mb = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--steps") == 0) { steps = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--every") == 0) { every = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--batch") == 0) { bsize = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--file") == 0) { path = argv[i + 1]; i++; }
+    }
+    if (steps == 0 || bsize == 0 || every == 0) return 1;
+
+    // One wide layer carries (nearly) all the parameters
+    const size_t in = 4096, classes = 10;
+    size_t hidden = (mb << 20) / sizeof(float) / in;
+    if (hidden == 0) hidden = 1;
+    size_t x_shape[] = { bsize, in };
+    size_t y_shape[] = { bsize, classes };
+    Tensor* x = tensor_create(x_shape, 2);
+    Tensor* y = tensor_create(y_shape, 2);
+    double* base_ms = malloc(steps * sizeof(double));
+    double* ckpt_ms = malloc(steps * sizeof(double));
+    AxiomNet* net = axiom_create();
+    Optimizer* opt = optimizer_sgd_create(0.01f);
+    if (!x || !y || !base_ms || !ckpt_ms || !net || !opt) {
+        tensor_free(x); tensor_free(y); free(base_ms); free(ckpt_ms); axiom_free(net); optimizer_free(opt);
+        return 1;
+    }
+    tensor_rand(x, 0.0f, 1.0f, 3);
+    tensor_fill(y, 0.0f);
+    for (size_t r = 0; r < bsize; r++) y->data[r * classes + r % classes] = 1.0f;
+
+    axiom_add(net, axiom_layer_dense(in, hidden), LAYER_DENSE);
+    axiom_add(net, axiom_activation_relu(), LAYER_ACTIVATION);
+    axiom_add(net, axiom_layer_dense(hidden, classes), LAYER_DENSE);
+    axiom_add(net, axiom_activation_softmax(), LAYER_ACTIVATION);
+    axiom_set_optimizer(net, opt);
+    axiom_params_build(net);
+    size_t params = in * hidden + hidden + hidden * classes + classes;
+    printf("Model %zu -> %zu -> %zu: %.0f MB of parameters, %zu steps of batch %zu per run\n",
+           in, hidden, classes, params * sizeof(float) / 1048576.0, steps, bsize);
+
+    Checkpointer* ckpt = checkpointer_create(net, path);
+    int rc = ckpt != NULL ? 0 : -1;
+    if (rc == 0) rc = timed_steps(net, NULL, x, y, steps, every, base_ms);
+    if (rc == 0) rc = timed_steps(net, ckpt, x, y, steps, every, ckpt_ms);
+    checkpointer_wait(ckpt);
+    CheckpointStats cs = {0};
+    checkpointer_stats(ckpt, &cs);
+    checkpointer_free(ckpt);
+
+    if (rc == 0) {
+        uint64_t start = timer_now_ns();
+        axiom_save(net, path);
+        double save_ms = timer_elapsed_ms(start);
+
+        qsort(base_ms, steps, sizeof(double), compare_double);
+        qsort(ckpt_ms, steps, sizeof(double), compare_double);
+        printf("Step time without checkpoints: median %.1f ms, max %.1f ms\n", base_ms[steps / 2], base_ms[steps - 1]);
+        printf("Step time, checkpoint every %zu steps: median %.1f ms, max %.1f ms\n", every, ckpt_ms[steps / 2], ckpt_ms[steps - 1]);
+        printf("Snapshot pause: %.1f ms max, %.1f ms avg over %zu snapshots (%zu skipped); background write %.1f ms avg\n",
+               cs.snapshot_ms_max, cs.taken > 0 ? cs.snapshot_ms_total / cs.taken : 0.0, cs.taken, cs.skipped,
+               cs.taken > 0 ? cs.write_ms_total / cs.taken : 0.0);
+        printf("A blocking axiom_save of the same model stalls training for %.1f ms\n", save_ms);
+    } else {
+        printf("bench checkpoint: training or checkpoint setup failed\n");
+    }
+
+    remove(path);
+    tensor_free(x);
+    tensor_free(y);
+    free(base_ms);
+    free(ckpt_ms);
+    axiom_free(net);
+    return rc == 0 ? 0 : 1;
+}
+
+static AxiomNet* graph_bench_net(size_t in, size_t hidden, size_t layers, size_t classes, int task_graph) {
+    AxiomNet* net = axiom_create();
+    if (!net) return NULL;
+    size_t width = in;
+    for (size_t l = 0; l < layers; l++) {
+        axiom_add(net, axiom_layer_dense(width, hidden), LAYER_DENSE);
+        axiom_add(net, axiom_activation_relu(), LAYER_ACTIVATION);
+        width = hidden;
+    }
+    axiom_add(net, axiom_layer_dense(width, classes), LAYER_DENSE);
+    axiom_add(net, axiom_activation_softmax(), LAYER_ACTIVATION);
+    axiom_set_optimizer(net, optimizer_adam_create(0.001f, 0.9f, 0.999f, 1e-8f));
+    if (!net->optimizer || axiom_params_build(net) != 0) {
+        axiom_free(net);
+        return NULL;
+    }
+    net->train_opts.task_graph = task_graph;
+    return net;
+}
+
+// Step time of the serial backward pass against the task-graph one over small batch sizes, where the
+// per-op work is too small to split further. Both nets start from the same weights and see the same
+// batches, so their weights must still be identical at the end.
+static int run_graph_bench(int argc, char* argv[]) {
+    size_t hidden = 256;
+    size_t layers = 3;
+    size_t steps = 50;
+    for (int i = 2; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--hidden") == 0) { hidden = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--layers") == 0) { layers = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--steps") == 0) { steps = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--threads") == 0) { parallel_set_num_threads((size_t)atol(argv[i + 1])); i++; }
+    }
+    if (hidden == 0 || steps == 0) return 1;
+
+    const size_t in = 784, classes = 10, warmup = 3;
+    const size_t batches[] = { 1, 4, 16, 64, 256 };
+    double* serial_ms = malloc(steps * sizeof(double));
+    double* graph_ms = malloc(steps * sizeof(double));
+    if (!serial_ms || !graph_ms) {
+        free(serial_ms);
+        free(graph_ms);
+        return 1;
+    }
+    printf("Model %zu -> %zu x %zu -> %zu (Adam), %zu threads, median of %zu steps\n",
+           in, hidden, layers, classes, parallel_num_threads(), steps);
+    printf("%6s %12s %12s %8s %12s %12s %10s\n", "batch", "serial ms", "graph ms", "speedup", "utilization",
+           "steals/step", "weights");
+
+    int rc = 0;
+    for (size_t b = 0; b < sizeof(batches) / sizeof(batches[0]) && rc == 0; b++) {
+        size_t bsize = batches[b];
+        size_t x_shape[] = { bsize, in };
+        size_t y_shape[] = { bsize, classes };
+        Tensor* x = tensor_create(x_shape, 2);
+        Tensor* y = tensor_create(y_shape, 2);
+        AxiomNet* serial = graph_bench_net(in, hidden, layers, classes, 0);
+        AxiomNet* graph = graph_bench_net(in, hidden, layers, classes, 1);
+        if (!x || !y || !serial || !graph) rc = -1;
+        if (rc == 0) {
+            tensor_rand(x, 0.0f, 1.0f, 3);
+            tensor_fill(y, 0.0f);
+            for (size_t r = 0; r < bsize; r++) y->data[r * classes + r % classes] = 1.0f;
+
+            rc = timed_steps(serial, NULL, x, y, warmup, 1, serial_ms);
+            if (rc == 0) rc = timed_steps(graph, NULL, x, y, warmup, 1, graph_ms);
+            memset(&graph->backward_stats, 0, sizeof graph->backward_stats);
+            if (rc == 0) rc = timed_steps(serial, NULL, x, y, steps, 1, serial_ms);
+            if (rc == 0) rc = timed_steps(graph, NULL, x, y, steps, 1, graph_ms);
+        }
+        if (rc == 0) {
+            qsort(serial_ms, steps, sizeof(double), compare_double);
+            qsort(graph_ms, steps, sizeof(double), compare_double);
+            const TaskGraphStats* gs = &graph->backward_stats;
+            int same = memcmp(serial->params->params, graph->params->params,
+                              serial->params->size * sizeof(float)) == 0;
+            char util[16] = "-", steals[16] = "-";  // one thread: the graph isn't used
+            if (gs->runs > 0) {
+                snprintf(util, sizeof util, "%.1f%%", 100.0 * (double)gs->busy_ns / (double)gs->slot_ns);
+                snprintf(steals, sizeof steals, "%.1f", (double)gs->steals / (double)gs->runs);
+            }
+            printf("%6zu %12.3f %12.3f %7.2fx %12s %12s %10s\n", bsize, serial_ms[steps / 2], graph_ms[steps / 2],
+                   serial_ms[steps / 2] / graph_ms[steps / 2], util, steals, same ? "identical" : "DIFFER");
+            if (!same) rc = -1;
+        }
+        tensor_free(x);
+        tensor_free(y);
+        axiom_free(serial);
+        axiom_free(graph);
+    }
+    if (rc != 0) printf("bench graph: a run failed or the two schedules diverged\n");
+    printf("Utilization: time in task bodies over threads x wall time of the task-graph backward passes\n");
+
+    free(serial_ms);
+    free(graph_ms);
+    return rc == 0 ? 0 : 1;
+}
+
+// Categorical IDs -> embedding -> dense -> softmax, for `bench embed`
+static AxiomNet* embed_bench_net(size_t vocab, size_t dim, size_t fields, size_t classes, int one_hot) {
+    AxiomNet* net = axiom_create();
+    if (!net) return NULL;
+    if (one_hot) {
+        axiom_add(net, axiom_layer_dense(fields * vocab, fields * dim), LAYER_DENSE);
+    } else {
+        axiom_add(net, axiom_layer_embedding(vocab, dim, fields), LAYER_EMBEDDING);
+    }
+    axiom_add(net, axiom_layer_dense(fields * dim, classes), LAYER_DENSE);
+    axiom_add(net, axiom_activation_softmax(), LAYER_ACTIVATION);
+    axiom_set_optimizer(net, optimizer_adam_create(0.001f, 0.9f, 0.999f, 1e-8f));
+    if (net->num_layers != 3 || !net->optimizer || axiom_params_build(net) != 0) {
+        axiom_free(net);
+        return NULL;
+    }
+    return net;
+}
+
+// Adam step time of an embedding table as the vocabulary grows: with sparse row updates it should stay
+// flat, since a step only touches the rows in the batch. Small vocabularies are also run as the
+// equivalent one-hot input into a dense layer.
+static int run_embed_bench(int argc, char* argv[]) {
+    size_t dim = 16, fields = 8, bsize = 64, steps = 30, max_vocab = 1000000;
+    for (int i = 2; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--dim") == 0) { dim = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--fields") == 0) { fields = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--batch") == 0) { bsize = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--steps") == 0) { steps = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--max-vocab") == 0) { max_vocab = (size_t)atol(argv[i + 1]); i++; }
+    }
+    if (dim == 0 || fields == 0 || bsize == 0 || steps == 0) return 1;
+    if (max_vocab > EMBEDDING_MAX_VOCAB) {
+        printf("bench embed: tables are capped at %u rows (IDs are exact floats only up to 2^24)\n", EMBEDDING_MAX_VOCAB);
+        max_vocab = EMBEDDING_MAX_VOCAB;
+    }
+
+    const size_t classes = 10, one_hot_max = 1000;
+    double* embed_ms = malloc(steps * sizeof(double));
+    double* dense_ms = malloc(steps * sizeof(double));
+    if (!embed_ms || !dense_ms) {
+        free(embed_ms);
+        free(dense_ms);
+        return 1;
+    }
+    printf("%zu fields x dim %zu -> %zu classes, batch %zu (%zu IDs/step), Adam, median of %zu steps\n",
+           fields, dim, classes, bsize, bsize * fields, steps);
+    printf("%10s %10s %10s %12s %12s %14s\n", "vocab", "table MB", "build ms", "embed ms", "rows/step", "one-hot ms");
+
+    int rc = 0;
+    for (size_t vocab = 1000; vocab <= max_vocab && rc == 0; vocab *= 10) {
+        size_t x_shape[] = { bsize, fields };
+        size_t y_shape[] = { bsize, classes };
+        Tensor* x = tensor_create(x_shape, 2);
+        Tensor* y = tensor_create(y_shape, 2);
+        uint64_t start = timer_now_ns();
+        AxiomNet* net = embed_bench_net(vocab, dim, fields, classes, 0);
+        double build_ms = timer_elapsed_ms(start);
+        if (!x || !y || !net) rc = -1;
+        if (rc == 0) {
+            Rng rng;
+            rng_seed(&rng, 7);
+            for (size_t i = 0; i < bsize * fields; i++) x->data[i] = (float)rng_below(&rng, (uint32_t)vocab);
+            tensor_fill(y, 0.0f);
+            for (size_t r = 0; r < bsize; r++) y->data[r * classes + r % classes] = 1.0f;
+            rc = timed_steps(net, NULL, x, y, steps, 1, embed_ms);
+        }
+
+        char one_hot[32] = "-";
+        if (rc == 0 && vocab <= one_hot_max) {
+            // the same IDs as one-hot rows of width fields * vocab
+            size_t oh_shape[] = { bsize, fields * vocab };
+            Tensor* oh = tensor_create(oh_shape, 2);
+            AxiomNet* dense = embed_bench_net(vocab, dim, fields, classes, 1);
+            if (oh && dense) {
+                tensor_fill(oh, 0.0f);
+                for (size_t r = 0; r < bsize; r++) {
+                    for (size_t f = 0; f < fields; f++) {
+                        oh->data[r * fields * vocab + f * vocab + (size_t)x->data[r * fields + f]] = 1.0f;
+                    }
+                }
+                if (timed_steps(dense, NULL, oh, y, steps, 1, dense_ms) == 0) {
+                    qsort(dense_ms, steps, sizeof(double), compare_double);
+                    snprintf(one_hot, sizeof one_hot, "%.3f", dense_ms[steps / 2]);
+                }
+            }
+            tensor_free(oh);
+            axiom_free(dense);
+        }
+
+        if (rc == 0) {
+            qsort(embed_ms, steps, sizeof(double), compare_double);
+            printf("%10zu %10.1f %10.1f %12.3f %12zu %14s\n", vocab, vocab * dim * sizeof(float) / 1048576.0,
+                   build_ms, embed_ms[steps / 2], net->layers->layer.embedding->num_rows, one_hot);
+        }
+        tensor_free(x);
+        tensor_free(y);
+        axiom_free(net);
+    }
+    if (rc != 0) printf("bench embed: a run failed\n");
+
+    free(embed_ms);
+    free(dense_ms);
+    return rc == 0 ? 0 : 1;
+}
+
+// in -> hidden... (ReLU) -> out (Softmax), for `bench latency`
+static AxiomNet* latency_bench_net(const size_t* sizes, size_t n) {
+    AxiomNet* net = axiom_create();
+    if (!net) return NULL;
+    for (size_t i = 0; i + 1 < n; i++) {
+        axiom_add(net, axiom_layer_dense(sizes[i], sizes[i + 1]), LAYER_DENSE);
+        axiom_add(net, i + 2 < n ? axiom_activation_relu() : axiom_activation_softmax(), LAYER_ACTIVATION);
+    }
+    if (net->num_layers != 2 * (n - 1)) {
+        axiom_free(net);
+        return NULL;
+    }
+    return net;
+}
+
+static size_t tracked_allocs(void) {
+    MemStats ms;
+    axiom_memory_stats(&ms);
+    size_t allocs = 0;
+    for (int c = 0; c < MEM_NUM_CATEGORIES; c++) allocs += ms.category[c].allocs;
+    return allocs;
+}
+
+static void print_latency_row(const char* model, const char* path, double* us, size_t iters, double allocs) {
+    double sum = 0.0;
+    for (size_t i = 0; i < iters; i++) sum += us[i];
+    qsort(us, iters, sizeof(double), compare_double);
+    printf("%-22s %-14s %9.2f %9.2f %9.2f %12.1f\n", model, path, us[iters / 2], us[iters * 99 / 100],
+           sum / (double)iters, allocs);
+}
+
+// Times `iters` single-row calls through axiom_forward and through a Predictor, cycling over rows of x
+static int latency_run(AxiomNet* net, const char* model, const float* x, size_t rows, size_t iters) {
+    Predictor* p = predictor_create(net);
+    if (!p) {
+        printf("bench latency: %s: no predictor for this net\n", model);
+        return -1;
+    }
+    size_t in = predictor_num_inputs(p), outs = predictor_num_outputs(p);
+    size_t warmup = iters / 10 + 1;
+    double* us = malloc(iters * sizeof(double));
+    float* out = malloc(outs * sizeof(float));
+    int rc = us && out ? 0 : -1;
+
+    // the general path, as a batch of one: view the row, forward, free the result
+    float max_diff = 0.0f;
+    size_t allocs = 0;
+    for (size_t i = 0; rc == 0 && i < warmup + iters; i++) {
+        float* row = (float*)x + (i % rows) * in;
+        size_t shape[] = { 1, in };
+        if (i == warmup) allocs = tracked_allocs();
+        uint64_t start = timer_now_ns();
+        Tensor* v = tensor_view(row, shape, 2);
+        Tensor* o = v ? axiom_forward(net, v) : NULL;
+        uint64_t ns = timer_now_ns() - start;
+        if (i >= warmup) us[i - warmup] = ns / 1000.0;
+        if (!o || o->size != outs || predictor_run(p, row, out) != 0) rc = -1;
+        for (size_t j = 0; rc == 0 && j < outs; j++) {
+            float d = fabsf(o->data[j] - out[j]);
+            if (d > max_diff) max_diff = d;
+        }
+        tensor_free(o);
+        tensor_free(v);
+    }
+    if (rc == 0) print_latency_row(model, "axiom_forward", us, iters, (double)(tracked_allocs() - allocs) / iters);
+
+    for (size_t i = 0; rc == 0 && i < warmup + iters; i++) {
+        if (i == warmup) allocs = tracked_allocs();
+        uint64_t start = timer_now_ns();
+        if (predictor_run(p, x + (i % rows) * in, out) != 0) rc = -1;
+        uint64_t ns = timer_now_ns() - start;
+        if (i >= warmup) us[i - warmup] = ns / 1000.0;
+    }
+    if (rc == 0) {
+        print_latency_row("", "predictor", us, iters, (double)(tracked_allocs() - allocs) / iters);
+        printf("%-22s max |difference| %.2e\n", "", (double)max_diff);
+    } else {
+        printf("bench latency: %s: a run failed\n", model);
+    }
+    free(us);
+    free(out);
+    predictor_free(p);
+    return rc;
+}
+
+// Single-request latency (p50/p99 over many calls) of axiom_forward against a Predictor: a saved model, or
+// MNIST-sized and wide randomly initialised nets. Inputs are MNIST test images when --data opens, else uniform noise.
+static int run_latency_bench(int argc, char* argv[]) {
+    const char* model_path = NULL;
+    const char* data_path = "data/MNIST";
+    size_t iters = 2000;
+    for (int i = 2; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--model") == 0) model_path = argv[++i];
+        else if (strcmp(argv[i], "--data") == 0) data_path = argv[++i];
+        else if (strcmp(argv[i], "--iters") == 0) iters = (size_t)atol(argv[++i]);
+    }
+    if (iters == 0) return 1;
+
+    static const size_t mnist_sizes[] = { 784, 128, 10 };
+    static const size_t wide_sizes[] = { 784, 1024, 1024, 10 };
+    const char* names[2] = { "784-128-10", "784-1024-1024-10" };
+    AxiomNet* nets[2] = { NULL, NULL };
+    size_t num_nets = 0;
+    if (model_path) {
+        names[0] = model_path;
+        nets[num_nets++] = axiom_load(model_path);
+    } else {
+        nets[num_nets++] = latency_bench_net(mnist_sizes, 3);
+        nets[num_nets++] = latency_bench_net(wide_sizes, 4);
+    }
+    int rc = 0;
+    for (size_t m = 0; m < num_nets; m++) {
+        if (!nets[m]) {
+            printf("bench latency: could not %s %s\n", model_path ? "load" : "build", names[m]);
+            rc = -1;
+        }
+    }
+
+    // enough distinct rows that the inputs don't all sit in L1
+    const size_t rows = 1000;
+    size_t in = 0;
+    for (size_t m = 0; rc == 0 && m < num_nets; m++) {
+        Predictor* p = predictor_create(nets[m]);
+        if (predictor_num_inputs(p) > in) in = predictor_num_inputs(p);
+        predictor_free(p);
+    }
+    float* x = rc == 0 && in > 0 ? malloc(rows * in * sizeof(float)) : NULL;
+    if (rc == 0 && !x) {
+        printf("bench latency: no predictor for %s\n", names[0]);
+        rc = -1;
+    }
+    const char* source = "uniform noise";
+    if (x) {
+        MnistData data;
+        if (mnist_open(data_path, &data) == 0) {
+            if (dataset_width(&data.x_test) == in && data.x_test.rows >= rows) {
+                size_t shape[] = { rows, in };
+                Tensor* t = tensor_view(x, shape, 2);
+                size_t* idx = malloc(rows * sizeof(size_t));
+                if (t && idx) {
+                    for (size_t i = 0; i < rows; i++) idx[i] = i;
+                    dataset_gather(&data.x_test, t, idx, rows);
+                    source = "MNIST test images";
+                }
+                free(idx);
+                tensor_free(t);
+            }
+            mnist_close(&data);
+        }
+        if (strcmp(source, "uniform noise") == 0) {
+            Rng rng;
+            rng_seed(&rng, 7);
+            for (size_t i = 0; i < rows * in; i++) x[i] = rng_uniform(&rng);
+        }
+    }
+
+    if (rc == 0) {
+        printf("Batch-1 latency over %zu calls (after %zu warm-up), inputs: %s\n", iters, iters / 10 + 1, source);
+        printf("%-22s %-14s %9s %9s %9s %12s\n", "model", "path", "p50 us", "p99 us", "mean us", "allocs/call");
+    }
+    for (size_t m = 0; rc == 0 && m < num_nets; m++) rc = latency_run(nets[m], names[m], x, rows, iters);
+
+    free(x);
+    for (size_t m = 0; m < num_nets; m++) axiom_free(nets[m]);
+    return rc == 0 ? 0 : 1;
+}
+
+static void print_loadgen_row(const char* label, const LoadgenResult* r) {
+    printf("%-22s %10.0f %10.1f %10.1f %9.2f %10.1f %7zu\n", label, r->throughput,
+           r->p50_us, r->p99_us, r->mean_batch, r->mean_queue_us, r->errors);
+}
+
+static int run_loadgen(int argc, char* argv[]) {
+    LoadgenConfig cfg = { "/tmp/axiom.sock", 16, 20000, 784 };
+    const char* model_path = NULL;
+    size_t workers = 2;
+    for (int i = 2; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--socket") == 0) { cfg.socket_path = argv[i + 1]; i++; }
+        else if (strcmp(argv[i], "--clients") == 0) { cfg.clients = (size_t)atoi(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--requests") == 0) { cfg.requests = (size_t)atoi(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--features") == 0) { cfg.num_features = (size_t)atoi(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--model") == 0) { model_path = argv[i + 1]; i++; }
+        else if (strcmp(argv[i], "--workers") == 0) { workers = (size_t)atoi(argv[i + 1]); i++; }
+    }
+
+    printf("%-22s %10s %10s %10s %9s %10s %7s\n", "config", "req/s", "p50 us", "p99 us", "avg batch", "queue us", "errors");
+
+    // against an already running server
+    if (model_path == NULL) {
+        LoadgenResult r;
+        if (loadgen_run(&cfg, &r) != 0) {
+            printf("bench loadgen: could not connect to %s\n", cfg.socket_path);
+            return 1;
+        }
+        print_loadgen_row(cfg.socket_path, &r);
+        return 0;
+    }
+
+    // sweep batching parameters with an in-process server per configuration
+    size_t batches[] = { 1, 8, 32, 64 };
+    double delays_ms[] = { 0.0, 0.5, 2.0 };
+    for (size_t b = 0; b < sizeof batches / sizeof batches[0]; b++) {
+        for (size_t d = 0; d < sizeof delays_ms / sizeof delays_ms[0]; d++) {
+            ServeConfig scfg = { cfg.socket_path, batches[b], delays_ms[d], workers };
+            ServeServer* server = serve_start(model_path, &scfg);
+            if (server == NULL) {
+                printf("bench loadgen: could not serve \"%s\" on %s\n", model_path, cfg.socket_path);
+                return 1;
+            }
+            cfg.num_features = serve_num_features(server);
+
+            LoadgenResult r;
+            int rc = loadgen_run(&cfg, &r);
+            serve_stop(server);
+            if (rc != 0) {
+                printf("bench loadgen: could not connect to %s\n", cfg.socket_path);
+                return 1;
+            }
+
+            char label[64];
+            snprintf(label, sizeof label, "batch=%zu delay=%.1fms", batches[b], delays_ms[d]);
+            print_loadgen_row(label, &r);
+        }
+    }
+    return 0;
+}
+
+// Synthetic records for `learn`: ./build/bench gen-records --features 784 --classes 10 | ./build/main learn ...
+static int run_gen_records(int argc, char* argv[]) {
+    size_t features = 784, classes = 10, count = 100000;
+    int bytes = 0;
+    uint64_t seed = 1;
+    for (int i = 2; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--features") == 0) { features = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--classes") == 0) { classes = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--count") == 0) { count = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--format") == 0) { bytes = strcmp(argv[i + 1], "u8") == 0; i++; }
+        else if (strcmp(argv[i], "--seed") == 0) { seed = strtoull(argv[i + 1], NULL, 10); i++; }
+    }
+    // a reader that goes away ends the run with an error instead of killing it
+    signal(SIGPIPE, SIG_IGN);
+    if (stream_generate(STDOUT_FILENO, count, features, classes, bytes, seed) != 0) {
+        fprintf(stderr, "bench gen-records: write failed\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Comma-separated numbers into out[0..max); returns how many were read
+static size_t parse_list(const char* s, double* out, size_t max) {
+    size_t n = 0;
+    while (s != NULL && *s != '\0' && n < max) {
+        char* end;
+        double v = strtod(s, &end);
+        if (end == s) break;
+        out[n++] = v;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+// features -> hidden (ReLU) -> classes (softmax) with momentum, as `main learn` builds it, for `bench learn`
+static AxiomNet* learn_bench_net(size_t features, size_t hidden, size_t classes, Optimizer* opt) {
+    AxiomNet* net = axiom_create();
+    if (net == NULL || opt == NULL) {
+        axiom_free(net);
+        optimizer_free(opt);
+        return NULL;
+    }
+    axiom_add(net, axiom_layer_dense(features, hidden), LAYER_DENSE);
+    axiom_add(net, axiom_activation_relu(), LAYER_ACTIVATION);
+    axiom_add(net, axiom_layer_dense(hidden, classes), LAYER_DENSE);
+    axiom_add(net, axiom_activation_softmax(), LAYER_ACTIVATION);
+    if (axiom_set_optimizer(net, opt) != 0) {
+        axiom_free(net);
+        return NULL;
+    }
+    return net;
+}
+
+// Sustained records/s of `learn` fed through a pipe by a generator process, per wire format and batch size.
+// The first row only drains the pipe, for the input side's ceiling.
+static int run_learn_bench(int argc, char* argv[]) {
+    size_t features = 784, classes = 10, hidden = 128, records = 100000;
+    double batches[16];
+    size_t num_batches = parse_list("32,128,512", batches, 16);
+    for (int i = 2; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--features") == 0) { features = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--classes") == 0) { classes = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--hidden") == 0) { hidden = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--records") == 0) { records = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--batch") == 0) { num_batches = parse_list(argv[i + 1], batches, 16); i++; }
+    }
+    printf("bench learn: %zu records of %zu features, %zu -> %zu -> %zu, generator in a child process\n",
+           records, features, features, hidden, classes);
+    printf("%-6s %6s %12s %8s %7s %8s %8s %9s %8s\n", "format", "batch", "records/s", "MB/s", "steps",
+           "train %", "wait %", "blocked %", "loss");
+
+    signal(SIGPIPE, SIG_IGN);
+    int rc = 0;
+    for (int bytes = 0; bytes <= 1 && rc == 0; bytes++) {
+        for (size_t b = 0; b <= num_batches && rc == 0; b++) {
+            int fds[2];
+            if (pipe(fds) != 0) return 1;
+            pid_t child = fork();
+            if (child < 0) return 1;
+            if (child == 0) {
+                close(fds[0]);
+                int failed = stream_generate(fds[1], records, features, classes, bytes, 1) != 0;
+                close(fds[1]);
+                _exit(failed);
+            }
+            close(fds[1]);
+
+            const char* format = bytes ? "u8" : "f32";
+            if (b == 0) {
+                // pipe ceiling: read and drop
+                static char sink_buf[1 << 16];
+                size_t total = 0;
+                uint64_t start = 0;
+                ssize_t got;
+                while ((got = read(fds[0], sink_buf, sizeof sink_buf)) > 0) {
+                    if (total == 0) start = timer_now_ns();
+                    total += (size_t)got;
+                }
+                double secs = timer_elapsed_ms(start) / 1000.0;
+                size_t n = total / stream_record_size(features, bytes);
+                printf("%-6s %6s %12.0f %8.1f %7s %8s %8s %9s %8s\n", format, "drain", n / secs, total / secs / 1e6,
+                       "-", "-", "-", "-", "-");
+            } else {
+                StreamConfig cfg = { .batch_size = (size_t)batches[b - 1], .num_buffers = 4, .learning_rate = 0.05f };
+                AxiomNet* net = learn_bench_net(features, hidden, classes, optimizer_momentum_create(0.05f, 0.9f));
+                StreamStats s;
+                if (net == NULL || stream_learn(net, fds[0], &cfg, &s) != 0) {
+                    printf("bench learn: run failed\n");
+                    rc = 1;
+                } else {
+                    double wall_ms = 1000.0 * s.seconds;
+                    printf("%-6s %6zu %12.0f %8.1f %7zu %8.1f %8.1f %9.1f %8.4f\n", format, cfg.batch_size,
+                           s.records / s.seconds, s.bytes / s.seconds / 1e6, s.batches, 100.0 * s.train_ms / wall_ms,
+                           100.0 * s.train_wait_ms / wall_ms, 100.0 * s.reader_blocked_ms / wall_ms, s.loss);
+                }
+                axiom_free(net);
+            }
+            close(fds[0]);
+            int status = 0;
+            waitpid(child, &status, 0);
+            fflush(stdout);
+        }
+    }
+    return rc;
+}
+
+static void usage(const char* prog) {
+    printf("Usage: %s [--reps 25] [--warmup 3] [--min-sample-us 2000] [--threads n] [--no-pin]\n", prog);
+    printf("       %*s [--filter name] [--quick] [--json out.json]\n", (int)strlen(prog), "");
+    printf("                             Kernel microbenchmarks\n");
+    printf("       %s <command> [options]\n", prog);
+    printf("Commands:\n");
+    printf("  stream [--budget-mb <n>] [--factor <n>] [--batch <n>] [--file <path>] [--keep 0|1]\n");
+    printf("                             Train on a synthetic chunked dataset <factor>x the memory budget\n");
+    printf("  checkpoint [--mb <n>] [--steps <n>] [--every <n>] [--batch <n>] [--file <path>]\n");
+    printf("                             Step-time impact of background checkpointing on a large model\n");
+    printf("  graph [--hidden <n>] [--layers <n>] [--steps <n>] [--threads <n>]\n");
+    printf("                             Serial vs task-graph backward pass at small batch sizes\n");
+    printf("  embed [--dim <n>] [--fields <n>] [--batch <n>] [--steps <n>] [--max-vocab <n>]\n");
+    printf("                             Embedding step time against vocabulary size (sparse row updates)\n");
+    printf("  latency [--model <model_file>] [--iters <n>] [--data <dir>]\n");
+    printf("                             Batch-1 p50/p99 latency: axiom_forward against the packed predictor\n");
+    printf("  loadgen [--socket <path>] [--clients <n>] [--requests <n>] [--features <n>]\n");
+    printf("          [--model <model_file> [--workers <n>]]\n");
+    printf("                             Load-test a server; with --model, sweep batching settings\n");
+    printf("  learn [--features <n>] [--classes <n>] [--hidden <n>] [--records <n>] [--batch <a,b,..>]\n");
+    printf("                             Sustained records/s of `main learn` fed by a generator process\n");
+    printf("  gen-records [--features <n>] [--classes <n>] [--count <n>] [--format f32|u8] [--seed <n>]\n");
+    printf("                             Write synthetic records for `main learn` to stdout\n");
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 2 && argv[1][0] != '-') {
+        if (strcmp(argv[1], "stream") == 0) {
+            return run_stream_bench(argc, argv);
+        } else if (strcmp(argv[1], "checkpoint") == 0) {
+            return run_checkpoint_bench(argc, argv);
+        } else if (strcmp(argv[1], "graph") == 0) {
+            return run_graph_bench(argc, argv);
+        } else if (strcmp(argv[1], "embed") == 0) {
+            return run_embed_bench(argc, argv);
+        } else if (strcmp(argv[1], "latency") == 0) {
+            return run_latency_bench(argc, argv);
+        } else if (strcmp(argv[1], "loadgen") == 0) {
+            return run_loadgen(argc, argv);
+        } else if (strcmp(argv[1], "learn") == 0) {
+            return run_learn_bench(argc, argv);
+        } else if (strcmp(argv[1], "gen-records") == 0) {
+            return run_gen_records(argc, argv);
+        }
+        printf("Unknown command: %s\n", argv[1]);
+        usage(argv[0]);
+        return 1;
+    }
+
+    BenchConfig cfg = { 3, 25, 2000.0, NULL };
+    const char* json_path = NULL;
+    size_t threads = 0;
+    int pin = 1;
+    int quick = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            cfg.reps = (size_t)atol(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            cfg.warmup = (size_t)atol(argv[++i]);
+        } else if (strcmp(argv[i], "--min-sample-us") == 0 && i + 1 < argc) {
+            cfg.min_sample_us = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = (size_t)atol(argv[++i]);
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            cfg.filter = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--no-pin") == 0) {
+            pin = 0;
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            quick = 1;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (cfg.reps == 0) cfg.reps = 1;
+
+    if (threads > 0) parallel_set_num_threads(threads);
+    if (pin) parallel_set_pinning(1);
+    // tune in memory: a bench run neither reads nor rewrites the user's cache
+    autotune_set_cache_path("");
+
+    printf("axiom kernel bench: %zu threads%s, %zu reps, %zu warmup\n",
+           parallel_num_threads(), pin ? " (pinned)" : "", cfg.reps, cfg.warmup);
+    printf("%-24s %-16s %12s %12s %12s\n", "kernel", "shape", "median us", "p10 us", "p90 us");
+
+    bench_tensor_ops(&cfg, quick);
+    bench_classifier_heads(&cfg, quick);
+    bench_dense(&cfg, quick);
+    bench_optimizers(&cfg, quick);
+
+    if (json_path != NULL) {
+        FILE* out = fopen(json_path, "w");
+        if (out == NULL) {
+            printf("bench: could not write %s\n", json_path);
+            return 1;
+        }
+        write_json(out, &cfg, pin);
+        fclose(out);
+        printf("Wrote %zu results to %s\n", num_results, json_path);
+    }
+    return 0;
+}
@@ -0,0 +1,198 @@
+#define _POSIX_C_SOURCE 200809L
+#include "checkpoint.h"
+#include "memstats.h"
+#include "timer.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct Checkpointer {
+    const AxiomNet* net;
+    char* path;
+    char* tmp_path;
+    float* staging;         // params, then each optimizer state buffer, arena size floats apiece
+    size_t size;            // floats per buffer
+    size_t num_state;
+    AxiomSnapshot snap;     // points into staging
+
+    pthread_t writer;
+    pthread_mutex_t lock;   // guards everything below
+    pthread_cond_t cv;
+    int pending;            // staging holds a snapshot that hasn't been written yet
+    int stopping;
+    CheckpointStats stats;
+};
+
+// fsync the directory so the rename itself survives a crash
+static void sync_parent_dir(const char* path) {
+    const char* slash = strrchr(path, '/');
+    char dir[1024];
+    if (slash == NULL) {
+        strcpy(dir, ".");
+    } else {
+        size_t len = (size_t)(slash - path);
+        if (len == 0) len = 1;  // "/file"
+        if (len >= sizeof dir) return;
+        memcpy(dir, path, len);
+        dir[len] = '\0';
+    }
+    int fd = open(dir, O_RDONLY);
+    if (fd < 0) return;
+    fsync(fd);
+    close(fd);
+}
+
+static int write_checkpoint(Checkpointer* cp) {
+    FILE* f = fopen(cp->tmp_path, "w+b");
+    if (f == NULL) return -1;
+
+    int failed = axiom_write_snapshot(cp->net, &cp->snap, f) != 0;
+    if (!failed && fsync(fileno(f)) != 0) failed = 1;
+    if (fclose(f) != 0) failed = 1;
+    if (failed) {
+        remove(cp->tmp_path);
+        return -1;
+    }
+    if (rename(cp->tmp_path, cp->path) != 0) return -1;
+    sync_parent_dir(cp->path);
+    return 0;
+}
+
+static void* writer_main(void* arg) {
+    Checkpointer* cp = arg;
+
+    pthread_mutex_lock(&cp->lock);
+    for (;;) {
+        while (!cp->pending && !cp->stopping) pthread_cond_wait(&cp->cv, &cp->lock);
+        if (!cp->pending) break;  // stopping with nothing left to write
+        pthread_mutex_unlock(&cp->lock);
+
+        // staging is ours until pending is cleared
+        uint64_t start = timer_now_ns();
+        int rc = write_checkpoint(cp);
+        double ms = timer_elapsed_ms(start);
+
+        pthread_mutex_lock(&cp->lock);
+        cp->pending = 0;
+        cp->stats.write_ms_total += ms;
+        if (rc == 0) cp->stats.written++;
+        else cp->stats.failed++;
+        pthread_cond_broadcast(&cp->cv);  // checkpointer_wait
+    }
+    pthread_mutex_unlock(&cp->lock);
+    return NULL;
+}
+
+Checkpointer* checkpointer_create(const AxiomNet* net, const char* path) {
+    if (net == NULL || path == NULL || net->params == NULL) return NULL;
+
+    Checkpointer* cp = calloc(1, sizeof(Checkpointer));
+    if (cp == NULL) return NULL;
+
+    ParamArena* arena = net->params;
+    cp->net = net;
+    cp->size = arena->size;
+    cp->num_state = net->optimizer != NULL && net->optimizer->arena == arena ? arena->num_state : 0;
+    cp->path = strdup(path);
+    cp->tmp_path = malloc(strlen(path) + 5);
+    cp->staging = malloc((1 + cp->num_state) * cp->size * sizeof(float) + sizeof(float));
+    if (cp->path == NULL || cp->tmp_path == NULL || cp->staging == NULL) {
+        free(cp->path);
+        free(cp->tmp_path);
+        free(cp->staging);
+        free(cp);
+        return NULL;
+    }
+    sprintf(cp->tmp_path, "%s.tmp", path);
+
+    // fault the staging pages in now rather than during the first snapshot
+    memset(cp->staging, 0, (1 + cp->num_state) * cp->size * sizeof(float));
+    mem_track_alloc(MEM_CHECKPOINT, (1 + cp->num_state) * cp->size * sizeof(float) + sizeof(float));
+
+    cp->snap.params = cp->staging;
+    cp->snap.num_state = cp->num_state;
+    for (size_t s = 0; s < cp->num_state; s++) cp->snap.state[s] = cp->staging + (1 + s) * cp->size;
+
+    pthread_mutex_init(&cp->lock, NULL);
+    pthread_cond_init(&cp->cv, NULL);
+    if (pthread_create(&cp->writer, NULL, writer_main, cp) != 0) {
+        pthread_mutex_destroy(&cp->lock);
+        pthread_cond_destroy(&cp->cv);
+        mem_track_free(MEM_CHECKPOINT, (1 + cp->num_state) * cp->size * sizeof(float) + sizeof(float));
+        free(cp->path);
+        free(cp->tmp_path);
+        free(cp->staging);
+        free(cp);
+        return NULL;
+    }
+    return cp;
+}
+
+int checkpointer_snapshot(Checkpointer* cp, const AxiomNet* net) {
+    if (cp == NULL || net == NULL || net->params == NULL || net->params->size != cp->size) return 0;
+
+    pthread_mutex_lock(&cp->lock);
+    if (cp->pending) {
+        cp->stats.skipped++;
+        pthread_mutex_unlock(&cp->lock);
+        return 0;
+    }
+    pthread_mutex_unlock(&cp->lock);
+
+    // the writer is idle, so staging is free to overwrite
+    uint64_t start = timer_now_ns();
+    ParamArena* arena = net->params;
+    memcpy(cp->staging, arena->params, cp->size * sizeof(float));
+    for (size_t s = 0; s < cp->num_state; s++) {
+        memcpy(cp->staging + (1 + s) * cp->size, arena->state[s], cp->size * sizeof(float));
+    }
+    cp->snap.has_opt = net->optimizer != NULL;
+    if (net->optimizer != NULL) cp->snap.opt = *net->optimizer;
+    double ms = timer_elapsed_ms(start);
+
+    pthread_mutex_lock(&cp->lock);
+    cp->pending = 1;
+    cp->stats.taken++;
+    cp->stats.snapshot_ms_total += ms;
+    if (ms > cp->stats.snapshot_ms_max) cp->stats.snapshot_ms_max = ms;
+    pthread_cond_broadcast(&cp->cv);
+    pthread_mutex_unlock(&cp->lock);
+    return 1;
+}
+
+void checkpointer_wait(Checkpointer* cp) {
+    if (cp == NULL) return;
+
+    pthread_mutex_lock(&cp->lock);
+    while (cp->pending) pthread_cond_wait(&cp->cv, &cp->lock);
+    pthread_mutex_unlock(&cp->lock);
+}
+
+void checkpointer_stats(Checkpointer* cp, CheckpointStats* stats) {
+    if (cp == NULL || stats == NULL) return;
+
+    pthread_mutex_lock(&cp->lock);
+    *stats = cp->stats;
+    pthread_mutex_unlock(&cp->lock);
+}
+
+void checkpointer_free(Checkpointer* cp) {
+    if (cp == NULL) return;
+
+    pthread_mutex_lock(&cp->lock);
+    cp->stopping = 1;
+    pthread_cond_broadcast(&cp->cv);
+    pthread_mutex_unlock(&cp->lock);
+    pthread_join(cp->writer, NULL);
+
+    pthread_mutex_destroy(&cp->lock);
+    pthread_cond_destroy(&cp->cv);
+    mem_track_free(MEM_CHECKPOINT, (1 + cp->num_state) * cp->size * sizeof(float) + sizeof(float));
+    free(cp->path);
+    free(cp->tmp_path);
+    free(cp->staging);
+    free(cp);
+}
@@ -0,0 +1,47 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stddef.h>
+#include "axiom.h"
+
+/**
+ * Background checkpoint writer for a training net.
+ *
+ * checkpointer_snapshot copies the net's parameters and optimizer state (one
+ * memcpy of each arena buffer) into a staging buffer and returns; a writer
+ * thread then saves that copy as a v2 checkpoint to "<path>.tmp", fsyncs it and
+ * renames it over path, so path always holds a complete checkpoint. If the
+ * previous snapshot is still being written the new one is skipped rather than
+ * making training wait.
+ *
+ * The net's layers must already live in its ParamArena (axiom_params_build) and
+ * the net's structure must not change while the checkpointer exists.
+ */
+typedef struct Checkpointer Checkpointer;
+
+typedef struct {
+    size_t taken;             // snapshots handed to the writer
+    size_t skipped;           // requests dropped because a write was still in flight
+    size_t written;           // checkpoints durably renamed into place
+    size_t failed;
+    double snapshot_ms_total; // time the training thread spent copying
+    double snapshot_ms_max;
+    double write_ms_total;    // background time per checkpoint, fsync and rename included
+} CheckpointStats;
+
+// Allocates the staging buffer and starts the writer thread. Returns NULL on error.
+Checkpointer* checkpointer_create(const AxiomNet* net, const char* path);
+
+// Copy the net's current values and queue them for writing. Returns 1 if a
+// snapshot was taken, 0 if it was skipped because the writer is busy.
+int checkpointer_snapshot(Checkpointer* cp, const AxiomNet* net);
+
+// Block until the snapshot being written (if any) is on disk
+void checkpointer_wait(Checkpointer* cp);
+
+void checkpointer_stats(Checkpointer* cp, CheckpointStats* stats);
+
+// Waits for any write in flight, then frees everything
+void checkpointer_free(Checkpointer* cp);
+
+#endif // CHECKPOINT_H
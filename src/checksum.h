@@ -0,0 +1,10 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3, as in zlib). Pass 0 to start, or a previous result to continue it.
+uint32_t checksum_crc32(uint32_t crc, const void* data, size_t n);
+
+#endif // CHECKSUM_H
@@ -0,0 +1,338 @@
+#define _DEFAULT_SOURCE  // madvise, getline
+#include "chunked.h"
+#include "idx.h"
+#include "simd.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CHUNKED_DEFAULT_BLOCK_BYTES (1u << 20)
+
+struct ChunkedWriter {
+    FILE* f;
+    ChunkedHeader h;
+    size_t row_bytes;
+    uint8_t* block;             // staging buffer for the block being filled
+    size_t fill;                // rows in it so far
+    ChunkedIndexEntry* index;
+    size_t index_cap;
+    size_t max_label;
+    int failed;
+};
+
+static size_t align_up(size_t n, size_t a) {
+    return (n + a - 1) / a * a;
+}
+
+ChunkedWriter* chunked_writer_create(const char* path, DatasetType x_type, size_t x_cols,
+                                     float x_scale, size_t num_classes, size_t block_rows) {
+    if (path == NULL || x_cols == 0 || num_classes > 256) return NULL;
+
+    size_t row_bytes = x_cols * dataset_elem_size(x_type);
+    if (block_rows == 0) {
+        block_rows = CHUNKED_DEFAULT_BLOCK_BYTES / (row_bytes + 1);
+        if (block_rows == 0) block_rows = 1;
+    }
+
+    ChunkedWriter* w = calloc(1, sizeof(ChunkedWriter));
+    if (w == NULL) return NULL;
+
+    memcpy(w->h.magic, CHUNKED_MAGIC, 4);
+    w->h.version = CHUNKED_VERSION;
+    w->h.x_type = (uint32_t)x_type;
+    w->h.x_scale = x_scale;
+    w->h.x_cols = x_cols;
+    w->h.num_classes = num_classes;
+    w->h.block_rows = block_rows;
+    w->h.y_offset = align_up(block_rows * row_bytes, 64);
+    w->h.block_bytes = align_up(w->h.y_offset + block_rows, CHUNKED_ALIGN);
+    w->row_bytes = row_bytes;
+
+    w->block = calloc(1, w->h.block_bytes);
+    w->f = fopen(path, "wb");
+    if (w->block == NULL || w->f == NULL) {
+        if (w->f != NULL) fclose(w->f);
+        free(w->block);
+        free(w);
+        return NULL;
+    }
+
+    // header page is rewritten with the final counts on close
+    uint8_t page[CHUNKED_ALIGN] = {0};
+    if (fwrite(page, 1, sizeof page, w->f) != sizeof page) w->failed = 1;
+    return w;
+}
+
+static void flush_block(ChunkedWriter* w) {
+    if (w->fill == 0 || w->failed) return;
+
+    if (w->h.num_blocks == w->index_cap) {
+        size_t cap = w->index_cap ? w->index_cap * 2 : 64;
+        ChunkedIndexEntry* index = realloc(w->index, cap * sizeof(ChunkedIndexEntry));
+        if (index == NULL) {
+            w->failed = 1;
+            return;
+        }
+        w->index = index;
+        w->index_cap = cap;
+    }
+    w->index[w->h.num_blocks].offset = CHUNKED_ALIGN + w->h.num_blocks * w->h.block_bytes;
+    w->index[w->h.num_blocks].rows = w->fill;
+
+    // blocks are always written full size so every one starts on a page
+    if (fwrite(w->block, 1, w->h.block_bytes, w->f) != w->h.block_bytes) w->failed = 1;
+    memset(w->block, 0, w->h.block_bytes);
+    w->h.num_blocks++;
+    w->h.rows += w->fill;
+    w->fill = 0;
+}
+
+int chunked_writer_append(ChunkedWriter* w, const void* x_row, uint8_t label) {
+    if (w == NULL || x_row == NULL || w->failed) return -1;
+
+    memcpy(w->block + w->fill * w->row_bytes, x_row, w->row_bytes);
+    w->block[w->h.y_offset + w->fill] = label;
+    if (label > w->max_label) w->max_label = label;
+    if (++w->fill == w->h.block_rows) flush_block(w);
+    return w->failed ? -1 : 0;
+}
+
+int chunked_writer_close(ChunkedWriter* w) {
+    if (w == NULL) return -1;
+
+    flush_block(w);
+    if (w->h.num_classes == 0) w->h.num_classes = w->max_label + 1;
+    w->h.index_offset = CHUNKED_ALIGN + w->h.num_blocks * w->h.block_bytes;
+
+    int failed = w->failed;
+    if (!failed && w->h.num_blocks > 0 &&
+        fwrite(w->index, sizeof(ChunkedIndexEntry), w->h.num_blocks, w->f) != w->h.num_blocks) failed = 1;
+    if (!failed && (fseek(w->f, 0, SEEK_SET) != 0 ||
+                    fwrite(&w->h, sizeof(ChunkedHeader), 1, w->f) != 1)) failed = 1;
+    if (fclose(w->f) != 0) failed = 1;
+
+    free(w->index);
+    free(w->block);
+    free(w);
+    return failed ? -1 : 0;
+}
+
+long chunked_convert_idx(const char* images_path, const char* labels_path,
+                         const char* out_path, size_t block_rows) {
+    IdxFile* images = idx_open(images_path);
+    IdxFile* labels = idx_open(labels_path);
+    if (images == NULL || labels == NULL || images->rows != labels->rows || labels->row_size != 1) {
+        idx_close(images);
+        idx_close(labels);
+        return -1;
+    }
+
+    ChunkedWriter* w = chunked_writer_create(out_path, DATASET_U8, images->row_size,
+                                             1.0f / 255.0f, 0, block_rows);
+    long rows = w != NULL ? 0 : -1;
+    for (size_t i = 0; w != NULL && i < images->rows; i++) {
+        if (chunked_writer_append(w, images->data + i * images->row_size, labels->data[i]) != 0) {
+            rows = -1;
+            break;
+        }
+        rows++;
+    }
+    if (w != NULL && chunked_writer_close(w) != 0) rows = -1;
+
+    idx_close(images);
+    idx_close(labels);
+    return rows;
+}
+
+// parse "label,x0,x1,..." into label and vals; returns the number of features, or -1
+static long parse_csv_line(char* line, long* label, float** vals, size_t* cap) {
+    char* end;
+    *label = strtol(line, &end, 10);
+    if (end == line) return -1;
+
+    size_t n = 0;
+    char* p = end;
+    while (*p == ',') {
+        p++;
+        float v = strtof(p, &end);
+        if (end == p) return -1;
+        if (n == *cap) {
+            size_t new_cap = *cap ? *cap * 2 : 1024;
+            float* grown = realloc(*vals, new_cap * sizeof(float));
+            if (grown == NULL) return -1;
+            *vals = grown;
+            *cap = new_cap;
+        }
+        (*vals)[n++] = v;
+        p = end;
+    }
+    while (*p == ' ' || *p == '\r' || *p == '\n') p++;
+    return *p == '\0' ? (long)n : -1;
+}
+
+long chunked_convert_csv(const char* csv_path, const char* out_path,
+                         DatasetType x_type, size_t block_rows) {
+    FILE* in = fopen(csv_path, "r");
+    if (in == NULL) return -1;
+
+    char* line = NULL;
+    size_t line_cap = 0;
+    float* vals = NULL;
+    size_t vals_cap = 0;
+    void* row = NULL;
+    ChunkedWriter* w = NULL;
+    size_t cols = 0;
+    long rows = 0;
+    long line_no = 0;
+
+    while (getline(&line, &line_cap, in) > 0) {
+        line_no++;
+        if (line[0] == '\n' || line[0] == '\r') continue;
+
+        long label;
+        long n = parse_csv_line(line, &label, &vals, &vals_cap);
+        if (n < 0 && line_no == 1) continue;  // header row
+        if (n <= 0 || label < 0 || label > 255 || (w != NULL && (size_t)n != cols)) {
+            rows = -1;
+            break;
+        }
+
+        if (w == NULL) {
+            cols = (size_t)n;
+            row = malloc(cols * dataset_elem_size(x_type));
+            w = chunked_writer_create(out_path, x_type, cols, x_type == DATASET_U8 ? 1.0f / 255.0f : 1.0f,
+                                      0, block_rows);
+            if (row == NULL || w == NULL) {
+                rows = -1;
+                break;
+            }
+        }
+
+        for (size_t j = 0; j < cols; j++) {
+            if (x_type == DATASET_U8) {
+                float v = roundf(vals[j]);
+                ((uint8_t*)row)[j] = (uint8_t)(v < 0.0f ? 0.0f : v > 255.0f ? 255.0f : v);
+            } else if (x_type == DATASET_F16) {
+                ((uint16_t*)row)[j] = float_to_half(vals[j]);
+            } else {
+                ((float*)row)[j] = vals[j];
+            }
+        }
+        if (chunked_writer_append(w, row, (uint8_t)label) != 0) {
+            rows = -1;
+            break;
+        }
+        rows++;
+    }
+
+    if (w != NULL && chunked_writer_close(w) != 0) rows = -1;
+    if (w == NULL) rows = -1;  // no data rows
+    free(row);
+    free(vals);
+    free(line);
+    fclose(in);
+    return rows;
+}
+
+ChunkedFile* chunked_open(const char* path) {
+    if (path == NULL) return NULL;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < CHUNKED_ALIGN) {
+        close(fd);
+        return NULL;
+    }
+    size_t size = (size_t)st.st_size;
+
+    void* map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    ChunkedFile* f = calloc(1, sizeof(ChunkedFile));
+    if (f == NULL) {
+        munmap(map, size);
+        close(fd);
+        return NULL;
+    }
+    f->fd = fd;
+    f->map = map;
+    f->map_size = size;
+    memcpy(&f->header, map, sizeof(ChunkedHeader));
+
+    const ChunkedHeader* h = &f->header;
+    int ok = memcmp(h->magic, CHUNKED_MAGIC, 4) == 0 && h->version == CHUNKED_VERSION &&
+             h->x_type <= DATASET_F16 && h->x_cols > 0 && h->block_rows > 0 &&
+             h->num_classes > 0 && h->num_classes <= 256 &&
+             h->y_offset >= h->block_rows * h->x_cols * dataset_elem_size((DatasetType)h->x_type) &&
+             h->block_bytes >= h->y_offset + h->block_rows && h->block_bytes % CHUNKED_ALIGN == 0 &&
+             h->index_offset == CHUNKED_ALIGN + h->num_blocks * h->block_bytes &&
+             h->index_offset + h->num_blocks * sizeof(ChunkedIndexEntry) <= size;
+    if (ok) {
+        f->index = (const ChunkedIndexEntry*)((const uint8_t*)map + h->index_offset);
+        uint64_t rows = 0;
+        for (uint64_t b = 0; b < h->num_blocks && ok; b++) {
+            const ChunkedIndexEntry* e = &f->index[b];
+            ok = e->offset == CHUNKED_ALIGN + b * h->block_bytes && e->rows > 0 &&
+                 (e->rows == h->block_rows || (b == h->num_blocks - 1 && e->rows < h->block_rows));
+            rows += e->rows;
+        }
+        ok = ok && rows == h->rows && rows > 0;
+    }
+    if (!ok) {
+        chunked_close(f);
+        return NULL;
+    }
+
+    // rows are visited in shuffled block order, so sequential readahead would only waste i/o;
+    // the loader prefetches whole blocks itself through chunked_advise
+    madvise(map, size, MADV_RANDOM);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+
+    const uint8_t* blocks = (const uint8_t*)map + CHUNKED_ALIGN;
+    f->x = (Dataset){
+        .type = (DatasetType)h->x_type, .data = blocks, .rows = h->rows, .stride = h->x_cols,
+        .scale = h->x_scale, .block_rows = h->block_rows, .block_bytes = h->block_bytes,
+        .advise = chunked_advise, .advise_ctx = f,
+    };
+    f->y = (Dataset){
+        .type = DATASET_U8, .data = blocks + h->y_offset, .rows = h->rows, .stride = 1,
+        .scale = 1.0f, .num_classes = h->num_classes,
+        .block_rows = h->block_rows, .block_bytes = h->block_bytes,
+    };
+    return f;
+}
+
+void chunked_close(ChunkedFile* f) {
+    if (f == NULL) return;
+    munmap(f->map, f->map_size);
+    close(f->fd);
+    free(f);
+}
+
+void chunked_advise(void* ctx, size_t block, int will_need) {
+    ChunkedFile* f = ctx;
+    if (f == NULL || block >= f->header.num_blocks) return;
+
+    size_t offset = f->index[block].offset;
+    size_t len = f->header.block_bytes;
+    uint8_t* p = (uint8_t*)f->map + offset;
+
+    if (will_need) {
+        posix_fadvise(f->fd, (off_t)offset, (off_t)len, POSIX_FADV_WILLNEED);  // async read into the page cache
+        madvise(p, len, MADV_WILLNEED);
+    } else {
+        // unmap the pages from this process, then let the kernel drop them from the cache
+        madvise(p, len, MADV_DONTNEED);
+        posix_fadvise(f->fd, (off_t)offset, (off_t)len, POSIX_FADV_DONTNEED);
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef CHUNKED_H
+#define CHUNKED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dataset.h"
+
+#define CHUNKED_MAGIC "AXDS"
+#define CHUNKED_VERSION 1
+#define CHUNKED_ALIGN 4096  // header size and block alignment, so blocks map to whole pages
+
+/**
+ * Out-of-core dataset file ("AXDS"), for training sets that don't fit in RAM.
+ *
+ * Layout: a one-page header, then num_blocks fixed-size blocks, each holding
+ * block_rows feature rows followed by their labels (the last block may be
+ * short), then an index of (offset, rows) per block. Feature rows are stored
+ * as u8, f16 or f32; labels are one u8 class id per row. Every block starts on
+ * a CHUNKED_ALIGN boundary so a block can be read ahead or dropped on its own.
+ *
+ * Integers are in host byte order, as in the model checkpoint.
+ */
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t x_type;        // DatasetType of the feature payload
+    float x_scale;          // applied when u8/f16 features are widened (1/255 for pixels)
+    uint64_t rows;
+    uint64_t x_cols;        // features per row
+    uint64_t num_classes;   // labels are class ids below this
+    uint64_t block_rows;
+    uint64_t num_blocks;
+    uint64_t block_bytes;   // distance between block starts
+    uint64_t y_offset;      // labels start this far into each block
+    uint64_t index_offset;  // file offset of the block index
+} ChunkedHeader;
+
+typedef struct {
+    uint64_t offset;
+    uint64_t rows;
+} ChunkedIndexEntry;
+
+typedef struct ChunkedWriter ChunkedWriter;
+
+// num_classes = 0 sets the class id range from the largest label written; block_rows = 0 picks
+// about 1 MiB per block. Returns NULL on error.
+ChunkedWriter* chunked_writer_create(const char* path, DatasetType x_type, size_t x_cols,
+                                     float x_scale, size_t num_classes, size_t block_rows);
+
+// Append one row: x_cols elements of the writer's x_type, and its class id. Returns 0 on success.
+int chunked_writer_append(ChunkedWriter* w, const void* x_row, uint8_t label);
+
+// Flush the last block, write the index and header, and free the writer. Returns 0 on success.
+int chunked_writer_close(ChunkedWriter* w);
+
+// Converters. Returns the number of rows written, or -1 on error.
+long chunked_convert_idx(const char* images_path, const char* labels_path,
+                         const char* out_path, size_t block_rows);
+
+// CSV rows are "label,x0,x1,..." (a non-numeric first line is skipped as a header).
+// u8 payloads round and clamp each value to 0..255 and widen with scale 1/255.
+long chunked_convert_csv(const char* csv_path, const char* out_path,
+                         DatasetType x_type, size_t block_rows);
+
+/**
+ * A chunked file mapped read-only. The whole file is mapped, but the kernel's
+ * own readahead is turned off: the loader asks for blocks through `x.advise`
+ * just before it reads them, and drops them (from this process and from the
+ * page cache) once it's done, so resident memory stays around two shuffle
+ * windows however big the file is.
+ */
+typedef struct {
+    int fd;
+    void* map;
+    size_t map_size;
+    ChunkedHeader header;
+    const ChunkedIndexEntry* index;
+    Dataset x;
+    Dataset y;
+} ChunkedFile;
+
+// Returns NULL if the file can't be mapped or fails validation
+ChunkedFile* chunked_open(const char* path);
+void chunked_close(ChunkedFile* f);
+
+// dataset_advise_fn over a ChunkedFile
+void chunked_advise(void* ctx, size_t block, int will_need);
+
+#endif // CHUNKED_H
@@ -0,0 +1,352 @@
+#define _POSIX_C_SOURCE 200809L
+#include "dataloader.h"
+#include "rng.h"
+#include "timer.h"
+#include "trace.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+typedef struct {
+    Batch batch;
+    float* x_data;    // batch_size rows, owned by the slot
+    float* y_data;    // targets, or int32 class ids for a label dataset
+} Slot;
+
+struct DataLoader {
+    Dataset x;
+    Dataset y;
+    DataLoaderConfig cfg;
+    size_t batch_size;
+    size_t num_buffers;
+    size_t* order;          // row visit order for the epoch being produced; producer-only
+    size_t n_samples;
+    // windowed shuffling (cfg.shuffle_window > 0), producer-only
+    size_t block_rows;
+    size_t num_blocks;
+    size_t window_blocks;
+    size_t num_windows;
+    size_t* block_order;    // blocks in visit order; window w is block_order[w * window_blocks ...]
+    size_t* window_start;   // position in order where each window starts, plus n_samples at the end
+    size_t cur_window;
+    int windows_live;       // cur_window's blocks may still be resident
+    size_t n_features;
+    size_t n_targets;
+    int y_labels;           // y is a label dataset: slots hold class ids, not target rows
+    size_t batches_per_epoch;
+    size_t total_batches;
+    Slot* slots;
+
+    pthread_t producer;
+    int producer_started;
+
+    pthread_mutex_t lock;   // guards everything below
+    pthread_cond_t cv;      // signalled on produce, release and stop
+    size_t produced;        // batches filled so far
+    size_t taken;           // batches handed out by dataloader_next
+    size_t released;        // batches handed back
+    int stopping;
+    DataLoaderStats stats;
+    size_t tracked_bytes;   // order arrays and slot buffers, accounted as MEM_DATASET once creation succeeds
+};
+
+// the slot's tensors are views over batch_size rows; narrow them to the rows actually filled
+static void set_rows(Tensor* t, size_t rows) {
+    t->shape[0] = rows;
+    t->size = rows * t->shape[1];
+}
+
+static void advise_window(DataLoader* dl, size_t w, int will_need) {
+    if (dl->x.advise == NULL || w >= dl->num_windows) return;
+    size_t end = (w + 1) * dl->window_blocks;
+    if (end > dl->num_blocks) end = dl->num_blocks;
+    for (size_t p = w * dl->window_blocks; p < end; p++) {
+        dl->x.advise(dl->x.advise_ctx, dl->block_order[p], will_need);
+    }
+}
+
+// windowed order: blocks in random order, then rows shuffled only within each run of
+// window_blocks blocks, so just a window or two of the dataset needs to be resident at once
+static void build_window_order(DataLoader* dl, Rng* rng) {
+    if (dl->cfg.shuffle) rng_permutation(rng, dl->block_order, dl->num_blocks);
+    else for (size_t b = 0; b < dl->num_blocks; b++) dl->block_order[b] = b;
+
+    size_t pos = 0;
+    for (size_t w = 0; w < dl->num_windows; w++) {
+        dl->window_start[w] = pos;
+        size_t end = (w + 1) * dl->window_blocks;
+        if (end > dl->num_blocks) end = dl->num_blocks;
+        for (size_t p = w * dl->window_blocks; p < end; p++) {
+            size_t first = dl->block_order[p] * dl->block_rows;
+            size_t last = first + dl->block_rows;
+            if (last > dl->n_samples) last = dl->n_samples;
+            for (size_t r = first; r < last; r++) dl->order[pos++] = r;
+        }
+        if (dl->cfg.shuffle) rng_shuffle(rng, dl->order + dl->window_start[w], pos - dl->window_start[w]);
+    }
+    dl->window_start[dl->num_windows] = pos;
+}
+
+// epoch order is a pure function of (seed, epoch) so any epoch can be replayed on its own
+static void build_order(DataLoader* dl, size_t epoch) {
+    Rng rng;
+    rng_seed(&rng, dl->cfg.seed ^ (0x9e3779b97f4a7c15ull * (uint64_t)(epoch + 1)));
+    if (dl->num_windows > 0) {
+        build_window_order(dl, &rng);
+        return;
+    }
+    if (!dl->cfg.shuffle) {
+        for (size_t i = 0; i < dl->n_samples; i++) dl->order[i] = i;
+        return;
+    }
+    rng_permutation(&rng, dl->order, dl->n_samples);
+}
+
+// read the next window ahead and drop the ones behind as the batch start moves forward
+static void track_window(DataLoader* dl, size_t index, size_t start) {
+    if (dl->num_windows == 0) return;
+    if (index == 0) {
+        dl->cur_window = 0;
+        dl->windows_live = 1;
+        advise_window(dl, 0, 1);
+        advise_window(dl, 1, 1);
+    }
+    while (start >= dl->window_start[dl->cur_window + 1]) {
+        advise_window(dl, dl->cur_window, 0);
+        dl->cur_window++;
+        advise_window(dl, dl->cur_window + 1, 1);
+    }
+}
+
+// returns ms spent augmenting
+static double fill_slot(DataLoader* dl, Slot* slot, size_t k) {
+    size_t index = k % dl->batches_per_epoch;
+    size_t epoch = dl->cfg.first_epoch + k / dl->batches_per_epoch;
+    if (index == 0) {
+        if (dl->windows_live) advise_window(dl, dl->cur_window, 0);  // last window of the previous epoch
+        build_order(dl, epoch);
+    }
+
+    size_t start = index * dl->batch_size;
+    track_window(dl, index, start);
+    size_t size = dl->batch_size;
+    if (start + size > dl->n_samples) size = dl->n_samples - start;
+
+    set_rows(slot->batch.x, size);
+    uint64_t t0 = trace_begin();
+    dataset_gather(&dl->x, slot->batch.x, dl->order + start, size);
+    if (dl->y_labels) {
+        dataset_gather_labels(&dl->y, slot->batch.labels, dl->order + start, size);
+    } else {
+        set_rows(slot->batch.y, size);
+        dataset_gather(&dl->y, slot->batch.y, dl->order + start, size);
+    }
+    trace_end(t0, "batch_gather", TRACE_NO_LAYER);
+
+    double augment_ms = 0.0;
+    if (augment_enabled(&dl->cfg.augment)) {
+        uint64_t start_ns = timer_now_ns();
+        t0 = trace_begin();
+        augment_batch(&dl->cfg.augment, slot->batch.x, (uint64_t)epoch * dl->batches_per_epoch + index);
+        trace_end(t0, "augment", TRACE_NO_LAYER);
+        augment_ms = timer_elapsed_ms(start_ns);
+    }
+
+    slot->batch.size = size;
+    slot->batch.epoch = epoch;
+    slot->batch.index = index;
+    return augment_ms;
+}
+
+static size_t rows_bytes(size_t rows, size_t cols) {
+    size_t bytes = (rows * cols * sizeof(float) + 63) / 64 * 64;
+    return bytes > 0 ? bytes : 64;
+}
+
+// slot buffers start on a cache line so the gather can use aligned streaming stores
+static float* alloc_rows(size_t rows, size_t cols) {
+    return aligned_alloc(64, rows_bytes(rows, cols));
+}
+
+static void* producer_main(void* arg) {
+    DataLoader* dl = arg;
+    trace_set_thread_name("dataloader");
+
+    for (size_t k = 0; k < dl->total_batches; k++) {
+        // wait for the consumer to hand back the slot batch k goes into
+        pthread_mutex_lock(&dl->lock);
+        while (!dl->stopping && k - dl->released >= dl->num_buffers) {
+            pthread_cond_wait(&dl->cv, &dl->lock);
+        }
+        int stopping = dl->stopping;
+        pthread_mutex_unlock(&dl->lock);
+        if (stopping) break;
+
+        uint64_t start = timer_now_ns();
+        double augment_ms = fill_slot(dl, &dl->slots[k % dl->num_buffers], k);
+        double ms = timer_elapsed_ms(start);
+
+        pthread_mutex_lock(&dl->lock);
+        dl->produced = k + 1;
+        dl->stats.assemble_ms += ms;
+        dl->stats.augment_ms += augment_ms;
+        pthread_cond_broadcast(&dl->cv);
+        pthread_mutex_unlock(&dl->lock);
+    }
+    return NULL;
+}
+
+DataLoader* dataloader_create(const Dataset* x, const Dataset* y, const DataLoaderConfig* cfg) {
+    if (x == NULL || y == NULL || cfg == NULL || cfg->batch_size == 0) return NULL;
+    if (x->data == NULL || y->data == NULL || x->rows != y->rows || x->rows == 0) return NULL;
+
+    DataLoader* dl = calloc(1, sizeof(DataLoader));
+    if (dl == NULL) return NULL;
+
+    size_t batch_size = cfg->batch_size;
+    size_t num_buffers = cfg->num_buffers < 2 ? 2 : cfg->num_buffers;
+    size_t epochs = cfg->epochs;
+
+    dl->x = *x;
+    dl->y = *y;
+    dl->cfg = *cfg;
+    dl->batch_size = batch_size;
+    dl->num_buffers = num_buffers;
+    dl->n_samples = x->rows;
+    dl->n_features = dataset_width(x);
+    dl->n_targets = dataset_width(y);
+    dl->y_labels = dataset_is_labels(y);
+    dl->batches_per_epoch = (dl->n_samples + batch_size - 1) / batch_size;
+    dl->total_batches = dl->batches_per_epoch * epochs;
+    pthread_mutex_init(&dl->lock, NULL);
+    pthread_cond_init(&dl->cv, NULL);
+
+    dl->order = malloc(dl->n_samples * sizeof(size_t));
+    dl->slots = calloc(num_buffers, sizeof(Slot));
+    if (dl->order == NULL || dl->slots == NULL) {
+        dataloader_free(dl);
+        return NULL;
+    }
+    if (cfg->shuffle_window > 0) {
+        dl->block_rows = x->block_rows > 0 ? x->block_rows : 1;
+        dl->num_blocks = (dl->n_samples + dl->block_rows - 1) / dl->block_rows;
+        dl->window_blocks = cfg->shuffle_window / dl->block_rows;
+        if (dl->window_blocks == 0) dl->window_blocks = 1;
+        dl->num_windows = (dl->num_blocks + dl->window_blocks - 1) / dl->window_blocks;
+        dl->block_order = malloc(dl->num_blocks * sizeof(size_t));
+        dl->window_start = malloc((dl->num_windows + 1) * sizeof(size_t));
+    }
+    if (cfg->shuffle_window > 0 && (dl->block_order == NULL || dl->window_start == NULL)) {
+        dataloader_free(dl);
+        return NULL;
+    }
+    size_t shape_x[] = {batch_size, dl->n_features};
+    size_t shape_y[] = {batch_size, dl->n_targets};
+    // class ids are one int32 per row, the same size as one float column
+    size_t y_cols = dl->y_labels ? 1 : dl->n_targets;
+    for (size_t i = 0; i < num_buffers; i++) {
+        Slot* s = &dl->slots[i];
+        s->x_data = alloc_rows(batch_size, dl->n_features);
+        s->y_data = alloc_rows(batch_size, y_cols);
+        if (s->x_data == NULL || s->y_data == NULL) {
+            dataloader_free(dl);
+            return NULL;
+        }
+        MemCategory prev = mem_set_category(MEM_DATASET);
+        s->batch.x = tensor_view(s->x_data, shape_x, 2);
+        if (dl->y_labels) s->batch.labels = (int32_t*)s->y_data;
+        else s->batch.y = tensor_view(s->y_data, shape_y, 2);
+        mem_set_category(prev);
+        if (s->batch.x == NULL || (s->batch.y == NULL && s->batch.labels == NULL)) {
+            dataloader_free(dl);
+            return NULL;
+        }
+    }
+
+    dl->tracked_bytes = dl->n_samples * sizeof(size_t) + num_buffers * sizeof(Slot) +
+                        num_buffers * (rows_bytes(batch_size, dl->n_features) + rows_bytes(batch_size, y_cols));
+    if (cfg->shuffle_window > 0) dl->tracked_bytes += (dl->num_blocks + dl->num_windows + 1) * sizeof(size_t);
+    mem_track_alloc(MEM_DATASET, dl->tracked_bytes);
+
+    if (dl->total_batches > 0) {
+        if (pthread_create(&dl->producer, NULL, producer_main, dl) != 0) {
+            dataloader_free(dl);
+            return NULL;
+        }
+        dl->producer_started = 1;
+    }
+
+    return dl;
+}
+
+Batch* dataloader_next(DataLoader* dl) {
+    if (dl == NULL) return NULL;
+
+    pthread_mutex_lock(&dl->lock);
+    if (dl->taken >= dl->total_batches) {
+        pthread_mutex_unlock(&dl->lock);
+        return NULL;
+    }
+
+    // any time spent here is time the training loop sat idle waiting on data
+    if (dl->produced <= dl->taken) {
+        uint64_t start = timer_now_ns();
+        while (dl->produced <= dl->taken) {
+            pthread_cond_wait(&dl->cv, &dl->lock);
+        }
+        dl->stats.wait_ms += timer_elapsed_ms(start);
+    }
+
+    Slot* slot = &dl->slots[dl->taken % dl->num_buffers];
+    dl->taken++;
+    dl->stats.batches++;
+    pthread_mutex_unlock(&dl->lock);
+
+    return &slot->batch;
+}
+
+void dataloader_release(DataLoader* dl, Batch* batch) {
+    if (dl == NULL || batch == NULL) return;
+
+    pthread_mutex_lock(&dl->lock);
+    dl->released++;
+    pthread_cond_broadcast(&dl->cv);
+    pthread_mutex_unlock(&dl->lock);
+}
+
+void dataloader_stats(DataLoader* dl, DataLoaderStats* stats) {
+    if (dl == NULL || stats == NULL) return;
+
+    pthread_mutex_lock(&dl->lock);
+    *stats = dl->stats;
+    pthread_mutex_unlock(&dl->lock);
+}
+
+void dataloader_free(DataLoader* dl) {
+    if (dl == NULL) return;
+
+    if (dl->producer_started) {
+        pthread_mutex_lock(&dl->lock);
+        dl->stopping = 1;
+        pthread_cond_broadcast(&dl->cv);
+        pthread_mutex_unlock(&dl->lock);
+        pthread_join(dl->producer, NULL);
+    }
+
+    if (dl->slots != NULL) {
+        for (size_t i = 0; i < dl->num_buffers; i++) {
+            tensor_free(dl->slots[i].batch.x);
+            tensor_free(dl->slots[i].batch.y);
+            free(dl->slots[i].x_data);
+            free(dl->slots[i].y_data);
+        }
+        free(dl->slots);
+    }
+    free(dl->order);
+    free(dl->block_order);
+    free(dl->window_start);
+    if (dl->tracked_bytes > 0) mem_track_free(MEM_DATASET, dl->tracked_bytes);
+
+    pthread_mutex_destroy(&dl->lock);
+    pthread_cond_destroy(&dl->cv);
+    free(dl);
+}
@@ -0,0 +1,70 @@
+#ifndef DATALOADER_H
+#define DATALOADER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tensor.h"
+#include "dataset.h"
+#include "augment.h"
+
+/**
+ * Background minibatch loader.
+ *
+ * A producer thread walks the dataset for the requested number of epochs and
+ * gathers rows of x and y into a ring of preallocated batch buffers, so
+ * batch k+1 is being assembled while the network trains on batch k. The
+ * consumer takes batches in order with dataloader_next and must hand each one
+ * back with dataloader_release before the producer can reuse its slot.
+ *
+ * x and y must have the same number of rows, and their storage must stay
+ * alive (and unchanged) until dataloader_free. Byte datasets are converted to
+ * floats as each batch is gathered, so only the batch buffers are ever float.
+ * A label dataset for y (dataset_is_labels) is delivered as class ids in
+ * `labels`, never expanded to one-hot rows.
+ */
+
+typedef struct {
+    Tensor* x;        // [size, features]; views into the slot's buffer
+    Tensor* y;        // [size, targets]; NULL when y is a label dataset
+    int32_t* labels;  // [size] class ids (-1: out of range) when y is a label dataset, else NULL
+    size_t size;      // rows in this batch; the last batch of an epoch may be short
+    size_t epoch;     // counts from DataLoaderConfig.first_epoch
+    size_t index;     // batch number within the epoch
+} Batch;
+
+typedef struct {
+    size_t batches;       // batches handed to the consumer so far
+    double wait_ms;       // time the consumer spent blocked in dataloader_next
+    double assemble_ms;   // time the producer spent filling buffers (augmentation included)
+    double augment_ms;    // part of assemble_ms spent augmenting
+} DataLoaderStats;
+
+typedef struct {
+    size_t batch_size;
+    size_t num_buffers;   // ring depth, at least 2
+    size_t epochs;
+    size_t first_epoch;   // epoch number of the first epoch produced, so resumed runs keep their order
+    int shuffle;          // visit rows in a fresh random order every epoch
+    uint64_t seed;        // each epoch's order depends only on (seed, epoch number)
+    size_t shuffle_window;  // > 0: shuffle blocks, then rows only within windows of about this many
+                            // rows, reading each window ahead and dropping it after (out-of-core data)
+    AugmentConfig augment;  // applied to x after the gather; zeroed = off
+} DataLoaderConfig;
+
+typedef struct DataLoader DataLoader;
+
+// x and y are copied (not their storage). Returns NULL on mismatched rows or allocation failure
+DataLoader* dataloader_create(const Dataset* x, const Dataset* y, const DataLoaderConfig* cfg);
+
+// Next batch in order, blocking until it's ready. NULL once every epoch has been delivered.
+Batch* dataloader_next(DataLoader* dl);
+
+// Return a batch's buffer to the producer
+void dataloader_release(DataLoader* dl, Batch* batch);
+
+void dataloader_stats(DataLoader* dl, DataLoaderStats* stats);
+
+// Stops the producer early if needed, then frees every buffer
+void dataloader_free(DataLoader* dl);
+
+#endif // DATALOADER_H
@@ -0,0 +1,162 @@
+#include "dataset.h"
+#include "simd.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DATASET_PREFETCH_AHEAD 4
+
+Dataset dataset_from_tensor(const Tensor* t) {
+    Dataset d = { .type = DATASET_F32, .scale = 1.0f };
+    if (t == NULL || t->ndim != 2) return d;
+    d.data = t->data;
+    d.rows = t->shape[0];
+    d.stride = t->shape[1];
+    return d;
+}
+
+Dataset dataset_from_idx(const IdxFile* f, float scale) {
+    Dataset d = { .type = DATASET_U8, .scale = scale };
+    if (f == NULL) return d;
+    d.data = f->data;
+    d.rows = f->rows;
+    d.stride = f->row_size;
+    return d;
+}
+
+Dataset dataset_labels_from_idx(const IdxFile* f, size_t num_classes) {
+    Dataset d = dataset_from_idx(f, 1.0f);
+    if (f == NULL || f->row_size != 1) return (Dataset){ .type = DATASET_U8, .scale = 1.0f };
+    d.num_classes = num_classes;
+    return d;
+}
+
+Dataset dataset_slice(const Dataset* d, size_t first, size_t rows) {
+    Dataset s = *d;
+    s.rows = 0;
+    if (first > d->rows || rows > d->rows - first) return s;
+
+    size_t row_bytes = d->stride * dataset_elem_size(d->type);
+    if (d->block_rows == 0) {
+        s.data = (const uint8_t*)d->data + first * row_bytes;
+    } else {
+        if (first % d->block_rows != 0) return s;
+        s.data = (const uint8_t*)d->data + (first / d->block_rows) * d->block_bytes;
+        // advise callbacks number blocks from the start of the source
+        s.advise = NULL;
+        s.advise_ctx = NULL;
+    }
+    s.rows = rows;
+    return s;
+}
+
+Dataset dataset_from_labels(const int32_t* labels, size_t rows, size_t num_classes) {
+    Dataset d = { .type = DATASET_I32, .scale = 1.0f };
+    if (labels == NULL) return d;
+    d.data = labels;
+    d.rows = rows;
+    d.stride = 1;
+    d.num_classes = num_classes;
+    return d;
+}
+
+int dataset_is_labels(const Dataset* d) {
+    return d != NULL && (d->type == DATASET_U8 || d->type == DATASET_I32) && d->num_classes > 0;
+}
+
+size_t dataset_width(const Dataset* d) {
+    if (d == NULL) return 0;
+    return dataset_is_labels(d) ? d->num_classes : d->stride;
+}
+
+size_t dataset_elem_size(DatasetType type) {
+    switch (type) {
+        case DATASET_U8: return 1;
+        case DATASET_F16: return 2;
+        case DATASET_I32: return sizeof(int32_t);
+        default: return sizeof(float);
+    }
+}
+
+static const uint8_t* row_ptr(const Dataset* d, size_t row, size_t row_bytes) {
+    const uint8_t* base = d->data;
+    if (d->block_rows == 0) return base + row * row_bytes;
+    return base + (row / d->block_rows) * d->block_bytes + (row % d->block_rows) * row_bytes;
+}
+
+// class id at the start of a label row; -1 unless it's below num_classes
+static int32_t label_at(const Dataset* d, size_t row, size_t row_bytes) {
+    const uint8_t* p = row_ptr(d, row, row_bytes);
+    int64_t id = d->type == DATASET_I32 ? *(const int32_t*)p : *p;
+    return id >= 0 && (uint64_t)id < d->num_classes ? (int32_t)id : -1;
+}
+
+void dataset_gather_labels(const Dataset* d, int32_t* dst, const size_t* rows, size_t n) {
+    if (!dataset_is_labels(d) || d->data == NULL || dst == NULL || rows == NULL) return;
+    size_t row_bytes = d->stride * dataset_elem_size(d->type);
+    for (size_t i = 0; i < n; i++) dst[i] = label_at(d, rows[i], row_bytes);
+}
+
+void dataset_gather(const Dataset* d, Tensor* dst, const size_t* rows, size_t n) {
+    if (d == NULL || d->data == NULL || dst == NULL || rows == NULL) return;
+    size_t width = dataset_width(d);
+    if (dst->ndim != 2 || dst->shape[1] != width || n > dst->shape[0]) return;
+
+    if (d->type == DATASET_F32 && d->block_rows == 0) {
+        size_t shape[] = { d->rows, d->stride };
+        Tensor src = { .data = (float*)d->data, .shape = shape, .ndim = 2, .size = d->rows * d->stride };
+        tensor_gather_rows(dst, &src, rows, n);
+        return;
+    }
+
+    size_t len = d->stride;
+    size_t row_bytes = len * dataset_elem_size(d->type);
+    if (dataset_is_labels(d)) {
+        memset(dst->data, 0, n * width * sizeof(float));
+        for (size_t i = 0; i < n; i++) {
+            int32_t label = label_at(d, rows[i], row_bytes);
+            if (label >= 0) dst->data[i * width + label] = 1.0f;
+        }
+        return;
+    }
+
+    // narrow rows are a quarter (bytes) or half (halves) the size of the floats they
+    // become, so widen here, per batch, rather than keeping a float copy of the dataset
+    for (size_t i = 0; i < n; i++) {
+        if (i + DATASET_PREFETCH_AHEAD < n) {
+            const uint8_t* ahead = row_ptr(d, rows[i + DATASET_PREFETCH_AHEAD], row_bytes);
+            for (size_t b = 0; b < row_bytes; b += 64) simd_prefetch(ahead + b);
+        }
+        const uint8_t* from = row_ptr(d, rows[i], row_bytes);
+        float* to = dst->data + i * width;
+        if (d->type == DATASET_U8) simd_u8_to_f32(to, from, len, d->scale);
+        else if (d->type == DATASET_F16) simd_f16_to_f32(to, (const uint16_t*)from, len, d->scale);
+        else if (d->type == DATASET_I32) {
+            for (size_t j = 0; j < len; j++) to[j] = (float)((const int32_t*)from)[j] * d->scale;
+        }
+        else memcpy(to, from, row_bytes);
+    }
+}
+
+Tensor* dataset_to_tensor(const Dataset* d) {
+    if (d == NULL || d->data == NULL) return NULL;
+
+    size_t shape[] = { d->rows, dataset_width(d) };
+    MemCategory prev = mem_set_category(MEM_DATASET);
+    Tensor* t = tensor_create(shape, 2);
+    mem_set_category(prev);
+    if (t == NULL) return NULL;
+
+    size_t rows_bytes = (d->rows > 0 ? d->rows : 1) * sizeof(size_t);
+    size_t* rows = malloc(rows_bytes);
+    if (rows == NULL) {
+        tensor_free(t);
+        return NULL;
+    }
+    mem_track_alloc(MEM_TEMPORARY, rows_bytes);
+    for (size_t i = 0; i < d->rows; i++) rows[i] = i;
+    dataset_gather(d, t, rows, d->rows);
+    free(rows);
+    mem_track_free(MEM_TEMPORARY, rows_bytes);
+    return t;
+}
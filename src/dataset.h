@@ -0,0 +1,80 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tensor.h"
+#include "idx.h"
+
+/**
+ * A read-only table of training rows, stored as floats, halves or raw bytes
+ * that are converted to floats only when rows are gathered into a batch.
+ * Byte and half rows are scaled by `scale` (1/255 for pixels).
+ *
+ * Byte or int32 rows with num_classes set are label datasets: one class id
+ * per row (int32 for more than 256 classes). They can be gathered as one-hot
+ * rows, but training and evaluation read the ids themselves with
+ * dataset_gather_labels, so labels stay 1-4 bytes per row.
+ *
+ * Rows are either one contiguous array, or split into blocks of block_rows
+ * rows that start block_bytes apart (an out-of-core file, see chunked.h).
+ * Blocked sources may also provide `advise`, which the loader calls to say
+ * which blocks it's about to read and which it's done with.
+ *
+ * A Dataset never owns its storage: it points into a Tensor, an IdxFile or a
+ * ChunkedFile that must outlive it.
+ */
+typedef enum {
+    DATASET_F32,
+    DATASET_U8,
+    DATASET_F16,
+    DATASET_I32
+} DatasetType;
+
+// will_need = 1: the block is coming up soon; 0: it won't be read again for a while
+typedef void (*dataset_advise_fn)(void* ctx, size_t block, int will_need);
+
+typedef struct {
+    DatasetType type;
+    const void* data;     // first row; rows * stride elements, row-major within a block
+    size_t rows;
+    size_t stride;        // stored elements per row
+    float scale;          // U8/F16: gathered value = stored * scale
+    size_t num_classes;   // U8/I32: > 0 makes each row a class id below this (see dataset_is_labels)
+    size_t block_rows;    // 0: one contiguous array
+    size_t block_bytes;   // distance between the starts of consecutive blocks
+    dataset_advise_fn advise;  // optional, blocked sources only
+    void* advise_ctx;
+} Dataset;
+
+Dataset dataset_from_tensor(const Tensor* t);
+Dataset dataset_from_idx(const IdxFile* f, float scale);
+Dataset dataset_labels_from_idx(const IdxFile* f, size_t num_classes);
+// Over an array of class ids, e.g. for vocabularies too large for bytes
+Dataset dataset_from_labels(const int32_t* labels, size_t rows, size_t num_classes);
+
+// Rows [first, first + rows) as a Dataset over the same storage. Blocked
+// sources can only be cut at a block boundary; returns rows = 0 if the range
+// is out of bounds or can't be cut there.
+Dataset dataset_slice(const Dataset* d, size_t first, size_t rows);
+
+// 1 if each row is a class id (U8/I32 with num_classes set)
+int dataset_is_labels(const Dataset* d);
+
+// dst[i] = class id of row rows[i], or -1 if it isn't below num_classes.
+// d must be a label dataset.
+void dataset_gather_labels(const Dataset* d, int32_t* dst, const size_t* rows, size_t n);
+
+// Floats per gathered row
+size_t dataset_width(const Dataset* d);
+
+// Bytes per stored element
+size_t dataset_elem_size(DatasetType type);
+
+// dst[i, :] = row rows[i] as floats, for i < n. dst is [>= n, dataset_width(d)].
+void dataset_gather(const Dataset* d, Tensor* dst, const size_t* rows, size_t n);
+
+// Every row converted into a new [rows, width] tensor; caller frees
+Tensor* dataset_to_tensor(const Dataset* d);
+
+#endif // DATASET_H
@@ -1,5 +1,8 @@
 #include "dense.h"
+#include "autotune.h"
+#include "reduce.h"
 #include <stdlib.h>
+#include <string.h>
 
 DenseLayer* dense_create(size_t input_size, size_t output_size) {
     DenseLayer* dense = malloc(sizeof(DenseLayer));
@@ -7,9 +10,11 @@ DenseLayer* dense_create(size_t input_size, size_t output_size) {
 
     // allocate tensors
 
+    MemCategory prev = mem_set_category(MEM_PARAMS);
     size_t weights_shape[] = {input_size, output_size};
     dense->weights = tensor_create(weights_shape, 2);
     if (dense->weights == NULL) {
+        mem_set_category(prev);
         free(dense);
         return NULL;
     }
@@ -17,6 +22,7 @@ DenseLayer* dense_create(size_t input_size, size_t output_size) {
     // only output size for bias
     size_t biases_shape[] = {output_size};
     dense->biases = tensor_create(biases_shape, 1);
+    mem_set_category(prev);
     if (dense->biases == NULL) {
         tensor_free(dense->weights);
         free(dense);
@@ -31,6 +37,46 @@ DenseLayer* dense_create(size_t input_size, size_t output_size) {
     dense->grad_biases = NULL;
     dense->input_size = input_size;
     dense->output_size = output_size;
+    dense->param_offset = 0;
+    dense->param_count = 0;
+    dense->packed = NULL;
+    dense->packed_t = NULL;
+    dense->packed_valid = 0;
+    dense->packed_t_valid = 0;
+
+    return dense;
+}
+
+DenseLayer* dense_create_view(size_t input_size, size_t output_size, float* weights, float* biases) {
+    if (weights == NULL || biases == NULL) return NULL;
+
+    DenseLayer* dense = malloc(sizeof(DenseLayer));
+    if (dense == NULL) return NULL;
+
+    size_t weights_shape[] = {input_size, output_size};
+    size_t biases_shape[] = {output_size};
+    MemCategory prev = mem_set_category(MEM_PARAMS);
+    dense->weights = tensor_view(weights, weights_shape, 2);
+    dense->biases = tensor_view(biases, biases_shape, 1);
+    mem_set_category(prev);
+    if (dense->weights == NULL || dense->biases == NULL) {
+        tensor_free(dense->weights);
+        tensor_free(dense->biases);
+        free(dense);
+        return NULL;
+    }
+
+    dense->input_cache = NULL;
+    dense->grad_weights = NULL;
+    dense->grad_biases = NULL;
+    dense->input_size = input_size;
+    dense->output_size = output_size;
+    dense->param_offset = 0;
+    dense->param_count = 0;
+    dense->packed = NULL;
+    dense->packed_t = NULL;
+    dense->packed_valid = 0;
+    dense->packed_t_valid = 0;
 
     return dense;
 }
@@ -58,16 +104,60 @@ void dense_free(DenseLayer* layer) {
         tensor_free(layer->grad_biases);
     }
 
+    size_t bytes = tensor_packed_size(layer->input_size, layer->output_size) * sizeof(float);
+    if (layer->packed != NULL) mem_track_free(MEM_PARAMS, bytes);
+    free(layer->packed);
+    bytes = tensor_packed_size(layer->output_size, layer->input_size) * sizeof(float);
+    if (layer->packed_t != NULL) mem_track_free(MEM_PARAMS, bytes);
+    free(layer->packed_t);
+
     free(layer);
 }
 
+// the packed weights (or their transpose), repacked if the weights changed since; NULL on out of memory
+static const float* packed_weights(DenseLayer* layer, int transposed) {
+    float** packed = transposed ? &layer->packed_t : &layer->packed;
+    int* valid = transposed ? &layer->packed_t_valid : &layer->packed_valid;
+    size_t k = transposed ? layer->output_size : layer->input_size;
+    size_t n = transposed ? layer->input_size : layer->output_size;
+    if (*packed == NULL) {
+        size_t bytes = tensor_packed_size(k, n) * sizeof(float);
+        *packed = aligned_alloc(64, (bytes + 63) / 64 * 64);
+        if (*packed == NULL) return NULL;
+        mem_track_alloc(MEM_PARAMS, bytes);
+        *valid = 0;
+    }
+    if (!*valid) {
+        const float* w = layer->weights->data;
+        if (transposed) tensor_pack_panels(w, k, n, 1, k, *packed);
+        else tensor_pack_panels(w, k, n, n, 1, *packed);
+        *valid = 1;
+    }
+    return *packed;
+}
+
+int dense_pack(DenseLayer* layer) {
+    if (layer == NULL) return -1;
+    return packed_weights(layer, 0) != NULL ? 0 : -1;
+}
+
+void dense_invalidate_packed(DenseLayer* layer) {
+    if (layer == NULL) return;
+    layer->packed_valid = 0;
+    layer->packed_t_valid = 0;
+}
+
 Tensor* dense_forward(DenseLayer* layer, const Tensor* input) {
     if (layer == NULL || input == NULL) return NULL;
 
     if (input->ndim != 2) return NULL;
     if (input->shape[1] != layer->input_size) return NULL;
 
-    Tensor* output = tensor_matmul(input, layer->weights);
+    // the packed copy is built once per weight update and reused by every forward until the next
+    const float* packed = packed_weights(layer, 0);
+    GemmTiling tiling = autotune_gemm(input->shape[0], layer->output_size, layer->input_size, 0);
+    Tensor* output = packed != NULL ? tensor_matmul_packed(input, packed, layer->output_size, &tiling)
+                                    : tensor_matmul(input, layer->weights);
     if (output == NULL) return NULL;
 
     Tensor* b = tensor_broadcast(layer->biases, output->shape, output->ndim);
@@ -84,58 +174,64 @@ Tensor* dense_forward(DenseLayer* layer, const Tensor* input) {
     if (layer->input_cache != NULL) {
         tensor_free(layer->input_cache);
     }
+    MemCategory prev = mem_set_category(MEM_ACTIVATIONS);
     layer->input_cache = tensor_copy(input);
+    mem_set_category(prev);
 
     return result;
 }
 
-Tensor* dense_backward(DenseLayer* layer, const Tensor* grad_output) {
-    if (layer == NULL || grad_output == NULL) return NULL;
-    if (grad_output->ndim != 2) return NULL;
-    if (grad_output->shape[1] != layer->output_size) return NULL;
+static int backward_args_ok(const DenseLayer* layer, const Tensor* grad_output) {
+    if (layer == NULL || grad_output == NULL) return 0;
+    if (grad_output->ndim != 2) return 0;
+    if (grad_output->shape[1] != layer->output_size) return 0;
+    return 1;
+}
 
-    if (layer->input_cache == NULL) return NULL;
+int dense_backward_weights(DenseLayer* layer, const Tensor* grad_output) {
+    if (!backward_args_ok(layer, grad_output)) return -1;
+    if (layer->input_cache == NULL) return -1;
+
+    // gradients are written in place so they stay put when they're views into the parameter arena;
+    // the first backward pass on a standalone layer allocates them
+    if (layer->grad_weights == NULL) {
+        size_t weights_shape[] = {layer->input_size, layer->output_size};
+        MemCategory prev = mem_set_category(MEM_GRADS);
+        layer->grad_weights = tensor_create(weights_shape, 2);
+        mem_set_category(prev);
+    }
+    if (layer->grad_weights == NULL) return -1;
 
-    Tensor* input_transposed = tensor_transpose(layer->input_cache);
+    // grad_weights = input^T grad_output, a sum over the batch (see reduce.h for how it's split)
+    return reduce_outer_sums(layer->input_cache, grad_output, layer->grad_weights->data);
+}
 
-    // compute gradients for weights
-    Tensor* grad_weights = tensor_matmul(input_transposed, grad_output);
-    tensor_free(input_transposed);
+int dense_backward_bias(DenseLayer* layer, const Tensor* grad_output) {
+    if (!backward_args_ok(layer, grad_output)) return -1;
 
-    if (grad_weights == NULL) return NULL;
+    if (layer->grad_biases == NULL) {
+        size_t biases_shape[] = {layer->output_size};
+        MemCategory prev = mem_set_category(MEM_GRADS);
+        layer->grad_biases = tensor_create(biases_shape, 1);
+        mem_set_category(prev);
+    }
+    if (layer->grad_biases == NULL) return -1;
 
     // sum bias over batch (axis 0). bias is shared across batch.
     // ex. if grad_output is [[0.1, 0.2], [0.3, 0.4]] then grad_biases would be [0.4, 0.6];
-    size_t biases_shape[] = {layer->output_size};
-    Tensor* grad_biases = tensor_create(biases_shape, 1);
-        if (grad_biases == NULL) {
-        tensor_free(grad_weights);
-        return NULL;
-        }
+    return reduce_column_sums(grad_output, layer->grad_biases->data);
+}
 
+Tensor* dense_backward_input(DenseLayer* layer, const Tensor* grad_output) {
+    if (!backward_args_ok(layer, grad_output)) return NULL;
 
-    for (size_t j = 0; j < layer->output_size; j++) {
-        float sum = 0.0f;
-        for (size_t i = 0; i < grad_output->shape[0]; i++) {
-            size_t idx = i * grad_output->strides[0] + j * grad_output->strides[1];
-            sum += grad_output->data[idx];
-        }
-        grad_biases->data[j] = sum;
+    // compute the gradient for input into next layer in the backprop order (the previous layer)
+    const float* packed = packed_weights(layer, 1);
+    if (packed != NULL) {
+        GemmTiling tiling = autotune_gemm(grad_output->shape[0], layer->input_size, layer->output_size, 1);
+        return tensor_matmul_packed(grad_output, packed, layer->input_size, &tiling);
     }
 
-    // free existing gradients if they exist (from previous backward pass)
-    if (layer->grad_weights != NULL) tensor_free(layer->grad_weights);
-    if (layer->grad_biases != NULL) tensor_free(layer->grad_biases);
-
-    // store gradients for optimizer to use
-    layer->grad_weights = tensor_copy(grad_weights);
-    layer->grad_biases = tensor_copy(grad_biases);
-
-    // free the temp tensors
-    tensor_free(grad_weights);
-    tensor_free(grad_biases);
-
-    // compute the gradient for input into next layer in the backprop order (the previous layer)
     Tensor* weights_transposed = tensor_transpose(layer->weights);
     if(weights_transposed == NULL) {
         return NULL;
@@ -143,8 +239,14 @@ Tensor* dense_backward(DenseLayer* layer, const Tensor* grad_output) {
 
     Tensor* grad_input = tensor_matmul(grad_output, weights_transposed);
     tensor_free(weights_transposed);
-    if (grad_input == NULL) return NULL;
+    return grad_input;
+}
 
+Tensor* dense_backward(DenseLayer* layer, const Tensor* grad_output) {
+    if (!backward_args_ok(layer, grad_output)) return NULL;
+    if (layer->input_cache == NULL) return NULL;
 
-    return grad_input;
+    if (dense_backward_weights(layer, grad_output) != 0) return NULL;
+    if (dense_backward_bias(layer, grad_output) != 0) return NULL;
+    return dense_backward_input(layer, grad_output);
 }
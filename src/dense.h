@@ -11,15 +11,42 @@ typedef struct {
     Tensor* input_cache;
     size_t input_size;
     size_t output_size;
+    size_t param_offset;  // where weights start in the network's ParamArena (biases follow)
+    size_t param_count;   // floats this layer spans in the arena, padding included
+    // GEMM-packed copies of the weights (see tensor_pack_panels), built on first use and kept
+    // until the weights change; both are accounted as MEM_PARAMS
+    float* packed;        // weights, for input weights in forward
+    float* packed_t;      // weights^T, for grad_output weights^T in backward
+    int packed_valid;
+    int packed_t_valid;
 } DenseLayer;
 
 DenseLayer* dense_create(size_t input_size, size_t output_size);
+
+// Layer whose weights ([input_size, output_size]) and biases ([output_size]) are views
+// over existing memory, e.g. a mapped checkpoint; nothing is initialized or copied
+DenseLayer* dense_create_view(size_t input_size, size_t output_size, float* weights, float* biases);
+
 void dense_free(DenseLayer* layer);
 
+// Build the forward panels now instead of on the first forward, e.g. once for a model loaded to serve.
+// Returns 0, or -1 if they couldn't be allocated (forward then packs, or falls back, on its own).
+int dense_pack(DenseLayer* layer);
+
+// The weights were written: repack before they're next multiplied. optimizer_step calls this on every
+// update; code that writes weights->data directly must too.
+void dense_invalidate_packed(DenseLayer* layer);
+
 // Forward pass
 Tensor* dense_forward(DenseLayer* layer, const Tensor* input);
 
-// Backward pass
+// Backward pass: fills grad_weights and grad_biases, returns the gradient w.r.t. the input
 Tensor* dense_backward(DenseLayer* layer, const Tensor* grad_output);
 
+// The three independent parts of dense_backward, for running them concurrently.
+// None of them touches the weights, so all must finish before the optimizer updates the layer.
+int dense_backward_weights(DenseLayer* layer, const Tensor* grad_output);    // grad_weights = input^T grad_output
+int dense_backward_bias(DenseLayer* layer, const Tensor* grad_output);       // grad_biases = column sums of grad_output
+Tensor* dense_backward_input(DenseLayer* layer, const Tensor* grad_output);  // grad_output weights^T
+
 #endif // DENSE_H
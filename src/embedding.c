@@ -0,0 +1,160 @@
+#include "embedding.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static EmbeddingLayer* embedding_alloc(size_t vocab_size, size_t dim, size_t num_fields) {
+    if (vocab_size == 0 || dim == 0 || num_fields == 0) return NULL;
+    if (vocab_size > EMBEDDING_MAX_VOCAB) return NULL;  // IDs past 2^24 aren't exact as floats
+    EmbeddingLayer* layer = calloc(1, sizeof(EmbeddingLayer));
+    if (layer == NULL) return NULL;
+    layer->vocab_size = vocab_size;
+    layer->dim = dim;
+    layer->num_fields = num_fields;
+    return layer;
+}
+
+EmbeddingLayer* embedding_create(size_t vocab_size, size_t dim, size_t num_fields) {
+    EmbeddingLayer* layer = embedding_alloc(vocab_size, dim, num_fields);
+    if (layer == NULL) return NULL;
+
+    size_t shape[] = {vocab_size, dim};
+    MemCategory prev = mem_set_category(MEM_PARAMS);
+    layer->table = tensor_create(shape, 2);
+    mem_set_category(prev);
+    if (layer->table == NULL) {
+        free(layer);
+        return NULL;
+    }
+    tensor_rand(layer->table, -0.1f, 0.1f, 42);
+    return layer;
+}
+
+EmbeddingLayer* embedding_create_view(size_t vocab_size, size_t dim, size_t num_fields, float* table) {
+    if (table == NULL) return NULL;
+    EmbeddingLayer* layer = embedding_alloc(vocab_size, dim, num_fields);
+    if (layer == NULL) return NULL;
+
+    size_t shape[] = {vocab_size, dim};
+    MemCategory prev = mem_set_category(MEM_PARAMS);
+    layer->table = tensor_view(table, shape, 2);
+    mem_set_category(prev);
+    if (layer->table == NULL) {
+        free(layer);
+        return NULL;
+    }
+    return layer;
+}
+
+void embedding_free(EmbeddingLayer* layer) {
+    if (layer == NULL) return;
+    tensor_free(layer->table);
+    tensor_free(layer->grad_table);
+    free(layer->ids);
+    free(layer->rows);
+    if (layer->capacity > 0) mem_track_free(MEM_ACTIVATIONS, 2 * layer->capacity * sizeof(size_t));
+    free(layer);
+}
+
+// float -> row index; -1 unless it's a whole number inside the table
+static long row_of(const EmbeddingLayer* layer, float id) {
+    if (!(id >= 0.0f && id < (float)layer->vocab_size) || floorf(id) != id) return -1;
+    return (long)id;
+}
+
+int embedding_lookup(const EmbeddingLayer* layer, const float* ids, float* out, size_t n) {
+    if (layer == NULL || ids == NULL || out == NULL) return -1;
+    size_t dim = layer->dim;
+    for (size_t i = 0; i < n * layer->num_fields; i++) {
+        long row = row_of(layer, ids[i]);
+        if (row < 0) return -1;
+        memcpy(out + i * dim, layer->table->data + (size_t)row * dim, dim * sizeof(float));
+    }
+    return 0;
+}
+
+static int reserve(EmbeddingLayer* layer, size_t n) {
+    if (n <= layer->capacity) return 0;
+    size_t* ids = malloc(n * sizeof(size_t));
+    size_t* rows = malloc(n * sizeof(size_t));
+    if (ids == NULL || rows == NULL) {
+        free(ids);
+        free(rows);
+        return -1;
+    }
+    // rows still lists what the last backward wrote; keep it so those gradients get cleared
+    memcpy(rows, layer->rows, layer->num_rows * sizeof(size_t));
+    free(layer->ids);
+    free(layer->rows);
+    if (layer->capacity > 0) mem_track_free(MEM_ACTIVATIONS, 2 * layer->capacity * sizeof(size_t));
+    mem_track_alloc(MEM_ACTIVATIONS, 2 * n * sizeof(size_t));
+    layer->ids = ids;
+    layer->rows = rows;
+    layer->capacity = n;
+    return 0;
+}
+
+Tensor* embedding_forward(EmbeddingLayer* layer, const Tensor* input) {
+    if (layer == NULL || input == NULL) return NULL;
+    if (input->ndim != 2 || input->shape[1] != layer->num_fields) return NULL;
+
+    size_t n = input->shape[0];
+    size_t count = n * layer->num_fields;
+    size_t shape[] = {n, layer->num_fields * layer->dim};
+    Tensor* output = tensor_create(shape, 2);
+    if (output == NULL) return NULL;
+    if (reserve(layer, count) != 0 || embedding_lookup(layer, input->data, output->data, n) != 0) {
+        tensor_free(output);
+        return NULL;
+    }
+
+    // lookup checked every ID
+    for (size_t i = 0; i < count; i++) layer->ids[i] = (size_t)input->data[i];
+    layer->num_ids = count;
+    return output;
+}
+
+static int compare_size(const void* a, const void* b) {
+    size_t x = *(const size_t*)a, y = *(const size_t*)b;
+    return (x > y) - (x < y);
+}
+
+Tensor* embedding_backward(EmbeddingLayer* layer, const Tensor* grad_output) {
+    if (layer == NULL || grad_output == NULL || layer->ids == NULL) return NULL;
+    size_t fields = layer->num_fields, dim = layer->dim;
+    if (grad_output->ndim != 2 || grad_output->shape[1] != fields * dim ||
+        grad_output->shape[0] * fields != layer->num_ids) {
+        return NULL;
+    }
+
+    if (layer->grad_table == NULL) {
+        MemCategory prev = mem_set_category(MEM_GRADS);
+        layer->grad_table = tensor_create(layer->table->shape, 2);
+        mem_set_category(prev);
+        if (layer->grad_table == NULL) return NULL;
+        tensor_fill(layer->grad_table, 0.0f);
+    }
+    float* grad = layer->grad_table->data;
+
+    // clear what the previous step left, then list this batch's rows: sorted, so the update order is fixed
+    for (size_t k = 0; k < layer->num_rows; k++) memset(grad + layer->rows[k] * dim, 0, dim * sizeof(float));
+    memcpy(layer->rows, layer->ids, layer->num_ids * sizeof(size_t));
+    qsort(layer->rows, layer->num_ids, sizeof(size_t), compare_size);
+    size_t unique = 0;
+    for (size_t k = 0; k < layer->num_ids; k++) {
+        if (unique == 0 || layer->rows[unique - 1] != layer->rows[k]) layer->rows[unique++] = layer->rows[k];
+    }
+    layer->num_rows = unique;
+
+    // an ID seen several times in the batch sums its gradients
+    for (size_t i = 0; i < layer->num_ids; i++) {
+        float* g = grad + layer->ids[i] * dim;
+        const float* go = grad_output->data + i * dim;
+        for (size_t j = 0; j < dim; j++) g[j] += go[j];
+    }
+
+    size_t shape[] = {grad_output->shape[0], fields};
+    Tensor* grad_input = tensor_create(shape, 2);
+    if (grad_input != NULL) tensor_fill(grad_input, 0.0f);
+    return grad_input;
+}
@@ -0,0 +1,55 @@
+#ifndef EMBEDDING_H
+#define EMBEDDING_H
+
+#include "tensor.h"
+
+/**
+ * Lookup table for categorical inputs. Each input row holds num_fields IDs in
+ * [0, vocab_size); the output row is their table rows concatenated, so
+ * [batch, num_fields] in gives [batch, num_fields * dim] out. IDs travel in
+ * the network's float tensors, which hold every integer exactly only up to
+ * 2^24; above that neighbouring IDs round to the same float and would share a
+ * row, so tables are capped at EMBEDDING_MAX_VOCAB rows.
+ *
+ * Backward is sparse: only the rows the batch touched get a gradient, written
+ * at their own place in grad_table and listed in `rows`. The rest of
+ * grad_table is never read, so a step costs O(IDs in the batch * dim) however
+ * large the vocabulary, and optimizer_step updates just those rows (lazy
+ * momentum and Adam: untouched rows keep their state until they next appear).
+ */
+#define EMBEDDING_MAX_VOCAB (1u << 24)
+
+typedef struct {
+    Tensor* table;          // [vocab_size, dim]
+    Tensor* grad_table;     // same shape; only the rows in `rows` are valid
+    size_t* ids;            // the last forward's IDs, batch * num_fields, for the backward scatter
+    size_t num_ids;
+    size_t* rows;           // distinct IDs of the last backward, ascending
+    size_t num_rows;
+    size_t capacity;        // of ids and rows
+    size_t vocab_size;
+    size_t dim;
+    size_t num_fields;
+    size_t param_offset;    // where the table starts in the network's ParamArena
+    size_t param_count;     // floats this layer spans in the arena, padding included
+} EmbeddingLayer;
+
+// NULL if vocab_size is 0 or above EMBEDDING_MAX_VOCAB, or on allocation failure
+EmbeddingLayer* embedding_create(size_t vocab_size, size_t dim, size_t num_fields);
+
+// Layer over an existing table ([vocab_size, dim]), e.g. a mapped checkpoint
+EmbeddingLayer* embedding_create_view(size_t vocab_size, size_t dim, size_t num_fields, float* table);
+
+void embedding_free(EmbeddingLayer* layer);
+
+// Gather n rows of IDs into out ([n, num_fields * dim]) without touching the
+// layer's caches. Returns -1 if an ID isn't an integer in range.
+int embedding_lookup(const EmbeddingLayer* layer, const float* ids, float* out, size_t n);
+
+Tensor* embedding_forward(EmbeddingLayer* layer, const Tensor* input);
+
+// Fills the touched rows of grad_table and `rows`. IDs have no gradient, so
+// the returned tensor is zeros of the input's shape.
+Tensor* embedding_backward(EmbeddingLayer* layer, const Tensor* grad_output);
+
+#endif // EMBEDDING_H
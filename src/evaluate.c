@@ -0,0 +1,351 @@
+#include "axiom.h"
+#include "parallel.h"
+#include "reduce.h"
+#include "simd.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EVAL_CHUNKS_PER_THREAD 4   // batches are handed out in about this many chunks per thread
+#define EVAL_DETERMINISTIC_CHUNKS 32   // chunk count in deterministic mode, so the loss sums the same way on any pool
+
+// per-chunk scratch: the gathered batch, two ping-pong activation buffers, the labels,
+// and for nets with low-rank layers one more buffer for x U
+typedef struct {
+    Tensor* x;          // view over in, [batch, in_width]
+    Tensor* y;          // view over labels, [batch, num_classes]; NULL for a label dataset
+    float* in;
+    float* bufs[2];
+    float* mid;         // [batch, max_rank], NULL without low-rank layers
+    float* labels;
+    int32_t* ids;       // [batch] class ids, instead of y, for a label dataset
+    size_t* rows;
+    size_t bytes;       // accounted as MEM_TEMPORARY
+} EvalWork;
+
+typedef struct {
+    const AxiomNet* net;
+    const Layer* head;      // final softmax, fused into scoring; NULL if the net doesn't end in one
+    const Dataset* x;
+    const Dataset* y;
+    size_t batch_size;
+    size_t num_batches;
+    size_t grain;           // batches per chunk
+    size_t max_width;
+    size_t max_rank;
+    size_t num_classes;
+    int y_labels;           // y holds class ids: read them instead of one-hot rows
+    size_t* confusion;      // shared; merged under lock; NULL above AXIOM_EVAL_CONFUSION_MAX classes
+    double* chunk_loss;     // one sum per chunk, added up in order afterwards so the total is deterministic
+    size_t correct;
+    size_t correct_topk;
+    size_t scored;          // rows with a valid label
+    int failed;
+    pthread_mutex_t lock;
+} EvalJob;
+
+static void work_free(EvalWork* w) {
+    tensor_free(w->x);
+    tensor_free(w->y);
+    free(w->in);
+    free(w->bufs[0]);
+    free(w->bufs[1]);
+    free(w->mid);
+    free(w->labels);
+    free(w->ids);
+    free(w->rows);
+    if (w->bytes > 0) mem_track_free(MEM_TEMPORARY, w->bytes);
+}
+
+static int work_create(EvalWork* w, const EvalJob* job) {
+    memset(w, 0, sizeof *w);
+    size_t b = job->batch_size;
+    size_t in_width = dataset_width(job->x);
+    w->in = malloc(b * in_width * sizeof(float));
+    w->bufs[0] = malloc(b * job->max_width * sizeof(float));
+    w->bufs[1] = malloc(b * job->max_width * sizeof(float));
+    w->mid = job->max_rank > 0 ? malloc(b * job->max_rank * sizeof(float)) : NULL;
+    if (job->y_labels) w->ids = malloc(b * sizeof(int32_t));
+    else w->labels = malloc(b * job->num_classes * sizeof(float));
+    w->rows = malloc(b * sizeof(size_t));
+    if (w->in == NULL || w->bufs[0] == NULL || w->bufs[1] == NULL || (w->labels == NULL && w->ids == NULL) ||
+        w->rows == NULL || (job->max_rank > 0 && w->mid == NULL)) {
+        work_free(w);
+        return -1;
+    }
+
+    size_t x_shape[] = {b, in_width};
+    size_t y_shape[] = {b, job->num_classes};
+    w->x = tensor_view(w->in, x_shape, 2);
+    if (!job->y_labels) w->y = tensor_view(w->labels, y_shape, 2);
+    if (w->x == NULL || (!job->y_labels && w->y == NULL)) {
+        work_free(w);
+        return -1;
+    }
+    size_t label_floats = job->y_labels ? 1 : job->num_classes;  // an int32 id is one float's worth
+    w->bytes = b * (in_width + 2 * job->max_width + job->max_rank + label_floats) * sizeof(float) + b * sizeof(size_t);
+    mem_track_alloc(MEM_TEMPORARY, w->bytes);
+    return 0;
+}
+
+// out[i, :] = b + x[i, :] W for n rows of width in, W [in, width], without touching the layer's caches.
+// rows of W are added in with axpy; zero inputs (relu outputs, blank pixels) are skipped. bias may be NULL.
+static void affine_infer(const float* w, const float* bias, size_t in, size_t width,
+                         const float* x, float* out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        float* o = out + i * width;
+        if (bias != NULL) {
+            memcpy(o, bias, width * sizeof(float));
+        } else {
+            memset(o, 0, width * sizeof(float));
+        }
+        const float* xi = x + i * in;
+        for (size_t k = 0; k < in; k++) {
+            float a = xi[k];
+            if (a == 0.0f) continue;
+            const float* wk = w + k * width;
+            f32x4 va = f32x4_set1(a);
+            size_t j = 0;
+            for (; j + SIMD_WIDTH <= width; j += SIMD_WIDTH) {
+                f32x4_store(o + j, f32x4_load(o + j) + va * f32x4_load(wk + j));
+            }
+            for (; j < width; j++) o[j] += a * wk[j];
+        }
+    }
+}
+
+static void softmax_rows(float* x, size_t n, size_t width) {
+    for (size_t i = 0; i < n; i++) {
+        float* row = x + i * width;
+        float max_val = row[0];
+        for (size_t j = 1; j < width; j++) if (row[j] > max_val) max_val = row[j];
+        float sum = 0.0f;
+        for (size_t j = 0; j < width; j++) {
+            row[j] = expf(row[j] - max_val);
+            sum += row[j];
+        }
+        for (size_t j = 0; j < width; j++) row[j] /= sum;
+    }
+}
+
+// forward one batch through every layer before the head; returns the buffer holding the result
+static const float* infer_batch(const EvalJob* job, EvalWork* w, size_t n, size_t* width) {
+    const float* cur = w->in;
+    size_t cur_width = dataset_width(job->x);
+    int next = 0;
+
+    for (const Layer* layer = job->net->layers; layer != NULL && layer != job->head; layer = layer->next) {
+        if (layer->type == LAYER_DENSE) {
+            const DenseLayer* d = layer->layer.dense;
+            if (d->input_size != cur_width) return NULL;
+            affine_infer(d->weights->data, d->biases->data, d->input_size, d->output_size, cur, w->bufs[next], n);
+            cur = w->bufs[next];
+            cur_width = d->output_size;
+            next ^= 1;
+            continue;
+        }
+        if (layer->type == LAYER_EMBEDDING) {
+            const EmbeddingLayer* e = layer->layer.embedding;
+            if (e->num_fields != cur_width || embedding_lookup(e, cur, w->bufs[next], n) != 0) return NULL;
+            cur = w->bufs[next];
+            cur_width = e->num_fields * e->dim;
+            next ^= 1;
+            continue;
+        }
+        if (layer->type == LAYER_DENSE_LOWRANK) {
+            const LowRankLayer* l = layer->layer.lowrank;
+            if (l->input_size != cur_width) return NULL;
+            affine_infer(l->u->data, NULL, l->input_size, l->rank, cur, w->mid, n);
+            affine_infer(l->v->data, l->biases->data, l->rank, l->output_size, w->mid, w->bufs[next], n);
+            cur = w->bufs[next];
+            cur_width = l->output_size;
+            next ^= 1;
+            continue;
+        }
+
+        // activations work in place once the data is in a scratch buffer
+        if (cur == w->in) {
+            memcpy(w->bufs[next], cur, n * cur_width * sizeof(float));
+            cur = w->bufs[next];
+            next ^= 1;
+        }
+        float* x = (float*)cur;
+        if (layer->layer.activation->type == ACTIVATION_RELU) {
+            for (size_t i = 0; i < n * cur_width; i++) x[i] = x[i] > 0.0f ? x[i] : 0.0f;
+        } else if (layer->layer.activation->type == ACTIVATION_SOFTMAX) {
+            softmax_rows(x, n, cur_width);
+        }
+    }
+    *width = cur_width;
+    return cur;
+}
+
+static void eval_range(void* ctx, size_t begin, size_t end) {
+    EvalJob* job = ctx;
+    size_t classes = job->num_classes;
+
+    EvalWork w;
+    size_t* confusion = job->confusion != NULL ? calloc(classes * classes, sizeof(size_t)) : NULL;
+    if ((job->confusion != NULL && confusion == NULL) || work_create(&w, job) != 0) {
+        free(confusion);
+        pthread_mutex_lock(&job->lock);
+        job->failed = 1;
+        pthread_mutex_unlock(&job->lock);
+        return;
+    }
+
+    size_t correct = 0, correct_topk = 0, scored = 0;
+    double loss = 0.0;
+    int failed = 0;
+    for (size_t b = begin; b < end && !failed; b++) {
+        size_t start = b * job->batch_size;
+        size_t n = job->batch_size;
+        if (start + n > job->x->rows) n = job->x->rows - start;
+        for (size_t i = 0; i < n; i++) w.rows[i] = start + i;
+        dataset_gather(job->x, w.x, w.rows, n);
+        if (job->y_labels) dataset_gather_labels(job->y, w.ids, w.rows, n);
+        else dataset_gather(job->y, w.y, w.rows, n);
+
+        size_t width;
+        const float* scores = infer_batch(job, &w, n, &width);
+        if (scores == NULL || width != classes) {
+            failed = 1;
+            break;
+        }
+
+        // head pass: argmax, rank of the true class and cross-entropy from one read of each row.
+        // with a softmax head the scores are its logits, so the loss is a log-sum-exp.
+        for (size_t i = 0; i < n; i++) {
+            const float* s = scores + i * classes;
+            size_t pred = 0, label = 0;
+            for (size_t j = 1; j < classes; j++) {
+                if (s[j] > s[pred]) pred = j;
+            }
+            // a row without a valid label (id out of range, or an all-zero one-hot row) is left out,
+            // as loss_cross_entropy_index leaves it out of training
+            if (job->y_labels) {
+                if (w.ids[i] < 0 || (size_t)w.ids[i] >= classes) continue;
+                label = (size_t)w.ids[i];
+            } else {
+                const float* t = w.labels + i * classes;
+                for (size_t j = 1; j < classes; j++) {
+                    if (t[j] > t[label]) label = j;
+                }
+                if (!(t[label] > 0.0f)) continue;
+            }
+            scored++;
+            size_t above = 0;
+            for (size_t j = 0; j < classes; j++) above += s[j] > s[label];
+
+            if (job->head != NULL) {
+                double sum = 0.0;
+                for (size_t j = 0; j < classes; j++) sum += exp((double)(s[j] - s[pred]));
+                loss += log(sum) - (double)(s[label] - s[pred]);
+            } else {
+                loss -= log(s[label] > 1e-7f ? (double)s[label] : 1e-7);
+            }
+
+            correct += pred == label;
+            correct_topk += above < AXIOM_EVAL_TOP_K;
+            if (confusion != NULL) confusion[label * classes + pred]++;
+        }
+    }
+
+    pthread_mutex_lock(&job->lock);
+    job->correct += correct;
+    job->correct_topk += correct_topk;
+    job->scored += scored;
+    job->chunk_loss[begin / job->grain] = loss;
+    if (confusion != NULL) {
+        for (size_t i = 0; i < classes * classes; i++) job->confusion[i] += confusion[i];
+    }
+    if (failed) job->failed = 1;
+    pthread_mutex_unlock(&job->lock);
+
+    free(confusion);
+    work_free(&w);
+}
+
+int axiom_evaluate(const AxiomNet* net, const Dataset* x, const Dataset* y, size_t batch_size, AxiomEvalResult* result) {
+    if (net == NULL || x == NULL || y == NULL || result == NULL) return -1;
+    memset(result, 0, sizeof *result);
+    if (x->rows != y->rows || x->rows == 0 || batch_size == 0) return -1;
+
+    EvalJob job;
+    memset(&job, 0, sizeof job);
+    job.net = net;
+    job.x = x;
+    job.y = y;
+    job.batch_size = batch_size;
+    job.num_classes = dataset_width(y);
+    job.y_labels = dataset_is_labels(y);
+    job.num_batches = (x->rows + batch_size - 1) / batch_size;
+    job.max_width = dataset_width(x);
+
+    const Layer* last = NULL;
+    for (const Layer* layer = net->layers; layer != NULL; layer = layer->next) {
+        if (layer->type == LAYER_DENSE && layer->layer.dense->output_size > job.max_width) {
+            job.max_width = layer->layer.dense->output_size;
+        }
+        if (layer->type == LAYER_DENSE_LOWRANK) {
+            const LowRankLayer* l = layer->layer.lowrank;
+            if (l->output_size > job.max_width) job.max_width = l->output_size;
+            if (l->rank > job.max_rank) job.max_rank = l->rank;
+        }
+        if (layer->type == LAYER_EMBEDDING) {
+            const EmbeddingLayer* e = layer->layer.embedding;
+            if (e->num_fields * e->dim > job.max_width) job.max_width = e->num_fields * e->dim;
+        }
+        last = layer;
+    }
+    if (last == NULL) return -1;
+    if (last->type == LAYER_ACTIVATION && last->layer.activation->type == ACTIVATION_SOFTMAX) job.head = last;
+
+    // the loss is summed per chunk, then chunk by chunk: the chunking decides its rounding
+    size_t chunks = reduce_is_deterministic() ? EVAL_DETERMINISTIC_CHUNKS : parallel_num_threads() * EVAL_CHUNKS_PER_THREAD;
+    job.grain = (job.num_batches + chunks - 1) / chunks;
+    if (job.grain == 0) job.grain = 1;
+    size_t num_chunks = (job.num_batches + job.grain - 1) / job.grain;
+
+    if (job.num_classes <= AXIOM_EVAL_CONFUSION_MAX) {
+        job.confusion = calloc(job.num_classes * job.num_classes, sizeof(size_t));
+        if (job.confusion == NULL) return -1;
+    }
+    job.chunk_loss = calloc(num_chunks, sizeof(double));
+    if (job.chunk_loss == NULL) {
+        free(job.confusion);
+        free(job.chunk_loss);
+        return -1;
+    }
+    pthread_mutex_init(&job.lock, NULL);
+
+    parallel_for(job.num_batches, job.grain, eval_range, &job);
+
+    pthread_mutex_destroy(&job.lock);
+    double loss = 0.0;
+    for (size_t c = 0; c < num_chunks; c++) loss += job.chunk_loss[c];
+    free(job.chunk_loss);
+    if (job.failed) {
+        free(job.confusion);
+        return -1;
+    }
+
+    size_t scored = job.scored > 0 ? job.scored : 1;
+    result->samples = job.scored;
+    result->skipped = x->rows - job.scored;
+    result->num_classes = job.num_classes;
+    result->correct = job.correct;
+    result->correct_topk = job.correct_topk;
+    result->accuracy = (float)job.correct / (float)scored;
+    result->topk_accuracy = (float)job.correct_topk / (float)scored;
+    result->loss = (float)(loss / (double)scored);
+    result->confusion = job.confusion;
+    return 0;
+}
+
+void axiom_eval_result_free(AxiomEvalResult* result) {
+    if (result == NULL) return;
+    free(result->confusion);
+    result->confusion = NULL;
+}
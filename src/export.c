@@ -0,0 +1,258 @@
+#include "export.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EXPORT_VALUES_PER_LINE 6
+
+// one emitted stage: an optional affine map (a dense layer, or one factor of a
+// low-rank layer) and the activation fused onto its output
+typedef struct {
+    const float* weights;      // [in, out]; NULL for an activation with no dense layer in front of it
+    const float* biases;       // NULL for none (the U factor of a low-rank layer)
+    int act;                   // ACTIVATION_*; NONE if nothing is fused
+    size_t in;
+    size_t out;
+} Stage;
+
+static int valid_prefix(const char* prefix) {
+    if (prefix == NULL || !(isalpha((unsigned char)prefix[0]) || prefix[0] == '_')) return 0;
+    for (const char* p = prefix; *p != '\0'; p++) {
+        if (!(isalnum((unsigned char)*p) || *p == '_')) return 0;
+    }
+    return 1;
+}
+
+static const char* act_name(int act) {
+    switch (act) {
+        case ACTIVATION_RELU: return "relu";
+        case ACTIVATION_SOFTMAX: return "softmax";
+        default: return "none";
+    }
+}
+
+// walk the net into stages, folding each activation into the dense layer before it
+static Stage* build_stages(const AxiomNet* net, size_t* num_stages) {
+    Stage* stages = calloc(net->num_layers > 0 ? 2 * net->num_layers : 1, sizeof(Stage));
+    if (stages == NULL) return NULL;
+
+    size_t n = 0, width = 0;
+    for (const Layer* layer = net->layers; layer != NULL; layer = layer->next) {
+        if (layer->type == LAYER_DENSE) {
+            const DenseLayer* d = layer->layer.dense;
+            if (n > 0 && d->input_size != width) goto fail;
+            stages[n++] = (Stage){ .weights = d->weights->data, .biases = d->biases->data, .act = ACTIVATION_NONE,
+                                   .in = d->input_size, .out = d->output_size };
+            width = d->output_size;
+            continue;
+        }
+        if (layer->type == LAYER_DENSE_LOWRANK) {
+            // x U then (x U) V + b, so the export keeps the rank (in + out) cost
+            const LowRankLayer* l = layer->layer.lowrank;
+            if (n > 0 && l->input_size != width) goto fail;
+            stages[n++] = (Stage){ .weights = l->u->data, .biases = NULL, .act = ACTIVATION_NONE,
+                                   .in = l->input_size, .out = l->rank };
+            stages[n++] = (Stage){ .weights = l->v->data, .biases = l->biases->data, .act = ACTIVATION_NONE,
+                                   .in = l->rank, .out = l->output_size };
+            width = l->output_size;
+            continue;
+        }
+        if (layer->type != LAYER_ACTIVATION) goto fail;
+
+        int act = layer->layer.activation->type;
+        if ((act != ACTIVATION_RELU && act != ACTIVATION_SOFTMAX) || n == 0) goto fail;  // the input width is only known from a dense layer
+        if (stages[n - 1].act == ACTIVATION_NONE) {
+            stages[n - 1].act = act;
+        } else {
+            stages[n++] = (Stage){ .weights = NULL, .act = act, .in = width, .out = width };
+        }
+    }
+    if (n == 0) goto fail;
+    *num_stages = n;
+    return stages;
+
+fail:
+    free(stages);
+    return NULL;
+}
+
+// %.8e keeps 9 significant digits, enough to round-trip every float
+static int write_array(FILE* f, const char* prefix, const char* name, size_t index, const float* data, size_t count) {
+    fprintf(f, "static const float %s_%s%zu[%zu] AXIOM_ALIGNED = {", prefix, name, index, count);
+    for (size_t i = 0; i < count; i++) {
+        if (!isfinite(data[i])) return -1;
+        fprintf(f, "%s%.8ef,", i % EXPORT_VALUES_PER_LINE == 0 ? "\n    " : " ", (double)data[i]);
+    }
+    fprintf(f, "\n};\n\n");
+    return 0;
+}
+
+static void emit_softmax(FILE* f, const char* dst, size_t width) {
+    fprintf(f, "    {\n");
+    fprintf(f, "        float max_val = %s[0];\n", dst);
+    fprintf(f, "        for (int j = 1; j < %zu; j++) if (%s[j] > max_val) max_val = %s[j];\n", width, dst, dst);
+    fprintf(f, "        float sum = 0.0f;\n");
+    fprintf(f, "        for (int j = 0; j < %zu; j++) {\n", width);
+    fprintf(f, "            %s[j] = expf(%s[j] - max_val);\n", dst, dst);
+    fprintf(f, "            sum += %s[j];\n", dst);
+    fprintf(f, "        }\n");
+    fprintf(f, "        const float inv = 1.0f / sum;\n");
+    fprintf(f, "        for (int j = 0; j < %zu; j++) %s[j] *= inv;\n", width, dst);
+    fprintf(f, "    }\n");
+}
+
+// narrow layers keep every output in its own local (o<stage>_<j>) so the whole row lives in registers
+static void emit_dense_unrolled(FILE* f, const char* prefix, size_t s, const Stage* st, const char* src,
+                                const char* dst, int skip_zeros) {
+    for (size_t j = 0; j < st->out; j++) {
+        if (st->biases != NULL) {
+            fprintf(f, "    float o%zu_%zu = %s_b%zu[%zu];\n", s, j, prefix, s, j);
+        } else {
+            fprintf(f, "    float o%zu_%zu = 0.0f;\n", s, j);
+        }
+    }
+    fprintf(f, "    for (int k = 0; k < %zu; k++) {\n", st->in);
+    fprintf(f, "        const float a = %s[k];\n", src);
+    if (skip_zeros) fprintf(f, "        if (a == 0.0f) continue;\n");
+    fprintf(f, "        const float* w = %s_w%zu + k * %zu;\n", prefix, s, st->out);
+    for (size_t j = 0; j < st->out; j++) fprintf(f, "        o%zu_%zu += a * w[%zu];\n", s, j, j);
+    fprintf(f, "    }\n");
+    for (size_t j = 0; j < st->out; j++) {
+        if (st->act == ACTIVATION_RELU) {
+            fprintf(f, "    %s[%zu] = o%zu_%zu > 0.0f ? o%zu_%zu : 0.0f;\n", dst, j, s, j, s, j);
+        } else {
+            fprintf(f, "    %s[%zu] = o%zu_%zu;\n", dst, j, s, j);
+        }
+    }
+}
+
+static void emit_dense_loop(FILE* f, const char* prefix, size_t s, const Stage* st, const char* src,
+                            const char* dst, int skip_zeros) {
+    if (st->biases != NULL) {
+        fprintf(f, "    for (int j = 0; j < %zu; j++) %s[j] = %s_b%zu[j];\n", st->out, dst, prefix, s);
+    } else {
+        fprintf(f, "    for (int j = 0; j < %zu; j++) %s[j] = 0.0f;\n", st->out, dst);
+    }
+    fprintf(f, "    for (int k = 0; k < %zu; k++) {\n", st->in);
+    fprintf(f, "        const float a = %s[k];\n", src);
+    if (skip_zeros) fprintf(f, "        if (a == 0.0f) continue;\n");
+    fprintf(f, "        const float* restrict w = %s_w%zu + k * %zu;\n", prefix, s, st->out);
+    fprintf(f, "        for (int j = 0; j < %zu; j++) %s[j] += a * w[j];\n", st->out, dst);
+    fprintf(f, "    }\n");
+    if (st->act == ACTIVATION_RELU) {
+        fprintf(f, "    for (int j = 0; j < %zu; j++) %s[j] = %s[j] > 0.0f ? %s[j] : 0.0f;\n", st->out, dst, dst, dst);
+    }
+}
+
+static void emit_stage(FILE* f, const char* prefix, size_t s, const Stage* st, const char* src, const char* dst,
+                       int skip_zeros) {
+    if (st->weights != NULL) {
+        if (st->act == ACTIVATION_NONE) {
+            fprintf(f, "    /* dense %zu -> %zu */\n", st->in, st->out);
+        } else {
+            fprintf(f, "    /* dense %zu -> %zu + %s */\n", st->in, st->out, act_name(st->act));
+        }
+        if (st->out <= EXPORT_UNROLL_MAX) {
+            emit_dense_unrolled(f, prefix, s, st, src, dst, skip_zeros);
+        } else {
+            emit_dense_loop(f, prefix, s, st, src, dst, skip_zeros);
+        }
+    } else {
+        fprintf(f, "    /* %s */\n", act_name(st->act));
+        if (st->act == ACTIVATION_RELU) {
+            fprintf(f, "    for (int j = 0; j < %zu; j++) %s[j] = %s[j] > 0.0f ? %s[j] : 0.0f;\n", st->out, dst, src, src);
+        } else {
+            fprintf(f, "    for (int j = 0; j < %zu; j++) %s[j] = %s[j];\n", st->out, dst, src);
+        }
+    }
+    if (st->act == ACTIVATION_SOFTMAX) emit_softmax(f, dst, st->out);
+}
+
+// the source name is a user path going into a block comment: control characters become '?' and
+// "*/" is broken up so it can't end the comment early
+static void write_comment_text(FILE* f, const char* s) {
+    for (; *s != '\0'; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c < 0x20 || c == 0x7f) fputc('?', f);
+        else if (c == '*' && s[1] == '/') fputs("* ", f);
+        else fputc(c, f);
+    }
+}
+
+static int write_source(FILE* f, const Stage* stages, size_t n, const char* prefix, const char* source_name) {
+    size_t in = stages[0].in, out = stages[n - 1].out;
+    int softmax = 0;
+    for (size_t s = 0; s < n; s++) softmax |= stages[s].act == ACTIVATION_SOFTMAX;
+
+    fprintf(f, "/* Generated by `axiom export-c` from ");
+    write_comment_text(f, source_name);
+    fprintf(f, ". Do not edit.\n *\n *   %zu", in);
+    for (size_t s = 0; s < n; s++) {
+        if (stages[s].weights != NULL) fprintf(f, " -> dense %zu", stages[s].out);
+        if (stages[s].act != ACTIVATION_NONE) fprintf(f, "%s%s", stages[s].weights != NULL ? " + " : " -> ",
+                                                      act_name(stages[s].act));
+    }
+    fprintf(f, "\n *\n");
+    fprintf(f, " *   void %s_forward(const float* x, float* out, size_t n);  n rows of %zu in, %zu out\n", prefix, in, out);
+    fprintf(f, " *   size_t %s_predict(const float* x);                     argmax of one row\n */\n", prefix);
+    fprintf(f, "#include <stddef.h>\n");
+    if (softmax) fprintf(f, "#include <math.h>\n");
+    fprintf(f, "\n#if defined(__GNUC__)\n#define AXIOM_ALIGNED __attribute__((aligned(64)))\n");
+    fprintf(f, "#else\n#define AXIOM_ALIGNED\n#endif\n\n");
+    fprintf(f, "#define %s_IN %zu\n#define %s_OUT %zu\n\n", prefix, in, prefix, out);
+    fprintf(f, "const size_t %s_num_inputs = %zu;\nconst size_t %s_num_outputs = %zu;\n\n", prefix, in, prefix, out);
+
+    for (size_t s = 0; s < n; s++) {
+        const Stage* st = &stages[s];
+        if (st->weights == NULL) continue;
+        if (write_array(f, prefix, "w", s, st->weights, st->in * st->out) != 0) return -1;
+        if (st->biases != NULL && write_array(f, prefix, "b", s, st->biases, st->out) != 0) return -1;
+    }
+
+    fprintf(f, "static void %s_row(const float* restrict x, float* restrict out) {\n", prefix);
+    for (size_t s = 0; s + 1 < n; s++) fprintf(f, "    float h%zu[%zu] AXIOM_ALIGNED;\n", s, stages[s].out);
+    char src[32] = "x", dst[32];
+    for (size_t s = 0; s < n; s++) {
+        if (s + 1 < n) {
+            snprintf(dst, sizeof(dst), "h%zu", s);
+        } else {
+            snprintf(dst, sizeof(dst), "out");
+        }
+        // blank pixels and relu outputs are mostly zero; their weight rows are skipped
+        int skip_zeros = s == 0 || stages[s - 1].act == ACTIVATION_RELU;
+        if (s > 0) fprintf(f, "\n");
+        emit_stage(f, prefix, s, &stages[s], src, dst, skip_zeros);
+        memcpy(src, dst, sizeof(src));
+    }
+    fprintf(f, "}\n\n");
+
+    fprintf(f, "void %s_forward(const float* x, float* out, size_t n) {\n", prefix);
+    fprintf(f, "    for (size_t i = 0; i < n; i++) %s_row(x + i * %s_IN, out + i * %s_OUT);\n}\n\n", prefix, prefix, prefix);
+    fprintf(f, "size_t %s_predict(const float* x) {\n", prefix);
+    fprintf(f, "    float out[%s_OUT];\n    %s_row(x, out);\n", prefix, prefix);
+    fprintf(f, "    size_t best = 0;\n");
+    fprintf(f, "    for (size_t j = 1; j < %s_OUT; j++) if (out[j] > out[best]) best = j;\n", prefix);
+    fprintf(f, "    return best;\n}\n");
+    return 0;
+}
+
+int export_c(const AxiomNet* net, const char* path, const char* prefix, const char* source_name) {
+    if (net == NULL || path == NULL || !valid_prefix(prefix)) return -1;
+
+    size_t num_stages;
+    Stage* stages = build_stages(net, &num_stages);
+    if (stages == NULL) return -1;
+
+    FILE* f = fopen(path, "w");
+    if (f == NULL) {
+        free(stages);
+        return -1;
+    }
+    int rc = write_source(f, stages, num_stages, prefix, source_name != NULL ? source_name : "a model");
+    if (ferror(f)) rc = -1;  // a short write anywhere above, e.g. a full disk
+    if (fclose(f) != 0) rc = -1;
+    free(stages);
+    if (rc != 0) remove(path);
+    return rc;
+}
@@ -0,0 +1,26 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include "axiom.h"
+
+/**
+ * Ahead-of-time export of a trained net as one standalone C file with no
+ * dependency on this library. Layer sizes become compile-time constants,
+ * weights become 64-byte-aligned static arrays, and each dense layer is a
+ * specialized loop nest with its bias and following activation fused in.
+ * Layers up to EXPORT_UNROLL_MAX wide are written out fully unrolled. The file
+ * defines:
+ *
+ *   extern const size_t <prefix>_num_inputs, <prefix>_num_outputs;
+ *   void <prefix>_forward(const float* x, float* out, size_t n);  // n rows in, n rows out
+ *   size_t <prefix>_predict(const float* x);                      // argmax of one row
+ *
+ * Supported layers: dense, low-rank dense (emitted as its two factors), relu
+ * and softmax. Returns 0 on success, -1 if the net has other layers, its sizes
+ * don't chain, or the file can't be written.
+ */
+#define EXPORT_UNROLL_MAX 16
+
+int export_c(const AxiomNet* net, const char* path, const char* prefix, const char* source_name);
+
+#endif // EXPORT_H
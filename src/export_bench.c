@@ -0,0 +1,152 @@
+#define _POSIX_C_SOURCE 200809L
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "axiom.h"
+#include "mnist.h"
+#include "timer.h"
+
+/*
+ * `make export-bench EXPORT_MODEL=<model_file>`: exports the model with
+ * `axiom export-c`, links the generated code into this driver and times it
+ * against axiom_forward on the same checkpoint, one row at a time (the
+ * embedded-inference case) and in batches. Inputs are MNIST test images when
+ * --data points at them, uniform random rows otherwise.
+ */
+
+#define EXPORT_BENCH_ROWS 256
+#define EXPORT_BENCH_REPS 15
+
+// from the generated file (default prefix)
+extern const size_t axiom_model_num_inputs;
+extern const size_t axiom_model_num_outputs;
+void axiom_model_forward(const float* x, float* out, size_t n);
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double median(double* v, size_t n) {
+    qsort(v, n, sizeof(double), compare_double);
+    return v[n / 2];
+}
+
+// fill rows with test images, or random values if the data isn't there
+static const char* load_inputs(const char* data_path, float* x, size_t rows, size_t width) {
+    MnistData data;
+    if (mnist_open(data_path, &data) == 0) {
+        if (dataset_width(&data.x_test) == width && data.x_test.rows >= rows) {
+            size_t idx[EXPORT_BENCH_ROWS];
+            for (size_t i = 0; i < rows; i++) idx[i] = i;
+            size_t shape[] = {rows, width};
+            Tensor* view = tensor_view(x, shape, 2);
+            if (view != NULL) {
+                dataset_gather(&data.x_test, view, idx, rows);
+                tensor_free(view);
+                mnist_close(&data);
+                return "MNIST test images";
+            }
+        }
+        mnist_close(&data);
+    }
+    srand(42);
+    for (size_t i = 0; i < rows * width; i++) x[i] = (float)rand() / (float)RAND_MAX;
+    return "uniform random rows";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <model_file> [--data <dir>]\n", argv[0]);
+        return 1;
+    }
+    const char* data_path = "data/MNIST";
+    for (int i = 2; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--data") == 0) { data_path = argv[i + 1]; i++; }
+    }
+
+    AxiomNet* net = axiom_load(argv[1]);
+    if (net == NULL) {
+        printf("export-bench: could not load \"%s\"\n", argv[1]);
+        return 1;
+    }
+    size_t in = axiom_model_num_inputs, out = axiom_model_num_outputs, rows = EXPORT_BENCH_ROWS;
+    float* x = malloc(rows * in * sizeof(float));
+    float* y = malloc(rows * out * sizeof(float));
+    Tensor* row_views[EXPORT_BENCH_ROWS] = {0};
+    Tensor* batch_view = NULL;
+    int rc = 1;
+    if (x == NULL || y == NULL) goto done;
+
+    const char* source = load_inputs(data_path, x, rows, in);
+    size_t row_shape[] = {1, in};
+    size_t batch_shape[] = {rows, in};
+    for (size_t i = 0; i < rows; i++) {
+        row_views[i] = tensor_view(x + i * in, row_shape, 2);
+        if (row_views[i] == NULL) goto done;
+    }
+    batch_view = tensor_view(x, batch_shape, 2);
+    if (batch_view == NULL) goto done;
+
+    // both paths must agree before their timings mean anything
+    Tensor* ref = axiom_forward(net, batch_view);
+    if (ref == NULL || ref->size != rows * out) {
+        printf("export-bench: the generated code doesn't match \"%s\" (%zu inputs, %zu outputs)\n", argv[1], in, out);
+        tensor_free(ref);
+        goto done;
+    }
+    axiom_model_forward(x, y, rows);
+    double max_diff = 0.0;
+    size_t agree = 0;
+    for (size_t i = 0; i < rows; i++) {
+        size_t a = 0, b = 0;
+        for (size_t j = 0; j < out; j++) {
+            double d = fabs((double)y[i * out + j] - (double)ref->data[i * out + j]);
+            if (d > max_diff) max_diff = d;
+            if (y[i * out + j] > y[i * out + a]) a = j;
+            if (ref->data[i * out + j] > ref->data[i * out + b]) b = j;
+        }
+        agree += a == b;
+    }
+    tensor_free(ref);
+    printf("%s: %zu -> %zu, %zu %s; max |difference| %.3g, argmax agrees on %zu/%zu rows\n",
+           argv[1], in, out, rows, source, max_diff, agree, rows);
+
+    // batch 1: every sample is one pass over all rows, one call per row
+    double gen_us[EXPORT_BENCH_REPS], ref_us[EXPORT_BENCH_REPS];
+    for (size_t r = 0; r < EXPORT_BENCH_REPS; r++) {
+        uint64_t start = timer_now_ns();
+        for (size_t i = 0; i < rows; i++) axiom_model_forward(x + i * in, y + i * out, 1);
+        gen_us[r] = (double)(timer_now_ns() - start) / 1e3 / (double)rows;
+
+        start = timer_now_ns();
+        for (size_t i = 0; i < rows; i++) tensor_free(axiom_forward(net, row_views[i]));
+        ref_us[r] = (double)(timer_now_ns() - start) / 1e3 / (double)rows;
+    }
+    double gen1 = median(gen_us, EXPORT_BENCH_REPS), ref1 = median(ref_us, EXPORT_BENCH_REPS);
+
+    for (size_t r = 0; r < EXPORT_BENCH_REPS; r++) {
+        uint64_t start = timer_now_ns();
+        axiom_model_forward(x, y, rows);
+        gen_us[r] = (double)(timer_now_ns() - start) / 1e3 / (double)rows;
+
+        start = timer_now_ns();
+        tensor_free(axiom_forward(net, batch_view));
+        ref_us[r] = (double)(timer_now_ns() - start) / 1e3 / (double)rows;
+    }
+    double genb = median(gen_us, EXPORT_BENCH_REPS), refb = median(ref_us, EXPORT_BENCH_REPS);
+
+    printf("%-14s %16s %16s %9s\n", "", "axiom_forward", "exported C", "speedup");
+    printf("%-14s %13.2f us %13.2f us %8.1fx\n", "batch 1", ref1, gen1, ref1 / gen1);
+    printf("batch %-8d %13.2f us %13.2f us %8.1fx   (per row)\n", EXPORT_BENCH_ROWS, refb, genb, refb / genb);
+    rc = 0;
+
+done:
+    for (size_t i = 0; i < rows; i++) tensor_free(row_views[i]);
+    tensor_free(batch_view);
+    free(x);
+    free(y);
+    axiom_free(net);
+    return rc;
+}
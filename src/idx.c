@@ -0,0 +1,75 @@
+#define _POSIX_C_SOURCE 200809L
+#include "idx.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static uint32_t be32(const uint8_t* b) {
+    return (uint32_t)b[0] << 24 | (uint32_t)b[1] << 16 |
+           (uint32_t)b[2] << 8  | (uint32_t)b[3];
+}
+
+IdxFile* idx_open(const char* path) {
+    if (path == NULL) return NULL;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 4) {
+        close(fd);
+        return NULL;
+    }
+    size_t size = (size_t)st.st_size;
+
+    void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // the mapping keeps the file alive
+    if (map == MAP_FAILED) return NULL;
+
+    // magic: two zero bytes, element type, number of dims; then one big-endian u32 per dim
+    const uint8_t* bytes = map;
+    size_t ndim = bytes[3];
+    size_t header = 4 + 4 * ndim;
+    if (bytes[0] != 0 || bytes[1] != 0 || bytes[2] != IDX_TYPE_UBYTE ||
+        ndim == 0 || ndim > IDX_MAX_DIMS || size < header) {
+        munmap(map, size);
+        return NULL;
+    }
+
+    IdxFile* f = malloc(sizeof(IdxFile));
+    if (f == NULL) {
+        munmap(map, size);
+        return NULL;
+    }
+    f->map = map;
+    f->map_size = size;
+    f->data = bytes + header;
+    f->ndim = ndim;
+    f->row_size = 1;
+    int overflow = 0;
+    for (size_t d = 0; d < ndim; d++) {
+        f->dims[d] = be32(bytes + 4 + 4 * d);
+        if (d == 0) continue;
+        // header dims are untrusted; a wrapped product would slip past the payload check
+        if (f->dims[d] != 0 && f->row_size > SIZE_MAX / f->dims[d]) overflow = 1;
+        else f->row_size *= f->dims[d];
+    }
+    f->rows = f->dims[0];
+    if (f->row_size != 0 && f->rows > SIZE_MAX / f->row_size) overflow = 1;
+
+    if (overflow || size - header < f->rows * f->row_size) {  // truncated payload
+        idx_close(f);
+        return NULL;
+    }
+
+    return f;
+}
+
+void idx_close(IdxFile* f) {
+    if (f == NULL) return;
+    munmap(f->map, f->map_size);
+    free(f);
+}
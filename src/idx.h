@@ -0,0 +1,32 @@
+#ifndef IDX_H
+#define IDX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define IDX_MAX_DIMS 8
+#define IDX_TYPE_UBYTE 0x08
+
+/**
+ * Read-only memory map of an IDX file (the MNIST container format).
+ *
+ * The header is parsed and `data` points straight at the payload inside the
+ * mapping, so nothing is copied or converted up front; pages are read in by
+ * the kernel as rows are touched and shared with any other process mapping
+ * the same file. Only unsigned-byte payloads (type 0x08) are supported.
+ */
+typedef struct {
+    void* map;
+    size_t map_size;
+    const uint8_t* data;        // payload, rows * row_size bytes
+    size_t ndim;
+    size_t dims[IDX_MAX_DIMS];
+    size_t rows;                // dims[0]
+    size_t row_size;            // product of the remaining dims (1 for label files)
+} IdxFile;
+
+// Returns NULL if the file can't be opened or mapped, or isn't a well-formed ubyte IDX file
+IdxFile* idx_open(const char* path);
+void idx_close(IdxFile* f);
+
+#endif // IDX_H
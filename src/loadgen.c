@@ -0,0 +1,172 @@
+#define _POSIX_C_SOURCE 200809L
+#include "loadgen.h"
+#include "serve.h"
+#include "timer.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+typedef struct {
+    const LoadgenConfig* cfg;
+    size_t count;           // requests this client sends
+    unsigned int seed;
+    double* latencies_us;   // this client's slice of the shared array
+    size_t completed;
+    size_t errors;
+    double batch_sum;
+    double queue_us_sum;
+    int connect_failed;
+} Client;
+
+static int connect_to(const char* path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof addr.sun_path) return -1;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof addr) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void* client_main(void* arg) {
+    Client* c = arg;
+    size_t nf = c->cfg->num_features;
+
+    int fd = connect_to(c->cfg->socket_path);
+    if (fd < 0) {
+        c->connect_failed = 1;
+        return NULL;
+    }
+
+    float* features = malloc(nf * sizeof(float));
+    float* outputs = NULL;
+    size_t outputs_cap = 0;
+    if (features == NULL) {
+        close(fd);
+        c->connect_failed = 1;
+        return NULL;
+    }
+
+    for (size_t i = 0; i < c->count; i++) {
+        for (size_t f = 0; f < nf; f++) {
+            c->seed = c->seed * 1103515245u + 12345u;  // cheap lcg; only has to look like pixels
+            features[f] = (float)((c->seed >> 16) & 0xff) / 255.0f;
+        }
+
+        ServeRequestHeader req = {SERVE_REQUEST_MAGIC, (uint32_t)i, (uint32_t)nf, 0};
+        ServeResponseHeader res;
+        uint64_t start = timer_now_ns();
+        if (serve_write_full(fd, &req, sizeof req) != 0 ||
+            serve_write_full(fd, features, nf * sizeof(float)) != 0 ||
+            serve_read_full(fd, &res, sizeof res) != 0) {
+            c->errors += c->count - i;
+            break;
+        }
+        if (res.num_outputs > outputs_cap) {
+            float* grown = realloc(outputs, res.num_outputs * sizeof(float));
+            if (grown == NULL) {
+                c->errors += c->count - i;
+                break;
+            }
+            outputs = grown;
+            outputs_cap = res.num_outputs;
+        }
+        if (res.num_outputs > 0 && serve_read_full(fd, outputs, res.num_outputs * sizeof(float)) != 0) {
+            c->errors += c->count - i;
+            break;
+        }
+        double latency_us = (double)(timer_now_ns() - start) / 1e3;
+
+        if (res.magic != SERVE_RESPONSE_MAGIC || res.status != SERVE_OK || res.id != (uint32_t)i) {
+            c->errors++;
+            continue;
+        }
+        c->latencies_us[c->completed++] = latency_us;
+        c->batch_sum += res.batch_size;
+        c->queue_us_sum += (double)res.queue_ns / 1e3;
+    }
+
+    free(features);
+    free(outputs);
+    close(fd);
+    return NULL;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+int loadgen_run(const LoadgenConfig* cfg, LoadgenResult* result) {
+    if (cfg == NULL || result == NULL || cfg->clients == 0) return -1;
+    memset(result, 0, sizeof *result);
+
+    Client* clients = calloc(cfg->clients, sizeof(Client));
+    pthread_t* threads = calloc(cfg->clients, sizeof(pthread_t));
+    double* latencies = malloc((cfg->requests + 1) * sizeof(double));
+    if (clients == NULL || threads == NULL || latencies == NULL) {
+        free(clients);
+        free(threads);
+        free(latencies);
+        return -1;
+    }
+
+    // split the requests evenly; each client records into its own slice of latencies
+    size_t offset = 0;
+    for (size_t i = 0; i < cfg->clients; i++) {
+        clients[i].cfg = cfg;
+        clients[i].count = cfg->requests / cfg->clients + (i < cfg->requests % cfg->clients ? 1 : 0);
+        clients[i].seed = 1234u + (unsigned int)i;
+        clients[i].latencies_us = latencies + offset;
+        offset += clients[i].count;
+    }
+
+    uint64_t start = timer_now_ns();
+    size_t started = 0;
+    for (; started < cfg->clients; started++) {
+        if (pthread_create(&threads[started], NULL, client_main, &clients[started]) != 0) break;
+    }
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    result->seconds = (double)(timer_now_ns() - start) / 1e9;
+
+    // gather the slices into one sorted array for percentiles
+    int failed = (started < cfg->clients);
+    size_t n = 0;
+    double batch_sum = 0.0, queue_sum = 0.0;
+    for (size_t i = 0; i < started; i++) {
+        Client* c = &clients[i];
+        if (c->connect_failed) failed = 1;
+        memmove(latencies + n, c->latencies_us, c->completed * sizeof(double));
+        n += c->completed;
+        result->errors += c->errors;
+        batch_sum += c->batch_sum;
+        queue_sum += c->queue_us_sum;
+    }
+    qsort(latencies, n, sizeof(double), compare_double);
+
+    result->completed = n;
+    if (n > 0) {
+        result->throughput = (double)n / result->seconds;
+        result->p50_us = latencies[(n - 1) / 2];
+        result->p99_us = latencies[(size_t)((double)(n - 1) * 0.99)];
+        result->mean_batch = batch_sum / (double)n;
+        result->mean_queue_us = queue_sum / (double)n;
+    }
+
+    free(clients);
+    free(threads);
+    free(latencies);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,32 @@
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#include <stddef.h>
+
+/**
+ * Closed-loop load generator for the inference server: `clients` connections,
+ * each sending one random sample at a time and waiting for its answer, until
+ * `requests` have been answered in total.
+ */
+typedef struct {
+    const char* socket_path;
+    size_t clients;
+    size_t requests;
+    size_t num_features;
+} LoadgenConfig;
+
+typedef struct {
+    size_t completed;
+    size_t errors;
+    double seconds;
+    double throughput;      // requests / second
+    double p50_us;          // end-to-end latency seen by the client
+    double p99_us;
+    double mean_batch;      // average batch size reported by the server
+    double mean_queue_us;   // average time requests waited for a batch
+} LoadgenResult;
+
+// Returns 0 if every client could connect
+int loadgen_run(const LoadgenConfig* cfg, LoadgenResult* result);
+
+#endif // LOADGEN_H
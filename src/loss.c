@@ -38,6 +38,40 @@ Tensor* loss_cross_entropy_grad(const Tensor* predictions, const Tensor* targets
     return grad;
 }
 
+float loss_cross_entropy_index(const Tensor* predictions, const int32_t* labels) {
+    if (predictions == NULL || labels == NULL || predictions->ndim != 2) return 0.0f;
+    size_t rows = predictions->shape[0], classes = predictions->shape[1];
+
+    float loss = 0.0;
+    float epsilon = 1e-7f;
+    for (size_t i = 0; i < rows; i++) {
+        if (labels[i] < 0 || (size_t)labels[i] >= classes) continue;
+        float p = predictions->data[i * predictions->strides[0] + (size_t)labels[i] * predictions->strides[1]];
+        float clipped = p < epsilon ? epsilon : p > 1.0f - epsilon ? 1.0f - epsilon : p;
+        loss += -log(clipped);
+    }
+    return loss / (float)rows;
+}
+
+Tensor* loss_cross_entropy_index_grad(const Tensor* predictions, const int32_t* labels) {
+    if (predictions == NULL || labels == NULL || predictions->ndim != 2) return NULL;
+    size_t rows = predictions->shape[0], classes = predictions->shape[1];
+
+    Tensor* grad = tensor_create(predictions->shape, 2);
+    if (grad == NULL) return NULL;
+
+    // (p - t) / batch as the one-hot version computes it, so both give the same bits
+    for (size_t i = 0; i < rows; i++) {
+        float* g = grad->data + i * classes;
+        const float* p = predictions->data + i * predictions->strides[0];
+        for (size_t j = 0; j < classes; j++) g[j] = p[j * predictions->strides[1]] / (float)rows;
+        if (labels[i] >= 0 && (size_t)labels[i] < classes) {
+            g[labels[i]] = (p[(size_t)labels[i] * predictions->strides[1]] - 1.0f) / (float)rows;
+        }
+    }
+    return grad;
+}
+
 float loss_mse(const Tensor* predictions, const Tensor* targets) {
     if (predictions == NULL || targets == NULL) return 0.0f;
     if (predictions->ndim != targets->ndim) return 0.0f;
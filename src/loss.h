@@ -1,12 +1,21 @@
 #ifndef LOSS_H
 #define LOSS_H
 
+#include <stdint.h>
 #include "tensor.h"
 
 // Cross-entropy loss for classification
 float loss_cross_entropy(const Tensor* predictions, const Tensor* targets);
 Tensor* loss_cross_entropy_grad(const Tensor* predictions, const Tensor* targets);
 
+// Same, with targets given as one class id per row of predictions instead of
+// one-hot rows. The loss reads only each row's target probability; the
+// gradient is (predictions - one_hot) / batch, built without the one-hot.
+// A label of -1 (or any id out of range) is a row with no target, like an
+// all-zero one-hot row.
+float loss_cross_entropy_index(const Tensor* predictions, const int32_t* labels);
+Tensor* loss_cross_entropy_index_grad(const Tensor* predictions, const int32_t* labels);
+
 // Mean Squared Error for regression
 float loss_mse(const Tensor* predictions, const Tensor* targets);
 Tensor* loss_mse_grad(const Tensor* predictions, const Tensor* targets);
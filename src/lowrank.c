@@ -0,0 +1,215 @@
+#include "lowrank.h"
+#include "svd.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static LowRankLayer* lowrank_alloc(size_t input_size, size_t output_size, size_t rank) {
+    LowRankLayer* layer = calloc(1, sizeof(LowRankLayer));
+    if (layer == NULL) return NULL;
+    layer->input_size = input_size;
+    layer->output_size = output_size;
+    layer->rank = rank;
+    return layer;
+}
+
+LowRankLayer* lowrank_create(size_t input_size, size_t output_size, size_t rank) {
+    if (rank == 0) return NULL;
+    LowRankLayer* layer = lowrank_alloc(input_size, output_size, rank);
+    if (layer == NULL) return NULL;
+
+    size_t u_shape[] = {input_size, rank};
+    size_t v_shape[] = {rank, output_size};
+    size_t biases_shape[] = {output_size};
+    MemCategory prev = mem_set_category(MEM_PARAMS);
+    layer->u = tensor_create(u_shape, 2);
+    layer->v = tensor_create(v_shape, 2);
+    layer->biases = tensor_create(biases_shape, 1);
+    mem_set_category(prev);
+    if (layer->u == NULL || layer->v == NULL || layer->biases == NULL) {
+        lowrank_free(layer);
+        return NULL;
+    }
+
+    // uniform(-a, a) factors give products with the variance of dense_create's uniform(-0.1, 0.1):
+    // rank * (a^2 / 3)^2 = 0.01 / 3
+    float a = (float)pow(0.03 / (double)rank, 0.25);
+    tensor_rand(layer->u, -a, a, 42);
+    tensor_rand(layer->v, -a, a, 43);
+    tensor_fill(layer->biases, 0.0f);
+    return layer;
+}
+
+LowRankLayer* lowrank_create_view(size_t input_size, size_t output_size, size_t rank,
+                                  float* u, float* v, float* biases) {
+    if (u == NULL || v == NULL || biases == NULL || rank == 0) return NULL;
+    LowRankLayer* layer = lowrank_alloc(input_size, output_size, rank);
+    if (layer == NULL) return NULL;
+
+    size_t u_shape[] = {input_size, rank};
+    size_t v_shape[] = {rank, output_size};
+    size_t biases_shape[] = {output_size};
+    MemCategory prev = mem_set_category(MEM_PARAMS);
+    layer->u = tensor_view(u, u_shape, 2);
+    layer->v = tensor_view(v, v_shape, 2);
+    layer->biases = tensor_view(biases, biases_shape, 1);
+    mem_set_category(prev);
+    if (layer->u == NULL || layer->v == NULL || layer->biases == NULL) {
+        lowrank_free(layer);
+        return NULL;
+    }
+    return layer;
+}
+
+void lowrank_free(LowRankLayer* layer) {
+    if (layer == NULL) return;
+    tensor_free(layer->u);
+    tensor_free(layer->v);
+    tensor_free(layer->biases);
+    tensor_free(layer->grad_u);
+    tensor_free(layer->grad_v);
+    tensor_free(layer->grad_biases);
+    tensor_free(layer->input_cache);
+    tensor_free(layer->hidden_cache);
+    free(layer);
+}
+
+Tensor* lowrank_forward(LowRankLayer* layer, const Tensor* input) {
+    if (layer == NULL || input == NULL) return NULL;
+    if (input->ndim != 2 || input->shape[1] != layer->input_size) return NULL;
+
+    MemCategory prev = mem_set_category(MEM_ACTIVATIONS);
+    Tensor* hidden = tensor_matmul(input, layer->u);
+    mem_set_category(prev);
+    if (hidden == NULL) return NULL;
+
+    Tensor* output = tensor_matmul(hidden, layer->v);
+    Tensor* b = output != NULL ? tensor_broadcast(layer->biases, output->shape, output->ndim) : NULL;
+    Tensor* result = b != NULL ? tensor_add(output, b) : NULL;
+    tensor_free(output);
+    tensor_free(b);
+    if (result == NULL) {
+        tensor_free(hidden);
+        return NULL;
+    }
+
+    tensor_free(layer->input_cache);
+    tensor_free(layer->hidden_cache);
+    prev = mem_set_category(MEM_ACTIVATIONS);
+    layer->input_cache = tensor_copy(input);
+    mem_set_category(prev);
+    layer->hidden_cache = hidden;
+    return result;
+}
+
+// a = x^T y, written into *grad (allocated on first use, in place after so arena views stay put)
+static int grad_product(Tensor** grad, const Tensor* x, const Tensor* y) {
+    Tensor* xt = tensor_transpose(x);
+    Tensor* product = xt != NULL ? tensor_matmul(xt, y) : NULL;
+    tensor_free(xt);
+    if (product == NULL) return -1;
+
+    if (*grad == NULL) {
+        MemCategory prev = mem_set_category(MEM_GRADS);
+        *grad = tensor_create(product->shape, product->ndim);
+        mem_set_category(prev);
+    }
+    if (*grad == NULL || (*grad)->size != product->size) {
+        tensor_free(product);
+        return -1;
+    }
+    memcpy((*grad)->data, product->data, product->size * sizeof(float));
+    tensor_free(product);
+    return 0;
+}
+
+// x w^T
+static Tensor* matmul_transposed(const Tensor* x, const Tensor* w) {
+    Tensor* wt = tensor_transpose(w);
+    if (wt == NULL) return NULL;
+    Tensor* result = tensor_matmul(x, wt);
+    tensor_free(wt);
+    return result;
+}
+
+Tensor* lowrank_backward(LowRankLayer* layer, const Tensor* grad_output) {
+    if (layer == NULL || grad_output == NULL) return NULL;
+    if (grad_output->ndim != 2 || grad_output->shape[1] != layer->output_size) return NULL;
+    if (layer->input_cache == NULL || layer->hidden_cache == NULL) return NULL;
+
+    // out = h V + b with h = x U: dV = h^T dY, db = column sums of dY, dh = dY V^T, dU = x^T dh, dx = dh U^T
+    if (grad_product(&layer->grad_v, layer->hidden_cache, grad_output) != 0) return NULL;
+
+    if (layer->grad_biases == NULL) {
+        size_t biases_shape[] = {layer->output_size};
+        MemCategory prev = mem_set_category(MEM_GRADS);
+        layer->grad_biases = tensor_create(biases_shape, 1);
+        mem_set_category(prev);
+        if (layer->grad_biases == NULL) return NULL;
+    }
+    for (size_t j = 0; j < layer->output_size; j++) {
+        float sum = 0.0f;
+        for (size_t i = 0; i < grad_output->shape[0]; i++) {
+            sum += grad_output->data[i * grad_output->strides[0] + j * grad_output->strides[1]];
+        }
+        layer->grad_biases->data[j] = sum;
+    }
+
+    Tensor* grad_hidden = matmul_transposed(grad_output, layer->v);
+    if (grad_hidden == NULL) return NULL;
+    if (grad_product(&layer->grad_u, layer->input_cache, grad_hidden) != 0) {
+        tensor_free(grad_hidden);
+        return NULL;
+    }
+    Tensor* grad_input = matmul_transposed(grad_hidden, layer->u);
+    tensor_free(grad_hidden);
+    return grad_input;
+}
+
+size_t lowrank_rank_for_energy(const float* s, size_t n, float energy) {
+    double total = 0.0;
+    for (size_t i = 0; i < n; i++) total += (double)s[i] * s[i];
+    if (total == 0.0 || energy >= 1.0f) return n;
+
+    double kept = 0.0;
+    for (size_t r = 0; r < n; r++) {
+        kept += (double)s[r] * s[r];
+        if (kept >= (double)energy * total) return r + 1;
+    }
+    return n;
+}
+
+LowRankLayer* lowrank_from_dense(const DenseLayer* dense, size_t rank, float energy, float* s) {
+    if (dense == NULL) return NULL;
+    size_t in = dense->input_size, out = dense->output_size;
+    size_t k = in < out ? in : out;
+
+    float* u = malloc(in * k * sizeof(float));
+    float* sv = malloc(k * sizeof(float));
+    float* vt = malloc(k * out * sizeof(float));
+    if (u == NULL || sv == NULL || vt == NULL || svd_jacobi(dense->weights->data, in, out, u, sv, vt) != 0) {
+        free(u);
+        free(sv);
+        free(vt);
+        return NULL;
+    }
+    if (s != NULL) memcpy(s, sv, k * sizeof(float));
+
+    if (rank == 0) rank = lowrank_rank_for_energy(sv, k, energy);
+    if (rank > k) rank = k;
+    if (rank == 0) rank = 1;
+
+    LowRankLayer* layer = lowrank_create(in, out, rank);
+    if (layer != NULL) {
+        for (size_t r = 0; r < rank; r++) {
+            float root = sqrtf(sv[r]);
+            for (size_t i = 0; i < in; i++) layer->u->data[i * rank + r] = u[i * k + r] * root;
+            for (size_t j = 0; j < out; j++) layer->v->data[r * out + j] = vt[r * out + j] * root;
+        }
+        memcpy(layer->biases->data, dense->biases->data, out * sizeof(float));
+    }
+    free(u);
+    free(sv);
+    free(vt);
+    return layer;
+}
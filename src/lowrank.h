@@ -0,0 +1,56 @@
+#ifndef LOWRANK_H
+#define LOWRANK_H
+
+#include "dense.h"
+#include "tensor.h"
+
+/**
+ * Dense layer with its weight matrix factored as W = U V, U [input_size, rank]
+ * and V [rank, output_size]: out = (x U) V + b. A row costs
+ * 2 rank (input_size + output_size) flops instead of 2 input_size output_size,
+ * and the layer stores that many fewer weights. U, V and the bias are all
+ * trained; in the parameter arena they sit back to back as [u | v | biases].
+ */
+typedef struct {
+    Tensor* u;
+    Tensor* v;
+    Tensor* biases;
+    Tensor* grad_u;
+    Tensor* grad_v;
+    Tensor* grad_biases;
+    Tensor* input_cache;    // x, for grad_u
+    Tensor* hidden_cache;   // x U, for grad_v
+    size_t input_size;
+    size_t output_size;
+    size_t rank;
+    size_t param_offset;    // where u starts in the network's ParamArena (v and biases follow)
+    size_t param_count;     // floats this layer spans in the arena, padding included
+} LowRankLayer;
+
+LowRankLayer* lowrank_create(size_t input_size, size_t output_size, size_t rank);
+
+// Layer over existing u ([input_size, rank]), v ([rank, output_size]) and biases, e.g. a mapped checkpoint
+LowRankLayer* lowrank_create_view(size_t input_size, size_t output_size, size_t rank,
+                                  float* u, float* v, float* biases);
+
+void lowrank_free(LowRankLayer* layer);
+
+Tensor* lowrank_forward(LowRankLayer* layer, const Tensor* input);
+
+// Fills grad_u, grad_v and grad_biases and returns the gradient w.r.t. the input
+Tensor* lowrank_backward(LowRankLayer* layer, const Tensor* grad_output);
+
+// Smallest rank whose singular values keep `energy` (0..1] of sum(s^2); s is descending
+size_t lowrank_rank_for_energy(const float* s, size_t n, float energy);
+
+/**
+ * Truncated SVD of a dense layer: W ~= U_r diag(s_r) V_r^T, with sqrt(s_r) folded
+ * into each factor and the bias copied. The rank is `rank` if nonzero (clamped to
+ * min(input_size, output_size)), otherwise the smallest that keeps `energy` of
+ * sum(s^2). If `s` isn't NULL it receives all min(input_size, output_size)
+ * singular values, descending, for reporting the truncation error.
+ * Returns NULL on out of memory.
+ */
+LowRankLayer* lowrank_from_dense(const DenseLayer* dense, size_t rank, float energy, float* s);
+
+#endif // LOWRANK_H
@@ -1,11 +1,653 @@
+#define _DEFAULT_SOURCE  /* getline, open */
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include "autotune.h"
 #include "axiom.h"
 #include "mnist.h"
+#include "chunked.h"
+#include "checkpoint.h"
+#include "export.h"
+#include "loss.h"
+#include "parallel.h"
+#include "predict.h"
+#include "reduce.h"
+#include "rng.h"
+#include "serve.h"
+#include "stream.h"
+#include "sweep.h"
+#include "timer.h"
+
+/* Train briefly with Adam, save, load: step count and moment buffers must come back unchanged. */
+static void check_optimizer_roundtrip(Tensor* x_train, Tensor* y_train) {
+    printf("Verifying optimizer state save/load ...\n");
+    AxiomNet* net = axiom_create();
+    if (!net) {
+        printf("FAIL: axiom_create\n");
+        return;
+    }
+    axiom_add(net, axiom_layer_dense(4, 4), LAYER_DENSE);
+    axiom_add(net, axiom_activation_relu(), LAYER_ACTIVATION);
+    axiom_add(net, axiom_layer_dense(4, 2), LAYER_DENSE);
+    axiom_add(net, axiom_activation_softmax(), LAYER_ACTIVATION);
+    axiom_set_optimizer(net, optimizer_adam_create(0.01f, 0.9f, 0.999f, 1e-8f));
+    axiom_train(net, x_train, y_train, 5, 0.01f, 2);
+
+    const char* ckpt = "build/smoke_optimizer.bin";
+    axiom_save(net, ckpt);
+    AxiomNet* loaded = axiom_load(ckpt);
+    if (!loaded || !loaded->optimizer || !loaded->params) {
+        printf("FAIL: optimizer save/load (no optimizer state after load)\n");
+        axiom_free(net);
+        axiom_free(loaded);
+        return;
+    }
+
+    ParamArena* a = net->params;
+    ParamArena* b = loaded->params;
+    int ok = loaded->optimizer->type == OPTIMIZER_ADAM &&
+             loaded->optimizer->t == net->optimizer->t &&
+             a->size == b->size && b->num_state == 2;
+    for (size_t s = 0; ok && s < 2; s++) {
+        ok = memcmp(a->state[s], b->state[s], a->size * sizeof(float)) == 0;
+    }
+    if (ok) {
+        ok = memcmp(a->params, b->params, a->size * sizeof(float)) == 0;
+    }
+    printf(ok ? "PASS: optimizer save/load (step %zu, moments match)\n"
+              : "FAIL: optimizer save/load (step %zu, state differs)\n", net->optimizer->t);
+
+    axiom_free(net);
+    axiom_free(loaded);
+}
+
+/* Driving axiom_backward by hand with momentum must build the arena and keep velocity, not fall back
+ * to plain SGD; an optimizer that isn't the net's has nowhere to keep state and is refused. */
+static void check_manual_backward(Tensor* x_train, Tensor* y_train) {
+    printf("Verifying manual backward with a stateful optimizer ...\n");
+    AxiomNet* net = axiom_create();
+    Optimizer* other = optimizer_adam_create(0.01f, 0.9f, 0.999f, 1e-8f);
+    if (!net || !other) {
+        printf("FAIL: manual backward setup\n");
+        axiom_free(net);
+        optimizer_free(other);
+        return;
+    }
+    axiom_add(net, axiom_layer_dense(4, 4), LAYER_DENSE);
+    axiom_add(net, axiom_activation_relu(), LAYER_ACTIVATION);
+    axiom_add(net, axiom_layer_dense(4, 2), LAYER_DENSE);
+    axiom_add(net, axiom_activation_softmax(), LAYER_ACTIVATION);
+    axiom_set_optimizer(net, optimizer_momentum_create(0.05f, 0.9f));
+
+    int stepped = 1;
+    for (int step = 0; step < 2; step++) {
+        Tensor* pred = axiom_forward(net, x_train);
+        Tensor* grad = pred ? loss_cross_entropy_grad(pred, y_train) : NULL;
+        Tensor* grad_in = grad ? axiom_backward(net, grad, net->optimizer) : NULL;
+        stepped &= grad_in != NULL;
+        tensor_free(pred);
+        tensor_free(grad);
+        tensor_free(grad_in);
+    }
+    size_t moving = 0;
+    ParamArena* arena = net->params;
+    int ok = stepped && arena != NULL && net->optimizer->arena == arena && arena->num_state == 1;
+    for (size_t i = 0; ok && i < arena->size; i++) moving += arena->state[0][i] != 0.0f;
+
+    Tensor* pred = axiom_forward(net, x_train);
+    Tensor* grad = pred ? loss_cross_entropy_grad(pred, y_train) : NULL;
+    Tensor* refused = grad ? axiom_backward(net, grad, other) : NULL;
+    ok = ok && moving > 0 && grad != NULL && refused == NULL;
+    printf("%s: manual backward (%zu velocity entries moving, foreign optimizer %s)\n",
+           ok ? "PASS" : "FAIL", moving, refused == NULL ? "refused" : "accepted");
+
+    tensor_free(pred);
+    tensor_free(grad);
+    tensor_free(refused);
+    optimizer_free(other);
+    axiom_free(net);
+}
+
+/* Low-rank layers: SVD at full rank reproduces W, and a net with one trains, saves and loads like a dense one. */
+static void check_lowrank(Tensor* x_train, Tensor* y_train) {
+    printf("Verifying low-rank layers ...\n");
+    DenseLayer* d = axiom_layer_dense(6, 4);
+    LowRankLayer* f = d ? lowrank_from_dense(d, 4, 1.0f, NULL) : NULL;
+    float max_err = f ? 0.0f : 1.0f;
+    for (size_t i = 0; f && i < 6; i++) {
+        for (size_t j = 0; j < 4; j++) {
+            float w = 0.0f;
+            for (size_t r = 0; r < f->rank; r++) w += f->u->data[i * f->rank + r] * f->v->data[r * 4 + j];
+            float err = w - d->weights->data[i * 4 + j];
+            if (err < 0.0f) err = -err;
+            if (err > max_err) max_err = err;
+        }
+    }
+    printf(max_err < 1e-5f ? "PASS: svd reconstruction (max error %.2e)\n"
+                           : "FAIL: svd reconstruction (max error %.2e)\n", (double)max_err);
+    dense_free(d);
+    lowrank_free(f);
+
+    AxiomNet* net = axiom_create();
+    if (!net) {
+        printf("FAIL: axiom_create\n");
+        return;
+    }
+    axiom_add(net, axiom_layer_dense_lowrank(4, 4, 2), LAYER_DENSE_LOWRANK);
+    axiom_add(net, axiom_activation_relu(), LAYER_ACTIVATION);
+    axiom_add(net, axiom_layer_dense(4, 2), LAYER_DENSE);
+    axiom_add(net, axiom_activation_softmax(), LAYER_ACTIVATION);
+    axiom_set_optimizer(net, optimizer_adam_create(0.01f, 0.9f, 0.999f, 1e-8f));
+    axiom_train(net, x_train, y_train, 5, 0.01f, 2);
+
+    const char* ckpt = "build/smoke_lowrank.bin";
+    axiom_save(net, ckpt);
+    AxiomNet* loaded = axiom_load(ckpt);
+    Tensor* a = axiom_forward(net, x_train);
+    Tensor* b = loaded ? axiom_forward(loaded, x_train) : NULL;
+    int ok = a != NULL && b != NULL && a->size == b->size &&
+             memcmp(a->data, b->data, a->size * sizeof(float)) == 0 &&
+             loaded->params->size == net->params->size &&
+             memcmp(loaded->params->state[1], net->params->state[1], net->params->size * sizeof(float)) == 0;
+    printf("%s: low-rank train/save/load (predictions and moments %s)\n", ok ? "PASS" : "FAIL", ok ? "match" : "differ");
+    tensor_free(a);
+    tensor_free(b);
+    axiom_free(net);
+    axiom_free(loaded);
+}
+
+/* Embedding: a step only moves the rows the batch used (Adam included), and the table survives save/load. */
+static void check_embedding(const Tensor* y_train) {
+    printf("Verifying embedding layer ...\n");
+    const size_t vocab = 50, dim = 3, fields = 2;
+    size_t x_shape[] = {4, fields};
+    Tensor* ids = tensor_create(x_shape, 2);
+    AxiomNet* net = axiom_create();
+    if (!ids || !net) {
+        printf("FAIL: embedding setup\n");
+        tensor_free(ids);
+        axiom_free(net);
+        return;
+    }
+    const float used[] = {3, 17, 3, 41, 9, 17, 29, 9};  /* five distinct rows, some repeated */
+    memcpy(ids->data, used, sizeof used);
+    axiom_add(net, axiom_layer_embedding(vocab, dim, fields), LAYER_EMBEDDING);
+    axiom_add(net, axiom_layer_dense(fields * dim, 2), LAYER_DENSE);
+    axiom_add(net, axiom_activation_softmax(), LAYER_ACTIVATION);
+    axiom_set_optimizer(net, optimizer_adam_create(0.05f, 0.9f, 0.999f, 1e-8f));
+    axiom_params_build(net);
+
+    EmbeddingLayer* emb = net->layers->layer.embedding;
+    float* before = malloc(vocab * dim * sizeof(float));
+    if (before) memcpy(before, emb->table->data, vocab * dim * sizeof(float));
+    axiom_train(net, ids, (Tensor*)y_train, 5, 0.05f, 2);
+
+    size_t moved = 0, stray = 0;
+    for (size_t r = 0; before && r < vocab; r++) {
+        int touched = memcmp(before + r * dim, emb->table->data + r * dim, dim * sizeof(float)) != 0;
+        int is_used = 0;
+        for (size_t i = 0; i < sizeof used / sizeof used[0]; i++) is_used |= (size_t)used[i] == r;
+        moved += touched && is_used;
+        stray += touched && !is_used;
+    }
+    printf("%s: sparse embedding update (%zu of 5 used rows moved, %zu others)\n",
+           before && moved == 5 && stray == 0 ? "PASS" : "FAIL", moved, stray);
+
+    const char* ckpt = "build/smoke_embedding.bin";
+    axiom_save(net, ckpt);
+    AxiomNet* loaded = axiom_load_mapped(ckpt, 1);
+    Tensor* a = axiom_forward(net, ids);
+    Tensor* b = loaded ? axiom_forward(loaded, ids) : NULL;
+    int ok = a && b && a->size == b->size && memcmp(a->data, b->data, a->size * sizeof(float)) == 0;
+    printf("%s: embedding save/load (predictions %s)\n", ok ? "PASS" : "FAIL", ok ? "match" : "differ");
+
+    /* past 2^24 neighbouring IDs share a float, so such a table is refused rather than aliased */
+    EmbeddingLayer* too_big = axiom_layer_embedding((size_t)EMBEDDING_MAX_VOCAB + 1, 1, 1);
+    printf("%s: embedding vocabulary capped at 2^24 rows\n", too_big == NULL ? "PASS" : "FAIL");
+    embedding_free(too_big);
+
+    free(before);
+    tensor_free(a);
+    tensor_free(b);
+    tensor_free(ids);
+    axiom_free(net);
+    axiom_free(loaded);
+}
+
+static AxiomNet* small_net(void) {
+    AxiomNet* net = axiom_create();
+    if (!net) return NULL;
+    axiom_add(net, axiom_layer_dense(4, 4), LAYER_DENSE);
+    axiom_add(net, axiom_activation_relu(), LAYER_ACTIVATION);
+    axiom_add(net, axiom_layer_dense(4, 2), LAYER_DENSE);
+    axiom_add(net, axiom_activation_softmax(), LAYER_ACTIVATION);
+    return net;
+}
+
+/* A step that can't run (here: rows narrower than the first layer) stops training with an error, not silently. */
+static void check_train_failure(void) {
+    printf("Verifying failed training steps are reported ...\n");
+    AxiomNet* net = small_net();
+    size_t shape[] = {4, 3};
+    size_t y_shape[] = {4, 2};
+    Tensor* x = tensor_create(shape, 2);
+    Tensor* y = tensor_create(y_shape, 2);
+    if (!net || !x || !y) {
+        printf("FAIL: failed-step setup\n");
+    } else {
+        tensor_fill(x, 0.5f);
+        tensor_fill(y, 0.0f);
+        for (size_t i = 0; i < 4; i++) y->data[i * 2] = 1.0f;
+        int rc = axiom_train(net, x, y, 2, 0.05f, 2);
+        printf("%s: failed training step reported (axiom_train returned %d after %zu epochs)\n",
+               rc != 0 && net->epochs_trained == 0 ? "PASS" : "FAIL", rc, net->epochs_trained);
+    }
+    tensor_free(x);
+    tensor_free(y);
+    axiom_free(net);
+}
+
+/* Class-id labels: training and evaluation must give the same bits as the one-hot rows they stand for. */
+static void check_class_labels(Tensor* x_train, Tensor* y_train) {
+    printf("Verifying class-index labels ...\n");
+    int32_t ids[4];
+    for (size_t i = 0; i < 4; i++) ids[i] = y_train->data[i * 2 + 1] > y_train->data[i * 2] ? 1 : 0;
+    Dataset x = dataset_from_tensor(x_train);
+    Dataset onehot = dataset_from_tensor(y_train);
+    Dataset labels = dataset_from_labels(ids, 4, 2);
+
+    AxiomNet* a = small_net();
+    AxiomNet* b = small_net();
+    if (!a || !b) {
+        printf("FAIL: class-index labels setup\n");
+        axiom_free(a);
+        axiom_free(b);
+        return;
+    }
+    axiom_train_dataset(a, &x, &onehot, 5, 0.05f, 2);
+    axiom_train_dataset(b, &x, &labels, 5, 0.05f, 2);
+    Tensor* pa = axiom_forward(a, x_train);
+    Tensor* pb = axiom_forward(b, x_train);
+    int same = pa && pb && memcmp(pa->data, pb->data, pa->size * sizeof(float)) == 0;
+    printf("%s: class-index training (predictions %s one-hot training)\n",
+           same ? "PASS" : "FAIL", same ? "match" : "differ from");
+
+    AxiomEvalResult ra = {0}, rb = {0};
+    int eval_ok = axiom_evaluate(a, &x, &onehot, 2, &ra) == 0 && axiom_evaluate(a, &x, &labels, 2, &rb) == 0 &&
+                  ra.correct == rb.correct && ra.correct_topk == rb.correct_topk && ra.loss == rb.loss &&
+                  memcmp(ra.confusion, rb.confusion, 4 * sizeof(size_t)) == 0;
+    axiom_eval_result_free(&ra);
+    axiom_eval_result_free(&rb);
+    float la = pa ? loss_cross_entropy(pa, y_train) : 0.0f;
+    float lb = pa ? loss_cross_entropy_index(pa, ids) : 1.0f;
+    printf("%s: class-index evaluation and loss (%.6f vs %.6f)\n",
+           eval_ok && la == lb ? "PASS" : "FAIL", la, lb);
+
+    /* a last row with no label (id -1, all-zero one-hot) scores like the first three rows alone */
+    int32_t bad_ids[4] = {ids[0], ids[1], ids[2], -1};
+    size_t three_shape[] = {3, 4};
+    Tensor* x3 = tensor_view(x_train->data, three_shape, 2);
+    Tensor* y_bad = tensor_copy(y_train);
+    AxiomEvalResult r3 = {0}, ri = {0}, ro = {0};
+    int skip_ok = x3 && y_bad;
+    if (skip_ok) {
+        y_bad->data[6] = y_bad->data[7] = 0.0f;
+        Dataset xd3 = dataset_from_tensor(x3);
+        Dataset ids3 = dataset_from_labels(ids, 3, 2);
+        Dataset ids_bad = dataset_from_labels(bad_ids, 4, 2);
+        Dataset onehot_bad = dataset_from_tensor(y_bad);
+        skip_ok = axiom_evaluate(a, &xd3, &ids3, 2, &r3) == 0 && axiom_evaluate(a, &x, &ids_bad, 2, &ri) == 0 &&
+                  axiom_evaluate(a, &x, &onehot_bad, 2, &ro) == 0;
+        skip_ok = skip_ok && ri.samples == 3 && ri.skipped == 1 && ro.samples == 3 && ro.skipped == 1 &&
+                  ri.correct == r3.correct && ro.correct == r3.correct && ri.loss == r3.loss && ro.loss == r3.loss &&
+                  memcmp(ri.confusion, r3.confusion, 4 * sizeof(size_t)) == 0 &&
+                  memcmp(ro.confusion, r3.confusion, 4 * sizeof(size_t)) == 0;
+    }
+    printf("%s: unlabeled rows left out of evaluation (%zu scored, %zu skipped)\n",
+           skip_ok ? "PASS" : "FAIL", ri.samples, ri.skipped);
+    axiom_eval_result_free(&r3);
+    axiom_eval_result_free(&ri);
+    axiom_eval_result_free(&ro);
+    tensor_free(x3);
+    tensor_free(y_bad);
+
+    tensor_free(pa);
+    tensor_free(pb);
+    axiom_free(a);
+    axiom_free(b);
+}
+
+/* ReLU keeps one bit per element for backward: same gradients as testing the input, a 64x smaller cache. */
+static void check_relu_mask(void) {
+    printf("Verifying relu masks ...\n");
+    size_t shape[] = {3, 77};  /* 231 elements: three full mask words and a partial one */
+    Tensor* x = tensor_create(shape, 2);
+    Tensor* g = tensor_create(shape, 2);
+    Activation* act = activation_relu();
+    if (!x || !g || !act) {
+        printf("FAIL: relu mask setup\n");
+        tensor_free(x);
+        tensor_free(g);
+        activation_free(act);
+        return;
+    }
+    tensor_rand(x, -1.0f, 1.0f, 11);
+    tensor_rand(g, -1.0f, 1.0f, 12);
+    x->data[0] = 0.0f;
+    x->data[1] = -0.0f;
+    x->data[2] = NAN;
+    for (size_t i = 64; i < 128; i++) x->data[i] = 1.0f;  /* a word with every bit set */
+
+    MemStats before, after;
+    axiom_memory_stats(&before);
+    Tensor* y = activation_forward(act, x);
+    axiom_memory_stats(&after);
+    Tensor* gi = y ? activation_backward(act, g) : NULL;
+    int ok = y != NULL && gi != NULL;
+    for (size_t i = 0; ok && i < x->size; i++) {
+        int on = x->data[i] > 0.0f;
+        ok = y->data[i] == (on ? x->data[i] : 0.0f) && !signbit(y->data[i]) && gi->data[i] == (on ? g->data[i] : 0.0f);
+    }
+    size_t cache = after.category[MEM_ACTIVATIONS].live_bytes - before.category[MEM_ACTIVATIONS].live_bytes;
+    ok = ok && cache == 4 * sizeof(uint64_t);
+    printf("%s: relu mask (outputs and gradients match, %zu cache bytes for %zu floats)\n",
+           ok ? "PASS" : "FAIL", cache, x->size);
+    tensor_free(y);
+    tensor_free(gi);
+    tensor_free(x);
+    tensor_free(g);
+    activation_free(act);
+}
+
+/* Predictor: the packed batch-1 path gives axiom_forward's outputs, through padding, low-rank and embedding layers,
+ * without allocating. */
+static void check_predictor(void) {
+    printf("Verifying batch-1 predictor ...\n");
+    AxiomNet* nets[2] = { axiom_create(), axiom_create() };
+    if (!nets[0] || !nets[1]) {
+        printf("FAIL: axiom_create\n");
+        axiom_free(nets[0]);
+        axiom_free(nets[1]);
+        return;
+    }
+    /* widths that aren't multiples of a panel */
+    axiom_add(nets[0], axiom_layer_dense(37, 50), LAYER_DENSE);
+    axiom_add(nets[0], axiom_activation_relu(), LAYER_ACTIVATION);
+    axiom_add(nets[0], axiom_layer_dense_lowrank(50, 21, 5), LAYER_DENSE_LOWRANK);
+    axiom_add(nets[0], axiom_activation_relu(), LAYER_ACTIVATION);
+    axiom_add(nets[0], axiom_layer_dense(21, 3), LAYER_DENSE);
+    axiom_add(nets[0], axiom_activation_softmax(), LAYER_ACTIVATION);
+    axiom_add(nets[1], axiom_layer_embedding(20, 6, 3), LAYER_EMBEDDING);
+    axiom_add(nets[1], axiom_layer_dense(18, 5), LAYER_DENSE);
+    axiom_add(nets[1], axiom_activation_softmax(), LAYER_ACTIVATION);
+
+    size_t shapes[2][2] = { { 5, 37 }, { 5, 3 } };
+    float max_diff = 0.0f;
+    size_t allocs = 0;
+    int ok = 1;
+    for (int k = 0; k < 2 && ok; k++) {
+        Tensor* x = tensor_create(shapes[k], 2);
+        Predictor* p = predictor_create(nets[k]);
+        ok = x != NULL && p != NULL;
+        if (ok) {
+            tensor_rand(x, -1.0f, 1.0f, 7);
+            /* relu'd and blank inputs are skipped by the predictor, so include some */
+            for (size_t i = 0; i < x->size; i++) {
+                if (k == 0 && x->data[i] < 0.0f) x->data[i] = 0.0f;
+                if (k == 1) x->data[i] = (float)(i * 7 % 20);
+            }
+        }
+        Tensor* ref = ok ? axiom_forward(nets[k], x) : NULL;
+        float out[5];
+        ok = ref != NULL;
+        MemStats before, after;
+        axiom_memory_stats(&before);
+        for (size_t r = 0; ok && r < 5; r++) {
+            size_t cols = shapes[k][1], outs = predictor_num_outputs(p);
+            ok = predictor_run(p, x->data + r * cols, out) == 0;
+            for (size_t j = 0; ok && j < outs; j++) {
+                float d = fabsf(out[j] - ref->data[r * outs + j]);
+                if (d > max_diff) max_diff = d;
+            }
+        }
+        axiom_memory_stats(&after);
+        for (int c = 0; c < MEM_NUM_CATEGORIES; c++) allocs += after.category[c].allocs - before.category[c].allocs;
+        tensor_free(ref);
+        tensor_free(x);
+        predictor_free(p);
+    }
+    ok = ok && max_diff < 1e-5f && allocs == 0;
+    printf("%s: predictor matches axiom_forward (max difference %.2e, %zu allocations)\n",
+           ok ? "PASS" : "FAIL", (double)max_diff, allocs);
+    axiom_free(nets[0]);
+    axiom_free(nets[1]);
+}
+
+/* GEMM tilings: every depth block, row block and thread split gives tensor_matmul's bits exactly. */
+static void check_gemm_tilings(void) {
+    printf("Verifying GEMM tilings ...\n");
+    size_t a_shape[] = {13, 37}, b_shape[] = {37, 21};
+    Tensor* a = tensor_create(a_shape, 2);
+    Tensor* b = tensor_create(b_shape, 2);
+    float* packed = malloc(tensor_packed_size(37, 21) * sizeof(float));
+    Tensor* ref = NULL;
+    if (a && b && packed) {
+        tensor_rand(a, -1.0f, 1.0f, 21);
+        tensor_rand(b, -1.0f, 1.0f, 22);
+        tensor_pack_panels(b->data, 37, 21, 21, 1, packed);
+        ref = tensor_matmul(a, b);
+    }
+    static const size_t depths[] = {0, 8, 16, 36}, rows[] = {4, 8, 12}, threads[] = {1, 3};
+    size_t tried = 0, same = 0;
+    for (size_t d = 0; ref && d < 4; d++) {
+        for (size_t r = 0; r < 3; r++) {
+            for (size_t t = 0; t < 2; t++) {
+                GemmTiling tiling = { .kc = depths[d], .mc = rows[r], .threads = threads[t] };
+                Tensor* c = tensor_matmul_packed(a, packed, 21, &tiling);
+                tried++;
+                same += c && memcmp(c->data, ref->data, ref->size * sizeof(float)) == 0;
+                tensor_free(c);
+            }
+        }
+    }
+    printf("%s: GEMM tilings (%zu of %zu match tensor_matmul bit for bit)\n",
+           tried > 0 && same == tried ? "PASS" : "FAIL", same, tried);
+    tensor_free(ref);
+    tensor_free(a);
+    tensor_free(b);
+    free(packed);
+}
+
+static int files_identical(const char* path_a, const char* path_b) {
+    FILE* fa = fopen(path_a, "rb");
+    FILE* fb = fopen(path_b, "rb");
+    int same = fa != NULL && fb != NULL;
+    while (same) {
+        int ca = fgetc(fa), cb = fgetc(fb);
+        same = ca == cb;
+        if (ca == EOF) break;
+    }
+    if (fa) fclose(fa);
+    if (fb) fclose(fb);
+    return same;
+}
+
+/* Deterministic reductions: the same start trained on 1 and 4 threads, with and without the task graph,
+ * must save byte-identical checkpoints. */
+static void check_deterministic_training(void) {
+    printf("Verifying deterministic multithreaded training ...\n");
+    size_t x_shape[] = {96, 37}, y_shape[] = {96, 5};
+    Tensor* x = tensor_create(x_shape, 2);
+    Tensor* y = tensor_create(y_shape, 2);
+    AxiomNet* net = axiom_create();
+    if (!x || !y || !net) {
+        printf("FAIL: deterministic training setup\n");
+        tensor_free(x);
+        tensor_free(y);
+        axiom_free(net);
+        return;
+    }
+    tensor_rand(x, -1.0f, 1.0f, 31);
+    tensor_fill(y, 0.0f);
+    for (size_t i = 0; i < 96; i++) y->data[i * 5 + (size_t)(x->data[i * 37] * 2.0f + 2.5f)] = 1.0f;
+
+    axiom_add(net, axiom_layer_dense(37, 64), LAYER_DENSE);
+    axiom_add(net, axiom_activation_relu(), LAYER_ACTIVATION);
+    axiom_add(net, axiom_layer_dense(64, 5), LAYER_DENSE);
+    axiom_add(net, axiom_activation_softmax(), LAYER_ACTIVATION);
+    axiom_set_optimizer(net, optimizer_momentum_create(0.05f, 0.9f));
+    const char* start = "build/smoke_deterministic.bin";
+    axiom_save(net, start);
+    axiom_free(net);
+
+    /* threads, task graph: the serial sums, the batch split over the pool, and the graph's inline kernels */
+    static const size_t runs[][2] = { {1, 0}, {4, 0}, {4, 1} };
+    const char* paths[] = { "build/smoke_deterministic_0.bin", "build/smoke_deterministic_1.bin",
+                            "build/smoke_deterministic_2.bin" };
+    size_t prev_threads = parallel_num_threads();
+    int prev_mode = reduce_set_deterministic(1);
+    int trained = 1;
+    for (size_t r = 0; r < 3; r++) {
+        parallel_set_num_threads(runs[r][0]);
+        AxiomNet* n = axiom_load(start);
+        if (n == NULL) {
+            trained = 0;
+            continue;
+        }
+        n->train_opts.task_graph = (int)runs[r][1];
+        axiom_train(n, x, y, 3, 0.05f, 48);
+        axiom_save(n, paths[r]);
+        axiom_free(n);
+    }
+    reduce_set_deterministic(prev_mode);
+    parallel_set_num_threads(prev_threads);
+
+    int same = trained && files_identical(paths[0], paths[1]) && files_identical(paths[0], paths[2]);
+    printf("%s: deterministic training (checkpoints from 1 and 4 threads %s)\n", same ? "PASS" : "FAIL",
+           same ? "are identical" : "differ");
+    tensor_free(x);
+    tensor_free(y);
+}
+
+/* Builds a fresh features -> hidden (ReLU) -> classes (softmax) net for the streaming commands. */
+static AxiomNet* stream_net(size_t features, size_t hidden, size_t classes, Optimizer* opt) {
+    AxiomNet* net = axiom_create();
+    if (net == NULL || opt == NULL) {
+        axiom_free(net);
+        optimizer_free(opt);
+        return NULL;
+    }
+    axiom_add(net, axiom_layer_dense(features, hidden), LAYER_DENSE);
+    axiom_add(net, axiom_activation_relu(), LAYER_ACTIVATION);
+    axiom_add(net, axiom_layer_dense(hidden, classes), LAYER_DENSE);
+    axiom_add(net, axiom_activation_softmax(), LAYER_ACTIVATION);
+    if (axiom_set_optimizer(net, opt) != 0) {
+        axiom_free(net);
+        return NULL;
+    }
+    return net;
+}
+
+
+/* Streamed records train exactly like the same rows batched from a dataset; bad records are counted and skipped. */
+static void check_stream_learning(void) {
+    printf("Verifying stream learning ...\n");
+    enum { ROWS = 150, FEATURES = 37, CLASSES = 5, BATCH = 32 };
+    size_t rec_f32 = stream_record_size(FEATURES, 0);
+    uint8_t* buf = malloc((ROWS + 4) * rec_f32);
+    size_t x_shape[] = {ROWS, FEATURES};
+    Tensor* x = tensor_create(x_shape, 2);
+    int32_t* ids = malloc(ROWS * sizeof(int32_t));
+    AxiomNet* net = stream_net(FEATURES, 16, CLASSES, optimizer_momentum_create(0.05f, 0.9f));
+    if (!buf || !x || !ids || !net) {
+        printf("FAIL: stream learning setup\n");
+        free(buf);
+        tensor_free(x);
+        free(ids);
+        axiom_free(net);
+        return;
+    }
+    const char* start = "build/smoke_stream_start.bin";
+    axiom_save(net, start);
+    axiom_free(net);
+
+    /* every 7th row travels as bytes; a bad length and two bad labels go in along the way, and the
+     * stream ends partway through a record */
+    Rng rng;
+    rng_seed(&rng, 7);
+    size_t len = 0, rejected = 0;
+    float row[FEATURES];
+    uint8_t row_bytes[FEATURES];
+    for (size_t i = 0; i < ROWS; i++) {
+        ids[i] = (int32_t)rng_below(&rng, CLASSES);
+        for (size_t j = 0; j < FEATURES; j++) row_bytes[j] = (uint8_t)rng_below(&rng, 256);
+        for (size_t j = 0; j < FEATURES; j++) row[j] = rng_uniform(&rng) - 0.5f;
+        int bytes = i % 7 == 0;
+        if (bytes) {
+            for (size_t j = 0; j < FEATURES; j++) x->data[i * FEATURES + j] = (float)row_bytes[j] * (1.0f / 255.0f);
+        } else {
+            memcpy(x->data + i * FEATURES, row, sizeof row);
+        }
+        stream_encode_record(buf + len, ids[i], bytes ? (const void*)row_bytes : (const void*)row, FEATURES, bytes);
+        len += stream_record_size(FEATURES, bytes);
+        if (i == 40 || i == 90) {
+            stream_encode_record(buf + len, i == 40 ? CLASSES : -1, row, FEATURES, 0);
+            len += rec_f32;
+            rejected++;
+        }
+        if (i == 60) {
+            stream_encode_record(buf + len, 0, row, FEATURES - 1, 0);
+            len += stream_record_size(FEATURES - 1, 0);
+            rejected++;
+        }
+    }
+    stream_encode_record(buf + len, 0, row, FEATURES, 0);
+    len += rec_f32 / 2;
+    rejected++;
+
+    const char* path = "build/smoke_stream.bin";
+    FILE* f = fopen(path, "wb");
+    if (f) {
+        fwrite(buf, 1, len, f);
+        fclose(f);
+    }
+    AxiomNet* streamed = axiom_load(start);
+    AxiomNet* batched = axiom_load(start);
+    int fd = open(path, O_RDONLY);
+    StreamConfig cfg = { .batch_size = BATCH, .num_buffers = 2, .learning_rate = 0.05f };
+    StreamStats s;
+    int ok = streamed && batched && fd >= 0 && stream_learn(streamed, fd, &cfg, &s) == 0;
+    if (fd >= 0) close(fd);
+    if (ok) {
+        Dataset xd = dataset_from_tensor(x);
+        Dataset yd = dataset_from_labels(ids, ROWS, CLASSES);
+        batched->train_opts.shuffle = 0;
+        batched->train_opts.verbose = 0;
+        axiom_train_dataset(batched, &xd, &yd, 1, 0.05f, BATCH);
+        ok = s.records == ROWS && s.rejected == rejected && s.batches == (ROWS + BATCH - 1) / BATCH &&
+             s.partial_batches == 1 && s.bytes == len && batched->params != NULL &&
+             memcmp(streamed->params->params, batched->params->params, batched->params->size * sizeof(float)) == 0;
+    }
+    printf("%s: stream learning (%zu records, %zu rejected, %zu steps; parameters %s batch training)\n",
+           ok ? "PASS" : "FAIL", ok ? s.records : 0, ok ? s.rejected : 0, ok ? s.batches : 0,
+           ok ? "match" : "differ from");
+    axiom_free(streamed);
+    axiom_free(batched);
+    free(buf);
+    tensor_free(x);
+    free(ids);
+}
 
 static void run_test(void) {
     printf("=== Axiom smoke test ===\n");
+    /* tuned tilings stay in memory: the test writes nothing outside build/ */
+    autotune_set_cache_path("");
+    MemStats mem_before;
+    axiom_memory_stats(&mem_before);
 
     /* Tiny network: 4 -> 4 (ReLU) -> 2 (Softmax) */
     AxiomNet* net = axiom_create();
@@ -105,33 +747,56 @@ static void run_test(void) {
         }
     }
     printf("PASS: save/load (predictions match)\n");
+    tensor_free(out_loaded);
+    axiom_free(net);
+
+    /* Mapped load uses the checkpoint's weights in place; it must predict the same */
+    net = axiom_load_mapped(ckpt, 1);
+    out_loaded = net ? axiom_forward(net, x_train) : NULL;
+    int mapped_ok = out_loaded != NULL && out_loaded->size == out_orig->size &&
+                    memcmp(out_loaded->data, out_orig->data, out_orig->size * sizeof(float)) == 0;
+    printf("%s: mapped load (predictions %s)\n", mapped_ok ? "PASS" : "FAIL", mapped_ok ? "match" : "differ");
     tensor_free(out_orig);
     tensor_free(out_loaded);
+    axiom_free(net);
+
+    check_optimizer_roundtrip(x_train, y_train);
+    check_manual_backward(x_train, y_train);
+    check_train_failure();
+    check_lowrank(x_train, y_train);
+    check_embedding(y_train);
+    check_class_labels(x_train, y_train);
+    check_predictor();
+    check_relu_mask();
+    check_gemm_tilings();
+    check_deterministic_training();
+    check_stream_learning();
+
     tensor_free(x_train);
     tensor_free(y_train);
-    axiom_free(net);
-    printf("=== Done ===\n");
-}
 
-static float compute_accuracy(AxiomNet* net, const Tensor* x, const Tensor* y_onehot) {
-    Tensor* out = axiom_forward(net, x);
-    if (!out || out->shape[1] != 10) {
-        if (out) tensor_free(out);
-        return -1.0f;
+    /* Everything above was freed, so the accounted live bytes must be back where they started */
+    MemStats mem_after;
+    axiom_memory_stats(&mem_after);
+    size_t allocs = 0;
+    for (int c = 0; c < MEM_NUM_CATEGORIES; c++) {
+        allocs += mem_after.category[c].allocs - mem_before.category[c].allocs;
     }
-    size_t n = out->shape[0];
-    size_t correct = 0;
-    for (size_t i = 0; i < n; i++) {
-        size_t pred = 0, label = 0;
-        for (size_t k = 1; k < 10; k++) {
-            if (out->data[i * 10 + k] > out->data[i * 10 + pred]) pred = k;
-            if (y_onehot->data[i * 10 + k] > y_onehot->data[i * 10 + label]) label = k;
-        }
-        if (pred == label) correct++;
+    if (mem_after.live_bytes == mem_before.live_bytes) {
+        printf("PASS: memory accounting (%zu allocations, all freed, peak %.1f KB)\n", allocs,
+               (double)mem_after.peak_bytes / 1024.0);
+    } else {
+        printf("FAIL: memory accounting (%zu bytes still live)\n", mem_after.live_bytes - mem_before.live_bytes);
     }
-    float acc = (float)correct / (float)n;
-    tensor_free(out);
-    return acc;
+    printf("=== Done ===\n");
+}
+
+/* Test-set accuracy through the streaming evaluator; -1 if it couldn't run */
+static float test_accuracy(AxiomNet* net, const MnistData* data, size_t bsize) {
+    AxiomEvalResult r;
+    if (axiom_evaluate(net, &data->x_test, &data->y_test, bsize, &r) != 0) return -1.0f;
+    axiom_eval_result_free(&r);
+    return r.accuracy;
 }
 
 static void run_mnist_load(void) {
@@ -161,12 +826,41 @@ static void run_mnist_load(void) {
     tensor_free(y_test);
 }
 
-static void run_train(int argc, char* argv[]) {
+static Optimizer* create_optimizer(const char* name, float lr, float momentum, float weight_decay) {
+    Optimizer* opt = NULL;
+    if (strcmp(name, "sgd") == 0) opt = optimizer_sgd_create(lr);
+    else if (strcmp(name, "momentum") == 0) opt = optimizer_momentum_create(lr, momentum);
+    else if (strcmp(name, "nesterov") == 0) opt = optimizer_nesterov_create(lr, momentum);
+    else if (strcmp(name, "adam") == 0) opt = optimizer_adam_create(lr, 0.9f, 0.999f, 1e-8f);
+    else if (strcmp(name, "adamw") == 0) return optimizer_adamw_create(lr, 0.9f, 0.999f, 1e-8f, weight_decay);
+    if (opt != NULL) opt->weight_decay = weight_decay;
+    return opt;
+}
+
+static int run_train(int argc, char* argv[]) {
     size_t epochs = 10;
     float lr = 0.01f;
     size_t bsize = 64;
     const char* output_path = "mnist_model.bin";
     const char* data_path = "data/MNIST";
+    const char* opt_name = "sgd";
+    float momentum = 0.9f;
+    float weight_decay = 0.0f;
+    int shuffle = 1;
+    unsigned long long seed = 42;
+    size_t shuffle_window = 0;
+    const char* checkpoint_path = NULL;
+    size_t checkpoint_steps = 0;
+    double checkpoint_secs = 0.0;
+    const char* trace_path = NULL;
+    size_t mem_report = 0;
+    int task_graph = 1;
+    int deterministic = 0;
+    size_t rank = 0;
+    float target_acc = 0.0f;
+    int augment = 0;
+    /* Augmentation defaults when --augment 1: small enough that digits stay legible */
+    AugmentConfig aug = { 0, 0, 2.0f, 10.0f, 0.1f, 1.0f, 0 };  /* geometry comes from the image files */
 
     for (int i = 2; i + 1 < argc; i++) {
         if (strcmp(argv[i], "--epochs") == 0) { epochs = (size_t)atoi(argv[i + 1]); i++; }
@@ -174,43 +868,849 @@ static void run_train(int argc, char* argv[]) {
         else if (strcmp(argv[i], "--batch") == 0) { bsize = (size_t)atoi(argv[i + 1]); i++; }
         else if (strcmp(argv[i], "--output") == 0) { output_path = argv[i + 1]; i++; }
         else if (strcmp(argv[i], "--data") == 0) { data_path = argv[i + 1]; i++; }
+        else if (strcmp(argv[i], "--optimizer") == 0) { opt_name = argv[i + 1]; i++; }
+        else if (strcmp(argv[i], "--momentum") == 0) { momentum = (float)atof(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--weight-decay") == 0) { weight_decay = (float)atof(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--shuffle") == 0) { shuffle = atoi(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--seed") == 0) { seed = strtoull(argv[i + 1], NULL, 10); i++; }
+        else if (strcmp(argv[i], "--shuffle-window") == 0) { shuffle_window = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--checkpoint") == 0) { checkpoint_path = argv[i + 1]; i++; }
+        else if (strcmp(argv[i], "--checkpoint-steps") == 0) { checkpoint_steps = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--checkpoint-secs") == 0) { checkpoint_secs = atof(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--trace") == 0) { trace_path = argv[i + 1]; i++; }
+        else if (strcmp(argv[i], "--mem-report") == 0) { mem_report = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--task-graph") == 0) { task_graph = atoi(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--deterministic") == 0) { deterministic = atoi(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--rank") == 0) { rank = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--target-acc") == 0) { target_acc = (float)atof(argv[i + 1]) / 100.0f; i++; }
+        else if (strcmp(argv[i], "--augment") == 0) { augment = atoi(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--aug-shift") == 0) { aug.max_shift = (float)atof(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--aug-rotate") == 0) { aug.max_rotate_deg = (float)atof(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--aug-scale") == 0) { aug.max_scale = (float)atof(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--aug-elastic") == 0) { aug.elastic = (float)atof(argv[i + 1]); i++; }
     }
 
-    Tensor *x_train = NULL, *y_train = NULL, *x_test = NULL, *y_test = NULL;
-    if (mnist_load(data_path, &x_train, &y_train, &x_test, &y_test) != 0) {
+    Optimizer* opt = create_optimizer(opt_name, lr, momentum, weight_decay);
+    if (!opt) {
+        printf("train: unknown optimizer \"%s\" (sgd, momentum, nesterov, adam, adamw)\n", opt_name);
+        return 1;
+    }
+
+    /* Both sets stay memory-mapped bytes: training rows are converted per batch, and axiom_evaluate streams the test set */
+    uint64_t open_start = timer_now_ns();
+    MnistData data;
+    if (mnist_open(data_path, &data) != 0) {
         printf("train: failed to load MNIST from \"%s\"\n", data_path);
-        return;
+        optimizer_free(opt);
+        return 1;
     }
+    size_t n_features = dataset_width(&data.x_train);
+    printf("Opened %zu training rows x %zu features in %.1f ms\n",
+           data.x_train.rows, n_features, timer_elapsed_ms(open_start));
 
     AxiomNet* net = axiom_create();
     if (!net) {
         printf("train: axiom_create failed\n");
-        tensor_free(x_train); tensor_free(y_train);
-        tensor_free(x_test); tensor_free(y_test);
-        return;
+        optimizer_free(opt);
+        mnist_close(&data);
+        return 1;
+    }
+    /* --rank factors the first layer as U [features, rank] V [rank, 128] */
+    if (rank > 0) {
+        axiom_add(net, axiom_layer_dense_lowrank(n_features, 128, rank), LAYER_DENSE_LOWRANK);
+    } else {
+        axiom_add(net, axiom_layer_dense(n_features, 128), LAYER_DENSE);
     }
-    axiom_add(net, axiom_layer_dense(784, 128), LAYER_DENSE);
     axiom_add(net, axiom_activation_relu(), LAYER_ACTIVATION);
-    axiom_add(net, axiom_layer_dense(128, 10), LAYER_DENSE);
+    axiom_add(net, axiom_layer_dense(128, MNIST_NUM_CLASSES), LAYER_DENSE);
     axiom_add(net, axiom_activation_softmax(), LAYER_ACTIVATION);
+    if (axiom_set_optimizer(net, opt) != 0) {
+        printf("train: could not set up the optimizer state\n");
+        axiom_free(net);
+        mnist_close(&data);
+        return 1;
+    }
+    net->train_opts.shuffle = shuffle;
+    net->train_opts.seed = seed;
+    net->train_opts.shuffle_window = shuffle_window;
+    net->train_opts.checkpoint_path = checkpoint_path;
+    net->train_opts.checkpoint_every_steps = checkpoint_steps;
+    net->train_opts.checkpoint_every_seconds = checkpoint_secs;
+    if (checkpoint_path != NULL && checkpoint_steps == 0 && checkpoint_secs <= 0.0)
+        net->train_opts.checkpoint_every_seconds = 60.0;
+    net->train_opts.trace_path = trace_path;
+    net->train_opts.memory_report_every = mem_report;
+    net->train_opts.task_graph = task_graph;
+    if (deterministic) reduce_set_deterministic(1);
+    if (augment) {
+        aug.seed = seed;
+        aug.width = data.image_width;
+        aug.height = data.image_height;
+        net->train_opts.augment = aug;
+        printf("Augmenting: shift %.1fpx, rotate %.1f deg, scale %.2f, elastic %.1fpx\n",
+               aug.max_shift, aug.max_rotate_deg, aug.max_scale, aug.elastic);
+    }
 
-    printf("Training 784 -> 128 -> 10 on MNIST, %zu epochs, lr=%.4f, batch=%zu ...\n", epochs, lr, bsize);
-    axiom_train(net, x_train, y_train, epochs, lr, bsize);
+    if (rank > 0) printf("First layer is low-rank: rank %zu\n", rank);
+    printf("Training %zu -> 128 -> %d on MNIST, %zu epochs, %s, lr=%.4f, batch=%zu, shuffle=%s (seed %llu) ...\n",
+           n_features, MNIST_NUM_CLASSES, epochs, opt_name, lr, bsize, shuffle ? "on" : "off", seed);
+    int trained = 1;
+    if (target_acc > 0.0f) {
+        /* Time-to-accuracy: one epoch at a time, stopping once the test set reaches the target. */
+        uint64_t start = timer_now_ns();
+        for (size_t e = 0; e < epochs; e++) {
+            if (axiom_train_dataset(net, &data.x_train, &data.y_train, 1, lr, bsize) != 0) {
+                trained = 0;
+                break;
+            }
+            float epoch_acc = test_accuracy(net, &data, bsize);
+            double secs = timer_elapsed_ms(start) / 1000.0;
+            printf("Epoch %zu: test accuracy %.2f%% at %.2fs\n", e, epoch_acc * 100.0f, secs);
+            if (epoch_acc >= target_acc) {
+                printf("Reached %.2f%% after %zu epochs in %.2fs\n", target_acc * 100.0f, e + 1, secs);
+                break;
+            }
+        }
+    } else {
+        trained = axiom_train_dataset(net, &data.x_train, &data.y_train, epochs, lr, bsize) == 0;
+    }
+    if (!trained) {
+        /* the weights may be half-updated: don't score them or overwrite the output with them */
+        printf("train: training failed; \"%s\" not written\n", output_path);
+        mnist_close(&data);
+        axiom_free(net);
+        return 1;
+    }
 
-    float acc = compute_accuracy(net, x_test, y_test);
-    if (acc >= 0.0f)
-        printf("Test accuracy: %.2f%%\n", acc * 100.0f);
-    else
+    AxiomEvalResult eval;
+    if (axiom_evaluate(net, &data.x_test, &data.y_test, bsize, &eval) == 0) {
+        printf("Test accuracy: %.2f%% (top-%d %.2f%%, loss %.4f)\n", eval.accuracy * 100.0f, AXIOM_EVAL_TOP_K,
+               eval.topk_accuracy * 100.0f, eval.loss);
+        axiom_eval_result_free(&eval);
+    } else {
         printf("Could not compute test accuracy\n");
+    }
 
     axiom_save(net, output_path);
     printf("Saved \"%s\"\n", output_path);
 
-    tensor_free(x_train);
-    tensor_free(y_train);
-    tensor_free(x_test);
-    tensor_free(y_test);
+    mnist_close(&data);
+    axiom_free(net);
+    return 0;
+}
+
+static int run_convert(int argc, char* argv[]) {
+    if (argc < 4) {
+        printf("convert: missing <out_file> and --idx/--csv input\n");
+        return 1;
+    }
+    const char* out_path = argv[2];
+    const char* images = NULL;
+    const char* labels = NULL;
+    const char* csv = NULL;
+    DatasetType type = DATASET_F32;
+    size_t block_rows = 0;
+    for (int i = 3; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--idx") == 0 && i + 2 < argc) { images = argv[i + 1]; labels = argv[i + 2]; i += 2; }
+        else if (strcmp(argv[i], "--csv") == 0) { csv = argv[i + 1]; i++; }
+        else if (strcmp(argv[i], "--block-rows") == 0) { block_rows = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--type") == 0) {
+            const char* t = argv[i + 1];
+            type = strcmp(t, "u8") == 0 ? DATASET_U8 : strcmp(t, "f16") == 0 ? DATASET_F16 : DATASET_F32;
+            i++;
+        }
+    }
+
+    uint64_t start = timer_now_ns();
+    long rows = images != NULL ? chunked_convert_idx(images, labels, out_path, block_rows)
+              : csv != NULL ? chunked_convert_csv(csv, out_path, type, block_rows) : -1;
+    if (rows < 0) {
+        printf("convert: failed to write \"%s\"\n", out_path);
+        return 1;
+    }
+    printf("Wrote %ld rows to \"%s\" in %.1f ms\n", rows, out_path, timer_elapsed_ms(start));
+    return 0;
+}
+
+static int run_serve(int argc, char* argv[]) {
+    if (argc < 3) {
+        printf("serve: missing <model_file>\n");
+        return 1;
+    }
+    ServeConfig cfg = { "/tmp/axiom.sock", 32, 1.0, 2 };
+    for (int i = 3; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--socket") == 0) { cfg.socket_path = argv[i + 1]; i++; }
+        else if (strcmp(argv[i], "--max-batch") == 0) { cfg.max_batch = (size_t)atoi(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--max-delay-ms") == 0) { cfg.max_delay_ms = atof(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--workers") == 0) { cfg.num_workers = (size_t)atoi(argv[i + 1]); i++; }
+    }
+    if (serve_run(argv[2], &cfg) != 0) {
+        printf("serve: could not load \"%s\" or bind %s\n", argv[2], cfg.socket_path);
+        return 1;
+    }
+    return 0;
+}
+
+/* Whole test set as one tensor through axiom_forward, the way accuracy used to be measured; for --compare */
+static float full_forward_accuracy(AxiomNet* net, const MnistData* data) {
+    Tensor* x = dataset_to_tensor(&data->x_test);
+    Tensor* y = dataset_to_tensor(&data->y_test);
+    Tensor* out = x && y ? axiom_forward(net, x) : NULL;
+    float acc = -1.0f;
+    if (out != NULL) {
+        size_t classes = out->shape[1], correct = 0;
+        for (size_t i = 0; i < out->shape[0]; i++) {
+            size_t pred = 0, label = 0;
+            for (size_t k = 1; k < classes; k++) {
+                if (out->data[i * classes + k] > out->data[i * classes + pred]) pred = k;
+                if (y->data[i * classes + k] > y->data[i * classes + label]) label = k;
+            }
+            correct += pred == label;
+        }
+        acc = (float)correct / (float)out->shape[0];
+    }
+    tensor_free(out);
+    tensor_free(x);
+    tensor_free(y);
+    return acc;
+}
+
+/* One scored row: "index: class (score)" */
+static int predict_row(Predictor* p, const float* x, float* out, size_t index) {
+    if (predictor_run(p, x, out) != 0) return -1;
+    size_t best = 0, outputs = predictor_num_outputs(p);
+    for (size_t j = 1; j < outputs; j++) if (out[j] > out[best]) best = j;
+    printf("%zu: %zu (%.4f)\n", index, best, out[best]);
+    return 0;
+}
+
+/* Scores every row of <input> with the batch-1 predictor. The input is an IDX byte file, scaled by 1/255
+ * as in training, or text with one row per line of comma- or space-separated numbers. */
+static int run_predict(int argc, char* argv[]) {
+    if (argc < 4) {
+        printf("predict: usage: predict <model_file> <input>\n");
+        return 1;
+    }
+    AxiomNet* net = axiom_load_mapped(argv[2], 1);
+    Predictor* p = net ? predictor_create(net) : NULL;
+    if (p == NULL) {
+        printf(net ? "predict: \"%s\" has a layer the predictor doesn't handle\n" : "predict: could not load \"%s\"\n", argv[2]);
+        axiom_free(net);
+        return 1;
+    }
+    size_t inputs = predictor_num_inputs(p);
+    float* x = malloc(inputs * sizeof(float));
+    float* out = malloc(predictor_num_outputs(p) * sizeof(float));
+    if (!x || !out) {
+        free(x);
+        free(out);
+        predictor_free(p);
+        axiom_free(net);
+        return 1;
+    }
+
+    int rc = 0;
+    size_t rows = 0;
+    uint64_t start = timer_now_ns();
+    IdxFile* idx = idx_open(argv[3]);
+    if (idx != NULL) {
+        Dataset d = dataset_from_idx(idx, 1.0f / 255.0f);
+        size_t shape[] = {1, inputs};
+        Tensor* row = tensor_view(x, shape, 2);
+        if (row == NULL || dataset_width(&d) != inputs) {
+            printf("predict: \"%s\" has rows of %zu values, the model takes %zu\n", argv[3], dataset_width(&d), inputs);
+            rc = 1;
+        }
+        for (size_t i = 0; rc == 0 && i < d.rows; i++, rows++) {
+            dataset_gather(&d, row, &i, 1);
+            if (predict_row(p, x, out, i) != 0) rc = 1;
+        }
+        tensor_free(row);
+        idx_close(idx);
+    } else {
+        FILE* f = fopen(argv[3], "r");
+        if (f == NULL) {
+            printf("predict: could not open \"%s\"\n", argv[3]);
+            rc = 1;
+        }
+        char* line = NULL;
+        size_t cap = 0;
+        while (rc == 0 && getline(&line, &cap, f) > 0) {
+            char* s = line;
+            size_t n = 0;
+            for (;;) {
+                while (*s == ',' || *s == ' ' || *s == '\t') s++;
+                char* end;
+                float v = strtof(s, &end);
+                if (end == s) break;
+                if (n < inputs) x[n] = v;
+                n++;
+                s = end;
+            }
+            if (n == 0 && (*s == '\n' || *s == '\r' || *s == '\0')) continue;  /* blank line */
+            if (n != inputs || (*s != '\n' && *s != '\r' && *s != '\0')) {
+                printf("predict: line %zu isn't %zu numbers\n", rows + 1, inputs);
+                rc = 1;
+            } else if (predict_row(p, x, out, rows++) != 0) {
+                rc = 1;
+            }
+        }
+        free(line);
+        if (f) fclose(f);
+    }
+    double ms = timer_elapsed_ms(start);
+    if (rc == 0) fprintf(stderr, "Scored %zu rows in %.1f ms (%.1f us per row)\n", rows, ms, rows ? 1000.0 * ms / rows : 0.0);
+
+    free(x);
+    free(out);
+    predictor_free(p);
+    axiom_free(net);
+    return rc;
+}
+
+static int run_evaluate(int argc, char* argv[]) {
+    if (argc < 3) {
+        printf("evaluate: missing <model_file>\n");
+        return 1;
+    }
+    const char* model_path = argv[2];
+    const char* data_path = "data/MNIST";
+    size_t bsize = 256;
+    int compare = 0;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--data") == 0 && i + 1 < argc) data_path = argv[++i];
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) bsize = (size_t)atol(argv[++i]);
+        else if (strcmp(argv[i], "--compare") == 0) compare = 1;
+    }
+
+    AxiomNet* net = axiom_load_mapped(model_path, 1);
+    if (net == NULL) {
+        printf("evaluate: could not load \"%s\"\n", model_path);
+        return 1;
+    }
+    MnistData data;
+    if (mnist_open(data_path, &data) != 0) {
+        printf("evaluate: failed to load MNIST from \"%s\"\n", data_path);
+        axiom_free(net);
+        return 1;
+    }
+
+    MemStats mem;
+    mem_reset_peak();
+    axiom_memory_stats(&mem);
+    size_t base = mem.live_bytes;
+    uint64_t start = timer_now_ns();
+    AxiomEvalResult r;
+    int rc = axiom_evaluate(net, &data.x_test, &data.y_test, bsize, &r);
+    double ms = timer_elapsed_ms(start);
+    axiom_memory_stats(&mem);
+    if (rc != 0) {
+        printf("evaluate: model doesn't fit the data (%zu features, %zu classes)\n",
+               dataset_width(&data.x_test), dataset_width(&data.y_test));
+        mnist_close(&data);
+        axiom_free(net);
+        return 1;
+    }
+
+    printf("%zu samples in %.1f ms (%.0f samples/s, %zu threads, batch %zu), %.2f MB peak working memory\n",
+           r.samples, ms, 1000.0 * (double)r.samples / ms, parallel_num_threads(), bsize,
+           (double)(mem.peak_bytes - base) / 1048576.0);
+    if (r.skipped > 0) printf("%zu rows without a valid label left out\n", r.skipped);
+    printf("Accuracy %.2f%%, top-%d %.2f%%, loss %.4f\n", r.accuracy * 100.0f, AXIOM_EVAL_TOP_K,
+           r.topk_accuracy * 100.0f, r.loss);
+    if (r.confusion != NULL) {
+        printf("Confusion matrix (rows: true class, columns: predicted)\n      ");
+        for (size_t j = 0; j < r.num_classes; j++) printf("%6zu", j);
+        printf("\n");
+        for (size_t i = 0; i < r.num_classes; i++) {
+            printf("%6zu", i);
+            for (size_t j = 0; j < r.num_classes; j++) printf("%6zu", r.confusion[i * r.num_classes + j]);
+            printf("\n");
+        }
+    }
+
+    if (compare) {
+        mem_reset_peak();
+        axiom_memory_stats(&mem);
+        base = mem.live_bytes;
+        start = timer_now_ns();
+        float acc = full_forward_accuracy(net, &data);
+        ms = timer_elapsed_ms(start);
+        axiom_memory_stats(&mem);
+        printf("Whole-set axiom_forward: accuracy %.2f%% in %.1f ms, %.2f MB peak working memory\n",
+               acc * 100.0f, ms, (double)(mem.peak_bytes - base) / 1048576.0);
+    }
+
+    axiom_eval_result_free(&r);
+    mnist_close(&data);
+    axiom_free(net);
+    return 0;
+}
+
+static int run_export_c(int argc, char* argv[]) {
+    if (argc < 4) {
+        printf("export-c: usage: export-c <model_file> <out.c> [--prefix <name>]\n");
+        return 1;
+    }
+    const char* prefix = "axiom_model";
+    for (int i = 4; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--prefix") == 0) { prefix = argv[i + 1]; i++; }
+    }
+
+    AxiomNet* net = axiom_load_mapped(argv[2], 1);
+    if (net == NULL) {
+        printf("export-c: could not load \"%s\"\n", argv[2]);
+        return 1;
+    }
+    int rc = export_c(net, argv[3], prefix, argv[2]);
+    axiom_free(net);
+    if (rc != 0) {
+        printf("export-c: could not export to \"%s\" (unsupported layer, bad prefix or write error)\n", argv[3]);
+        return 1;
+    }
+    printf("Wrote \"%s\" (%s_forward, %s_predict)\n", argv[3], prefix, prefix);
+    return 0;
+}
+
+/* Test-set accuracy and evaluation time, for the before/after columns of compress */
+static int compress_eval(AxiomNet* net, const MnistData* data, float* acc, double* ms) {
+    AxiomEvalResult r;
+    uint64_t start = timer_now_ns();
+    if (axiom_evaluate(net, &data->x_test, &data->y_test, 256, &r) != 0) return -1;
+    *ms = timer_elapsed_ms(start);
+    *acc = r.accuracy;
+    axiom_eval_result_free(&r);
+    return 0;
+}
+
+static int run_compress(int argc, char* argv[]) {
+    if (argc < 4) {
+        printf("compress: usage: compress <model_file> <out_file> (--rank <r> | --energy <e>) [--data <dir>]\n");
+        return 1;
+    }
+    size_t rank = 0;
+    float energy = 0.0f;
+    const char* data_path = NULL;
+    for (int i = 4; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--rank") == 0) { rank = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--energy") == 0) { energy = (float)atof(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--data") == 0) { data_path = argv[i + 1]; i++; }
+    }
+    if (rank == 0 && !(energy > 0.0f && energy <= 1.0f)) {
+        printf("compress: give --rank <r> or --energy <e> with 0 < e <= 1\n");
+        return 1;
+    }
+
+    AxiomNet* net = axiom_load(argv[2]);
+    if (net == NULL) {
+        printf("compress: could not load \"%s\"\n", argv[2]);
+        return 1;
+    }
+    MnistData data;
+    int have_data = data_path != NULL && mnist_open(data_path, &data) == 0;
+    if (data_path != NULL && !have_data) printf("compress: failed to load MNIST from \"%s\", skipping accuracy\n", data_path);
+    float acc_before = 0.0f, acc_after = 0.0f;
+    double ms_before = 0.0, ms_after = 0.0;
+    if (have_data && compress_eval(net, &data, &acc_before, &ms_before) != 0) have_data = 0;
+
+    AxiomCompressLayer* report = calloc(net->num_layers + 1, sizeof(AxiomCompressLayer));
+    uint64_t start = timer_now_ns();
+    int replaced = report != NULL ? axiom_compress_lowrank(net, rank, energy, report) : -1;
+    double svd_ms = timer_elapsed_ms(start);
+    if (replaced < 0) {
+        printf("compress: factoring failed\n");
+        free(report);
+        if (have_data) mnist_close(&data);
+        axiom_free(net);
+        return 1;
+    }
+
+    /* one dense layer per report entry, in order */
+    size_t num_dense = 0;
+    for (Layer* cur = net->layers; cur != NULL; cur = cur->next) {
+        num_dense += cur->type == LAYER_DENSE || cur->type == LAYER_DENSE_LOWRANK;
+    }
+    printf("Factored %d of %zu dense layers in %.1f ms\n", replaced, num_dense, svd_ms);
+    printf("layer   in -> out   rank  energy  rel.err   params KB before -> after   MFLOP/row before -> after\n");
+    size_t bytes_before = 0, bytes_after = 0, flops_before = 0, flops_after = 0;
+    for (size_t i = 0; i < num_dense; i++) {
+        const AxiomCompressLayer* c = &report[i];
+        size_t in = c->input_size, out = c->output_size;
+        size_t pb = (in * out + out) * sizeof(float);
+        size_t pa = c->rank > 0 ? (c->rank * (in + out) + out) * sizeof(float) : pb;
+        size_t fb = 2 * in * out;
+        size_t fa = c->rank > 0 ? 2 * c->rank * (in + out) : fb;
+        bytes_before += pb;
+        bytes_after += pa;
+        flops_before += fb;
+        flops_after += fa;
+        if (c->rank > 0) {
+            printf("%5zu %5zu -> %-5zu %5zu  %6.4f  %7.5f   %9.1f -> %-9.1f       %8.4f -> %.4f\n",
+                   c->layer, in, out, c->rank, (double)c->energy, (double)c->rel_error,
+                   pb / 1024.0, pa / 1024.0, fb / 1e6, fa / 1e6);
+        } else {
+            printf("%5zu %5zu -> %-5zu  kept dense (rank (in + out) >= in out)\n", c->layer, in, out);
+        }
+    }
+    printf("total: params %.1f KB -> %.1f KB (%.2fx), %.4f -> %.4f MFLOP/row (%.2fx)\n",
+           bytes_before / 1024.0, bytes_after / 1024.0, bytes_after > 0 ? (double)bytes_before / bytes_after : 0.0,
+           flops_before / 1e6, flops_after / 1e6, flops_after > 0 ? (double)flops_before / flops_after : 0.0);
+
+    if (have_data && compress_eval(net, &data, &acc_after, &ms_after) == 0) {
+        printf("Test accuracy %.2f%% -> %.2f%% (%+.2f points), evaluation %.1f ms -> %.1f ms\n",
+               acc_before * 100.0f, acc_after * 100.0f, (acc_after - acc_before) * 100.0f, ms_before, ms_after);
+    }
+
+    axiom_save(net, argv[3]);
+    printf("Saved \"%s\"\n", argv[3]);
+    free(report);
+    if (have_data) mnist_close(&data);
+    axiom_free(net);
+    return 0;
+}
+
+/* Comma-separated numbers into out[0..max); returns how many were read */
+static size_t parse_list(const char* s, double* out, size_t max) {
+    size_t n = 0;
+    while (s != NULL && *s != '\0' && n < max) {
+        char* end;
+        double v = strtod(s, &end);
+        if (end == s) break;
+        out[n++] = v;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+/* Tunes every GEMM shape class a checkpoint's dense layers multiply at the given batch sizes (forward,
+ * and backward unless --inference), and saves the winners to the tuning cache for later runs. */
+static int run_tune(int argc, char* argv[]) {
+    if (argc < 3) {
+        printf("tune: missing <model_file>\n");
+        return 1;
+    }
+    double batches[16];
+    size_t num_batches = parse_list("1,64,256", batches, 16);
+    int force = 0, backward = 1;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) num_batches = parse_list(argv[++i], batches, 16);
+        else if (strcmp(argv[i], "--force") == 0) force = 1;
+        else if (strcmp(argv[i], "--inference") == 0) backward = 0;
+    }
+    AxiomNet* net = axiom_load(argv[2]);
+    if (net == NULL) {
+        printf("tune: could not load \"%s\"\n", argv[2]);
+        return 1;
+    }
+
+    const char* path = autotune_cache_path();
+    printf("CPU: %s, %zu threads\n", autotune_cpu_model(), parallel_num_threads());
+    printf("Cache: %s\n", path[0] != '\0' ? path : "(not persisted)");
+    printf("%-8s %-20s %-9s %6s %6s %8s %12s %12s %8s\n", "pass", "m x n x k", "source", "kc", "mc", "threads",
+           "default us", "tuned us", "speedup");
+    int rc = 0;
+    for (size_t b = 0; b < num_batches; b++) {
+        size_t m = (size_t)batches[b];
+        for (const Layer* layer = net->layers; layer != NULL && m > 0; layer = layer->next) {
+            if (layer->type != LAYER_DENSE) continue;
+            const DenseLayer* d = layer->layer.dense;
+            for (int t = 0; t <= backward; t++) {
+                size_t n = t ? d->input_size : d->output_size, k = t ? d->output_size : d->input_size;
+                char shape[48];
+                snprintf(shape, sizeof shape, "%zu x %zu x %zu", m, n, k);
+                AutotuneResult r;
+                if (autotune_gemm_now(m, n, k, t, force, &r) != 0) {
+                    printf("%-8s %-20s %-9s\n", t ? "backward" : "forward", shape, "too small");
+                    continue;
+                }
+                if (r.tuned_us <= 0.0) rc = 1;
+                char source[32];
+                if (r.candidates > 0) snprintf(source, sizeof source, "tuned/%zu", r.candidates);
+                else snprintf(source, sizeof source, "cached");
+                printf("%-8s %-20s %-9s %6zu %6zu %8zu %12.1f %12.1f %7.2fx\n", t ? "backward" : "forward", shape,
+                       source, r.tiling.kc, r.tiling.mc, r.tiling.threads, r.default_us, r.tuned_us,
+                       r.tuned_us > 0.0 ? r.default_us / r.tuned_us : 0.0);
+            }
+        }
+    }
+    axiom_free(net);
+    return rc;
+}
+
+static int compare_sweep_rank(const void* a, const void* b) {
+    const SweepResult* x = a;
+    const SweepResult* y = b;
+    return (x->rank > y->rank) - (x->rank < y->rank);
+}
+
+#define SWEEP_MAX_VALUES 16
+
+static int run_sweep(int argc, char* argv[]) {
+    const char* lr_list = "0.1,0.03,0.01";
+    const char* batch_list = "32,64,128";
+    const char* hidden_list = "64,128";
+    const char* opt_list = "sgd,adam";
+    const char* data_path = "data/MNIST";
+    const char* output_path = NULL;
+    size_t random_configs = 0;
+    size_t val_rows = 0;  /* default: a sixth of the training rows, 10000 for MNIST */
+    unsigned long long seed = 42;
+    SweepOptions opts = { .workers = 0, .min_epochs = 1, .max_epochs = 8, .eta = 2, .verbose = 1 };
+    for (int i = 2; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--lr") == 0) { lr_list = argv[i + 1]; i++; }
+        else if (strcmp(argv[i], "--batch") == 0) { batch_list = argv[i + 1]; i++; }
+        else if (strcmp(argv[i], "--hidden") == 0) { hidden_list = argv[i + 1]; i++; }
+        else if (strcmp(argv[i], "--optimizer") == 0) { opt_list = argv[i + 1]; i++; }
+        else if (strcmp(argv[i], "--random") == 0) { random_configs = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--seed") == 0) { seed = strtoull(argv[i + 1], NULL, 10); i++; }
+        else if (strcmp(argv[i], "--epochs") == 0) { opts.max_epochs = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--min-epochs") == 0) { opts.min_epochs = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--eta") == 0) { opts.eta = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--workers") == 0) { opts.workers = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--val-rows") == 0) { val_rows = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--data") == 0) { data_path = argv[i + 1]; i++; }
+        else if (strcmp(argv[i], "--output") == 0) { output_path = argv[i + 1]; i++; }
+    }
+    opts.seed = seed;
+
+    double lrs[SWEEP_MAX_VALUES], batches[SWEEP_MAX_VALUES], hiddens[SWEEP_MAX_VALUES];
+    int optimizers[SWEEP_MAX_VALUES];
+    size_t num_lr = parse_list(lr_list, lrs, SWEEP_MAX_VALUES);
+    size_t num_batch = parse_list(batch_list, batches, SWEEP_MAX_VALUES);
+    size_t num_hidden = parse_list(hidden_list, hiddens, SWEEP_MAX_VALUES);
+    size_t num_opt = 0;
+    for (const char* s = opt_list; *s != '\0' && num_opt < SWEEP_MAX_VALUES;) {
+        size_t len = strcspn(s, ",");
+        char name[32];
+        snprintf(name, sizeof name, "%.*s", (int)(len < sizeof name ? len : sizeof name - 1), s);
+        optimizers[num_opt] = sweep_optimizer_type(name);
+        if (optimizers[num_opt] < 0) {
+            printf("sweep: unknown optimizer \"%s\" (sgd, momentum, nesterov, adam, adamw)\n", name);
+            return 1;
+        }
+        num_opt++;
+        s += len;
+        if (*s == ',') s++;
+    }
+    if (num_lr == 0 || num_batch == 0 || num_hidden == 0 || num_opt == 0 || opts.max_epochs == 0) {
+        printf("sweep: each of --lr, --batch, --hidden and --optimizer needs at least one value, --epochs > 0\n");
+        return 1;
+    }
+
+    /* Grid: every combination. Random: lr log-uniform over the --lr range, the rest picked from their lists. */
+    size_t n = random_configs > 0 ? random_configs : num_lr * num_batch * num_hidden * num_opt;
+    SweepConfig* configs = calloc(n, sizeof(SweepConfig));
+    SweepResult* results = calloc(n, sizeof(SweepResult));
+    if (configs == NULL || results == NULL) {
+        printf("sweep: out of memory\n");
+        free(configs);
+        free(results);
+        return 1;
+    }
+    if (random_configs > 0) {
+        double lo = lrs[0], hi = lrs[0];
+        for (size_t i = 1; i < num_lr; i++) {
+            if (lrs[i] < lo) lo = lrs[i];
+            if (lrs[i] > hi) hi = lrs[i];
+        }
+        Rng rng;
+        rng_seed(&rng, seed);
+        for (size_t i = 0; i < n; i++) {
+            configs[i].learning_rate = (float)(lo * pow(hi / lo, rng_uniform(&rng)));
+            configs[i].batch_size = (size_t)batches[rng_below(&rng, (uint32_t)num_batch)];
+            configs[i].hidden = (size_t)hiddens[rng_below(&rng, (uint32_t)num_hidden)];
+            configs[i].optimizer = optimizers[rng_below(&rng, (uint32_t)num_opt)];
+        }
+    } else {
+        size_t i = 0;
+        for (size_t a = 0; a < num_opt; a++)
+            for (size_t b = 0; b < num_lr; b++)
+                for (size_t c = 0; c < num_batch; c++)
+                    for (size_t d = 0; d < num_hidden; d++) {
+                        configs[i].optimizer = optimizers[a];
+                        configs[i].learning_rate = (float)lrs[b];
+                        configs[i].batch_size = (size_t)batches[c];
+                        configs[i].hidden = (size_t)hiddens[d];
+                        i++;
+                    }
+    }
+
+    /* One mapping of the data serves every model; the last val_rows training rows rank the configs */
+    MnistData data;
+    if (mnist_open(data_path, &data) != 0) {
+        printf("sweep: failed to load MNIST from \"%s\"\n", data_path);
+        free(configs);
+        free(results);
+        return 1;
+    }
+    size_t rows = data.x_train.rows;
+    if (val_rows == 0) val_rows = rows / 6;
+    if (val_rows == 0 || val_rows >= rows) {
+        printf("sweep: --val-rows must be between 1 and %zu\n", rows - 1);
+        mnist_close(&data);
+        free(configs);
+        free(results);
+        return 1;
+    }
+    Dataset x_fit = dataset_slice(&data.x_train, 0, rows - val_rows);
+    Dataset y_fit = dataset_slice(&data.y_train, 0, rows - val_rows);
+    Dataset x_val = dataset_slice(&data.x_train, rows - val_rows, val_rows);
+    Dataset y_val = dataset_slice(&data.y_train, rows - val_rows, val_rows);
+
+    size_t workers = opts.workers > 0 ? opts.workers : parallel_num_threads();
+    printf("Sweeping %zu configs (%s) on %zu training rows, %zu validation rows, %zu workers\n",
+           n, random_configs > 0 ? "random" : "grid", x_fit.rows, x_val.rows, workers);
+    if (opts.eta >= 2) {
+        printf("Successive halving: %zu -> %zu epochs, keeping 1/%zu per rung\n",
+               opts.min_epochs, opts.max_epochs, opts.eta);
+    }
+
+    AxiomNet* best = NULL;
+    uint64_t start = timer_now_ns();
+    if (sweep_run(&x_fit, &y_fit, &x_val, &y_val, configs, n, &opts, results, &best) != 0) {
+        printf("sweep: failed to run\n");
+        mnist_close(&data);
+        free(configs);
+        free(results);
+        return 1;
+    }
+    double wall = timer_elapsed_ms(start) / 1000.0;
+
+    double model_secs = 0.0;
+    size_t epochs = 0;
+    for (size_t i = 0; i < n; i++) {
+        model_secs += results[i].train_ms / 1000.0;
+        epochs += results[i].epochs;
+    }
+    qsort(results, n, sizeof(SweepResult), compare_sweep_rank);
+    printf("\n rank  optimizer  lr        batch  hidden  epochs  val acc   time (s)\n");
+    for (size_t i = 0; i < n; i++) {
+        const SweepResult* r = &results[i];
+        printf("%5zu  %-9s  %-8.4g  %5zu  %6zu  %6zu  ", r->rank, sweep_optimizer_name(r->config.optimizer),
+               r->config.learning_rate, r->config.batch_size, r->config.hidden, r->epochs);
+        if (r->failed) printf("failed\n");
+        else printf("%6.2f%%  %8.1f%s\n", r->val_accuracy * 100.0f, r->train_ms / 1000.0, r->pruned ? "  pruned" : "");
+    }
+    printf("\n%zu epochs in %.1f s wall (%.1f s of model time, %.2fx concurrency); a full grid would be %zu epochs\n",
+           epochs, wall, model_secs, wall > 0.0 ? model_secs / wall : 0.0, n * opts.max_epochs);
+
+    if (best != NULL) {
+        printf("Best: %s lr=%g batch=%zu hidden=%zu, test accuracy %.2f%%\n",
+               sweep_optimizer_name(results[0].config.optimizer), results[0].config.learning_rate,
+               results[0].config.batch_size, results[0].config.hidden, test_accuracy(best, &data, 256) * 100.0f);
+        if (output_path != NULL) {
+            axiom_save(best, output_path);
+            printf("Saved \"%s\"\n", output_path);
+        }
+        axiom_free(best);
+    }
+    mnist_close(&data);
+    free(configs);
+    free(results);
+    return 0;
+}
+
+static volatile sig_atomic_t learn_stop = 0;
+
+static void on_learn_signal(int sig) {
+    (void)sig;
+    learn_stop = 1;
+}
+
+static void print_stream_stats(const StreamStats* s) {
+    double secs = s->seconds > 0.0 ? s->seconds : 1e-9;
+    double wall_ms = 1000.0 * secs;
+    printf("Trained on %zu records in %zu steps (%zu partial) over %.2f s: %.0f records/s, %.1f MB/s\n",
+           s->records, s->batches, s->partial_batches, s->seconds, s->records / secs, s->bytes / secs / 1e6);
+    printf("Rejected %zu records%s, mean loss %.4f, %zu checkpoints written\n", s->rejected,
+           s->corrupt ? " and stopped at a corrupt length prefix" : "", s->loss, s->checkpoints);
+    printf("Busy: parse %.1f%%, convert %.1f%%, train %.1f%%; reader blocked on training %.1f%%, trainer waiting on input %.1f%%\n",
+           100.0 * s->parse_ms / wall_ms, 100.0 * s->convert_ms / wall_ms, 100.0 * s->train_ms / wall_ms,
+           100.0 * s->reader_blocked_ms / wall_ms, 100.0 * s->train_wait_ms / wall_ms);
+}
+
+/* Online learning from length-prefixed records on stdin or a FIFO (format in src/stream.h), until the stream
+ * closes or SIGINT/SIGTERM; checkpoints are published along the way and once more at the end. */
+static int run_learn(int argc, char* argv[]) {
+    const char* model_path = NULL;
+    const char* input = "-";
+    const char* output_path = NULL;
+    const char* opt_name = "sgd";
+    size_t features = 0, classes = 0, hidden = 128;
+    float momentum = 0.9f;
+    StreamConfig cfg = { .batch_size = 64, .num_buffers = 4, .flush_ms = 100.0, .learning_rate = 0.01f,
+                         .report_every_seconds = 5.0, .stop = &learn_stop };
+    const char* checkpoint_path = NULL;
+    size_t checkpoint_steps = 0;
+    double checkpoint_secs = 0.0;
+    for (int i = 2; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--model") == 0) { model_path = argv[i + 1]; i++; }
+        else if (strcmp(argv[i], "--input") == 0) { input = argv[i + 1]; i++; }
+        else if (strcmp(argv[i], "--output") == 0) { output_path = argv[i + 1]; i++; }
+        else if (strcmp(argv[i], "--features") == 0) { features = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--classes") == 0) { classes = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--hidden") == 0) { hidden = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--optimizer") == 0) { opt_name = argv[i + 1]; i++; }
+        else if (strcmp(argv[i], "--momentum") == 0) { momentum = (float)atof(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--lr") == 0) { cfg.learning_rate = (float)atof(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--batch") == 0) { cfg.batch_size = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--buffers") == 0) { cfg.num_buffers = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--flush-ms") == 0) { cfg.flush_ms = atof(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--max-records") == 0) { cfg.max_records = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--report-secs") == 0) { cfg.report_every_seconds = atof(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--checkpoint") == 0) { checkpoint_path = argv[i + 1]; i++; }
+        else if (strcmp(argv[i], "--checkpoint-steps") == 0) { checkpoint_steps = (size_t)atol(argv[i + 1]); i++; }
+        else if (strcmp(argv[i], "--checkpoint-secs") == 0) { checkpoint_secs = atof(argv[i + 1]); i++; }
+    }
+
+    AxiomNet* net = NULL;
+    if (model_path != NULL) {
+        net = axiom_load(model_path);
+        if (net == NULL) {
+            printf("learn: could not load \"%s\"\n", model_path);
+            return 1;
+        }
+    } else if (features > 0 && classes > 0) {
+        net = stream_net(features, hidden, classes, create_optimizer(opt_name, cfg.learning_rate, momentum, 0.0f));
+        if (net == NULL) {
+            printf("learn: could not create a %zu -> %zu -> %zu net with optimizer \"%s\"\n", features, hidden, classes, opt_name);
+            return 1;
+        }
+    } else {
+        printf("learn: give --model <file>, or --features <n> and --classes <n> for a new net\n");
+        return 1;
+    }
+    net->train_opts.checkpoint_path = checkpoint_path;
+    net->train_opts.checkpoint_every_steps = checkpoint_steps;
+    net->train_opts.checkpoint_every_seconds = checkpoint_secs;
+    if (checkpoint_path != NULL && checkpoint_steps == 0 && checkpoint_secs <= 0.0)
+        net->train_opts.checkpoint_every_seconds = 60.0;
+
+    /* opening a FIFO blocks until a writer shows up */
+    int fd = strcmp(input, "-") == 0 ? STDIN_FILENO : open(input, O_RDONLY);
+    if (fd < 0) {
+        printf("learn: could not open \"%s\"\n", input);
+        axiom_free(net);
+        return 1;
+    }
+    signal(SIGINT, on_learn_signal);
+    signal(SIGTERM, on_learn_signal);
+    printf("Learning from %s: batch %zu, %zu buffers per stage, flush after %.0f ms idle%s%s\n",
+           fd == STDIN_FILENO ? "stdin" : input, cfg.batch_size, cfg.num_buffers, cfg.flush_ms,
+           checkpoint_path ? ", checkpoints to " : "", checkpoint_path ? checkpoint_path : "");
+    fflush(stdout);
+
+    StreamStats stats;
+    int rc = stream_learn(net, fd, &cfg, &stats);
+    if (fd != STDIN_FILENO) close(fd);
+    print_stream_stats(&stats);
+    if (rc != 0) printf("learn: the stream ended with an error\n");
+    if (output_path != NULL) {
+        axiom_save(net, output_path);
+        printf("Saved \"%s\"\n", output_path);
+    }
     axiom_free(net);
+    return rc != 0;
 }
 
 int main(int argc, char* argv[]) {
@@ -229,16 +1729,58 @@ int main(int argc, char* argv[]) {
         printf("  test                           Run smoke test\n");
         printf("  mnist                          Smoke-test MNIST loader\n");
         printf("  train [--epochs <n>] [--lr <rate>] [--batch <n>] [--output <path>] [--data <dir>]\n");
+        printf("        [--optimizer sgd|momentum|nesterov|adam|adamw] [--momentum <m>] [--weight-decay <wd>]\n");
+        printf("        [--shuffle 0|1] [--seed <n>] [--shuffle-window <rows>] [--target-acc <pct>]\n");
+        printf("        [--checkpoint <path> [--checkpoint-steps <n>] [--checkpoint-secs <s>]] [--trace <out.json>]\n");
+        printf("        [--mem-report <steps>] [--task-graph 0|1] [--deterministic 0|1] [--rank <r>]\n");
+        printf("        [--augment 0|1] [--aug-shift <px>] [--aug-rotate <deg>] [--aug-scale <f>] [--aug-elastic <px>]\n");
         printf("                             Train on MNIST, save checkpoint\n");
-        printf("  predict <model_file> <input>   Run inference\n");
+        printf("  sweep [--lr <a,b,..>] [--batch <a,b,..>] [--hidden <a,b,..>] [--optimizer <a,b,..>] [--random <n>]\n");
+        printf("        [--seed <n>] [--epochs <n>] [--min-epochs <n>] [--eta <n>] [--workers <n>] [--val-rows <n>]\n");
+        printf("        [--data <dir>] [--output <path>]\n");
+        printf("                             Train many configs at once on one copy of the data, successive halving\n");
+        printf("  predict <model_file> <input>   Score each row (IDX bytes, or text rows of numbers) with the batch-1 predictor\n");
+        printf("  evaluate <model_file> [--data <dir>] [--batch <n>] [--compare]\n");
+        printf("                             Accuracy, top-k, loss and confusion matrix on the test set\n");
+        printf("  export-c <model_file> <out.c> [--prefix <name>]\n");
+        printf("                             Compile a model to standalone, specialized C inference code\n");
+        printf("  compress <model_file> <out_file> (--rank <r> | --energy <e>) [--data <dir>]\n");
+        printf("                             Factor dense layers by truncated SVD; report size, FLOPs and accuracy\n");
+        printf("  serve <model_file> [--socket <path>] [--max-batch <n>] [--max-delay-ms <ms>] [--workers <n>]\n");
+        printf("                             Batching inference server on a UNIX socket\n");
+        printf("  learn (--model <file> | --features <n> --classes <n> [--hidden <n>]) [--input <fifo>|-]\n");
+        printf("        [--batch <n>] [--lr <rate>] [--optimizer <name>] [--buffers <n>] [--flush-ms <ms>]\n");
+        printf("        [--max-records <n>] [--checkpoint <path> [--checkpoint-steps <n>] [--checkpoint-secs <s>]]\n");
+        printf("        [--report-secs <s>] [--output <path>]\n");
+        printf("                             Train continuously from length-prefixed records on stdin or a FIFO\n");
+        printf("  convert <out_file> (--idx <images> <labels> | --csv <file> [--type u8|f16|f32]) [--block-rows <n>]\n");
+        printf("                             Write a chunked out-of-core dataset\n");
+        printf("  tune <model_file> [--batch <a,b,..>] [--inference] [--force]\n");
+        printf("                             Autotune GEMM tilings for a model's layer shapes into the tuning cache\n");
+        printf("Benchmarks and load/record generators: ./build/bench --help\n");
         return 1;
     }
 
     if (strcmp(argv[1], "train") == 0) {
-        run_train(argc, argv);
-        return 0;
+        return run_train(argc, argv);
+    } else if (strcmp(argv[1], "sweep") == 0) {
+        return run_sweep(argc, argv);
     } else if (strcmp(argv[1], "predict") == 0) {
-        printf("Inference not yet implemented\n");
+        return run_predict(argc, argv);
+    } else if (strcmp(argv[1], "evaluate") == 0) {
+        return run_evaluate(argc, argv);
+    } else if (strcmp(argv[1], "export-c") == 0) {
+        return run_export_c(argc, argv);
+    } else if (strcmp(argv[1], "compress") == 0) {
+        return run_compress(argc, argv);
+    } else if (strcmp(argv[1], "serve") == 0) {
+        return run_serve(argc, argv);
+    } else if (strcmp(argv[1], "learn") == 0) {
+        return run_learn(argc, argv);
+    } else if (strcmp(argv[1], "convert") == 0) {
+        return run_convert(argc, argv);
+    } else if (strcmp(argv[1], "tune") == 0) {
+        return run_tune(argc, argv);
     } else {
         printf("Unknown command: %s\n", argv[1]);
         return 1;
@@ -0,0 +1,95 @@
+#include "memstats.h"
+#include <stdatomic.h>
+
+typedef struct {
+    atomic_size_t live;
+    atomic_size_t peak;
+    atomic_size_t allocs;
+    atomic_size_t frees;
+} Counter;
+
+static Counter counters[MEM_NUM_CATEGORIES];
+static atomic_size_t total_live;
+static atomic_size_t total_peak;
+static _Thread_local MemCategory current_category = MEM_TEMPORARY;
+
+static const char* const category_names[MEM_NUM_CATEGORIES] = {
+    "params", "grads", "optimizer", "activations", "temporary", "dataset", "checkpoint",
+};
+
+static void raise_peak(atomic_size_t* peak, size_t value) {
+    size_t seen = atomic_load_explicit(peak, memory_order_relaxed);
+    while (value > seen &&
+           !atomic_compare_exchange_weak_explicit(peak, &seen, value, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+void mem_track_alloc(MemCategory cat, size_t bytes) {
+    if ((unsigned)cat >= MEM_NUM_CATEGORIES) return;
+    size_t live = atomic_fetch_add_explicit(&counters[cat].live, bytes, memory_order_relaxed) + bytes;
+    raise_peak(&counters[cat].peak, live);
+    atomic_fetch_add_explicit(&counters[cat].allocs, 1, memory_order_relaxed);
+    size_t total = atomic_fetch_add_explicit(&total_live, bytes, memory_order_relaxed) + bytes;
+    raise_peak(&total_peak, total);
+}
+
+void mem_track_free(MemCategory cat, size_t bytes) {
+    if ((unsigned)cat >= MEM_NUM_CATEGORIES) return;
+    atomic_fetch_sub_explicit(&counters[cat].live, bytes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&counters[cat].frees, 1, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&total_live, bytes, memory_order_relaxed);
+}
+
+MemCategory mem_set_category(MemCategory cat) {
+    MemCategory prev = current_category;
+    if ((unsigned)cat < MEM_NUM_CATEGORIES) current_category = cat;
+    return prev;
+}
+
+MemCategory mem_category(void) {
+    return current_category;
+}
+
+void mem_stats(MemStats* stats) {
+    if (stats == NULL) return;
+    for (int c = 0; c < MEM_NUM_CATEGORIES; c++) {
+        MemCategoryStats* s = &stats->category[c];
+        s->live_bytes = atomic_load_explicit(&counters[c].live, memory_order_relaxed);
+        s->peak_bytes = atomic_load_explicit(&counters[c].peak, memory_order_relaxed);
+        s->allocs = atomic_load_explicit(&counters[c].allocs, memory_order_relaxed);
+        s->frees = atomic_load_explicit(&counters[c].frees, memory_order_relaxed);
+    }
+    stats->live_bytes = atomic_load_explicit(&total_live, memory_order_relaxed);
+    stats->peak_bytes = atomic_load_explicit(&total_peak, memory_order_relaxed);
+}
+
+void mem_reset_peak(void) {
+    for (int c = 0; c < MEM_NUM_CATEGORIES; c++) {
+        atomic_store(&counters[c].peak, atomic_load(&counters[c].live));
+    }
+    atomic_store(&total_peak, atomic_load(&total_live));
+}
+
+const char* mem_category_name(MemCategory cat) {
+    return (unsigned)cat < MEM_NUM_CATEGORIES ? category_names[cat] : "unknown";
+}
+
+void mem_print_line(FILE* out, const MemStats* stats) {
+    fprintf(out, "live %.2f MB (", (double)stats->live_bytes / 1048576.0);
+    for (int c = 0; c < MEM_NUM_CATEGORIES; c++) {
+        fprintf(out, "%s%s %.2f", c > 0 ? ", " : "", category_names[c],
+                (double)stats->category[c].live_bytes / 1048576.0);
+    }
+    fprintf(out, "), peak %.2f MB\n", (double)stats->peak_bytes / 1048576.0);
+}
+
+void mem_print_table(FILE* out, const MemStats* stats) {
+    fprintf(out, "%-12s %12s %12s %12s %12s\n", "memory", "live MB", "peak MB", "allocs", "frees");
+    for (int c = 0; c < MEM_NUM_CATEGORIES; c++) {
+        const MemCategoryStats* s = &stats->category[c];
+        fprintf(out, "%-12s %12.2f %12.2f %12zu %12zu\n", category_names[c],
+                (double)s->live_bytes / 1048576.0, (double)s->peak_bytes / 1048576.0, s->allocs, s->frees);
+    }
+    fprintf(out, "%-12s %12.2f %12.2f\n", "total", (double)stats->live_bytes / 1048576.0,
+            (double)stats->peak_bytes / 1048576.0);
+}
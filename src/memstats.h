@@ -0,0 +1,61 @@
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Process-wide accounting of the memory the library allocates, by category.
+ * Byte counts are what was requested (tensor data plus shape/stride metadata,
+ * arena and batch buffers), not allocator overhead. File-backed mappings
+ * (mmapped datasets and checkpoints) aren't heap memory and aren't counted.
+ */
+typedef enum {
+    MEM_PARAMS,        // weights and biases
+    MEM_GRADS,         // their gradients
+    MEM_OPTIMIZER,     // per-parameter optimizer state (momentum, adam m/v)
+    MEM_ACTIVATIONS,   // per-layer caches kept for the backward pass
+    MEM_TEMPORARY,     // layer outputs, gradients in flight, scratch; the default for new tensors
+    MEM_DATASET,       // in-memory dataset tensors, batch buffers and row orders
+    MEM_CHECKPOINT,    // checkpoint staging and load buffers
+    MEM_NUM_CATEGORIES
+} MemCategory;
+
+typedef struct {
+    size_t live_bytes;
+    size_t peak_bytes;    // highest live_bytes this category alone has reached
+    size_t allocs;
+    size_t frees;
+} MemCategoryStats;
+
+typedef struct {
+    MemCategoryStats category[MEM_NUM_CATEGORIES];
+    size_t live_bytes;    // all categories
+    size_t peak_bytes;    // highest simultaneous total
+} MemStats;
+
+void mem_track_alloc(MemCategory cat, size_t bytes);
+void mem_track_free(MemCategory cat, size_t bytes);
+
+// Category new tensors on the calling thread are accounted under (MEM_TEMPORARY
+// unless set). Returns the previous one so callers can restore it:
+//   MemCategory prev = mem_set_category(MEM_ACTIVATIONS);
+//   layer->input_cache = tensor_copy(input);
+//   mem_set_category(prev);
+MemCategory mem_set_category(MemCategory cat);
+MemCategory mem_category(void);
+
+void mem_stats(MemStats* stats);
+
+// Start peaks over from the current live values
+void mem_reset_peak(void);
+
+const char* mem_category_name(MemCategory cat);
+
+// One line: live total and per-category live bytes, plus the total peak
+void mem_print_line(FILE* out, const MemStats* stats);
+
+// Table of live, peak and allocation counts per category
+void mem_print_table(FILE* out, const MemStats* stats);
+
+#endif // MEMSTATS_H
@@ -2,14 +2,46 @@
 #define MNIST_H
 
 #include "tensor.h"
+#include "idx.h"
+#include "dataset.h"
+
+#define MNIST_NUM_CLASSES 10
 
 /**
- * Load MNIST train and test data from IDX files under base_path.
+ * MNIST (or any dataset in the same four-file IDX layout) opened in place.
  *
  * base_path should be the directory containing:
  *   train-images.idx3-ubyte, train-labels.idx1-ubyte
  *   t10k-images-idx3-ubyte,  t10k-labels-idx1-ubyte
  *
+ * The files are memory-mapped and left as bytes; the datasets convert rows
+ * to floats only when they are gathered:
+ *
+ * - x_train / x_test: one row per image (any image size), pixels scaled to [0, 1]
+ * - y_train / y_test: label datasets, one byte class id per row. Training and
+ *   evaluation read the ids directly; gathered as floats they are one-hot over
+ *   MNIST_NUM_CLASSES. Out-of-range labels have no class (all-zero rows).
+ *
+ * image_height / image_width come from the image files' header (rows then
+ * columns of each sample), 0 if the file isn't 3D.
+ */
+typedef struct {
+    IdxFile* files[4];    // train images, train labels, test images, test labels
+    Dataset x_train;
+    Dataset y_train;
+    Dataset x_test;
+    Dataset y_test;
+    size_t image_height;
+    size_t image_width;
+} MnistData;
+
+// Returns 0 on success, -1 on error (missing file, invalid format or mismatched counts)
+int mnist_open(const char* base_path, MnistData* out);
+void mnist_close(MnistData* data);
+
+/**
+ * Load MNIST train and test data from IDX files under base_path as float tensors.
+ *
  * On success, allocates four tensors and sets *out_x_train, *out_y_train,
  * *out_x_test, *out_y_test. Caller must tensor_free each.
  *
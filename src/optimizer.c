@@ -1,15 +1,64 @@
 #include "optimizer.h"
+#include <math.h>
 #include <stdlib.h>
 #include "dense.h"
 #include "axiom.h"
+#include "parallel.h"
+#include "simd.h"
 
-Optimizer* optimizer_sgd_create(float learning_rate) {
+#define OPTIMIZER_GRAIN 16384  // floats per parallel chunk; a multiple of PARAM_ALIGN_FLOATS
+
+static Optimizer* optimizer_alloc(int type, float learning_rate) {
     Optimizer* opt = malloc(sizeof(Optimizer));
     if (opt == NULL) return NULL;
 
     opt->learning_rate = learning_rate;
-    opt->type = OPTIMIZER_SGD;
+    opt->type = type;
+    opt->momentum = 0.0f;
+    opt->beta1 = 0.9f;
+    opt->beta2 = 0.999f;
+    opt->epsilon = 1e-8f;
+    opt->weight_decay = 0.0f;
+    opt->t = 0;
+    opt->arena = NULL;
+
+    return opt;
+}
 
+Optimizer* optimizer_sgd_create(float learning_rate) {
+    return optimizer_alloc(OPTIMIZER_SGD, learning_rate);
+}
+
+Optimizer* optimizer_momentum_create(float learning_rate, float momentum) {
+    Optimizer* opt = optimizer_alloc(OPTIMIZER_MOMENTUM, learning_rate);
+    if (opt == NULL) return NULL;
+    opt->momentum = momentum;
+    return opt;
+}
+
+Optimizer* optimizer_nesterov_create(float learning_rate, float momentum) {
+    Optimizer* opt = optimizer_alloc(OPTIMIZER_NESTEROV, learning_rate);
+    if (opt == NULL) return NULL;
+    opt->momentum = momentum;
+    return opt;
+}
+
+Optimizer* optimizer_adam_create(float learning_rate, float beta1, float beta2, float epsilon) {
+    Optimizer* opt = optimizer_alloc(OPTIMIZER_ADAM, learning_rate);
+    if (opt == NULL) return NULL;
+    opt->beta1 = beta1;
+    opt->beta2 = beta2;
+    opt->epsilon = epsilon;
+    return opt;
+}
+
+Optimizer* optimizer_adamw_create(float learning_rate, float beta1, float beta2, float epsilon, float weight_decay) {
+    Optimizer* opt = optimizer_alloc(OPTIMIZER_ADAMW, learning_rate);
+    if (opt == NULL) return NULL;
+    opt->beta1 = beta1;
+    opt->beta2 = beta2;
+    opt->epsilon = epsilon;
+    opt->weight_decay = weight_decay;
     return opt;
 }
 
@@ -18,6 +67,180 @@ void optimizer_free(Optimizer* opt) {
     free(opt);
 }
 
+size_t optimizer_num_state(const Optimizer* opt) {
+    if (opt == NULL) return 0;
+
+    switch (opt->type) {
+        case OPTIMIZER_MOMENTUM:
+        case OPTIMIZER_NESTEROV:
+            return 1;  // velocity
+        case OPTIMIZER_ADAM:
+        case OPTIMIZER_ADAMW:
+            return 2;  // first and second moment
+        default:
+            return 0;
+    }
+}
+
+typedef struct {
+    const Optimizer* opt;
+    float* params;
+    const float* grads;
+    float* state0;
+    float* state1;
+    float c1;  // adam bias corrections: 1 / (1 - beta^t)
+    float c2;
+} UpdateJob;
+
+// one pass per chunk: read param, grad and state once, write param and state once
+static void update_range(void* ctx, size_t begin, size_t end) {
+    const UpdateJob* job = ctx;
+    const Optimizer* opt = job->opt;
+    float* p = job->params;
+    const float* g = job->grads;
+    float* s0 = job->state0;
+    float* s1 = job->state1;
+
+    float lr = opt->learning_rate;
+    float wd = opt->weight_decay;
+    f32x4 vlr = f32x4_set1(lr);
+    f32x4 vwd = f32x4_set1(wd);
+    size_t i = begin;
+
+    switch (opt->type) {
+        case OPTIMIZER_SGD: {
+            // w -= lr * (dW + wd * w)
+            for (; i + SIMD_WIDTH <= end; i += SIMD_WIDTH) {
+                f32x4 w = f32x4_load(p + i);
+                f32x4 d = f32x4_load(g + i) + vwd * w;
+                f32x4_store(p + i, w - vlr * d);
+            }
+            for (; i < end; i++) {
+                p[i] -= lr * (g[i] + wd * p[i]);
+            }
+            break;
+        }
+        case OPTIMIZER_MOMENTUM:
+        case OPTIMIZER_NESTEROV: {
+            // v = mu * v + d; w -= lr * v  (nesterov looks ahead: w -= lr * (d + mu * v))
+            float mu = opt->momentum;
+            int nesterov = (opt->type == OPTIMIZER_NESTEROV);
+            f32x4 vmu = f32x4_set1(mu);
+            for (; i + SIMD_WIDTH <= end; i += SIMD_WIDTH) {
+                f32x4 w = f32x4_load(p + i);
+                f32x4 d = f32x4_load(g + i) + vwd * w;
+                f32x4 v = vmu * f32x4_load(s0 + i) + d;
+                f32x4_store(s0 + i, v);
+                f32x4 step = nesterov ? d + vmu * v : v;
+                f32x4_store(p + i, w - vlr * step);
+            }
+            for (; i < end; i++) {
+                float d = g[i] + wd * p[i];
+                float v = mu * s0[i] + d;
+                s0[i] = v;
+                p[i] -= lr * (nesterov ? d + mu * v : v);
+            }
+            break;
+        }
+        case OPTIMIZER_ADAM:
+        case OPTIMIZER_ADAMW: {
+            // m = b1 m + (1 - b1) d; v = b2 v + (1 - b2) d^2; w -= lr * m_hat / (sqrt(v_hat) + eps)
+            // adam folds weight decay into d, adamw applies it to w directly
+            float b1 = opt->beta1, b2 = opt->beta2, eps = opt->epsilon;
+            float c1 = job->c1, c2 = job->c2;
+            float l2 = (opt->type == OPTIMIZER_ADAM) ? wd : 0.0f;
+            float decoupled = (opt->type == OPTIMIZER_ADAMW) ? wd : 0.0f;
+            f32x4 vb1 = f32x4_set1(b1), vb1c = f32x4_set1(1.0f - b1);
+            f32x4 vb2 = f32x4_set1(b2), vb2c = f32x4_set1(1.0f - b2);
+            f32x4 vc1 = f32x4_set1(c1), vc2 = f32x4_set1(c2);
+            f32x4 veps = f32x4_set1(eps);
+            f32x4 vl2 = f32x4_set1(l2), vdec = f32x4_set1(decoupled);
+            for (; i + SIMD_WIDTH <= end; i += SIMD_WIDTH) {
+                f32x4 w = f32x4_load(p + i);
+                f32x4 d = f32x4_load(g + i) + vl2 * w;
+                f32x4 m = vb1 * f32x4_load(s0 + i) + vb1c * d;
+                f32x4 v = vb2 * f32x4_load(s1 + i) + vb2c * d * d;
+                f32x4_store(s0 + i, m);
+                f32x4_store(s1 + i, v);
+                f32x4 step = (m * vc1) / (f32x4_sqrt(v * vc2) + veps) + vdec * w;
+                f32x4_store(p + i, w - vlr * step);
+            }
+            for (; i < end; i++) {
+                float d = g[i] + l2 * p[i];
+                float m = b1 * s0[i] + (1.0f - b1) * d;
+                float v = b2 * s1[i] + (1.0f - b2) * d * d;
+                s0[i] = m;
+                s1[i] = v;
+                p[i] -= lr * ((m * c1) / (sqrtf(v * c2) + eps) + decoupled * p[i]);
+            }
+            break;
+        }
+    }
+}
+
+static UpdateJob update_job(const Optimizer* opt, float* params, const float* grads, float* state0, float* state1) {
+    double t = (opt->t > 0) ? (double)opt->t : 1.0;
+    UpdateJob job = {
+        .opt = opt,
+        .params = params,
+        .grads = grads,
+        .state0 = state0,
+        .state1 = state1,
+        .c1 = (float)(1.0 / (1.0 - pow(opt->beta1, t))),
+        .c2 = (float)(1.0 / (1.0 - pow(opt->beta2, t))),
+    };
+    return job;
+}
+
+void optimizer_update(Optimizer* opt, float* params, const float* grads,
+                      float* state0, float* state1, size_t n) {
+    if (opt == NULL || params == NULL || grads == NULL) return;
+    size_t num_state = optimizer_num_state(opt);
+    if ((num_state > 0 && state0 == NULL) || (num_state > 1 && state1 == NULL)) return;
+
+    UpdateJob job = update_job(opt, params, grads, state0, state1);
+    parallel_for(n, OPTIMIZER_GRAIN, update_range, &job);
+}
+
+typedef struct {
+    UpdateJob job;          // pointers at the start of the table
+    const size_t* rows;
+    size_t dim;
+} RowUpdateJob;
+
+// the same update on just the listed rows; a row sits at row * dim in params, grads and state alike
+static void update_rows(void* ctx, size_t begin, size_t end) {
+    const RowUpdateJob* rj = ctx;
+    for (size_t k = begin; k < end; k++) {
+        size_t off = rj->rows[k] * rj->dim;
+        UpdateJob job = rj->job;
+        job.params += off;
+        job.grads += off;
+        if (job.state0 != NULL) job.state0 += off;
+        if (job.state1 != NULL) job.state1 += off;
+        update_range(&job, 0, rj->dim);
+    }
+}
+
+// one fused update over a layer's whole arena slice; returns 0 if the layer doesn't live in the optimizer's arena
+static int arena_step(Optimizer* opt, const float* first, size_t off, size_t count) {
+    ParamArena* arena = opt->arena;
+    if (arena == NULL || arena->num_state < optimizer_num_state(opt) || first != arena->params + off) return 0;
+    optimizer_update(opt, arena->params + off, arena->grads + off,
+                     arena->state[0] ? arena->state[0] + off : NULL,
+                     arena->state[1] ? arena->state[1] + off : NULL,
+                     count);
+    return 1;
+}
+
+// not in an arena: p -= lr * dp. axiom_backward puts the layers in the arena first for any
+// optimizer with state or weight decay, so this only runs for plain sgd
+static void sgd_step(const Optimizer* opt, Tensor* param, const Tensor* grad) {
+    for (size_t i = 0; i < param->size; i++) {
+        param->data[i] -= opt->learning_rate * grad->data[i];
+    }
+}
+
 void optimizer_step(Optimizer* opt, Layer* layer) {
     if (opt == NULL || layer == NULL) return;
 
@@ -25,15 +248,54 @@ void optimizer_step(Optimizer* opt, Layer* layer) {
         case LAYER_DENSE: {
             DenseLayer* dense = layer->layer.dense;
             if (dense == NULL || dense->grad_weights == NULL || dense->grad_biases == NULL) return;
+            dense_invalidate_packed(dense);
+
+            // weights and biases sit back to back in the arena, so the whole layer is one fused update
+            if (arena_step(opt, dense->weights->data, dense->param_offset, dense->param_count)) break;
+
+            sgd_step(opt, dense->weights, dense->grad_weights);
+            sgd_step(opt, dense->biases, dense->grad_biases);
+            break;
+        }
+        case LAYER_DENSE_LOWRANK: {
+            LowRankLayer* lr = layer->layer.lowrank;
+            if (lr == NULL || lr->grad_u == NULL || lr->grad_v == NULL || lr->grad_biases == NULL) return;
+
+            // likewise [u | v | biases]
+            if (arena_step(opt, lr->u->data, lr->param_offset, lr->param_count)) break;
+
+            sgd_step(opt, lr->u, lr->grad_u);
+            sgd_step(opt, lr->v, lr->grad_v);
+            sgd_step(opt, lr->biases, lr->grad_biases);
+            break;
+        }
+        case LAYER_EMBEDDING: {
+            // lazy: only rows this batch touched are updated, and their momentum or moments advance
+            // only then. adam's bias correction still uses the global step count.
+            EmbeddingLayer* emb = layer->layer.embedding;
+            if (emb == NULL || emb->grad_table == NULL || emb->num_rows == 0) return;
 
-            // update weights: W -= lr * dW
-            for (size_t i = 0; i < dense->weights->size; i++) {
-                dense->weights->data[i] -= opt->learning_rate * dense->grad_weights->data[i];
+            size_t dim = emb->dim;
+            ParamArena* arena = opt->arena;
+            if (arena != NULL && arena->num_state >= optimizer_num_state(opt) &&
+                emb->table->data == arena->params + emb->param_offset) {
+                size_t off = emb->param_offset;
+                RowUpdateJob rj = {
+                    .job = update_job(opt, arena->params + off, arena->grads + off,
+                                      arena->state[0] ? arena->state[0] + off : NULL,
+                                      arena->state[1] ? arena->state[1] + off : NULL),
+                    .rows = emb->rows,
+                    .dim = dim,
+                };
+                size_t grain = OPTIMIZER_GRAIN / dim > 0 ? OPTIMIZER_GRAIN / dim : 1;
+                parallel_for(emb->num_rows, grain, update_rows, &rj);
+                break;
             }
 
-            // update biases: b -= lr * db
-            for (size_t i = 0; i < dense->biases->size; i++) {
-                dense->biases->data[i] -= opt->learning_rate * dense->grad_biases->data[i];
+            for (size_t k = 0; k < emb->num_rows; k++) {
+                float* w = emb->table->data + emb->rows[k] * dim;
+                const float* g = emb->grad_table->data + emb->rows[k] * dim;
+                for (size_t j = 0; j < dim; j++) w[j] -= opt->learning_rate * g[j];
             }
             break;
         }
@@ -1,20 +1,45 @@
 #ifndef OPTIMIZER_H
 #define OPTIMIZER_H
 
+#include <stddef.h>
+#include "params.h"
+
 // Forward declaration (circular dependecy otherwise)
 typedef struct Layer Layer;
 
 typedef struct {
     float learning_rate;
     enum {
-        OPTIMIZER_SGD
+        OPTIMIZER_SGD,
+        OPTIMIZER_MOMENTUM,
+        OPTIMIZER_NESTEROV,
+        OPTIMIZER_ADAM,
+        OPTIMIZER_ADAMW
     } type;
+    float momentum;       // momentum / nesterov
+    float beta1;          // adam / adamw
+    float beta2;
+    float epsilon;
+    float weight_decay;   // l2 penalty, decoupled for adamw
+    size_t t;             // steps taken, for adam bias correction
+    ParamArena* arena;    // state lives here; set by axiom_params_build, not owned
 } Optimizer;
 
 Optimizer* optimizer_sgd_create(float learning_rate);
+Optimizer* optimizer_momentum_create(float learning_rate, float momentum);
+Optimizer* optimizer_nesterov_create(float learning_rate, float momentum);
+Optimizer* optimizer_adam_create(float learning_rate, float beta1, float beta2, float epsilon);
+Optimizer* optimizer_adamw_create(float learning_rate, float beta1, float beta2, float epsilon, float weight_decay);
 void optimizer_free(Optimizer* opt);
 
+// Number of per-parameter state buffers the optimizer keeps in the arena
+size_t optimizer_num_state(const Optimizer* opt);
+
 // Update weights and biases using gradients
 void optimizer_step(Optimizer* opt, Layer* layer);
 
+// Fused update over a flat slice of the arena: params, grads and state at the same offsets
+void optimizer_update(Optimizer* opt, float* params, const float* grads,
+                      float* state0, float* state1, size_t n);
+
 #endif // OPTIMIZER_H
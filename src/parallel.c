@@ -0,0 +1,245 @@
+#define _GNU_SOURCE  /* pthread_setaffinity_np */
+#include "parallel.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define PARALLEL_MAX_THREADS 64
+
+// one persistent pool shared by every kernel. a job is posted by bumping
+// `generation`; workers and the caller then pull chunk indices off
+// `next_chunk` until it runs past the end.
+typedef struct {
+    pthread_mutex_t owner;  // held by whichever thread is running a parallel_for
+    pthread_mutex_t mu;     // guards everything below
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    pthread_t workers[PARALLEL_MAX_THREADS];
+    size_t num_workers;     // started workers, caller not included
+    size_t num_threads;     // requested size incl. caller, 0 = not resolved yet
+    int started;
+    int stopping;
+    int atexit_registered;
+    int pin;                // pin threads to cpus as they start
+    unsigned long generation;
+    size_t busy;            // workers still inside the current job
+
+    parallel_fn fn;
+    void* ctx;
+    size_t n;
+    size_t grain;
+    atomic_size_t next_chunk;
+} Pool;
+
+static Pool pool = {
+    .owner = PTHREAD_MUTEX_INITIALIZER,
+    .mu = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+// set on pool workers and on the caller while it owns the pool, so nested calls run inline
+static _Thread_local int in_parallel = 0;
+// set by parallel_set_inline
+static _Thread_local int run_inline = 0;
+
+static size_t resolve_num_threads(void) {
+    if (pool.num_threads > 0) return pool.num_threads;
+
+    long n = 0;
+    const char* env = getenv("AXIOM_NUM_THREADS");
+    if (env != NULL) n = atol(env);
+    if (n <= 0) n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n <= 0) n = 1;
+    if (n > PARALLEL_MAX_THREADS) n = PARALLEL_MAX_THREADS;
+
+    pool.num_threads = (size_t)n;
+    return pool.num_threads;
+}
+
+static void run_chunks(void) {
+    size_t num_chunks = (pool.n + pool.grain - 1) / pool.grain;
+    for (;;) {
+        size_t c = atomic_fetch_add(&pool.next_chunk, 1);
+        if (c >= num_chunks) break;
+
+        size_t begin = c * pool.grain;
+        size_t end = begin + pool.grain;
+        if (end > pool.n) end = pool.n;
+        pool.fn(pool.ctx, begin, end);
+    }
+}
+
+static void* worker_main(void* arg) {
+    unsigned long seen = (unsigned long)(uintptr_t)arg;  // generation at spawn time
+    in_parallel = 1;
+
+    pthread_mutex_lock(&pool.mu);
+    for (;;) {
+        while (!pool.stopping && pool.generation == seen) {
+            pthread_cond_wait(&pool.wake, &pool.mu);
+        }
+        if (pool.stopping) break;
+        seen = pool.generation;
+        pthread_mutex_unlock(&pool.mu);
+
+        run_chunks();
+
+        pthread_mutex_lock(&pool.mu);
+        if (--pool.busy == 0) pthread_cond_signal(&pool.done);
+    }
+    pthread_mutex_unlock(&pool.mu);
+    return NULL;
+}
+
+// cpu < 0 lifts the pin again
+static void pin_thread(pthread_t thread, long cpu) {
+#ifdef __linux__
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu <= 0) ncpu = 1;
+    if (ncpu > CPU_SETSIZE) ncpu = CPU_SETSIZE;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (cpu < 0) {
+        for (long i = 0; i < ncpu; i++) CPU_SET(i, &set);
+    } else {
+        CPU_SET(cpu % ncpu, &set);
+    }
+    pthread_setaffinity_np(thread, sizeof(set), &set);
+#else
+    (void)thread;
+    (void)cpu;
+#endif
+}
+
+// both of these expect pool.owner to be held
+static void pool_stop(void) {
+    if (!pool.started) return;
+
+    pthread_mutex_lock(&pool.mu);
+    pool.stopping = 1;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.mu);
+
+    for (size_t i = 0; i < pool.num_workers; i++) {
+        pthread_join(pool.workers[i], NULL);
+    }
+    pool.num_workers = 0;
+    pool.stopping = 0;
+    pool.started = 0;
+}
+
+static void pool_start(void) {
+    if (pool.started) return;
+
+    pthread_mutex_lock(&pool.mu);
+    size_t want = resolve_num_threads();
+    pthread_mutex_unlock(&pool.mu);
+
+    pool.num_workers = 0;
+    for (size_t i = 0; i + 1 < want; i++) {
+        void* arg = (void*)(uintptr_t)pool.generation;
+        if (pthread_create(&pool.workers[i], NULL, worker_main, arg) != 0) break;
+        if (pool.pin) pin_thread(pool.workers[i], (long)i + 1);
+        pool.num_workers++;
+    }
+    pool.started = 1;
+
+    if (!pool.atexit_registered) {
+        atexit(parallel_shutdown);  // join workers so leak checkers see a clean exit
+        pool.atexit_registered = 1;
+    }
+}
+
+int parallel_set_inline(int enable) {
+    int old = run_inline;
+    run_inline = enable != 0;
+    return old;
+}
+
+int parallel_is_inline(void) {
+    return in_parallel || run_inline;
+}
+
+void parallel_for(size_t n, size_t grain, parallel_fn fn, void* ctx) {
+    if (n == 0 || fn == NULL) return;
+    if (grain == 0) grain = 1;
+
+    // chunk boundaries are the same on the serial path so results don't depend on who ran them
+    int serial = (n <= grain || in_parallel || run_inline || pthread_mutex_trylock(&pool.owner) != 0);
+    if (!serial) {
+        pool_start();
+        if (pool.num_workers == 0) {
+            pthread_mutex_unlock(&pool.owner);
+            serial = 1;
+        }
+    }
+    if (serial) {
+        for (size_t begin = 0; begin < n; begin += grain) {
+            size_t end = (begin + grain < n) ? begin + grain : n;
+            fn(ctx, begin, end);
+        }
+        return;
+    }
+
+    in_parallel = 1;
+
+    pthread_mutex_lock(&pool.mu);
+    pool.fn = fn;
+    pool.ctx = ctx;
+    pool.n = n;
+    pool.grain = grain;
+    atomic_store(&pool.next_chunk, 0);
+    pool.busy = pool.num_workers;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.mu);
+
+    run_chunks();
+
+    pthread_mutex_lock(&pool.mu);
+    while (pool.busy > 0) {
+        pthread_cond_wait(&pool.done, &pool.mu);
+    }
+    pthread_mutex_unlock(&pool.mu);
+
+    in_parallel = 0;
+    pthread_mutex_unlock(&pool.owner);
+}
+
+size_t parallel_num_threads(void) {
+    pthread_mutex_lock(&pool.mu);
+    size_t n = resolve_num_threads();
+    pthread_mutex_unlock(&pool.mu);
+    return n;
+}
+
+void parallel_set_num_threads(size_t n) {
+    if (n == 0) n = 1;
+    if (n > PARALLEL_MAX_THREADS) n = PARALLEL_MAX_THREADS;
+
+    pthread_mutex_lock(&pool.owner);
+    pool_stop();
+    pthread_mutex_lock(&pool.mu);
+    pool.num_threads = n;
+    pthread_mutex_unlock(&pool.mu);
+    pthread_mutex_unlock(&pool.owner);
+}
+
+void parallel_set_pinning(int enable) {
+    pthread_mutex_lock(&pool.owner);
+    pool_stop();
+    pool.pin = enable != 0;
+    pin_thread(pthread_self(), enable ? 0 : -1);
+    pthread_mutex_unlock(&pool.owner);
+}
+
+void parallel_shutdown(void) {
+    pthread_mutex_lock(&pool.owner);
+    pool_stop();
+    pthread_mutex_unlock(&pool.owner);
+}
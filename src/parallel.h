@@ -0,0 +1,41 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stddef.h>
+
+// Body of a parallel loop: processes indices [begin, end)
+typedef void (*parallel_fn)(void* ctx, size_t begin, size_t end);
+
+/**
+ * Split [0, n) into chunks of `grain` indices and run fn over them on the
+ * shared worker pool. The calling thread takes part and the call returns
+ * once every chunk is done.
+ *
+ * Calls made from inside a worker, or while another thread already owns the
+ * pool, run serially on the calling thread instead of blocking.
+ */
+void parallel_for(size_t n, size_t grain, parallel_fn fn, void* ctx);
+
+// Number of threads parallel_for uses (caller included).
+// Defaults to AXIOM_NUM_THREADS if set, otherwise the number of online cpus.
+size_t parallel_num_threads(void);
+void parallel_set_num_threads(size_t n);
+
+// Pin the calling thread to cpu 0 and pool worker i to cpu i + 1 (wrapping), or
+// undo that with 0, so repeated timings don't wander between cores. Restarts
+// the pool. A no-op where thread affinity isn't supported.
+void parallel_set_pinning(int enable);
+
+// Make the calling thread's parallel_for calls run serially on it (1) or use
+// the pool again (0). For threads that are themselves one of many concurrent
+// jobs, e.g. sweep workers each training their own model. Returns the old setting.
+int parallel_set_inline(int enable);
+
+// 1 if this thread's parallel_for calls run serially whatever the pool is doing: it's a pool
+// worker, it's inside a parallel_for already, or it was set inline.
+int parallel_is_inline(void);
+
+// Stop and join the workers; the pool restarts lazily on next use.
+void parallel_shutdown(void);
+
+#endif // PARALLEL_H
@@ -0,0 +1,49 @@
+#include "params.h"
+#include "memstats.h"
+#include <stdlib.h>
+#include <string.h>
+
+size_t param_arena_pad(size_t n) {
+    return (n + PARAM_ALIGN_FLOATS - 1) / PARAM_ALIGN_FLOATS * PARAM_ALIGN_FLOATS;
+}
+
+ParamArena* param_arena_create(size_t size, size_t num_state) {
+    if (num_state > PARAM_MAX_STATE) return NULL;
+
+    ParamArena* arena = malloc(sizeof(ParamArena));
+    if (arena == NULL) return NULL;
+
+    size = param_arena_pad(size);
+    size_t regions = 2 + num_state;
+    size_t bytes = regions * size * sizeof(float);
+    if (bytes == 0) bytes = PARAM_ALIGN;  // aligned_alloc wants a non-zero multiple of the alignment
+
+    arena->data = aligned_alloc(PARAM_ALIGN, bytes);
+    if (arena->data == NULL) {
+        free(arena);
+        return NULL;
+    }
+    memset(arena->data, 0, bytes);
+
+    arena->size = size;
+    arena->num_state = num_state;
+    mem_track_alloc(MEM_PARAMS, size * sizeof(float));
+    mem_track_alloc(MEM_GRADS, size * sizeof(float));
+    if (num_state > 0) mem_track_alloc(MEM_OPTIMIZER, num_state * size * sizeof(float));
+    arena->params = arena->data;
+    arena->grads = arena->data + size;
+    for (size_t s = 0; s < PARAM_MAX_STATE; s++) {
+        arena->state[s] = (s < num_state) ? arena->data + (2 + s) * size : NULL;
+    }
+
+    return arena;
+}
+
+void param_arena_free(ParamArena* arena) {
+    if (arena == NULL) return;
+    mem_track_free(MEM_PARAMS, arena->size * sizeof(float));
+    mem_track_free(MEM_GRADS, arena->size * sizeof(float));
+    if (arena->num_state > 0) mem_track_free(MEM_OPTIMIZER, arena->num_state * arena->size * sizeof(float));
+    free(arena->data);
+    free(arena);
+}
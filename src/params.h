@@ -0,0 +1,36 @@
+#ifndef PARAMS_H
+#define PARAMS_H
+
+#include <stddef.h>
+
+#define PARAM_ALIGN 64                          // bytes; one cache line
+#define PARAM_ALIGN_FLOATS (PARAM_ALIGN / sizeof(float))
+#define PARAM_MAX_STATE 2                       // adam keeps m and v
+
+/**
+ * One aligned allocation holding every trainable parameter of a network,
+ * the matching gradients and the optimizer's per-parameter state:
+ *
+ *   [ params | grads | state[0] | state[1] ]
+ *
+ * Each region holds `size` floats and a parameter lives at the same offset in
+ * all of them, so an optimizer update is one pass over parallel arrays.
+ * Layer tensors are views into the params/grads regions.
+ */
+typedef struct ParamArena {
+    float* data;
+    float* params;
+    float* grads;
+    float* state[PARAM_MAX_STATE];
+    size_t size;        // floats per region, a multiple of PARAM_ALIGN_FLOATS
+    size_t num_state;
+} ParamArena;
+
+// Allocates a zeroed arena. size is rounded up to keep every region aligned.
+ParamArena* param_arena_create(size_t size, size_t num_state);
+void param_arena_free(ParamArena* arena);
+
+// Round a float count up so the next slice starts on a PARAM_ALIGN boundary
+size_t param_arena_pad(size_t n);
+
+#endif // PARAMS_H
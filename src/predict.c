@@ -0,0 +1,258 @@
+#include "predict.h"
+#include "simd.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// a panel is four vectors of accumulators
+#if PREDICT_PANEL != 4 * SIMD_WIDTH
+#error "predict.c assumes PREDICT_PANEL == 4 * SIMD_WIDTH"
+#endif
+
+typedef enum {
+    STAGE_AFFINE,
+    STAGE_EMBEDDING,
+    STAGE_RELU,
+    STAGE_SOFTMAX
+} StageKind;
+
+typedef struct {
+    StageKind kind;
+    size_t in;
+    size_t out;
+    float* panels;      // affine: ceil(out / PREDICT_PANEL) panels of [in][PREDICT_PANEL], zero-padded
+    float* bias;        // affine: one per packed output, zeros past out
+    int relu;           // affine: relu applied as the panel is stored
+    const EmbeddingLayer* embedding;
+} Stage;
+
+struct Predictor {
+    Stage* stages;
+    size_t num_stages;
+    size_t num_inputs;
+    size_t num_outputs;
+    float* bufs[2];     // ping-pong activations, each as wide as the widest packed stage
+    uint32_t* nz_index; // nonzero inputs of the stage being run, gathered once for all its panels
+    float* nz_value;
+    size_t param_bytes;     // accounted as MEM_PARAMS
+    size_t scratch_bytes;   // accounted as MEM_TEMPORARY
+};
+
+static size_t padded(size_t n) {
+    return (n + PREDICT_PANEL - 1) / PREDICT_PANEL * PREDICT_PANEL;
+}
+
+static void* alloc_aligned(size_t bytes) {
+    bytes = (bytes + 63) / 64 * 64;
+    return aligned_alloc(64, bytes > 0 ? bytes : 64);
+}
+
+void predictor_free(Predictor* p) {
+    if (p == NULL) return;
+    for (size_t i = 0; p->stages != NULL && i < p->num_stages; i++) {
+        free(p->stages[i].panels);
+        free(p->stages[i].bias);
+    }
+    free(p->stages);
+    free(p->bufs[0]);
+    free(p->bufs[1]);
+    free(p->nz_index);
+    free(p->nz_value);
+    if (p->param_bytes > 0) mem_track_free(MEM_PARAMS, p->param_bytes);
+    if (p->scratch_bytes > 0) mem_track_free(MEM_TEMPORARY, p->scratch_bytes);
+    free(p);
+}
+
+// next stage, checking it takes the width the previous one produced
+static Stage* add_stage(Predictor* p, StageKind kind, size_t in, size_t out, size_t* width) {
+    if (*width != 0 && *width != in) return NULL;
+    if (*width == 0) p->num_inputs = in;
+    *width = out;
+    Stage* s = &p->stages[p->num_stages++];
+    s->kind = kind;
+    s->in = in;
+    s->out = out;
+    return s;
+}
+
+// W is [in, out] row-major; bias may be NULL
+static int add_affine(Predictor* p, const float* w, const float* bias, size_t in, size_t out, size_t* width) {
+    Stage* s = add_stage(p, STAGE_AFFINE, in, out, width);
+    if (s == NULL) return -1;
+    size_t num_panels = padded(out) / PREDICT_PANEL;
+    size_t bytes = (num_panels * in * PREDICT_PANEL + padded(out)) * sizeof(float);
+    s->panels = alloc_aligned(num_panels * in * PREDICT_PANEL * sizeof(float));
+    s->bias = alloc_aligned(padded(out) * sizeof(float));
+    if (s->panels == NULL || s->bias == NULL) return -1;
+    mem_track_alloc(MEM_PARAMS, bytes);
+    p->param_bytes += bytes;
+
+    tensor_pack_panels(w, in, out, out, 1, s->panels);
+    for (size_t j = 0; j < padded(out); j++) s->bias[j] = (bias != NULL && j < out) ? bias[j] : 0.0f;
+    return 0;
+}
+
+static int add_layer(Predictor* p, const Layer* layer, size_t* width) {
+    switch (layer->type) {
+    case LAYER_DENSE: {
+        const DenseLayer* d = layer->layer.dense;
+        return add_affine(p, d->weights->data, d->biases->data, d->input_size, d->output_size, width);
+    }
+    case LAYER_DENSE_LOWRANK: {
+        const LowRankLayer* l = layer->layer.lowrank;
+        if (add_affine(p, l->u->data, NULL, l->input_size, l->rank, width) != 0) return -1;
+        return add_affine(p, l->v->data, l->biases->data, l->rank, l->output_size, width);
+    }
+    case LAYER_EMBEDDING: {
+        const EmbeddingLayer* e = layer->layer.embedding;
+        Stage* s = add_stage(p, STAGE_EMBEDDING, e->num_fields, e->num_fields * e->dim, width);
+        if (s == NULL) return -1;
+        s->embedding = e;
+        return 0;
+    }
+    case LAYER_ACTIVATION: {
+        // activations run in place on the previous stage's output, so they can't come first
+        if (*width == 0) return -1;
+        Stage* prev = &p->stages[p->num_stages - 1];
+        if (layer->layer.activation->type == ACTIVATION_RELU) {
+            if (prev->kind == STAGE_AFFINE && !prev->relu) {
+                prev->relu = 1;
+                return 0;
+            }
+            return add_stage(p, STAGE_RELU, *width, *width, width) != NULL ? 0 : -1;
+        }
+        if (layer->layer.activation->type == ACTIVATION_SOFTMAX) {
+            return add_stage(p, STAGE_SOFTMAX, *width, *width, width) != NULL ? 0 : -1;
+        }
+        return -1;
+    }
+    default:
+        return -1;
+    }
+}
+
+Predictor* predictor_create(const AxiomNet* net) {
+    if (net == NULL || net->layers == NULL) return NULL;
+    Predictor* p = calloc(1, sizeof(Predictor));
+    if (p == NULL) return NULL;
+    p->stages = calloc(2 * net->num_layers, sizeof(Stage));  // a low-rank layer takes two
+    if (p->stages == NULL) {
+        predictor_free(p);
+        return NULL;
+    }
+
+    size_t width = 0;
+    for (const Layer* layer = net->layers; layer != NULL; layer = layer->next) {
+        if (add_layer(p, layer, &width) != 0) {
+            predictor_free(p);
+            return NULL;
+        }
+    }
+    p->num_outputs = width;
+
+    size_t max_width = 0, max_in = 0;
+    for (size_t i = 0; i < p->num_stages; i++) {
+        if (padded(p->stages[i].out) > max_width) max_width = padded(p->stages[i].out);
+        if (p->stages[i].in > max_in) max_in = p->stages[i].in;
+    }
+    p->bufs[0] = alloc_aligned(max_width * sizeof(float));
+    p->bufs[1] = alloc_aligned(max_width * sizeof(float));
+    p->nz_index = malloc(max_in * sizeof(uint32_t));
+    p->nz_value = malloc(max_in * sizeof(float));
+    if (width == 0 || p->bufs[0] == NULL || p->bufs[1] == NULL || p->nz_index == NULL || p->nz_value == NULL) {
+        predictor_free(p);
+        return NULL;
+    }
+    p->scratch_bytes = 2 * max_width * sizeof(float) + max_in * (sizeof(uint32_t) + sizeof(float));
+    mem_track_alloc(MEM_TEMPORARY, p->scratch_bytes);
+    return p;
+}
+
+size_t predictor_num_inputs(const Predictor* p) {
+    return p != NULL ? p->num_inputs : 0;
+}
+
+size_t predictor_num_outputs(const Predictor* p) {
+    return p != NULL ? p->num_outputs : 0;
+}
+
+// y[0..padded(out)) = bias + x W, relu'd if the stage says so. Zero inputs (relu outputs,
+// blank pixels) are dropped once up front rather than tested inside every panel.
+static void gemv(Predictor* p, const Stage* s, const float* x, float* y) {
+    size_t nnz = 0;
+    for (size_t k = 0; k < s->in; k++) {
+        p->nz_index[nnz] = (uint32_t)k;
+        p->nz_value[nnz] = x[k];
+        nnz += x[k] != 0.0f;
+    }
+
+    const f32x4 zero = f32x4_set1(0.0f);
+    for (size_t q = 0; q * PREDICT_PANEL < s->out; q++) {
+        const float* panel = s->panels + q * s->in * PREDICT_PANEL;
+        const float* b = s->bias + q * PREDICT_PANEL;
+        f32x4 acc0 = f32x4_load(b), acc1 = f32x4_load(b + 4), acc2 = f32x4_load(b + 8), acc3 = f32x4_load(b + 12);
+        for (size_t i = 0; i < nnz; i++) {
+            const float* w = panel + (size_t)p->nz_index[i] * PREDICT_PANEL;
+            f32x4 a = f32x4_set1(p->nz_value[i]);
+            acc0 += a * f32x4_load(w);
+            acc1 += a * f32x4_load(w + 4);
+            acc2 += a * f32x4_load(w + 8);
+            acc3 += a * f32x4_load(w + 12);
+        }
+        if (s->relu) {
+            acc0 = f32x4_max(acc0, zero);
+            acc1 = f32x4_max(acc1, zero);
+            acc2 = f32x4_max(acc2, zero);
+            acc3 = f32x4_max(acc3, zero);
+        }
+        float* o = y + q * PREDICT_PANEL;
+        f32x4_store(o, acc0);
+        f32x4_store(o + 4, acc1);
+        f32x4_store(o + 8, acc2);
+        f32x4_store(o + 12, acc3);
+    }
+}
+
+static void softmax_row(float* x, size_t width) {
+    float max_val = x[0];
+    for (size_t j = 1; j < width; j++) if (x[j] > max_val) max_val = x[j];
+    float sum = 0.0f;
+    for (size_t j = 0; j < width; j++) {
+        x[j] = expf(x[j] - max_val);
+        sum += x[j];
+    }
+    for (size_t j = 0; j < width; j++) x[j] /= sum;
+}
+
+int predictor_run(Predictor* p, const float* x, float* out) {
+    if (p == NULL || x == NULL || out == NULL) return -1;
+
+    // the first stage always has weights or a table, so activations only ever see scratch
+    const float* in = x;
+    float* cur = NULL;
+    int next = 0;
+    for (size_t i = 0; i < p->num_stages; i++) {
+        const Stage* s = &p->stages[i];
+        switch (s->kind) {
+        case STAGE_AFFINE:
+            cur = p->bufs[next];
+            gemv(p, s, in, cur);
+            break;
+        case STAGE_EMBEDDING:
+            cur = p->bufs[next];
+            if (embedding_lookup(s->embedding, in, cur, 1) != 0) return -1;
+            break;
+        case STAGE_RELU:
+            for (size_t j = 0; j < s->out; j++) cur[j] = cur[j] > 0.0f ? cur[j] : 0.0f;
+            continue;
+        case STAGE_SOFTMAX:
+            softmax_row(cur, s->out);
+            continue;
+        }
+        in = cur;
+        next ^= 1;
+    }
+    memcpy(out, in, p->num_outputs * sizeof(float));
+    return 0;
+}
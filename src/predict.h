@@ -0,0 +1,42 @@
+#ifndef PREDICT_H
+#define PREDICT_H
+
+#include <stddef.h>
+#include "axiom.h"
+
+/**
+ * Single-sample inference for latency-bound callers (an online scorer at
+ * batch 1). axiom_forward on one row still pays for the general path: a
+ * matmul with m = 1, a broadcast bias, layer caches and a tensor per layer.
+ * A Predictor compiles the net once instead:
+ *
+ * - dense weights are repacked into panels of PREDICT_PANEL outputs,
+ *   [in][PREDICT_PANEL] each, so a GEMV keeps a panel's outputs in registers
+ *   and streams its weights front to back;
+ * - the bias seeds the accumulators, and a following relu is applied as the
+ *   panel is stored;
+ * - low-rank layers become their two factors, embeddings a table lookup;
+ * - scratch for every layer is allocated up front, so predictor_run makes no
+ *   allocations at all.
+ *
+ * The packed weights are a copy taken at creation: create the predictor again
+ * after the net trains further. Embedding tables are read in place, so the
+ * net must outlive it. predictor_run uses the predictor's own scratch, so
+ * give each thread its own predictor.
+ */
+#define PREDICT_PANEL TENSOR_PANEL  // the same panels dense layers multiply from
+
+typedef struct Predictor Predictor;
+
+// NULL if the net has a layer the predictor doesn't handle, sizes that don't chain, or on out of memory
+Predictor* predictor_create(const AxiomNet* net);
+void predictor_free(Predictor* p);
+
+size_t predictor_num_inputs(const Predictor* p);
+size_t predictor_num_outputs(const Predictor* p);
+
+// out[0..num_outputs) for the single row x[0..num_inputs). Returns 0, or -1 on
+// bad arguments or an embedding id out of range.
+int predictor_run(Predictor* p, const float* x, float* out);
+
+#endif // PREDICT_H
@@ -0,0 +1,172 @@
+#include "reduce.h"
+#include "parallel.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REDUCE_PARALLEL_MIN (1u << 16)  // multiply-adds below which a split isn't worth a pool dispatch
+#define REDUCE_COMBINE_GRAIN 4096      // floats per chunk when adding partials
+
+// -1 until the first reduction reads AXIOM_DETERMINISTIC
+static atomic_int deterministic = -1;
+
+static int mode(void) {
+    int d = atomic_load_explicit(&deterministic, memory_order_relaxed);
+    if (d >= 0) return d;
+    const char* env = getenv("AXIOM_DETERMINISTIC");
+    int want = env != NULL && atoi(env) != 0;
+    atomic_compare_exchange_strong(&deterministic, &d, want);
+    return atomic_load_explicit(&deterministic, memory_order_relaxed);
+}
+
+int reduce_set_deterministic(int enable) {
+    int old = mode();
+    atomic_store(&deterministic, enable != 0);
+    return old;
+}
+
+int reduce_is_deterministic(void) {
+    return mode();
+}
+
+typedef struct {
+    const Tensor* a;
+    const Tensor* b;        // outer sums only
+    float* out;             // leaf 0 sums straight into the result
+    float* partials;        // leaves 1.., cols floats each
+    float* packed;          // outer sums: each leaf's rows of b as GEMM panels
+    size_t cols;
+    size_t leaf_rows;
+    size_t leaves;
+    int deterministic;
+    atomic_int failed;
+} ReduceJob;
+
+static float* leaf_sums(const ReduceJob* job, size_t leaf) {
+    return leaf == 0 ? job->out : job->partials + (leaf - 1) * job->cols;
+}
+
+// the split for m rows and `work` multiply-adds; sets leaf_rows and leaves
+static void plan(ReduceJob* job, size_t m, size_t work) {
+    size_t leaves = 1;
+    if (job->deterministic) {
+        leaves = (m + REDUCE_LEAF_ROWS - 1) / REDUCE_LEAF_ROWS;
+        if (leaves > REDUCE_MAX_LEAVES) leaves = REDUCE_MAX_LEAVES;
+    } else if (work >= REDUCE_PARALLEL_MIN && !parallel_is_inline()) {
+        leaves = parallel_num_threads();
+        if (leaves > (m + REDUCE_LEAF_ROWS - 1) / REDUCE_LEAF_ROWS) leaves = (m + REDUCE_LEAF_ROWS - 1) / REDUCE_LEAF_ROWS;
+    }
+    if (leaves == 0) leaves = 1;
+    job->leaf_rows = (m + leaves - 1) / leaves;
+    job->leaves = job->leaf_rows > 0 ? (m + job->leaf_rows - 1) / job->leaf_rows : 1;
+}
+
+// leaves [begin, end) of a column sum: each adds its rows in order from zero
+static void column_leaves(void* ctx, size_t begin, size_t end) {
+    ReduceJob* job = ctx;
+    const Tensor* x = job->a;
+    size_t m = x->shape[0];
+    for (size_t l = begin; l < end; l++) {
+        float* dst = leaf_sums(job, l);
+        memset(dst, 0, job->cols * sizeof(float));
+        for (size_t i = l * job->leaf_rows; i < m && i < (l + 1) * job->leaf_rows; i++) {
+            const float* row = x->data + i * x->strides[0];
+            for (size_t j = 0; j < job->cols; j++) dst[j] += row[j * x->strides[1]];
+        }
+    }
+}
+
+// leaves [begin, end) of an outer sum: a leaf's rows of a^T times its rows of b, through the packed
+// GEMM, which adds each element's products in row order from zero
+static void outer_leaves(void* ctx, size_t begin, size_t end) {
+    ReduceJob* job = ctx;
+    const Tensor* a = job->a;
+    const Tensor* b = job->b;
+    size_t m = a->shape[0], k = a->shape[1], n = b->shape[1];
+    for (size_t l = begin; l < end; l++) {
+        size_t r0 = l * job->leaf_rows;
+        size_t rows = m - r0 < job->leaf_rows ? m - r0 : job->leaf_rows;
+        float* packed = job->packed + tensor_packed_size(r0, n);
+        tensor_pack_panels(b->data + r0 * b->strides[0], rows, n, b->strides[0], b->strides[1], packed);
+
+        // a^T over this leaf's rows, as a strided view of a
+        size_t shape[] = { k, rows };
+        size_t strides[] = { a->strides[1], a->strides[0] };
+        Tensor at = { .data = a->data + r0 * a->strides[0], .shape = shape, .strides = strides, .ndim = 2, .size = k * rows };
+        Tensor* c = tensor_matmul_packed(&at, packed, n, NULL);
+        if (c == NULL) {
+            atomic_store(&job->failed, 1);
+            continue;
+        }
+        memcpy(leaf_sums(job, l), c->data, job->cols * sizeof(float));
+        tensor_free(c);
+    }
+}
+
+// elements [begin, end) of the result: the same additions, in the same order, for every element
+static void combine_range(void* ctx, size_t begin, size_t end) {
+    ReduceJob* job = ctx;
+    if (job->deterministic) {
+        for (size_t step = 1; step < job->leaves; step *= 2) {
+            for (size_t l = 0; l + step < job->leaves; l += 2 * step) {
+                float* dst = leaf_sums(job, l);
+                const float* src = leaf_sums(job, l + step);
+                for (size_t e = begin; e < end; e++) dst[e] += src[e];
+            }
+        }
+    } else {
+        for (size_t l = 1; l < job->leaves; l++) {
+            const float* src = leaf_sums(job, l);
+            for (size_t e = begin; e < end; e++) job->out[e] += src[e];
+        }
+    }
+}
+
+static int run(ReduceJob* job, size_t work, parallel_fn leaves_fn, size_t packed_floats) {
+    size_t partial_floats = (job->leaves - 1) * job->cols;
+    size_t bytes = (partial_floats + packed_floats) * sizeof(float);
+    float* scratch = bytes > 0 ? malloc(bytes) : NULL;
+    if (bytes > 0 && scratch == NULL) return -1;
+    if (bytes > 0) mem_track_alloc(MEM_TEMPORARY, bytes);
+    job->partials = scratch;
+    job->packed = scratch != NULL ? scratch + partial_floats : NULL;
+
+    // deterministic leaves give the same bits run serially or spread over the pool
+    int spread = job->leaves > 1 && work >= REDUCE_PARALLEL_MIN;
+    if (spread) parallel_for(job->leaves, 1, leaves_fn, job);
+    else leaves_fn(job, 0, job->leaves);
+    if (job->leaves > 1) {
+        if (spread && job->cols * job->leaves >= REDUCE_PARALLEL_MIN) {
+            parallel_for(job->cols, REDUCE_COMBINE_GRAIN, combine_range, job);
+        } else {
+            combine_range(job, 0, job->cols);
+        }
+    }
+
+    if (bytes > 0) mem_track_free(MEM_TEMPORARY, bytes);
+    free(scratch);
+    return atomic_load(&job->failed) ? -1 : 0;
+}
+
+int reduce_column_sums(const Tensor* x, float* out) {
+    if (x == NULL || out == NULL || x->ndim != 2) return -1;
+    size_t m = x->shape[0], n = x->shape[1];
+    ReduceJob job = { .a = x, .out = out, .cols = n, .deterministic = mode() };
+    atomic_init(&job.failed, 0);
+    plan(&job, m, m * n);
+    return run(&job, m * n, column_leaves, 0);
+}
+
+int reduce_outer_sums(const Tensor* a, const Tensor* b, float* out) {
+    if (a == NULL || b == NULL || out == NULL || a->ndim != 2 || b->ndim != 2) return -1;
+    if (a->shape[0] != b->shape[0]) return -1;
+    size_t m = a->shape[0], k = a->shape[1], n = b->shape[1];
+    if (m == 0 || k == 0 || n == 0) {
+        memset(out, 0, k * n * sizeof(float));
+        return 0;
+    }
+    ReduceJob job = { .a = a, .b = b, .out = out, .cols = k * n, .deterministic = mode() };
+    atomic_init(&job.failed, 0);
+    plan(&job, m, m * k * n);
+    return run(&job, m * k * n, outer_leaves, tensor_packed_size(m, n));
+}
@@ -0,0 +1,38 @@
+#ifndef REDUCE_H
+#define REDUCE_H
+
+#include <stddef.h>
+#include "tensor.h"
+
+/**
+ * Sums over the rows of a batch (a dense layer's weight and bias gradients),
+ * split over the pool. Each "leaf" is a contiguous run of rows summed in
+ * order into its own partial, and the partials are then added together.
+ * How the rows are split decides the rounding, and there are two modes:
+ *
+ * - fast (default): one leaf per pool thread, added left to right. A call
+ *   from inside a parallel region, or one too small to be worth splitting,
+ *   is a single leaf, which gives exactly the serial sum. Results can change
+ *   with the thread count.
+ * - deterministic (AXIOM_DETERMINISTIC=1, or reduce_set_deterministic):
+ *   leaves of REDUCE_LEAF_ROWS rows (at most REDUCE_MAX_LEAVES of them, with
+ *   bigger leaves for bigger batches) combined by a fixed pairwise tree. The
+ *   shape depends only on the batch size, so training gives the same bits
+ *   whatever the thread count, task graph or scheduling.
+ */
+#define REDUCE_LEAF_ROWS 16
+#define REDUCE_MAX_LEAVES 8
+
+// Deterministic mode on (1) or off (0) for every later reduction; returns the old setting.
+// Set it before training starts, not while reductions are running.
+int reduce_set_deterministic(int enable);
+int reduce_is_deterministic(void);
+
+// out[j] = sum over rows i of x[i][j], for the n columns of a [m, n] x
+int reduce_column_sums(const Tensor* x, float* out);
+
+// out = a^T b as an [k, n] row-major block: the sum over rows i of the outer product of a[i] ([m, k])
+// and b[i] ([m, n]). Returns 0, or -1 on mismatched shapes or out of memory.
+int reduce_outer_sums(const Tensor* a, const Tensor* b, float* out);
+
+#endif // REDUCE_H
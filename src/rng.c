@@ -0,0 +1,35 @@
+#include "rng.h"
+
+void rng_seed(Rng* rng, uint64_t seed) {
+    rng->state = seed;
+}
+
+uint64_t rng_next(Rng* rng) {
+    uint64_t z = (rng->state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+uint32_t rng_below(Rng* rng, uint32_t n) {
+    // multiply-shift maps 32 random bits onto [0, n); the bias is far below anything training can notice
+    return (uint32_t)(((rng_next(rng) >> 32) * (uint64_t)n) >> 32);
+}
+
+float rng_uniform(Rng* rng) {
+    return (float)(rng_next(rng) >> 40) * (1.0f / 16777216.0f);  // top 24 bits, exact in a float
+}
+
+void rng_shuffle(Rng* rng, size_t* a, size_t n) {
+    for (size_t i = n; i > 1; i--) {
+        size_t j = (size_t)(rng_next(rng) % i);  // modulo bias is ~i / 2^64
+        size_t tmp = a[i - 1];
+        a[i - 1] = a[j];
+        a[j] = tmp;
+    }
+}
+
+void rng_permutation(Rng* rng, size_t* perm, size_t n) {
+    for (size_t i = 0; i < n; i++) perm[i] = i;
+    rng_shuffle(rng, perm, n);
+}
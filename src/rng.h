@@ -0,0 +1,28 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Small seeded generator (splitmix64) with its own state, unlike rand()/srand().
+// The same seed always yields the same stream on every platform.
+typedef struct {
+    uint64_t state;
+} Rng;
+
+void rng_seed(Rng* rng, uint64_t seed);
+uint64_t rng_next(Rng* rng);
+
+// Uniform integer in [0, n)
+uint32_t rng_below(Rng* rng, uint32_t n);
+
+// Uniform float in [0, 1)
+float rng_uniform(Rng* rng);
+
+// Shuffle a[0..n) in place (Fisher-Yates)
+void rng_shuffle(Rng* rng, size_t* a, size_t n);
+
+// Fill perm with a uniformly random permutation of 0..n-1 (Fisher-Yates)
+void rng_permutation(Rng* rng, size_t* perm, size_t n);
+
+#endif // RNG_H
@@ -0,0 +1,523 @@
+#define _POSIX_C_SOURCE 200809L
+#include "serve.h"
+#include "axiom.h"
+#include "predict.h"
+#include "timer.h"
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+// a client connection. shared by its reader thread and every queued request
+// from it, and closed when the last of those lets go.
+typedef struct ServeConn {
+    int fd;
+    int refs;                     // guarded by server->lock
+    pthread_mutex_t write_lock;   // workers answer from different threads
+    struct ServeConn* next;       // live-reader list, for shutdown
+    struct ServeConn* prev;
+} ServeConn;
+
+typedef struct ServeRequest {
+    ServeConn* conn;
+    uint32_t id;
+    uint64_t enqueued_ns;
+    struct ServeRequest* next;
+    float features[];
+} ServeRequest;
+
+struct ServeServer {
+    ServeConfig cfg;
+    char socket_path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+    int listen_fd;
+    size_t num_features;
+    size_t num_outputs;
+
+    AxiomNet** nets;              // one per worker
+    pthread_t* workers;
+    size_t num_workers;
+    pthread_t acceptor;
+
+    pthread_mutex_t lock;         // guards everything below
+    pthread_cond_t queue_cv;      // signalled on enqueue and on stop
+    pthread_cond_t readers_cv;    // signalled when a reader exits
+    ServeRequest* head;
+    ServeRequest* tail;
+    size_t queued;
+    ServeConn* conns;
+    size_t num_readers;
+    int stopping;
+
+    uint64_t served;
+    uint64_t batches;
+};
+
+typedef struct {
+    ServeServer* server;
+    ServeConn* conn;
+} ReaderArgs;
+
+int serve_read_full(int fd, void* buf, size_t n) {
+    char* p = buf;
+    while (n > 0) {
+        ssize_t r = read(fd, p, n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return -1;
+        p += r;
+        n -= (size_t)r;
+    }
+    return 0;
+}
+
+int serve_write_full(int fd, const void* buf, size_t n) {
+    const char* p = buf;
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return -1;
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+// call with server->lock held
+static void conn_release(ServeConn* conn) {
+    if (--conn->refs > 0) return;
+    close(conn->fd);
+    pthread_mutex_destroy(&conn->write_lock);
+    free(conn);
+}
+
+static void respond(ServeConn* conn, const ServeResponseHeader* hdr, const float* outputs) {
+    pthread_mutex_lock(&conn->write_lock);
+    if (serve_write_full(conn->fd, hdr, sizeof *hdr) == 0 && hdr->num_outputs > 0) {
+        serve_write_full(conn->fd, outputs, hdr->num_outputs * sizeof(float));
+    }
+    pthread_mutex_unlock(&conn->write_lock);
+}
+
+static void* reader_main(void* arg) {
+    ReaderArgs* args = arg;
+    ServeServer* server = args->server;
+    ServeConn* conn = args->conn;
+    free(args);
+
+    for (;;) {
+        ServeRequestHeader hdr;
+        if (serve_read_full(conn->fd, &hdr, sizeof hdr) != 0) break;
+
+        if (hdr.magic != SERVE_REQUEST_MAGIC || hdr.num_features != server->num_features) {
+            // the stream can't be resynced after a bad header, so answer and hang up
+            ServeResponseHeader res = {SERVE_RESPONSE_MAGIC, hdr.id, SERVE_BAD_REQUEST, 0, 0, 0, 0, 0};
+            respond(conn, &res, NULL);
+            break;
+        }
+
+        ServeRequest* req = malloc(sizeof(ServeRequest) + server->num_features * sizeof(float));
+        if (req == NULL) break;
+        if (serve_read_full(conn->fd, req->features, server->num_features * sizeof(float)) != 0) {
+            free(req);
+            break;
+        }
+        req->id = hdr.id;
+        req->next = NULL;
+        req->enqueued_ns = timer_now_ns();
+
+        pthread_mutex_lock(&server->lock);
+        if (server->stopping) {
+            pthread_mutex_unlock(&server->lock);
+            free(req);
+            break;
+        }
+        req->conn = conn;
+        conn->refs++;
+        if (server->tail != NULL) server->tail->next = req;
+        else server->head = req;
+        server->tail = req;
+        server->queued++;
+        pthread_cond_signal(&server->queue_cv);
+        pthread_mutex_unlock(&server->lock);
+    }
+
+    pthread_mutex_lock(&server->lock);
+    if (conn->prev != NULL) conn->prev->next = conn->next;
+    else server->conns = conn->next;
+    if (conn->next != NULL) conn->next->prev = conn->prev;
+    server->num_readers--;
+    conn_release(conn);
+    pthread_cond_broadcast(&server->readers_cv);
+    pthread_mutex_unlock(&server->lock);
+    return NULL;
+}
+
+static void* acceptor_main(void* arg) {
+    ServeServer* server = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&server->lock);
+        int stopping = server->stopping;
+        pthread_mutex_unlock(&server->lock);
+        if (stopping) break;
+
+        // poll with a timeout so a stop request is noticed without closing the fd under accept()
+        struct pollfd pfd = {server->listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0) continue;
+
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+
+        ServeConn* conn = malloc(sizeof(ServeConn));
+        ReaderArgs* args = malloc(sizeof(ReaderArgs));
+        if (conn == NULL || args == NULL) {
+            free(conn);
+            free(args);
+            close(fd);
+            continue;
+        }
+        conn->fd = fd;
+        conn->refs = 1;  // the reader's
+        pthread_mutex_init(&conn->write_lock, NULL);
+        args->server = server;
+        args->conn = conn;
+
+        pthread_mutex_lock(&server->lock);
+        conn->prev = NULL;
+        conn->next = server->conns;
+        if (server->conns != NULL) server->conns->prev = conn;
+        server->conns = conn;
+        server->num_readers++;
+        pthread_mutex_unlock(&server->lock);
+
+        pthread_t reader;
+        if (pthread_create(&reader, NULL, reader_main, args) != 0) {
+            pthread_mutex_lock(&server->lock);
+            server->conns = conn->next;
+            if (conn->next != NULL) conn->next->prev = NULL;
+            server->num_readers--;
+            conn_release(conn);
+            pthread_mutex_unlock(&server->lock);
+            free(args);
+            continue;
+        }
+        pthread_detach(reader);
+    }
+    return NULL;
+}
+
+// block until there is work, then until the batch is full or the oldest request has waited
+// max_delay. returns the number of requests unlinked into *out, 0 once stopped and drained.
+static size_t take_batch(ServeServer* server, ServeRequest** out) {
+    uint64_t max_delay_ns = (uint64_t)(server->cfg.max_delay_ms * 1e6);
+
+    pthread_mutex_lock(&server->lock);
+    for (;;) {
+        while (server->queued == 0 && !server->stopping) {
+            pthread_cond_wait(&server->queue_cv, &server->lock);
+        }
+        if (server->queued == 0) {
+            pthread_mutex_unlock(&server->lock);
+            return 0;
+        }
+
+        uint64_t deadline = server->head->enqueued_ns + max_delay_ns;
+        while (server->queued > 0 && server->queued < server->cfg.max_batch && !server->stopping) {
+            uint64_t now = timer_now_ns();
+            if (now >= deadline) break;
+
+            // condvars time out on the realtime clock
+            uint64_t wait_ns = deadline - now;
+            struct timespec abs;
+            clock_gettime(CLOCK_REALTIME, &abs);
+            abs.tv_sec += (time_t)(wait_ns / 1000000000ull);
+            abs.tv_nsec += (long)(wait_ns % 1000000000ull);
+            if (abs.tv_nsec >= 1000000000L) {
+                abs.tv_sec++;
+                abs.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&server->queue_cv, &server->lock, &abs);
+        }
+        if (server->queued > 0) break;  // another worker may have taken it while we slept
+    }
+
+    size_t n = 0;
+    ServeRequest* first = server->head;
+    ServeRequest* last = NULL;
+    while (server->head != NULL && n < server->cfg.max_batch) {
+        last = server->head;
+        server->head = server->head->next;
+        n++;
+    }
+    last->next = NULL;
+    if (server->head == NULL) server->tail = NULL;
+    server->queued -= n;
+    // leftovers may already be due for another worker
+    if (server->queued > 0) pthread_cond_signal(&server->queue_cv);
+    pthread_mutex_unlock(&server->lock);
+
+    *out = first;
+    return n;
+}
+
+typedef struct {
+    ServeServer* server;
+    AxiomNet* net;
+} WorkerArgs;
+
+static void* worker_main(void* arg) {
+    WorkerArgs* args = arg;
+    ServeServer* server = args->server;
+    AxiomNet* net = args->net;
+    free(args);
+
+    // a lone request skips the batched path: no tensors, no layer caches
+    Predictor* predictor = predictor_create(net);
+    float* single = predictor != NULL ? malloc(server->num_outputs * sizeof(float)) : NULL;
+
+    size_t nf = server->num_features;
+    for (;;) {
+        ServeRequest* batch = NULL;
+        size_t n = take_batch(server, &batch);
+        if (n == 0) break;
+
+        uint64_t start = timer_now_ns();
+        Tensor* out = NULL;
+        const float* outputs = NULL;
+        if (n == 1 && single != NULL) {
+            if (predictor_run(predictor, batch->features, single) == 0) outputs = single;
+        } else {
+            size_t shape[] = {n, nf};
+            Tensor* x = tensor_create(shape, 2);
+            if (x != NULL) {
+                size_t i = 0;
+                for (ServeRequest* r = batch; r != NULL; r = r->next, i++) {
+                    memcpy(x->data + i * nf, r->features, nf * sizeof(float));
+                }
+                out = axiom_forward(net, x);
+                tensor_free(x);
+            }
+            if (out != NULL) outputs = out->data;
+        }
+        uint64_t compute_ns = timer_now_ns() - start;
+
+        size_t i = 0;
+        for (ServeRequest* r = batch; r != NULL; r = r->next, i++) {
+            ServeResponseHeader res = {
+                .magic = SERVE_RESPONSE_MAGIC,
+                .id = r->id,
+                .status = outputs ? SERVE_OK : SERVE_INTERNAL_ERROR,
+                .num_outputs = outputs ? (uint32_t)server->num_outputs : 0,
+                .batch_size = (uint32_t)n,
+                .queue_ns = start - r->enqueued_ns,
+                .compute_ns = compute_ns,
+            };
+            respond(r->conn, &res, outputs ? outputs + i * server->num_outputs : NULL);
+        }
+        tensor_free(out);
+
+        pthread_mutex_lock(&server->lock);
+        server->served += n;
+        server->batches++;
+        while (batch != NULL) {
+            ServeRequest* next = batch->next;
+            conn_release(batch->conn);
+            free(batch);
+            batch = next;
+        }
+        pthread_mutex_unlock(&server->lock);
+    }
+    free(single);
+    predictor_free(predictor);
+    return NULL;
+}
+
+// input width of the first layer with weights, output width of the last
+static int model_dims(AxiomNet* net, size_t* in, size_t* out) {
+    *in = 0;
+    *out = 0;
+    for (Layer* cur = net->layers; cur != NULL; cur = cur->next) {
+        if (cur->type == LAYER_DENSE) {
+            if (*in == 0) *in = cur->layer.dense->input_size;
+            *out = cur->layer.dense->output_size;
+        } else if (cur->type == LAYER_DENSE_LOWRANK) {
+            if (*in == 0) *in = cur->layer.lowrank->input_size;
+            *out = cur->layer.lowrank->output_size;
+        } else if (cur->type == LAYER_EMBEDDING) {
+            if (*in == 0) *in = cur->layer.embedding->num_fields;
+            *out = cur->layer.embedding->num_fields * cur->layer.embedding->dim;
+        }
+    }
+    return (*in > 0 && *out > 0) ? 0 : -1;
+}
+
+static void server_free(ServeServer* server) {
+    if (server->listen_fd >= 0) close(server->listen_fd);
+    if (server->nets != NULL) {
+        for (size_t i = 0; i < server->cfg.num_workers; i++) axiom_free(server->nets[i]);
+    }
+    free(server->nets);
+    free(server->workers);
+    pthread_mutex_destroy(&server->lock);
+    pthread_cond_destroy(&server->queue_cv);
+    pthread_cond_destroy(&server->readers_cv);
+    free(server);
+}
+
+ServeServer* serve_start(const char* model_path, const ServeConfig* cfg) {
+    if (model_path == NULL || cfg == NULL || cfg->socket_path == NULL) return NULL;
+
+    ServeServer* server = calloc(1, sizeof(ServeServer));
+    if (server == NULL) return NULL;
+    server->cfg = *cfg;
+    if (server->cfg.max_batch == 0) server->cfg.max_batch = 1;
+    if (server->cfg.num_workers == 0) server->cfg.num_workers = 1;
+    if (server->cfg.max_delay_ms < 0.0) server->cfg.max_delay_ms = 0.0;
+    server->listen_fd = -1;
+    pthread_mutex_init(&server->lock, NULL);
+    pthread_cond_init(&server->queue_cv, NULL);
+    pthread_cond_init(&server->readers_cv, NULL);
+
+    size_t nw = server->cfg.num_workers;
+    server->nets = calloc(nw, sizeof(AxiomNet*));
+    server->workers = calloc(nw, sizeof(pthread_t));
+    if (server->nets == NULL || server->workers == NULL) {
+        server_free(server);
+        return NULL;
+    }
+    for (size_t i = 0; i < nw; i++) {
+        // the file can't change under the other workers, so checking it once is enough
+        server->nets[i] = axiom_load_mapped(model_path, i == 0);
+        if (server->nets[i] == NULL) {
+            server_free(server);
+            return NULL;
+        }
+    }
+    if (model_dims(server->nets[0], &server->num_features, &server->num_outputs) != 0) {
+        server_free(server);
+        return NULL;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (strlen(cfg->socket_path) >= sizeof addr.sun_path) {
+        server_free(server);
+        return NULL;
+    }
+    strcpy(addr.sun_path, cfg->socket_path);
+    strcpy(server->socket_path, cfg->socket_path);
+
+    server->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server->listen_fd < 0) {
+        server_free(server);
+        return NULL;
+    }
+    unlink(cfg->socket_path);  // stale socket from a previous run
+    if (bind(server->listen_fd, (struct sockaddr*)&addr, sizeof addr) != 0 ||
+        listen(server->listen_fd, 128) != 0) {
+        server_free(server);
+        return NULL;
+    }
+
+    // a client hanging up mid-response must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+
+    for (size_t i = 0; i < nw; i++) {
+        WorkerArgs* args = malloc(sizeof(WorkerArgs));
+        if (args != NULL) {
+            args->server = server;
+            args->net = server->nets[i];
+        }
+        if (args == NULL || pthread_create(&server->workers[i], NULL, worker_main, args) != 0) {
+            free(args);
+            break;
+        }
+        server->num_workers++;
+    }
+    if (server->num_workers == 0 || pthread_create(&server->acceptor, NULL, acceptor_main, server) != 0) {
+        pthread_mutex_lock(&server->lock);
+        server->stopping = 1;
+        pthread_cond_broadcast(&server->queue_cv);
+        pthread_mutex_unlock(&server->lock);
+        for (size_t i = 0; i < server->num_workers; i++) pthread_join(server->workers[i], NULL);
+        unlink(server->socket_path);
+        server_free(server);
+        return NULL;
+    }
+
+    return server;
+}
+
+void serve_stop(ServeServer* server) {
+    if (server == NULL) return;
+
+    pthread_mutex_lock(&server->lock);
+    server->stopping = 1;
+    pthread_cond_broadcast(&server->queue_cv);
+    pthread_mutex_unlock(&server->lock);
+
+    pthread_join(server->acceptor, NULL);
+
+    // wake readers blocked in read() and wait for them to let go of the server
+    pthread_mutex_lock(&server->lock);
+    for (ServeConn* c = server->conns; c != NULL; c = c->next) {
+        shutdown(c->fd, SHUT_RD);
+    }
+    while (server->num_readers > 0) {
+        pthread_cond_wait(&server->readers_cv, &server->lock);
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    for (size_t i = 0; i < server->num_workers; i++) {
+        pthread_join(server->workers[i], NULL);
+    }
+
+    unlink(server->socket_path);
+    server_free(server);
+}
+
+size_t serve_num_features(const ServeServer* server) {
+    return server ? server->num_features : 0;
+}
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+int serve_run(const char* model_path, const ServeConfig* cfg) {
+    ServeServer* server = serve_start(model_path, cfg);
+    if (server == NULL) return -1;
+
+    printf("Serving \"%s\" on %s: %zu -> %zu, max batch %zu, max delay %.2f ms, %zu workers\n",
+           model_path, server->socket_path, server->num_features, server->num_outputs,
+           server->cfg.max_batch, server->cfg.max_delay_ms, server->num_workers);
+    fflush(stdout);
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    while (!stop_requested) {
+        struct timespec tick = {0, 100 * 1000000L};
+        nanosleep(&tick, NULL);
+    }
+
+    pthread_mutex_lock(&server->lock);
+    uint64_t served = server->served;
+    uint64_t batches = server->batches;
+    pthread_mutex_unlock(&server->lock);
+
+    serve_stop(server);
+    printf("Served %llu requests in %llu batches (avg batch %.2f)\n",
+           (unsigned long long)served, (unsigned long long)batches,
+           batches ? (double)served / (double)batches : 0.0);
+    return 0;
+}
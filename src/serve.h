@@ -0,0 +1,76 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Dynamic-batching inference server on a UNIX domain socket.
+ *
+ * Clients send one sample per request and may pipeline several requests on
+ * a connection; responses carry the request id back and can arrive out of
+ * order. Requests from all connections go into one queue; a worker takes up
+ * to max_batch of them, waiting at most max_delay_ms after the oldest one
+ * arrived for the batch to fill, and runs them through axiom_forward as a
+ * single [batch, features] tensor; a batch of one goes through the worker's
+ * Predictor instead (see predict.h). Every worker has its own net, since
+ * forward passes write layer caches, but v2 checkpoints are mapped read-only
+ * so all of them (and other server processes) share one copy of the weights.
+ *
+ * Wire format (native byte order, both directions start with a header):
+ *   request:  ServeRequestHeader, then num_features floats
+ *   response: ServeResponseHeader, then num_outputs floats (0 on error)
+ */
+
+#define SERVE_REQUEST_MAGIC  0x51525841u  // "AXRQ"
+#define SERVE_RESPONSE_MAGIC 0x53525841u  // "AXRS"
+
+#define SERVE_OK             0
+#define SERVE_BAD_REQUEST    1  // wrong magic or feature count
+#define SERVE_INTERNAL_ERROR 2  // forward pass failed
+
+typedef struct {
+    uint32_t magic;
+    uint32_t id;            // echoed back in the response
+    uint32_t num_features;
+    uint32_t reserved;
+} ServeRequestHeader;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t id;
+    uint32_t status;
+    uint32_t num_outputs;
+    uint32_t batch_size;    // how many requests shared this forward pass
+    uint32_t reserved;
+    uint64_t queue_ns;      // time spent waiting for a batch
+    uint64_t compute_ns;    // time of the batched forward pass
+} ServeResponseHeader;
+
+typedef struct {
+    const char* socket_path;
+    size_t max_batch;       // requests coalesced into one forward pass
+    double max_delay_ms;    // longest the oldest queued request waits for the batch to fill
+    size_t num_workers;
+} ServeConfig;
+
+typedef struct ServeServer ServeServer;
+
+// Load the model once per worker, bind the socket and start serving in background threads.
+// Returns NULL if the model can't be loaded or the socket can't be bound.
+ServeServer* serve_start(const char* model_path, const ServeConfig* cfg);
+
+// Stop accepting, answer whatever is queued, join every thread and remove the socket file
+void serve_stop(ServeServer* server);
+
+// Feature / output width of the served model
+size_t serve_num_features(const ServeServer* server);
+
+// Blocking read/write of exactly n bytes, retrying on EINTR. Return 0 on success, -1 on EOF or error.
+int serve_read_full(int fd, void* buf, size_t n);
+int serve_write_full(int fd, const void* buf, size_t n);
+
+// serve_start, then block until SIGINT or SIGTERM and serve_stop. Returns 0 on clean shutdown.
+int serve_run(const char* model_path, const ServeConfig* cfg);
+
+#endif // SERVE_H
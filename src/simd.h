@@ -0,0 +1,194 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// 4-wide float vectors built on gcc/clang vector extensions, so the same
+// kernel source compiles to sse on x86-64 and neon on arm64. anything the
+// extensions can't express goes through a per-arch intrinsic with a scalar
+// fallback.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#define SIMD_WIDTH 4
+
+typedef float f32x4 __attribute__((vector_size(16)));
+typedef int32_t i32x4 __attribute__((vector_size(16)));  // what comparing two f32x4 gives: -1 where true, else 0
+
+// memcpy keeps loads/stores legal for unaligned pointers; compilers lower it to a single move
+static inline f32x4 f32x4_load(const float* p) {
+    f32x4 v;
+    memcpy(&v, p, sizeof v);
+    return v;
+}
+
+static inline void f32x4_store(float* p, f32x4 v) {
+    memcpy(p, &v, sizeof v);
+}
+
+static inline f32x4 f32x4_set1(float x) {
+    return (f32x4){x, x, x, x};
+}
+
+static inline f32x4 f32x4_sqrt(f32x4 v) {
+#if defined(__SSE2__)
+    return (f32x4)_mm_sqrt_ps((__m128)v);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    return (f32x4)vsqrtq_f32((float32x4_t)v);
+#else
+    return (f32x4){__builtin_sqrtf(v[0]), __builtin_sqrtf(v[1]),
+                   __builtin_sqrtf(v[2]), __builtin_sqrtf(v[3])};
+#endif
+}
+
+static inline f32x4 f32x4_max(f32x4 a, f32x4 b) {
+#if defined(__SSE2__)
+    return (f32x4)_mm_max_ps((__m128)a, (__m128)b);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    return (f32x4)vmaxq_f32((float32x4_t)a, (float32x4_t)b);
+#else
+    return (f32x4){a[0] > b[0] ? a[0] : b[0], a[1] > b[1] ? a[1] : b[1],
+                   a[2] > b[2] ? a[2] : b[2], a[3] > b[3] ? a[3] : b[3]};
+#endif
+}
+
+// bit k set where lane k of v is > 0 (so not for NaN): one bit per float, e.g. for relu masks
+static inline unsigned f32x4_positive_mask(f32x4 v) {
+#if defined(__SSE2__)
+    return (unsigned)_mm_movemask_ps(_mm_cmpgt_ps((__m128)v, _mm_setzero_ps()));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint32x4_t bits = {1, 2, 4, 8};
+    return vaddvq_u32(vandq_u32(vcgtq_f32((float32x4_t)v, vdupq_n_f32(0.0f)), bits));
+#else
+    return (unsigned)(v[0] > 0.0f) | (unsigned)(v[1] > 0.0f) << 1 | (unsigned)(v[2] > 0.0f) << 2 |
+           (unsigned)(v[3] > 0.0f) << 3;
+#endif
+}
+
+// store that goes around the cache where the isa has one (p must be 16-byte aligned);
+// pair with simd_stream_fence() before anyone else reads the data
+static inline void f32x4_stream(float* p, f32x4 v) {
+#if defined(__SSE2__)
+    _mm_stream_ps(p, (__m128)v);
+#else
+    f32x4_store(p, v);
+#endif
+}
+
+static inline void simd_stream_fence(void) {
+#if defined(__SSE2__)
+    _mm_sfence();
+#endif
+}
+
+// dst[i] = src[i] * scale, 16 bytes at a time
+static inline void simd_u8_to_f32(float* dst, const uint8_t* src, size_t n, float scale) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128 vs = _mm_set1_ps(scale);
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo = _mm_unpacklo_epi8(b, zero);
+        __m128i hi = _mm_unpackhi_epi8(b, zero);
+        _mm_storeu_ps(dst + i,      _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), vs));
+        _mm_storeu_ps(dst + i + 4,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), vs));
+        _mm_storeu_ps(dst + i + 8,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), vs));
+        _mm_storeu_ps(dst + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), vs));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t b = vld1q_u8(src + i);
+        uint16x8_t lo = vmovl_u8(vget_low_u8(b));
+        uint16x8_t hi = vmovl_u8(vget_high_u8(b));
+        vst1q_f32(dst + i,      vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), scale));
+        vst1q_f32(dst + i + 4,  vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), scale));
+        vst1q_f32(dst + i + 8,  vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), scale));
+        vst1q_f32(dst + i + 12, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), scale));
+    }
+#endif
+    for (; i < n; i++) dst[i] = (float)src[i] * scale;
+}
+
+// ieee binary16 <-> float, scalar; round to nearest even on the way down
+static inline float half_to_float(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000u) << 16;
+    uint32_t exp = (h >> 10) & 0x1fu;
+    uint32_t man = h & 0x3ffu;
+    uint32_t bits;
+    if (exp == 0x1f) {
+        bits = sign | 0x7f800000u | (man << 13);            // inf / nan
+    } else if (exp != 0) {
+        bits = sign | ((exp + 112) << 23) | (man << 13);    // normal: rebias 15 -> 127
+    } else if (man == 0) {
+        bits = sign;                                        // zero
+    } else {
+        // subnormal: shift the mantissa up until it's normalized
+        exp = 113;
+        while (!(man & 0x400u)) {
+            man <<= 1;
+            exp--;
+        }
+        bits = sign | (exp << 23) | ((man & 0x3ffu) << 13);
+    }
+    float f;
+    memcpy(&f, &bits, sizeof f);
+    return f;
+}
+
+static inline uint16_t float_to_half(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof bits);
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000u);
+    uint32_t exp = (bits >> 23) & 0xffu;
+    uint32_t man = bits & 0x7fffffu;
+
+    if (exp == 0xff) return sign | 0x7c00u | (man ? 0x200u : 0);  // inf / nan
+    int e = (int)exp - 112;
+    if (e >= 0x1f) return sign | 0x7c00u;                          // overflow -> inf
+    if (e <= 0) {
+        if (e < -10) return sign;                                  // underflow -> zero
+        man |= 0x800000u;                                          // subnormal
+        uint32_t shift = (uint32_t)(14 - e);
+        uint32_t half = man >> shift;
+        uint32_t rem = man & ((1u << shift) - 1);
+        uint32_t mid = 1u << (shift - 1);
+        if (rem > mid || (rem == mid && (half & 1))) half++;
+        return sign | (uint16_t)half;
+    }
+    uint32_t half = ((uint32_t)e << 10) | (man >> 13);
+    uint32_t rem = man & 0x1fffu;
+    if (rem > 0x1000u || (rem == 0x1000u && (half & 1))) half++;  // a carry into the exponent is still right
+    return sign | (uint16_t)half;
+}
+
+// dst[i] = half src[i] * scale
+static inline void simd_f16_to_f32(float* dst, const uint16_t* src, size_t n, float scale) {
+    size_t i = 0;
+#if defined(__F16C__)
+    __m128 vs = _mm_set1_ps(scale);
+    for (; i + 4 <= n; i += 4) {
+        __m128i h = _mm_loadl_epi64((const __m128i*)(src + i));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtph_ps(h), vs));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 4 <= n; i += 4) {
+        float16x4_t h = vreinterpret_f16_u16(vld1_u16(src + i));
+        vst1q_f32(dst + i, vmulq_n_f32(vcvt_f32_f16(h), scale));
+    }
+#endif
+    for (; i < n; i++) dst[i] = half_to_float(src[i]) * scale;
+}
+
+// read prefetch with no temporal locality hint
+#define simd_prefetch(p) __builtin_prefetch((p), 0, 0)
+
+#endif // SIMD_H
@@ -0,0 +1,549 @@
+#define _POSIX_C_SOURCE 200809L
+#include "stream.h"
+#include "checkpoint.h"
+#include "rng.h"
+#include "serve.h"
+#include "simd.h"
+#include "timer.h"
+#include "trace.h"
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define STREAM_READ_CHUNK (1u << 20)   // bytes asked of each read()
+#define STREAM_POLL_MS 100             // how often a reader waiting on input looks at the stop flags
+#define STREAM_GEN_POOL 1024           // distinct records the generator encodes, then repeats
+
+// a bounded queue of batch slots between two stages. the producer fills slots in order and the
+// consumer hands them back in order, so three counters say whose each slot is (as in dataloader.c)
+typedef struct {
+    size_t num_slots;
+    pthread_mutex_t lock;
+    pthread_cond_t cv;      // signalled on publish, release, finish and stop
+    size_t produced;
+    size_t taken;
+    size_t released;
+    int done;               // the producer has published its last slot
+    int stopping;           // the consumer gave up, so the producer should too
+} Ring;
+
+static void ring_init(Ring* r, size_t num_slots) {
+    memset(r, 0, sizeof *r);
+    r->num_slots = num_slots;
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->cv, NULL);
+}
+
+static void ring_destroy(Ring* r) {
+    pthread_mutex_destroy(&r->lock);
+    pthread_cond_destroy(&r->cv);
+}
+
+// producer: wait for a free slot. Returns 0, or -1 once the consumer has stopped
+static int ring_reserve(Ring* r, size_t* slot, double* blocked_ms) {
+    uint64_t t0 = timer_now_ns();
+    pthread_mutex_lock(&r->lock);
+    while (r->produced - r->released >= r->num_slots && !r->stopping) pthread_cond_wait(&r->cv, &r->lock);
+    int rc = r->stopping ? -1 : 0;
+    *slot = r->produced % r->num_slots;
+    pthread_mutex_unlock(&r->lock);
+    *blocked_ms += timer_elapsed_ms(t0);
+    return rc;
+}
+
+static void ring_publish(Ring* r) {
+    pthread_mutex_lock(&r->lock);
+    r->produced++;
+    pthread_cond_broadcast(&r->cv);
+    pthread_mutex_unlock(&r->lock);
+}
+
+static void ring_finish(Ring* r) {
+    pthread_mutex_lock(&r->lock);
+    r->done = 1;
+    pthread_cond_broadcast(&r->cv);
+    pthread_mutex_unlock(&r->lock);
+}
+
+// consumer: wait for the next filled slot. Returns 0, or -1 once everything published has been
+// taken and the producer is done, or the ring was stopped
+static int ring_take(Ring* r, size_t* slot, double* wait_ms) {
+    uint64_t t0 = timer_now_ns();
+    pthread_mutex_lock(&r->lock);
+    while (r->taken == r->produced && !r->done && !r->stopping) pthread_cond_wait(&r->cv, &r->lock);
+    int rc = r->taken < r->produced && !r->stopping ? 0 : -1;
+    if (rc == 0) *slot = r->taken++ % r->num_slots;
+    pthread_mutex_unlock(&r->lock);
+    *wait_ms += timer_elapsed_ms(t0);
+    return rc;
+}
+
+static void ring_release(Ring* r) {
+    pthread_mutex_lock(&r->lock);
+    r->released++;
+    pthread_cond_broadcast(&r->cv);
+    pthread_mutex_unlock(&r->lock);
+}
+
+static void ring_stop(Ring* r) {
+    pthread_mutex_lock(&r->lock);
+    r->stopping = 1;
+    pthread_cond_broadcast(&r->cv);
+    pthread_mutex_unlock(&r->lock);
+}
+
+static int ring_stopped(Ring* r) {
+    pthread_mutex_lock(&r->lock);
+    int stopping = r->stopping;
+    pthread_mutex_unlock(&r->lock);
+    return stopping;
+}
+
+// records as they came off the stream, features still in their wire format
+typedef struct {
+    uint8_t* features;      // batch_size rows of 4 * num_features bytes
+    uint8_t* is_bytes;      // per row: byte features (1) or floats (0)
+    int32_t* labels;
+    size_t rows;
+} RawBatch;
+
+typedef struct {
+    float* x_data;
+    Tensor* x;              // view over x_data, narrowed to rows
+    int32_t* labels;
+    size_t rows;
+} FloatBatch;
+
+typedef struct {
+    int fd;
+    StreamConfig cfg;
+    size_t num_features;
+    size_t num_classes;
+    RawBatch* raw;
+    FloatBatch* ready;
+    Ring raw_ring;          // reader -> converter
+    Ring ready_ring;        // converter -> trainer
+    size_t tracked_bytes;   // slot buffers, accounted as MEM_DATASET
+
+    // reader's, read by the trainer once it's joined
+    size_t records;
+    size_t rejected;
+    size_t partial_batches;
+    size_t bytes;
+    uint64_t first_byte_ns;
+    int corrupt;
+    int read_error;
+    double parse_ms;
+    double reader_blocked_ms;
+
+    // converter's
+    double convert_ms;
+    double convert_wait_ms;
+} Learner;
+
+// widths of the first layer's input and the last layer's output
+static int net_widths(const AxiomNet* net, size_t* in, size_t* out) {
+    *in = 0;
+    *out = 0;
+    for (const Layer* layer = net->layers; layer != NULL; layer = layer->next) {
+        size_t a, b;
+        if (layer->type == LAYER_DENSE) {
+            a = layer->layer.dense->input_size;
+            b = layer->layer.dense->output_size;
+        } else if (layer->type == LAYER_DENSE_LOWRANK) {
+            a = layer->layer.lowrank->input_size;
+            b = layer->layer.lowrank->output_size;
+        } else if (layer->type == LAYER_EMBEDDING) {
+            a = layer->layer.embedding->num_fields;
+            b = layer->layer.embedding->num_fields * layer->layer.embedding->dim;
+        } else {
+            continue;
+        }
+        if (*in == 0) *in = a;
+        *out = b;
+    }
+    return *in > 0 && *out > 0 ? 0 : -1;
+}
+
+static void learner_free(Learner* l) {
+    for (size_t s = 0; l->raw != NULL && s < l->cfg.num_buffers; s++) {
+        free(l->raw[s].features);
+        free(l->raw[s].is_bytes);
+        free(l->raw[s].labels);
+    }
+    for (size_t s = 0; l->ready != NULL && s < l->cfg.num_buffers; s++) {
+        tensor_free(l->ready[s].x);
+        free(l->ready[s].x_data);
+        free(l->ready[s].labels);
+    }
+    free(l->raw);
+    free(l->ready);
+    if (l->tracked_bytes > 0) mem_track_free(MEM_DATASET, l->tracked_bytes);
+}
+
+static int learner_alloc(Learner* l) {
+    size_t n = l->num_features, batch = l->cfg.batch_size, slots = l->cfg.num_buffers;
+    l->raw = calloc(slots, sizeof(RawBatch));
+    l->ready = calloc(slots, sizeof(FloatBatch));
+    if (l->raw == NULL || l->ready == NULL) return -1;
+    for (size_t s = 0; s < slots; s++) {
+        RawBatch* r = &l->raw[s];
+        r->features = malloc(batch * 4 * n);
+        r->is_bytes = malloc(batch);
+        r->labels = malloc(batch * sizeof(int32_t));
+        FloatBatch* f = &l->ready[s];
+        f->x_data = malloc(batch * n * sizeof(float));
+        f->labels = malloc(batch * sizeof(int32_t));
+        size_t shape[] = {batch, n};
+        f->x = f->x_data != NULL ? tensor_view(f->x_data, shape, 2) : NULL;
+        if (r->features == NULL || r->is_bytes == NULL || r->labels == NULL || f->x == NULL || f->labels == NULL) {
+            return -1;
+        }
+    }
+    l->tracked_bytes = slots * batch * (4 * n + 1 + 2 * sizeof(int32_t) + n * sizeof(float));
+    mem_track_alloc(MEM_DATASET, l->tracked_bytes);
+    return 0;
+}
+
+// hand the batch being filled to the converter and start the next; *b is NULL once the converter stopped
+static void reader_publish(Learner* l, RawBatch** b) {
+    ring_publish(&l->raw_ring);
+    size_t slot;
+    if (ring_reserve(&l->raw_ring, &slot, &l->reader_blocked_ms) != 0) {
+        *b = NULL;
+        return;
+    }
+    *b = &l->raw[slot];
+    (*b)->rows = 0;
+}
+
+static void* reader_main(void* arg) {
+    Learner* l = arg;
+    trace_set_thread_name("stream_reader");
+    size_t n = l->num_features, row_bytes = 4 * n, max_len = 4 + row_bytes;
+    size_t cap = STREAM_READ_CHUNK > 2 * (4 + max_len) ? STREAM_READ_CHUNK : 2 * (4 + max_len);
+    uint8_t* buf = malloc(cap);
+    size_t start = 0, end = 0;
+
+    size_t slot;
+    RawBatch* b = NULL;
+    if (buf == NULL) l->read_error = 1;
+    else if (ring_reserve(&l->raw_ring, &slot, &l->reader_blocked_ms) == 0) b = &l->raw[slot];
+    if (b != NULL) b->rows = 0;
+    uint64_t last_record = timer_now_ns();
+    int at_limit = 0;
+
+    while (b != NULL && !at_limit) {
+        // split off every whole record in the buffer
+        uint64_t t0 = timer_now_ns();
+        while (b != NULL && end - start >= 4) {
+            uint32_t len;
+            memcpy(&len, buf + start, sizeof len);
+            if (len > max_len) {
+                l->corrupt = 1;
+                break;
+            }
+            if (end - start - 4 < len) break;
+            const uint8_t* p = buf + start + 4;
+            start += 4 + (size_t)len;
+
+            int32_t label = -1;
+            if (len >= 4) memcpy(&label, p, sizeof label);
+            if ((len != 4 + row_bytes && len != 4 + n) || label < 0 || (size_t)label >= l->num_classes) {
+                l->rejected++;
+                continue;
+            }
+            memcpy(b->features + b->rows * row_bytes, p + 4, len - 4);
+            b->is_bytes[b->rows] = len == 4 + n;
+            b->labels[b->rows] = label;
+            b->rows++;
+            l->records++;
+            last_record = timer_now_ns();
+            if (l->cfg.max_records > 0 && l->records == l->cfg.max_records) {
+                at_limit = 1;
+                break;
+            }
+            if (b->rows == l->cfg.batch_size) {
+                l->parse_ms += timer_elapsed_ms(t0);
+                reader_publish(l, &b);
+                t0 = timer_now_ns();
+            }
+        }
+        l->parse_ms += timer_elapsed_ms(t0);
+        if (b == NULL || l->corrupt || at_limit) break;
+        if (start > 0) {
+            memmove(buf, buf + start, end - start);
+            end -= start;
+            start = 0;
+        }
+
+        // wait for input, handing on a partial batch once the stream has gone quiet for flush_ms
+        int timeout = STREAM_POLL_MS;
+        if (b->rows > 0 && l->cfg.flush_ms > 0.0) {
+            double left = l->cfg.flush_ms - timer_elapsed_ms(last_record);
+            if (left <= 0.0) {
+                l->partial_batches++;
+                reader_publish(l, &b);
+                continue;
+            }
+            if (left < timeout) timeout = (int)left + 1;
+        }
+        if ((l->cfg.stop != NULL && *l->cfg.stop) || ring_stopped(&l->raw_ring)) break;
+        struct pollfd pfd = {l->fd, POLLIN, 0};
+        int ready = poll(&pfd, 1, timeout);
+        if (ready < 0 && errno != EINTR) {
+            l->read_error = 1;
+            break;
+        }
+        if (ready <= 0) continue;
+        ssize_t got = read(l->fd, buf + end, cap - end);
+        if (got < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            l->read_error = 1;
+            break;
+        }
+        if (got == 0) break;
+        if (l->bytes == 0) l->first_byte_ns = timer_now_ns();
+        l->bytes += (size_t)got;
+        end += (size_t)got;
+    }
+
+    // a record cut off by the end of the stream is lost; the rows batched so far still train
+    if (end > start && !l->corrupt && !at_limit) l->rejected++;
+    if (b != NULL && b->rows > 0) {
+        if (b->rows < l->cfg.batch_size) l->partial_batches++;
+        ring_publish(&l->raw_ring);
+    }
+    ring_finish(&l->raw_ring);
+    free(buf);
+    return NULL;
+}
+
+static void* converter_main(void* arg) {
+    Learner* l = arg;
+    trace_set_thread_name("stream_convert");
+    size_t n = l->num_features, row_bytes = 4 * n;
+    float scale = l->cfg.u8_scale > 0.0f ? l->cfg.u8_scale : 1.0f / 255.0f;
+    double blocked_ms = 0.0;
+    size_t in_slot, out_slot;
+
+    while (ring_take(&l->raw_ring, &in_slot, &l->convert_wait_ms) == 0) {
+        if (ring_reserve(&l->ready_ring, &out_slot, &blocked_ms) != 0) {
+            ring_release(&l->raw_ring);
+            break;
+        }
+        uint64_t t0 = trace_begin();
+        uint64_t start = timer_now_ns();
+        const RawBatch* in = &l->raw[in_slot];
+        FloatBatch* out = &l->ready[out_slot];
+        for (size_t r = 0; r < in->rows; r++) {
+            float* dst = out->x_data + r * n;
+            const uint8_t* src = in->features + r * row_bytes;
+            if (in->is_bytes[r]) simd_u8_to_f32(dst, src, n, scale);
+            else memcpy(dst, src, n * sizeof(float));
+        }
+        memcpy(out->labels, in->labels, in->rows * sizeof(int32_t));
+        out->rows = in->rows;
+        l->convert_ms += timer_elapsed_ms(start);
+        trace_end(t0, "stream_convert", TRACE_NO_LAYER);
+        ring_release(&l->raw_ring);
+        ring_publish(&l->ready_ring);
+    }
+
+    // the reader finished (pass that on) or the trainer stopped (pass that back)
+    ring_stop(&l->raw_ring);
+    ring_finish(&l->ready_ring);
+    return NULL;
+}
+
+int stream_learn(AxiomNet* net, int fd, const StreamConfig* cfg, StreamStats* stats) {
+    if (stats != NULL) memset(stats, 0, sizeof *stats);
+    if (net == NULL || cfg == NULL || fd < 0 || cfg->batch_size == 0) return -1;
+
+    Learner* l = calloc(1, sizeof(Learner));
+    if (l == NULL) return -1;
+    l->fd = fd;
+    l->cfg = *cfg;
+    if (l->cfg.num_buffers < 2) l->cfg.num_buffers = 2;
+    if (net_widths(net, &l->num_features, &l->num_classes) != 0) {
+        free(l);
+        return -1;
+    }
+
+    // the net's optimizer keeps its state across runs; plain sgd if it has none
+    if (net->optimizer == NULL) net->optimizer = optimizer_sgd_create(cfg->learning_rate > 0.0f ? cfg->learning_rate : 0.01f);
+    if (net->optimizer == NULL || axiom_params_build(net) != 0 || learner_alloc(l) != 0) {
+        learner_free(l);
+        free(l);
+        return -1;
+    }
+    if (cfg->learning_rate > 0.0f) net->optimizer->learning_rate = cfg->learning_rate;
+
+    const AxiomTrainOptions* opts = &net->train_opts;
+    Checkpointer* ckpt = NULL;
+    if (opts->checkpoint_path != NULL) {
+        ckpt = checkpointer_create(net, opts->checkpoint_path);
+        if (ckpt == NULL) printf("Checkpointing to \"%s\" disabled: could not set up the writer\n", opts->checkpoint_path);
+    }
+
+    ring_init(&l->raw_ring, l->cfg.num_buffers);
+    ring_init(&l->ready_ring, l->cfg.num_buffers);
+    pthread_t reader, converter;
+    int have_reader = pthread_create(&reader, NULL, reader_main, l) == 0;
+    int have_converter = have_reader && pthread_create(&converter, NULL, converter_main, l) == 0;
+    if (have_reader && !have_converter) {
+        ring_stop(&l->raw_ring);
+        pthread_join(reader, NULL);
+        have_reader = 0;
+    }
+
+    trace_set_thread_name("train");
+    int rc = have_converter ? 0 : -1;
+    size_t steps = 0;
+    double loss_sum = 0.0, report_loss = 0.0, train_ms = 0.0, wait_ms = 0.0;
+    size_t report_steps = 0, report_records = 0, trained = 0;
+    uint64_t last_ckpt = timer_now_ns(), last_report = timer_now_ns();
+    size_t slot;
+    for (;;) {
+        if (rc != 0) break;
+        uint64_t t0 = trace_begin();
+        int got = ring_take(&l->ready_ring, &slot, &wait_ms);
+        trace_end(t0, "batch_wait", TRACE_NO_LAYER);
+        if (got != 0) break;
+
+        // the converter refills the slot as soon as it's released
+        FloatBatch* b = &l->ready[slot];
+        size_t rows = b->rows;
+        b->x->shape[0] = b->rows;
+        b->x->size = b->rows * l->num_features;
+        uint64_t start = timer_now_ns();
+        float loss = 0.0f;
+        if (axiom_train_step(net, b->x, NULL, b->labels, &loss) != 0) rc = -1;
+        train_ms += timer_elapsed_ms(start);
+        ring_release(&l->ready_ring);
+        trace_end(t0, "step", TRACE_NO_LAYER);
+        if (rc != 0) break;
+
+        trained += rows;
+        steps++;
+        loss_sum += loss;
+        report_loss += loss;
+        report_steps++;
+        report_records += rows;
+        if (ckpt != NULL &&
+            ((opts->checkpoint_every_steps > 0 && steps % opts->checkpoint_every_steps == 0) ||
+             (opts->checkpoint_every_seconds > 0.0 && timer_elapsed_ms(last_ckpt) >= 1000.0 * opts->checkpoint_every_seconds))) {
+            checkpointer_snapshot(ckpt, net);
+            last_ckpt = timer_now_ns();
+        }
+        if (cfg->report_every_seconds > 0.0 && timer_elapsed_ms(last_report) >= 1000.0 * cfg->report_every_seconds) {
+            double secs = timer_elapsed_ms(last_report) / 1000.0;
+            printf("Stream: %zu records trained, %.0f records/s, %zu steps, loss %.4f\n",
+                   trained, report_records / secs, steps, report_loss / report_steps);
+            fflush(stdout);
+            report_loss = 0.0;
+            report_steps = report_records = 0;
+            last_report = timer_now_ns();
+        }
+    }
+    uint64_t end_ns = timer_now_ns();
+
+    // a failed step stops both queues, so the reader and converter drop what they hold and exit
+    if (rc != 0) {
+        ring_stop(&l->ready_ring);
+        ring_stop(&l->raw_ring);
+    }
+    if (have_converter) pthread_join(converter, NULL);
+    if (have_reader) pthread_join(reader, NULL);
+    ring_destroy(&l->raw_ring);
+    ring_destroy(&l->ready_ring);
+    if (l->read_error || l->corrupt) rc = -1;
+
+    // the last word goes to the checkpoint too, even if the periodic one just missed it
+    size_t written = 0;
+    if (ckpt != NULL) {
+        CheckpointStats cs;
+        checkpointer_wait(ckpt);
+        if (steps > 0) checkpointer_snapshot(ckpt, net);
+        checkpointer_wait(ckpt);
+        checkpointer_stats(ckpt, &cs);
+        written = cs.written;
+        checkpointer_free(ckpt);
+    }
+
+    if (stats != NULL) {
+        stats->records = trained;
+        stats->rejected = l->rejected;
+        stats->batches = steps;
+        stats->partial_batches = l->partial_batches;
+        stats->bytes = l->bytes;
+        stats->checkpoints = written;
+        stats->corrupt = l->corrupt;
+        stats->seconds = l->bytes > 0 && end_ns > l->first_byte_ns ? (end_ns - l->first_byte_ns) / 1e9 : 0.0;
+        stats->parse_ms = l->parse_ms;
+        stats->convert_ms = l->convert_ms;
+        stats->train_ms = train_ms;
+        stats->reader_blocked_ms = l->reader_blocked_ms;
+        stats->train_wait_ms = wait_ms;
+        stats->loss = steps > 0 ? (float)(loss_sum / steps) : 0.0f;
+    }
+    learner_free(l);
+    free(l);
+    return rc;
+}
+
+size_t stream_record_size(size_t num_features, int bytes) {
+    return 4 + 4 + (bytes ? num_features : 4 * num_features);
+}
+
+void stream_encode_record(uint8_t* out, int32_t label, const void* features, size_t num_features, int bytes) {
+    uint32_t len = (uint32_t)(stream_record_size(num_features, bytes) - 4);
+    memcpy(out, &len, sizeof len);
+    memcpy(out + 4, &label, sizeof label);
+    memcpy(out + 8, features, bytes ? num_features : num_features * sizeof(float));
+}
+
+int stream_generate(int fd, size_t count, size_t num_features, size_t num_classes, int bytes, uint64_t seed) {
+    if (num_features == 0 || num_classes == 0) return -1;
+    size_t rec = stream_record_size(num_features, bytes);
+    float* protos = malloc(num_classes * num_features * sizeof(float));
+    float* x = malloc(num_features * sizeof(float));
+    uint8_t* xb = malloc(num_features);
+    uint8_t* pool = malloc(STREAM_GEN_POOL * rec);
+    if (protos == NULL || x == NULL || xb == NULL || pool == NULL) {
+        free(protos);
+        free(x);
+        free(xb);
+        free(pool);
+        return -1;
+    }
+
+    // a fixed pattern per class, each record that pattern with noise on top
+    Rng rng;
+    rng_seed(&rng, seed);
+    for (size_t i = 0; i < num_classes * num_features; i++) protos[i] = rng_uniform(&rng);
+    for (size_t r = 0; r < STREAM_GEN_POOL; r++) {
+        int32_t label = (int32_t)rng_below(&rng, (uint32_t)num_classes);
+        for (size_t j = 0; j < num_features; j++) {
+            x[j] = 0.7f * protos[(size_t)label * num_features + j] + 0.3f * rng_uniform(&rng);
+            xb[j] = (uint8_t)(x[j] * 255.0f);
+        }
+        stream_encode_record(pool + r * rec, label, bytes ? (const void*)xb : (const void*)x, num_features, bytes);
+    }
+    free(protos);
+    free(x);
+    free(xb);
+
+    int rc = 0;
+    for (size_t sent = 0; sent < count && rc == 0;) {
+        size_t k = count - sent < STREAM_GEN_POOL ? count - sent : STREAM_GEN_POOL;
+        rc = serve_write_full(fd, pool, k * rec);
+        sent += k;
+    }
+    free(pool);
+    return rc;
+}
@@ -0,0 +1,82 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "axiom.h"
+
+/**
+ * Online learning from a record stream: stdin, a FIFO, a socket or a file
+ * that keeps growing, for models that learn from live events rather than a
+ * dataset on disk.
+ *
+ * Record format (native byte order, records back to back, no header):
+ *   uint32 length, then `length` bytes: int32 class id, then the features,
+ *   either num_features floats (length = 4 + 4 * num_features) or
+ *   num_features bytes widened with u8_scale (length = 4 + num_features)
+ *
+ * stream_learn runs three threads as a pipeline, with bounded queues of
+ * num_buffers batches between them. Memory stays fixed however fast records
+ * arrive, and a slow trainer pushes back on the writer through the pipe.
+ *   reader:    read()s big chunks, splits them into records, checks each
+ *              record's length and label and copies it into a raw batch
+ *   converter: widens a raw batch's features into a float batch
+ *   trainer:   the calling thread; one optimizer step per batch, with
+ *              background checkpoints per the net's train_opts
+ * A batch is handed on when full, at the end of the stream, or once the
+ * stream has been idle for flush_ms with rows waiting, so a slow trickle of
+ * events still gets trained on.
+ *
+ * Records with the wrong length or a class id outside the net's outputs are
+ * counted and skipped. A length prefix longer than any valid record means the
+ * stream is corrupt, and there's no resynchronizing a length-prefixed stream,
+ * so the run stops there.
+ */
+
+typedef struct {
+    size_t batch_size;
+    size_t num_buffers;     // batches queued between each pair of stages, at least 2
+    double flush_ms;        // hand on a partial batch after this long without a record; 0 = only full batches
+    float learning_rate;    // 0 keeps the net's optimizer's rate
+    float u8_scale;         // for byte features; 0 = 1/255
+    size_t max_records;     // stop after this many accepted records; 0 = until the stream ends
+    double report_every_seconds;  // print a progress line this often; 0 = quiet
+    const volatile sig_atomic_t* stop;  // optional: set (e.g. by a signal handler) to end as if the stream closed
+} StreamConfig;
+
+typedef struct {
+    size_t records;         // accepted and trained on
+    size_t rejected;        // wrong length, class id out of range, or cut off by the end of the stream
+    size_t batches;         // optimizer steps
+    size_t partial_batches; // of those, handed on short by an idle flush or the end of the stream
+    size_t bytes;           // read from the stream
+    size_t checkpoints;     // written by the background checkpointer, the final one included
+    int corrupt;            // stopped at an impossible length prefix
+    double seconds;         // first byte read to last step
+    double parse_ms;        // reader busy splitting and copying records
+    double convert_ms;      // converter busy widening features
+    double train_ms;        // trainer busy in optimizer steps
+    double reader_blocked_ms;  // reader waiting for the converter: training is the bottleneck
+    double train_wait_ms;      // trainer waiting for a batch: input is the bottleneck
+    float loss;             // mean batch loss over the run
+} StreamStats;
+
+// Train net on the records read from fd until the stream ends (or cfg->stop or max_records), then
+// take a final checkpoint if train_opts asks for them. Uses the net's optimizer, or plain SGD if it
+// has none. Returns 0, or -1 on bad arguments, a read error, a corrupt stream or a failed step; the
+// net keeps whatever it learned either way.
+int stream_learn(AxiomNet* net, int fd, const StreamConfig* cfg, StreamStats* stats);
+
+// Bytes of one record with num_features features, as floats or (bytes = 1) as bytes
+size_t stream_record_size(size_t num_features, int bytes);
+
+// Write one record, stream_record_size bytes, to out. features are floats, or uint8_t with bytes = 1.
+void stream_encode_record(uint8_t* out, int32_t label, const void* features, size_t num_features, int bytes);
+
+// Synthetic source for tests and benchmarks: `count` records of a learnable problem (each class a
+// fixed random pattern plus noise), written to fd as fast as it will take them. Returns 0, or -1
+// if a write failed (e.g. the reader went away).
+int stream_generate(int fd, size_t count, size_t num_features, size_t num_classes, int bytes, uint64_t seed);
+
+#endif // STREAM_H
@@ -0,0 +1,120 @@
+#include "svd.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define SVD_MAX_SWEEPS 60
+#define SVD_TOL 1e-12   // columns count as orthogonal once |cos| of their angle drops below this
+
+// Hestenes one-sided Jacobi on q columns of length p (p >= q), each stored contiguously in g.
+// rotates pairs of columns until all are mutually orthogonal, applying the same rotations
+// to v (q columns of length q, starting as the identity), so that g_in v = g_out.
+static void jacobi(double* g, size_t p, size_t q, double* v) {
+    for (size_t i = 0; i < q * q; i++) v[i] = 0.0;
+    for (size_t i = 0; i < q; i++) v[i * q + i] = 1.0;
+
+    for (int sweep = 0; sweep < SVD_MAX_SWEEPS; sweep++) {
+        int rotated = 0;
+        for (size_t j = 0; j + 1 < q; j++) {
+            for (size_t k = j + 1; k < q; k++) {
+                double* gj = g + j * p;
+                double* gk = g + k * p;
+                double alpha = 0.0, beta = 0.0, gamma = 0.0;
+                for (size_t i = 0; i < p; i++) {
+                    alpha += gj[i] * gj[i];
+                    beta += gk[i] * gk[i];
+                    gamma += gj[i] * gk[i];
+                }
+                if (gamma == 0.0 || fabs(gamma) <= SVD_TOL * sqrt(alpha * beta)) continue;
+                rotated = 1;
+
+                double zeta = (beta - alpha) / (2.0 * gamma);
+                double t = (zeta >= 0.0 ? 1.0 : -1.0) / (fabs(zeta) + sqrt(1.0 + zeta * zeta));
+                double c = 1.0 / sqrt(1.0 + t * t);
+                double s = c * t;
+                for (size_t i = 0; i < p; i++) {
+                    double x = gj[i], y = gk[i];
+                    gj[i] = c * x - s * y;
+                    gk[i] = s * x + c * y;
+                }
+                double* vj = v + j * q;
+                double* vk = v + k * q;
+                for (size_t i = 0; i < q; i++) {
+                    double x = vj[i], y = vk[i];
+                    vj[i] = c * x - s * y;
+                    vk[i] = s * x + c * y;
+                }
+            }
+        }
+        if (!rotated) break;
+    }
+}
+
+int svd_jacobi(const float* a, size_t m, size_t n, float* u, float* s, float* vt) {
+    if (a == NULL || u == NULL || s == NULL || vt == NULL || m == 0 || n == 0) return -1;
+
+    // work on A when it is tall, on A^T when it is wide, so the rotated columns are the long side
+    int wide = m < n;
+    size_t p = wide ? n : m;
+    size_t q = wide ? m : n;
+
+    double* g = malloc(p * q * sizeof(double));
+    double* v = malloc(q * q * sizeof(double));
+    double* norms = malloc(q * sizeof(double));
+    size_t* order = malloc(q * sizeof(size_t));
+    if (g == NULL || v == NULL || norms == NULL || order == NULL) {
+        free(g);
+        free(v);
+        free(norms);
+        free(order);
+        return -1;
+    }
+
+    // columns of A, or rows of A when working on A^T
+    for (size_t j = 0; j < q; j++) {
+        for (size_t i = 0; i < p; i++) {
+            g[j * p + i] = wide ? (double)a[j * n + i] : (double)a[i * n + j];
+        }
+    }
+    jacobi(g, p, q, v);
+
+    for (size_t j = 0; j < q; j++) {
+        double sum = 0.0;
+        for (size_t i = 0; i < p; i++) sum += g[j * p + i] * g[j * p + i];
+        norms[j] = sqrt(sum);
+
+        // insertion sort, largest first; q is at most a few thousand
+        size_t r = j;
+        for (; r > 0 && norms[order[r - 1]] < norms[j]; r--) order[r] = order[r - 1];
+        order[r] = j;
+    }
+
+    // G = A V (or A^T V): the normalized columns of G are the left vectors and V holds the right ones
+    for (size_t r = 0; r < q; r++) {
+        size_t j = order[r];
+        double sigma = norms[j];
+        double inv = sigma > 0.0 ? 1.0 / sigma : 0.0;
+        s[r] = (float)sigma;
+        for (size_t i = 0; i < p; i++) {
+            float left = (float)(g[j * p + i] * inv);
+            if (wide) {
+                vt[r * n + i] = left;
+            } else {
+                u[i * q + r] = left;
+            }
+        }
+        for (size_t i = 0; i < q; i++) {
+            float right = (float)v[j * q + i];
+            if (wide) {
+                u[i * q + r] = right;
+            } else {
+                vt[r * n + i] = right;
+            }
+        }
+    }
+
+    free(g);
+    free(v);
+    free(norms);
+    free(order);
+    return 0;
+}
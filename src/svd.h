@@ -0,0 +1,16 @@
+#ifndef SVD_H
+#define SVD_H
+
+#include <stddef.h>
+
+/**
+ * Thin singular value decomposition A = U diag(s) V^T of a row-major m x n
+ * matrix, by one-sided Jacobi rotations in double precision. With k = min(m, n):
+ * u is m x k, s has k values in descending order, vt is k x n, all row-major.
+ * Accurate to about float precision and fine for the layer sizes here
+ * (cost is O(m n k) per sweep, typically under ten sweeps).
+ * Returns 0 on success, -1 on bad arguments or out of memory.
+ */
+int svd_jacobi(const float* a, size_t m, size_t n, float* u, float* s, float* vt);
+
+#endif // SVD_H
@@ -0,0 +1,246 @@
+#include "sweep.h"
+#include "optimizer.h"
+#include "parallel.h"
+#include "timer.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SWEEP_EVAL_BATCH 256
+#define SWEEP_MOMENTUM 0.9f
+
+static const char* const optimizer_names[] = { "sgd", "momentum", "nesterov", "adam", "adamw" };
+#define NUM_OPTIMIZERS (sizeof optimizer_names / sizeof optimizer_names[0])
+
+const char* sweep_optimizer_name(int optimizer) {
+    if (optimizer < 0 || (size_t)optimizer >= NUM_OPTIMIZERS) return "?";
+    return optimizer_names[optimizer];
+}
+
+int sweep_optimizer_type(const char* name) {
+    for (size_t i = 0; name != NULL && i < NUM_OPTIMIZERS; i++) {
+        if (strcmp(name, optimizer_names[i]) == 0) return (int)i;
+    }
+    return -1;
+}
+
+static Optimizer* create_optimizer(int type, float lr) {
+    switch (type) {
+    case OPTIMIZER_SGD: return optimizer_sgd_create(lr);
+    case OPTIMIZER_MOMENTUM: return optimizer_momentum_create(lr, SWEEP_MOMENTUM);
+    case OPTIMIZER_NESTEROV: return optimizer_nesterov_create(lr, SWEEP_MOMENTUM);
+    case OPTIMIZER_ADAM: return optimizer_adam_create(lr, 0.9f, 0.999f, 1e-8f);
+    case OPTIMIZER_ADAMW: return optimizer_adamw_create(lr, 0.9f, 0.999f, 1e-8f, 0.0f);
+    default: return NULL;
+    }
+}
+
+// in -> hidden -> relu -> classes -> softmax; NULL if any piece couldn't be made
+static AxiomNet* build_net(const SweepConfig* c, size_t in, size_t classes, uint64_t seed) {
+    if (c->hidden == 0 || c->batch_size == 0) return NULL;
+    AxiomNet* net = axiom_create();
+    Optimizer* opt = create_optimizer(c->optimizer, c->learning_rate);
+    if (net == NULL || opt == NULL) {
+        axiom_free(net);
+        optimizer_free(opt);
+        return NULL;
+    }
+    axiom_add(net, axiom_layer_dense(in, c->hidden), LAYER_DENSE);
+    axiom_add(net, axiom_activation_relu(), LAYER_ACTIVATION);
+    axiom_add(net, axiom_layer_dense(c->hidden, classes), LAYER_DENSE);
+    axiom_add(net, axiom_activation_softmax(), LAYER_ACTIVATION);
+    if (axiom_set_optimizer(net, opt) != 0 || net->num_layers != 4) {
+        axiom_free(net);
+        return NULL;
+    }
+    net->train_opts.seed = seed;
+    net->train_opts.verbose = 0;
+    return net;
+}
+
+typedef struct {
+    const Dataset* x_train;
+    const Dataset* y_train;
+    const Dataset* x_val;
+    const Dataset* y_val;
+    const SweepOptions* opts;
+    AxiomNet** nets;
+    SweepResult* results;
+    const size_t* alive;    // configs in this rung
+    size_t num_alive;
+    size_t budget;          // epochs each should have trained by the end of the rung
+    int inline_kernels;     // several models at once: each keeps its kernels on its own thread
+    atomic_size_t next;
+    pthread_mutex_t print_lock;
+} Sweep;
+
+static void train_one(Sweep* s, size_t i) {
+    AxiomNet* net = s->nets[i];
+    SweepResult* r = &s->results[i];
+    const SweepConfig* c = &r->config;
+
+    uint64_t start = timer_now_ns();
+    int trained = 1;
+    if (net->epochs_trained < s->budget) {
+        trained = axiom_train_dataset(net, s->x_train, s->y_train, s->budget - net->epochs_trained,
+                                      c->learning_rate, c->batch_size) == 0;
+    }
+    AxiomEvalResult eval;
+    if (!trained || net->epochs_trained < s->budget ||
+        axiom_evaluate(net, s->x_val, s->y_val, SWEEP_EVAL_BATCH, &eval) != 0) {
+        r->failed = 1;
+        r->val_accuracy = 0.0f;
+    } else {
+        r->val_accuracy = eval.accuracy;
+        axiom_eval_result_free(&eval);
+    }
+    r->train_ms += timer_elapsed_ms(start);
+    r->epochs = net->epochs_trained;
+    r->rungs++;
+
+    if (s->opts->verbose) {
+        pthread_mutex_lock(&s->print_lock);
+        printf("  %-8s lr=%-8.4g batch=%-4zu hidden=%-4zu %2zu epochs: ",
+               sweep_optimizer_name(c->optimizer), c->learning_rate, c->batch_size, c->hidden, r->epochs);
+        if (r->failed) printf("failed\n");
+        else printf("%.2f%% (%.1f s)\n", r->val_accuracy * 100.0f, r->train_ms / 1000.0);
+        fflush(stdout);
+        pthread_mutex_unlock(&s->print_lock);
+    }
+}
+
+static void* worker_main(void* arg) {
+    Sweep* s = arg;
+    int prev = parallel_set_inline(s->inline_kernels);
+    for (;;) {
+        size_t k = atomic_fetch_add(&s->next, 1);
+        if (k >= s->num_alive) break;
+        train_one(s, s->alive[k]);
+    }
+    parallel_set_inline(prev);
+    return NULL;
+}
+
+// run one rung on up to `workers` threads, the caller included
+static void run_rung(Sweep* s, size_t workers) {
+    if (workers > s->num_alive) workers = s->num_alive;
+    s->inline_kernels = workers > 1;
+    for (size_t k = 0; k < s->num_alive; k++) {
+        // the task graph wants the pool, which inline workers don't use
+        s->nets[s->alive[k]]->train_opts.task_graph = !s->inline_kernels;
+    }
+    atomic_store(&s->next, 0);
+
+    pthread_t* threads = workers > 1 ? malloc((workers - 1) * sizeof(pthread_t)) : NULL;
+    size_t started = 0;
+    while (threads != NULL && started < workers - 1 &&
+           pthread_create(&threads[started], NULL, worker_main, s) == 0) {
+        started++;
+    }
+    worker_main(s);
+    for (size_t t = 0; t < started; t++) pthread_join(threads[t], NULL);
+    free(threads);
+}
+
+// best first; failed configs last; ties keep config order
+static int ranks_before(const SweepResult* results, size_t a, size_t b) {
+    if (results[a].failed != results[b].failed) return results[b].failed;
+    if (results[a].val_accuracy != results[b].val_accuracy) return results[a].val_accuracy > results[b].val_accuracy;
+    return a < b;
+}
+
+static void rank_alive(size_t* alive, size_t n, const SweepResult* results) {
+    for (size_t i = 1; i < n; i++) {
+        size_t v = alive[i];
+        size_t j = i;
+        for (; j > 0 && ranks_before(results, v, alive[j - 1]); j--) alive[j] = alive[j - 1];
+        alive[j] = v;
+    }
+}
+
+int sweep_run(const Dataset* x_train, const Dataset* y_train, const Dataset* x_val, const Dataset* y_val,
+              const SweepConfig* configs, size_t n, const SweepOptions* opts,
+              SweepResult* results, AxiomNet** best) {
+    if (best != NULL) *best = NULL;
+    if (x_train == NULL || y_train == NULL || x_val == NULL || y_val == NULL || configs == NULL ||
+        opts == NULL || results == NULL || n == 0 || opts->max_epochs == 0) {
+        return -1;
+    }
+    size_t in = dataset_width(x_train), classes = dataset_width(y_train);
+    if (in == 0 || classes == 0 || dataset_width(x_val) != in || dataset_width(y_val) != classes) return -1;
+
+    AxiomNet** nets = calloc(n, sizeof(AxiomNet*));
+    size_t* alive = malloc(n * sizeof(size_t));
+    if (nets == NULL || alive == NULL) {
+        free(nets);
+        free(alive);
+        return -1;
+    }
+
+    // built here, not on the workers: layer init draws from the global rand() stream
+    size_t num_alive = 0;
+    for (size_t i = 0; i < n; i++) {
+        memset(&results[i], 0, sizeof results[i]);
+        results[i].config = configs[i];
+        nets[i] = build_net(&configs[i], in, classes, opts->seed);
+        if (nets[i] == NULL) results[i].failed = 1;
+        else alive[num_alive++] = i;
+    }
+
+    Sweep s = {
+        .x_train = x_train, .y_train = y_train, .x_val = x_val, .y_val = y_val,
+        .opts = opts, .nets = nets, .results = results, .alive = alive,
+    };
+    pthread_mutex_init(&s.print_lock, NULL);
+
+    size_t workers = opts->workers > 0 ? opts->workers : parallel_num_threads();
+    int halving = opts->eta >= 2;
+    size_t budget = opts->min_epochs > 0 ? opts->min_epochs : 1;
+    if (!halving || budget > opts->max_epochs) budget = opts->max_epochs;
+
+    for (size_t rung = 0; num_alive > 0; rung++) {
+        // a lone survivor has nothing left to race: train it to the end
+        if (num_alive == 1) budget = opts->max_epochs;
+        s.num_alive = num_alive;
+        s.budget = budget;
+        uint64_t start = timer_now_ns();
+        run_rung(&s, workers);
+        rank_alive(alive, num_alive, results);
+        if (opts->verbose) {
+            printf("Rung %zu: %zu configs to %zu epochs in %.1f s, best %.2f%%\n", rung, num_alive, budget,
+                   timer_elapsed_ms(start) / 1000.0, results[alive[0]].val_accuracy * 100.0f);
+        }
+        if (budget >= opts->max_epochs) break;
+
+        size_t keep = num_alive / opts->eta;
+        if (keep == 0) keep = 1;
+        for (size_t k = keep; k < num_alive; k++) {
+            results[alive[k]].pruned = 1;
+            axiom_free(nets[alive[k]]);
+            nets[alive[k]] = NULL;
+        }
+        num_alive = keep;
+        budget = budget > opts->max_epochs / opts->eta ? opts->max_epochs : budget * opts->eta;
+    }
+
+    // each rung only reorders and truncates the front of alive, so it ends as the standings:
+    // finalists, then the configs pruned at each earlier rung; ones that never built come last
+    size_t built = 0;
+    for (size_t i = 0; i < n; i++) built += nets[i] != NULL || results[i].pruned;
+    for (size_t k = 0; k < built; k++) results[alive[k]].rank = k + 1;
+    for (size_t i = 0, next = built + 1; i < n; i++) {
+        if (results[i].rank == 0) results[i].rank = next++;
+    }
+
+    if (best != NULL && num_alive > 0 && !results[alive[0]].failed) {
+        *best = nets[alive[0]];
+        nets[alive[0]] = NULL;
+    }
+    for (size_t i = 0; i < n; i++) axiom_free(nets[i]);
+    pthread_mutex_destroy(&s.print_lock);
+    free(nets);
+    free(alive);
+    return 0;
+}
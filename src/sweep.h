@@ -0,0 +1,65 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "axiom.h"
+#include "dataset.h"
+
+/**
+ * Hyperparameter sweep: many small nets (in -> hidden -> relu -> classes ->
+ * softmax) trained at once, one per worker thread, all reading the same
+ * read-only training Dataset. Nothing is copied per model, so a sweep over a
+ * memory-mapped file costs one mapping plus each model's own parameters and
+ * batches. Each worker runs its model's kernels serially on its own thread
+ * (see parallel_set_inline): with more configs than cores, whole models in
+ * parallel beat one model at a time spread over the pool.
+ *
+ * Configs are pruned by successive halving. Every surviving config trains up
+ * to the rung's epoch budget (min_epochs, then eta times that, and so on up
+ * to max_epochs), is scored on the validation set, and only the best
+ * 1/eta (at least one) go on to the next rung. Models keep their weights and
+ * optimizer state between rungs, so survivors continue rather than restart.
+ */
+typedef struct {
+    float learning_rate;
+    size_t batch_size;
+    size_t hidden;
+    int optimizer;          // OPTIMIZER_*; momentum and nesterov use 0.9
+} SweepConfig;
+
+typedef struct {
+    size_t workers;         // models trained at once; 0 = parallel_num_threads()
+    size_t min_epochs;      // first rung's budget
+    size_t max_epochs;      // last rung's budget
+    size_t eta;             // keep 1/eta per rung and grow the budget eta-fold; < 2 = no pruning
+    uint64_t seed;          // shuffle seed, shared so every config sees the same batches
+    int verbose;            // print a line per finished config and per rung
+} SweepOptions;
+
+typedef struct {
+    SweepConfig config;
+    size_t rank;            // final standing, 1 = best: finalists by accuracy, then by how far they got
+    size_t epochs;          // epochs trained before it finished or was pruned
+    size_t rungs;           // rungs it took part in
+    int pruned;             // dropped by successive halving before max_epochs
+    int failed;             // couldn't be built or scored
+    float val_accuracy;     // after its last rung
+    double train_ms;        // training and scoring time, summed over rungs
+} SweepResult;
+
+// Short name of an OPTIMIZER_* value, and back; -1 for an unknown name
+const char* sweep_optimizer_name(int optimizer);
+int sweep_optimizer_type(const char* name);
+
+/**
+ * Train configs[0..n) on (x_train, y_train) and rank them on (x_val, y_val).
+ * results[i] describes configs[i]. If best isn't NULL it receives the model
+ * of the rank 1 config (caller frees), or NULL if that one failed.
+ * Returns 0 on success, -1 on bad arguments or out of memory.
+ */
+int sweep_run(const Dataset* x_train, const Dataset* y_train, const Dataset* x_val, const Dataset* y_val,
+              const SweepConfig* configs, size_t n, const SweepOptions* opts,
+              SweepResult* results, AxiomNet** best);
+
+#endif // SWEEP_H
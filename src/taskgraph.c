@@ -0,0 +1,248 @@
+#define _POSIX_C_SOURCE 200809L
+#include "taskgraph.h"
+#include "parallel.h"
+#include "timer.h"
+#include "trace.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+typedef struct {
+    task_fn fn;
+    void* ctx;
+    const char* name;
+    int layer;
+    int num_deps;
+    int first_edge;       // successor list, in the order the dependencies were added; -1 if none
+    int last_edge;
+    atomic_int pending;   // dependencies still running in the current run
+} Task;
+
+typedef struct {
+    int task;
+    int next;
+} Edge;
+
+// ready tasks of one pool thread. the owner pushes and pops at the bottom
+// (newest first); thieves take from the top (oldest first).
+typedef struct {
+    pthread_mutex_t lock;
+    int* items;
+    size_t top;
+    size_t bottom;
+} Deque;
+
+struct TaskGraph {
+    Task* tasks;
+    size_t num_tasks;
+    size_t cap_tasks;
+    Edge* edges;
+    size_t num_edges;
+    size_t cap_edges;
+    Deque* deques;
+    size_t num_deques;    // allocated
+    size_t deque_cap;     // items each can hold; every task is pushed once per run, so num_tasks is enough
+    size_t slots;         // deques in use this run, one per thread
+    atomic_size_t remaining;
+    atomic_size_t steals;
+    _Atomic uint64_t busy_ns;
+};
+
+TaskGraph* taskgraph_create(size_t capacity) {
+    TaskGraph* g = calloc(1, sizeof(TaskGraph));
+    if (g == NULL) return NULL;
+    if (capacity == 0) capacity = 16;
+    g->tasks = malloc(capacity * sizeof(Task));
+    g->edges = malloc(2 * capacity * sizeof(Edge));
+    if (g->tasks == NULL || g->edges == NULL) {
+        taskgraph_free(g);
+        return NULL;
+    }
+    g->cap_tasks = capacity;
+    g->cap_edges = 2 * capacity;
+    return g;
+}
+
+void taskgraph_free(TaskGraph* graph) {
+    if (graph == NULL) return;
+    for (size_t i = 0; i < graph->num_deques; i++) {
+        pthread_mutex_destroy(&graph->deques[i].lock);
+        free(graph->deques[i].items);
+    }
+    free(graph->deques);
+    free(graph->tasks);
+    free(graph->edges);
+    free(graph);
+}
+
+void taskgraph_clear(TaskGraph* graph) {
+    if (graph == NULL) return;
+    graph->num_tasks = 0;
+    graph->num_edges = 0;
+}
+
+int taskgraph_add(TaskGraph* graph, task_fn fn, void* ctx, const char* name, int layer) {
+    if (graph == NULL || fn == NULL) return -1;
+    if (graph->num_tasks == graph->cap_tasks) {
+        Task* grown = realloc(graph->tasks, 2 * graph->cap_tasks * sizeof(Task));
+        if (grown == NULL) return -1;
+        graph->tasks = grown;
+        graph->cap_tasks *= 2;
+    }
+    Task* t = &graph->tasks[graph->num_tasks];
+    t->fn = fn;
+    t->ctx = ctx;
+    t->name = name;
+    t->layer = layer;
+    t->num_deps = 0;
+    t->first_edge = -1;
+    t->last_edge = -1;
+    atomic_init(&t->pending, 0);
+    return (int)graph->num_tasks++;
+}
+
+int taskgraph_depend(TaskGraph* graph, int task, int on) {
+    if (graph == NULL || task < 0 || on < 0 || task == on) return -1;
+    if ((size_t)task >= graph->num_tasks || (size_t)on >= graph->num_tasks) return -1;
+    if (graph->num_edges == graph->cap_edges) {
+        Edge* grown = realloc(graph->edges, 2 * graph->cap_edges * sizeof(Edge));
+        if (grown == NULL) return -1;
+        graph->edges = grown;
+        graph->cap_edges *= 2;
+    }
+    int e = (int)graph->num_edges++;
+    graph->edges[e] = (Edge){ .task = task, .next = -1 };
+    Task* from = &graph->tasks[on];
+    if (from->last_edge < 0) {
+        from->first_edge = e;
+    } else {
+        graph->edges[from->last_edge].next = e;
+    }
+    from->last_edge = e;
+    graph->tasks[task].num_deps++;
+    return 0;
+}
+
+// make room for `slots` deques of num_tasks items each
+static int reserve_deques(TaskGraph* g, size_t slots) {
+    if (g->num_tasks > g->deque_cap) {
+        for (size_t i = 0; i < g->num_deques; i++) {
+            int* grown = realloc(g->deques[i].items, g->num_tasks * sizeof(int));
+            if (grown == NULL) return -1;
+            g->deques[i].items = grown;
+        }
+        g->deque_cap = g->num_tasks;
+    }
+    if (slots > g->num_deques) {
+        Deque* grown = realloc(g->deques, slots * sizeof(Deque));
+        if (grown == NULL) return -1;
+        g->deques = grown;
+        for (; g->num_deques < slots; g->num_deques++) {
+            Deque* d = &g->deques[g->num_deques];
+            d->items = malloc((g->deque_cap > 0 ? g->deque_cap : 1) * sizeof(int));
+            if (d->items == NULL) return -1;
+            pthread_mutex_init(&d->lock, NULL);
+        }
+    }
+    for (size_t i = 0; i < slots; i++) g->deques[i].top = g->deques[i].bottom = 0;
+    return 0;
+}
+
+static void deque_push(Deque* d, int task) {
+    pthread_mutex_lock(&d->lock);
+    d->items[d->bottom++] = task;
+    pthread_mutex_unlock(&d->lock);
+}
+
+static int deque_pop(Deque* d) {
+    int task = -1;
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom > d->top) task = d->items[--d->bottom];
+    if (d->bottom == d->top) d->top = d->bottom = 0;
+    pthread_mutex_unlock(&d->lock);
+    return task;
+}
+
+static int deque_steal(Deque* d) {
+    int task = -1;
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom > d->top) task = d->items[d->top++];
+    if (d->bottom == d->top) d->top = d->bottom = 0;
+    pthread_mutex_unlock(&d->lock);
+    return task;
+}
+
+static void run_task(TaskGraph* g, int id, size_t slot) {
+    Task* t = &g->tasks[id];
+    uint64_t start = timer_now_ns();
+    t->fn(t->ctx);
+    uint64_t end = timer_now_ns();
+    trace_end(trace_enabled() ? start : 0, t->name, t->layer);
+    atomic_fetch_add_explicit(&g->busy_ns, end - start, memory_order_relaxed);
+
+    for (int e = t->first_edge; e >= 0; e = g->edges[e].next) {
+        int next = g->edges[e].task;
+        if (atomic_fetch_sub(&g->tasks[next].pending, 1) == 1) deque_push(&g->deques[slot], next);
+    }
+    atomic_fetch_sub(&g->remaining, 1);
+}
+
+// one thread's scheduler loop; returns once every task in the graph has finished
+static void run_slots(void* ctx, size_t begin, size_t end) {
+    TaskGraph* g = ctx;
+    for (size_t slot = begin; slot < end; slot++) {
+        while (atomic_load(&g->remaining) > 0) {
+            int id = deque_pop(&g->deques[slot]);
+            for (size_t i = 1; id < 0 && i < g->slots; i++) {
+                id = deque_steal(&g->deques[(slot + i) % g->slots]);
+                if (id >= 0) atomic_fetch_add_explicit(&g->steals, 1, memory_order_relaxed);
+            }
+            if (id < 0) {
+                sched_yield();  // everything ready is running; wait for a dependency to finish
+                continue;
+            }
+            run_task(g, id, slot);
+        }
+    }
+}
+
+int taskgraph_run(TaskGraph* graph, TaskGraphStats* stats) {
+    if (graph == NULL) return -1;
+    if (graph->num_tasks == 0) return 0;
+
+    size_t slots = parallel_num_threads();
+    if (slots > graph->num_tasks) slots = graph->num_tasks;
+    if (reserve_deques(graph, slots) != 0) return -1;
+    graph->slots = slots;
+
+    // ready tasks are dealt out round robin so every thread starts with work
+    size_t ready = 0;
+    for (size_t i = 0; i < graph->num_tasks; i++) {
+        Task* t = &graph->tasks[i];
+        atomic_store(&t->pending, t->num_deps);
+        if (t->num_deps == 0) {
+            Deque* d = &graph->deques[ready++ % slots];
+            d->items[d->bottom++] = (int)i;
+        }
+    }
+    if (ready == 0) return -1;
+
+    atomic_store(&graph->remaining, graph->num_tasks);
+    atomic_store(&graph->steals, 0);
+    atomic_store(&graph->busy_ns, 0);
+    uint64_t start = timer_now_ns();
+    parallel_for(slots, 1, run_slots, graph);
+    uint64_t wall = timer_now_ns() - start;
+
+    if (stats != NULL) {
+        stats->runs++;
+        stats->tasks += graph->num_tasks;
+        stats->steals += atomic_load(&graph->steals);
+        stats->threads = slots;
+        stats->wall_ns += wall;
+        stats->busy_ns += atomic_load(&graph->busy_ns);
+        stats->slot_ns += wall * slots;
+    }
+    return 0;
+}
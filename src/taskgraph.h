@@ -0,0 +1,50 @@
+#ifndef TASKGRAPH_H
+#define TASKGRAPH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A small dependency-graph runtime. Tasks are added with their dependencies,
+ * then taskgraph_run executes the whole graph on the shared worker pool: every
+ * pool thread has its own deque of ready tasks, pops its newest task first,
+ * and when the deque runs dry steals the oldest from another thread. A
+ * finished task pushes the successors it made ready onto its own thread's
+ * deque, so a chain of dependent ops tends to stay on one core while the
+ * side branches are taken by idle threads.
+ *
+ * Kernels called from a task that use parallel_for run inline on that task's
+ * thread. The graph must be acyclic.
+ */
+typedef void (*task_fn)(void* ctx);
+
+typedef struct TaskGraph TaskGraph;
+
+typedef struct {
+    size_t runs;
+    size_t tasks;       // executed, over all runs
+    size_t steals;      // tasks taken from another thread's deque
+    size_t threads;     // threads the last run used
+    uint64_t wall_ns;   // time inside taskgraph_run
+    uint64_t busy_ns;   // time spent in task bodies, all threads
+    uint64_t slot_ns;   // wall_ns times the threads each run used; busy_ns / slot_ns is the utilization
+} TaskGraphStats;
+
+TaskGraph* taskgraph_create(size_t capacity);
+void taskgraph_free(TaskGraph* graph);
+
+// Remove every task, keeping the memory for the next graph
+void taskgraph_clear(TaskGraph* graph);
+
+// Add a task; returns its id, or -1 when out of memory. `name` and `layer`
+// label it in traces (TRACE_NO_LAYER for none) and must outlive the run.
+int taskgraph_add(TaskGraph* graph, task_fn fn, void* ctx, const char* name, int layer);
+
+// `task` may only start once `on` has finished. Returns 0, or -1 on bad ids
+int taskgraph_depend(TaskGraph* graph, int task, int on);
+
+// Run every task once and return when all have finished. Stats, if given,
+// are added to. Returns -1 if no task is free to start, or out of memory
+int taskgraph_run(TaskGraph* graph, TaskGraphStats* stats);
+
+#endif // TASKGRAPH_H
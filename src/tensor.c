@@ -1,4 +1,7 @@
 #include "tensor.h"
+#include "parallel.h"
+#include "simd.h"
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
@@ -50,17 +53,61 @@ Tensor* tensor_create(size_t* shape, size_t ndim) {
     // initialize fields
     tensor->ndim = ndim;
     tensor->size = total_size;
+    tensor->owns_data = 1;
+    tensor->mem_category = mem_category();
+    tensor->mem_bytes = sizeof(Tensor) + 2 * ndim * sizeof(size_t) + total_size * sizeof(float);
+    mem_track_alloc((MemCategory)tensor->mem_category, tensor->mem_bytes);
 
     return tensor;
 }
 
+Tensor* tensor_view(float* data, size_t* shape, size_t ndim) {
+    if (data == NULL || shape == NULL || ndim == 0) return NULL;
+
+    // same metadata as tensor_create, but data points at caller-owned memory and tensor_free leaves it alone
+    Tensor* view = malloc(sizeof(Tensor));
+    if (view == NULL) return NULL;
+
+    view->shape = malloc(ndim * sizeof(size_t));
+    view->strides = malloc(ndim * sizeof(size_t));
+    if (view->shape == NULL || view->strides == NULL) {
+        free(view->shape);
+        free(view->strides);
+        free(view);
+        return NULL;
+    }
+
+    size_t total_size = 1;
+    for (size_t i = 0; i < ndim; i++) {
+        view->shape[i] = shape[i];
+        total_size *= shape[i];
+    }
+
+    view->strides[ndim - 1] = 1;
+    for (size_t k = 1; k < ndim; k++) {
+        size_t i = ndim - 1 - k;
+        view->strides[i] = view->strides[i + 1] * shape[i + 1];
+    }
+
+    view->data = data;
+    view->ndim = ndim;
+    view->size = total_size;
+    view->owns_data = 0;
+    view->mem_category = mem_category();
+    view->mem_bytes = sizeof(Tensor) + 2 * ndim * sizeof(size_t);
+    mem_track_alloc((MemCategory)view->mem_category, view->mem_bytes);
+
+    return view;
+}
+
 void tensor_free(Tensor* t) {
     if (t == NULL) return;
 
     // only freeing these here bc they were created w malloc, ndim and size aren't pointers;
+    mem_track_free((MemCategory)t->mem_category, t->mem_bytes);
     free(t->strides);
     free(t->shape);
-    free(t->data);
+    if (t->owns_data) free(t->data);
     free(t);
 }
 
@@ -111,6 +158,112 @@ Tensor* tensor_matmul(const Tensor* a, const Tensor* b) {
     return result;
 }
 
+size_t tensor_packed_size(size_t k, size_t n) {
+    return (n + TENSOR_PANEL - 1) / TENSOR_PANEL * TENSOR_PANEL * k;
+}
+
+void tensor_pack_panels(const float* b, size_t k, size_t n, size_t row_stride, size_t col_stride, float* packed) {
+    for (size_t q = 0; q * TENSOR_PANEL < n; q++) {
+        float* panel = packed + q * k * TENSOR_PANEL;
+        for (size_t r = 0; r < k; r++) {
+            for (size_t c = 0; c < TENSOR_PANEL; c++) {
+                size_t j = q * TENSOR_PANEL + c;
+                panel[r * TENSOR_PANEL + c] = j < n ? b[r * row_stride + j * col_stride] : 0.0f;
+            }
+        }
+    }
+}
+
+// out[r][0..8) += sum over k of a_r[k] * half[k][0..8) for four rows of a; half is 8 columns of a
+// panel (row stride TENSOR_PANEL). sums run over k in order from out's starting values (zero on a
+// product's first depth block), so splitting k into blocks adds exactly what tensor_matmul adds
+static void kernel_4x8(const float* const a[4], size_t a_col, size_t k, const float* half, float out[4][8]) {
+    f32x4 c00 = f32x4_load(out[0]), c01 = f32x4_load(out[0] + 4), c10 = f32x4_load(out[1]), c11 = f32x4_load(out[1] + 4);
+    f32x4 c20 = f32x4_load(out[2]), c21 = f32x4_load(out[2] + 4), c30 = f32x4_load(out[3]), c31 = f32x4_load(out[3] + 4);
+    for (size_t r = 0; r < k; r++) {
+        f32x4 b0 = f32x4_load(half + r * TENSOR_PANEL);
+        f32x4 b1 = f32x4_load(half + r * TENSOR_PANEL + 4);
+        f32x4 a0 = f32x4_set1(a[0][r * a_col]), a1 = f32x4_set1(a[1][r * a_col]);
+        f32x4 a2 = f32x4_set1(a[2][r * a_col]), a3 = f32x4_set1(a[3][r * a_col]);
+        c00 += a0 * b0; c01 += a0 * b1;
+        c10 += a1 * b0; c11 += a1 * b1;
+        c20 += a2 * b0; c21 += a2 * b1;
+        c30 += a3 * b0; c31 += a3 * b1;
+    }
+    f32x4_store(out[0], c00); f32x4_store(out[0] + 4, c01);
+    f32x4_store(out[1], c10); f32x4_store(out[1] + 4, c11);
+    f32x4_store(out[2], c20); f32x4_store(out[2] + 4, c21);
+    f32x4_store(out[3], c30); f32x4_store(out[3] + 4, c31);
+}
+
+typedef struct {
+    const Tensor* a;
+    const float* packed;
+    Tensor* c;
+    size_t kc;
+    size_t mc;
+} PackedJob;
+
+// row blocks [begin, end) of c: each block walks k a slab of kc at a time, and within a slab every
+// 8-column strip of every panel, so the slab stays in cache while the block's rows go over it
+static void packed_blocks(void* ctx, size_t begin, size_t end) {
+    const PackedJob* job = ctx;
+    const Tensor* a = job->a;
+    size_t m = a->shape[0], k = a->shape[1], n = job->c->shape[1];
+    float* c = job->c->data;
+    float out[4][8];
+
+    for (size_t i0 = begin * job->mc; i0 < m && i0 < end * job->mc; i0 += job->mc) {
+        size_t i1 = i0 + job->mc < m ? i0 + job->mc : m;
+        for (size_t k0 = 0; k0 < k; k0 += job->kc) {
+            size_t depth = k - k0 < job->kc ? k - k0 : job->kc;
+            for (size_t j = 0; j < n; j += 8) {
+                const float* half = job->packed + (j / TENSOR_PANEL) * k * TENSOR_PANEL + k0 * TENSOR_PANEL + j % TENSOR_PANEL;
+                size_t cols = n - j < 8 ? n - j : 8;
+                for (size_t i = i0; i < i1; i += 4) {
+                    // rows past i1 repeat row i and their sums are dropped
+                    const float* rows[4];
+                    for (size_t r = 0; r < 4; r++) {
+                        rows[r] = a->data + (i + r < i1 ? i + r : i) * a->strides[0] + k0 * a->strides[1];
+                        memset(out[r], 0, sizeof out[r]);
+                        if (k0 > 0) memcpy(out[r], c + (i + r < i1 ? i + r : i) * n + j, cols * sizeof(float));
+                    }
+                    kernel_4x8(rows, a->strides[1], depth, half, out);
+                    for (size_t r = 0; r < 4 && i + r < i1; r++) memcpy(c + (i + r) * n + j, out[r], cols * sizeof(float));
+                }
+            }
+        }
+    }
+}
+
+Tensor* tensor_matmul_packed(const Tensor* a, const float* packed, size_t n, const GemmTiling* tiling) {
+    if (a == NULL || packed == NULL || a->ndim != 2) return NULL;
+
+    size_t m = a->shape[0], k = a->shape[1];
+    size_t shape[] = {m, n};
+    Tensor* result = tensor_create(shape, 2);
+    if (result == NULL) return NULL;
+    if (m == 0 || n == 0) return result;
+    if (k == 0) {
+        memset(result->data, 0, m * n * sizeof(float));
+        return result;
+    }
+
+    GemmTiling t = tiling != NULL ? *tiling : GEMM_TILING_DEFAULT;
+    PackedJob job = {
+        .a = a, .packed = packed, .c = result,
+        .kc = t.kc > 0 && t.kc < k ? t.kc : k,
+        .mc = t.mc >= 4 ? t.mc / 4 * 4 : 4,
+    };
+    size_t blocks = (m + job.mc - 1) / job.mc;
+    if (t.threads <= 1 || blocks == 1) {
+        packed_blocks(&job, 0, blocks);
+    } else {
+        parallel_for(blocks, (blocks + t.threads - 1) / t.threads, packed_blocks, &job);
+    }
+    return result;
+}
+
 Tensor* tensor_add(const Tensor* a, const Tensor* b) {
     if (a == NULL || b == NULL) return NULL;
     if (a->ndim != b->ndim) return NULL;
@@ -215,6 +368,42 @@ Tensor* tensor_broadcast(const Tensor* t, size_t* new_shape, size_t new_ndim) {
     return result;
 }
 
+#define GATHER_PREFETCH_AHEAD 4          // rows fetched ahead of the one being copied
+#define GATHER_STREAM_BYTES (1u << 20)   // gathers at least this big bypass the cache
+
+void tensor_gather_rows(Tensor* dst, const Tensor* src, const size_t* rows, size_t n) {
+    if (dst == NULL || src == NULL || rows == NULL) return;
+    if (dst->ndim != 2 || src->ndim != 2 || dst->shape[1] != src->shape[1] || n > dst->shape[0]) return;
+
+    size_t len = src->shape[1];
+    const float* base = src->data;
+
+    // random rows defeat the hardware prefetcher, so ask for the next few explicitly.
+    // a batch bigger than cache would only evict the working set on its way through,
+    // so those are written with streaming stores instead
+    int stream = (n * len * sizeof(float) >= GATHER_STREAM_BYTES) &&
+                 len % SIMD_WIDTH == 0 && ((uintptr_t)dst->data % 16) == 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (i + GATHER_PREFETCH_AHEAD < n) {
+            const char* ahead = (const char*)(base + rows[i + GATHER_PREFETCH_AHEAD] * len);
+            for (size_t b = 0; b < len * sizeof(float); b += 64) simd_prefetch(ahead + b);
+        }
+
+        const float* from = base + rows[i] * len;
+        float* to = dst->data + i * len;
+        if (stream) {
+            for (size_t j = 0; j < len; j += SIMD_WIDTH) {
+                f32x4_stream(to + j, f32x4_load(from + j));
+            }
+        } else {
+            memcpy(to, from, len * sizeof(float));
+        }
+    }
+
+    if (stream) simd_stream_fence();
+}
+
 Tensor* tensor_apply(const Tensor* t, float (*func)(float)) {
     if (t == NULL || func == NULL) return NULL;
 
@@ -2,6 +2,7 @@
 #define TENSOR_H
 
 #include <stddef.h>
+#include "memstats.h"
 
 typedef struct {
     float* data;
@@ -9,12 +10,16 @@ typedef struct {
     size_t* strides;
     size_t ndim;
     size_t size;
+    int owns_data;  // 0 for views into memory owned elsewhere (e.g. the parameter arena)
+    int mem_category;  // MemCategory its bytes are accounted under: the thread's mem_category() at creation
+    size_t mem_bytes;  // bytes accounted: metadata, plus the data if owned
 } Tensor;
 
 // Tensor creation and memory management
 Tensor* tensor_create(size_t* shape, size_t ndim);
 void tensor_free(Tensor* t);
 Tensor* tensor_copy(const Tensor* t);
+Tensor* tensor_view(float* data, size_t* shape, size_t ndim);
 
 // Matrix operations
 Tensor* tensor_matmul(const Tensor* a, const Tensor* b);
@@ -23,6 +28,31 @@ Tensor* tensor_subtract(const Tensor* a, const Tensor* b);
 Tensor* tensor_transpose(const Tensor* t);
 Tensor* tensor_broadcast(const Tensor* t, size_t* new_shape, size_t new_ndim);
 
+// GEMM-packed right operand: B [k, n] split into ceil(n / TENSOR_PANEL) column panels, each
+// [k][TENSOR_PANEL] contiguous with the last one zero-padded, so the kernel streams a panel front
+// to back. Packing once and reusing it saves the strided walk over B on every multiply.
+#define TENSOR_PANEL 16
+size_t tensor_packed_size(size_t k, size_t n);  // floats
+// element (r, c) of B is b[r * row_stride + c * col_stride]: (n, 1) packs a row-major B, (1, k) packs B
+// from the row-major [n, k] matrix it's the transpose of
+void tensor_pack_panels(const float* b, size_t k, size_t n, size_t row_stride, size_t col_stride, float* packed);
+
+// How tensor_matmul_packed walks the product. Every tiling adds the same products in the same
+// order, so results never depend on it; src/autotune.h picks one per shape.
+typedef struct {
+    size_t kc;       // depth per pass, so a [kc][TENSOR_PANEL] slab stays cached across a row block; 0 = all of k
+    size_t mc;       // rows of a per block, a multiple of 4
+    size_t threads;  // row blocks are spread over up to this many pool threads; 1 = serial
+} GemmTiling;
+#define GEMM_TILING_DEFAULT ((GemmTiling){ .kc = 0, .mc = 4, .threads = 1 })
+
+// a [m, k] times packed B [k, n]; each element sums the same products in the same order as
+// tensor_matmul. tiling may be NULL for GEMM_TILING_DEFAULT.
+Tensor* tensor_matmul_packed(const Tensor* a, const float* packed, size_t n, const GemmTiling* tiling);
+
+// Row gather: dst[i, :] = src[rows[i], :] for i < n. Both 2D, row-major, same row length.
+void tensor_gather_rows(Tensor* dst, const Tensor* src, const size_t* rows, size_t n);
+
 // Element-wise operations
 Tensor* tensor_apply(const Tensor* t, float (*func)(float));
 void tensor_fill(Tensor* t, float value);
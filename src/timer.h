@@ -0,0 +1,12 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+// Monotonic clock in nanoseconds; only differences are meaningful
+uint64_t timer_now_ns(void);
+
+// Milliseconds elapsed since a timer_now_ns() reading
+double timer_elapsed_ms(uint64_t start_ns);
+
+#endif // TIMER_H
@@ -0,0 +1,237 @@
+#define _POSIX_C_SOURCE 200809L
+#include "trace.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char* name;
+    int layer;
+    uint64_t start_ns;
+    uint64_t end_ns;
+} TraceEvent;
+
+// one per thread that has recorded; lives on the global list until trace_reset after its thread exits
+typedef struct TraceRing {
+    TraceEvent* events;        // TRACE_RING_EVENTS slots
+    atomic_size_t written;     // events ever recorded; the newest is at (written - 1) % TRACE_RING_EVENTS
+    unsigned tid;
+    int retired;               // owning thread has exited
+    char name[32];
+    struct TraceRing* next;
+} TraceRing;
+
+// aggregate of one (name, layer) pair for the summary
+typedef struct {
+    const char* name;
+    int layer;
+    size_t calls;
+    double total_ms;
+    double max_us;
+} TraceStat;
+
+atomic_int trace_active = 0;
+
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static TraceRing* rings = NULL;
+static unsigned next_tid = 0;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ring_key;
+
+static _Thread_local TraceRing* local_ring = NULL;
+static _Thread_local char local_name[32];
+
+static void ring_retire(void* arg) {
+    TraceRing* ring = arg;
+    pthread_mutex_lock(&rings_lock);
+    ring->retired = 1;
+    pthread_mutex_unlock(&rings_lock);
+}
+
+static void make_key(void) {
+    pthread_key_create(&ring_key, ring_retire);
+}
+
+static TraceRing* ring_create(void) {
+    TraceRing* ring = calloc(1, sizeof(TraceRing));
+    if (ring == NULL) return NULL;
+    ring->events = malloc(TRACE_RING_EVENTS * sizeof(TraceEvent));
+    if (ring->events == NULL) {
+        free(ring);
+        return NULL;
+    }
+    atomic_init(&ring->written, 0);
+    memcpy(ring->name, local_name, sizeof(ring->name));
+
+    pthread_once(&key_once, make_key);
+    pthread_setspecific(ring_key, ring);  // retires the ring when this thread exits
+
+    pthread_mutex_lock(&rings_lock);
+    ring->tid = next_tid++;
+    ring->next = rings;
+    rings = ring;
+    pthread_mutex_unlock(&rings_lock);
+    return ring;
+}
+
+void trace_record(const char* name, int layer, uint64_t start_ns, uint64_t end_ns) {
+    TraceRing* ring = local_ring;
+    if (ring == NULL) {
+        ring = local_ring = ring_create();
+        if (ring == NULL) return;
+    }
+
+    size_t n = atomic_load_explicit(&ring->written, memory_order_relaxed);
+    TraceEvent* e = &ring->events[n % TRACE_RING_EVENTS];
+    e->name = name;
+    e->layer = layer;
+    e->start_ns = start_ns;
+    e->end_ns = end_ns;
+    atomic_store_explicit(&ring->written, n + 1, memory_order_release);
+}
+
+void trace_set_enabled(int enable) {
+    atomic_store(&trace_active, enable != 0);
+}
+
+void trace_set_thread_name(const char* name) {
+    snprintf(local_name, sizeof(local_name), "%s", name != NULL ? name : "");
+    if (local_ring != NULL) memcpy(local_ring->name, local_name, sizeof(local_name));
+}
+
+void trace_reset(void) {
+    pthread_mutex_lock(&rings_lock);
+    TraceRing** link = &rings;
+    while (*link != NULL) {
+        TraceRing* ring = *link;
+        if (ring->retired) {
+            *link = ring->next;
+            free(ring->events);
+            free(ring);
+        } else {
+            atomic_store(&ring->written, 0);
+            link = &ring->next;
+        }
+    }
+    pthread_mutex_unlock(&rings_lock);
+}
+
+// index range of a ring's surviving events, oldest first
+static size_t ring_first(const TraceRing* ring, size_t* count) {
+    size_t written = atomic_load_explicit(&ring->written, memory_order_acquire);
+    *count = written < TRACE_RING_EVENTS ? written : TRACE_RING_EVENTS;
+    return written - *count;
+}
+
+int trace_write_chrome(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (f == NULL) return -1;
+
+    pthread_mutex_lock(&rings_lock);
+
+    // timestamps are relative to the earliest surviving event
+    uint64_t origin = UINT64_MAX;
+    for (TraceRing* ring = rings; ring != NULL; ring = ring->next) {
+        size_t count;
+        size_t first = ring_first(ring, &count);
+        for (size_t i = 0; i < count; i++) {
+            const TraceEvent* e = &ring->events[(first + i) % TRACE_RING_EVENTS];
+            if (e->start_ns < origin) origin = e->start_ns;
+        }
+    }
+
+    fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    int sep = 0;
+    for (TraceRing* ring = rings; ring != NULL; ring = ring->next) {
+        fprintf(f, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"",
+                sep ? ",\n" : "", ring->tid);
+        if (ring->name[0] != '\0') {
+            fprintf(f, "%s", ring->name);
+        } else {
+            fprintf(f, "thread %u", ring->tid);
+        }
+        fprintf(f, "\"}}");
+        sep = 1;
+
+        size_t count;
+        size_t first = ring_first(ring, &count);
+        for (size_t i = 0; i < count; i++) {
+            const TraceEvent* e = &ring->events[(first + i) % TRACE_RING_EVENTS];
+            fprintf(f, ",\n{\"name\": \"%s\", \"cat\": \"axiom\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, "
+                       "\"ts\": %.3f, \"dur\": %.3f",
+                    e->name, ring->tid, (double)(e->start_ns - origin) / 1e3,
+                    (double)(e->end_ns - e->start_ns) / 1e3);
+            if (e->layer != TRACE_NO_LAYER) fprintf(f, ", \"args\": {\"layer\": %d}", e->layer);
+            fprintf(f, "}");
+        }
+    }
+    fprintf(f, "\n]}\n");
+
+    pthread_mutex_unlock(&rings_lock);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+static int compare_stat_total(const void* a, const void* b) {
+    double x = ((const TraceStat*)a)->total_ms, y = ((const TraceStat*)b)->total_ms;
+    return (x < y) - (x > y);
+}
+
+void trace_print_summary(FILE* out) {
+    size_t cap = 64, num_stats = 0;
+    TraceStat* stats = malloc(cap * sizeof(TraceStat));
+    if (stats == NULL) return;
+
+    size_t events = 0, dropped = 0, threads = 0;
+    pthread_mutex_lock(&rings_lock);
+    for (TraceRing* ring = rings; ring != NULL; ring = ring->next) {
+        size_t count;
+        size_t first = ring_first(ring, &count);
+        if (count == 0) continue;
+        threads++;
+        events += count;
+        dropped += first;
+
+        for (size_t i = 0; i < count; i++) {
+            const TraceEvent* e = &ring->events[(first + i) % TRACE_RING_EVENTS];
+            // a handful of distinct ops, so a linear scan beats anything cleverer
+            size_t s = 0;
+            while (s < num_stats && !(stats[s].layer == e->layer && strcmp(stats[s].name, e->name) == 0)) s++;
+            if (s == num_stats) {
+                if (num_stats == cap) {
+                    TraceStat* grown = realloc(stats, 2 * cap * sizeof(TraceStat));
+                    if (grown == NULL) break;
+                    stats = grown;
+                    cap *= 2;
+                }
+                stats[num_stats++] = (TraceStat){ e->name, e->layer, 0, 0.0, 0.0 };
+            }
+            double us = (double)(e->end_ns - e->start_ns) / 1e3;
+            stats[s].calls++;
+            stats[s].total_ms += us / 1e3;
+            if (us > stats[s].max_us) stats[s].max_us = us;
+        }
+    }
+    pthread_mutex_unlock(&rings_lock);
+
+    double step_ms = 0.0;
+    for (size_t s = 0; s < num_stats; s++) {
+        if (strcmp(stats[s].name, "step") == 0) step_ms += stats[s].total_ms;
+    }
+    qsort(stats, num_stats, sizeof(TraceStat), compare_stat_total);
+
+    fprintf(out, "Trace: %zu events on %zu threads", events, threads);
+    if (dropped > 0) fprintf(out, " (%zu oldest overwritten)", dropped);
+    fprintf(out, "\n%-20s %5s %9s %11s %10s %10s %7s\n", "op", "layer", "calls", "total ms", "mean us", "max us", "% step");
+    for (size_t s = 0; s < num_stats; s++) {
+        const TraceStat* st = &stats[s];
+        char layer[16] = "-";
+        if (st->layer != TRACE_NO_LAYER) snprintf(layer, sizeof(layer), "%d", st->layer);
+        fprintf(out, "%-20s %5s %9zu %11.2f %10.2f %10.2f", st->name, layer, st->calls, st->total_ms,
+                1e3 * st->total_ms / (double)st->calls, st->max_us);
+        if (step_ms > 0.0) {
+            fprintf(out, " %6.1f%%", 100.0 * st->total_ms / step_ms);
+        }
+        fprintf(out, "\n");
+    }
+    free(stats);
+}
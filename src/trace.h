@@ -0,0 +1,75 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "timer.h"
+
+#define TRACE_RING_EVENTS 65536   // per thread; older events are overwritten once a ring is full
+#define TRACE_NO_LAYER -1
+
+/**
+ * Hot-path tracing. Instrumented code brackets a region with
+ *
+ *   uint64_t t0 = trace_begin();
+ *   ...
+ *   trace_end(t0, "dense_forward", layer_index);
+ *
+ * Each thread records into its own ring buffer, so recording takes no locks.
+ * Recording is off until trace_set_enabled(1), and while it is off
+ * trace_begin is one load and a branch. Building with -DAXIOM_NO_TRACE
+ * compiles the calls out altogether.
+ *
+ * Only the name pointer is stored, so names must outlive the trace (use literals).
+ * Reading the trace (trace_write_chrome, trace_print_summary, trace_reset)
+ * expects the traced work to have finished.
+ */
+
+#ifdef AXIOM_NO_TRACE
+
+static inline int trace_enabled(void) { return 0; }
+static inline uint64_t trace_begin(void) { return 0; }
+static inline void trace_end(uint64_t start_ns, const char* name, int layer) {
+    (void)start_ns;
+    (void)name;
+    (void)layer;
+}
+
+#else
+
+extern atomic_int trace_active;
+
+// Append one event to the calling thread's ring
+void trace_record(const char* name, int layer, uint64_t start_ns, uint64_t end_ns);
+
+static inline int trace_enabled(void) {
+    return atomic_load_explicit(&trace_active, memory_order_relaxed);
+}
+
+// 0 when tracing is off, which makes the matching trace_end a no-op
+static inline uint64_t trace_begin(void) {
+    return trace_enabled() ? timer_now_ns() : 0;
+}
+
+static inline void trace_end(uint64_t start_ns, const char* name, int layer) {
+    if (start_ns != 0) trace_record(name, layer, start_ns, timer_now_ns());
+}
+
+#endif
+
+void trace_set_enabled(int enable);
+
+// Label the calling thread in trace output (copied; at most 31 characters)
+void trace_set_thread_name(const char* name);
+
+// Drop everything recorded so far
+void trace_reset(void);
+
+// Chrome trace_event JSON (chrome://tracing, Perfetto). Returns 0 on success.
+int trace_write_chrome(const char* path);
+
+// Time per op and layer across all threads, largest first, as a share of "step" time when steps were traced
+void trace_print_summary(FILE* out);
+
+#endif // TRACE_H